@@ -89,13 +89,33 @@ void EvaluateRay(
                  int god_rays_b_size
                  );
 
-void ExecuteGodRaysReference(cl_float* p_input, cl_float* p_output, cl_uint width, cl_uint height, cl_uint blend, size_t global_work_size)
+void EvaluateRaysParallel(
+                 float* inBuf,
+                 int iw,
+                 int ih,
+                 int blend,
+                 float* outBuf,
+                 int num_rays,
+                 int num_threads
+                 );
+
+float ExecuteGodRaysReference(cl_float* p_input, cl_float* p_output, cl_uint width, cl_uint height, cl_uint blend, size_t global_work_size)
 {
+    double perf_start = time_stamp();
     // rays bunch loop
     for(cl_uint j = 0; j < global_work_size;j++)
     {
         EvaluateRay(p_input, width, height, blend, p_output, j, GOD_RAYS_BUNCH_SIZE);
     }
+    return (float)(time_stamp() - perf_start);
+}
+
+// multithreaded host path, used as a fallback when no OpenCL device is available
+float ExecuteGodRaysNative(cl_float* p_input, cl_float* p_output, cl_uint width, cl_uint height, cl_uint blend, size_t global_work_size, int num_threads)
+{
+    double perf_start = time_stamp();
+    EvaluateRaysParallel(p_input, width, height, blend, p_output, (int)(global_work_size*GOD_RAYS_BUNCH_SIZE), num_threads);
+    return (float)(time_stamp() - perf_start);
 }
 
 float ExecuteGodRaysKernel(cl_float* p_input, cl_float* p_output, cl_uint width, cl_uint height, cl_uint blend, size_t* p_global_work_size, OpenCLBasic &oclobjects, OpenCLProgramOneKernel &executable)
@@ -166,7 +186,28 @@ float ExecuteGodRaysKernel(cl_float* p_input, cl_float* p_output, cl_uint width,
 }
 
 
+// compare two output images, return count of mismatched values
+int VerifyOutput(cl_float* p_output, cl_float* p_ref, cl_uint width, cl_uint height, int max_error_count)
+{
+    int error_count = 0;
+    for(cl_uint i = 0; i < width*height*4; i++)
+    {
+            // Compare the data
+            if( fabsf(p_output[i] - p_ref[i]) > 0.01 )
+            {
+                printf("Error at location %d,  p_output = %f, p_ref = %f \n", i, p_output[i], p_ref[i]);
+                error_count++;
+                if(max_error_count>0 && error_count>=max_error_count)
+                    break;
+            }
+    }
+    return error_count;
+}
+
 // main execution routine - perform God Rays post-processing on float4 vectors
+// usage: GodRays [device_type] [native_threads]
+//   device_type    - OpenCL device type to run the kernel on ("cpu", "gpu", "all"), default "all"
+//   native_threads - number of host threads for the native path, 0 means all cores
 int main (int argc, const char** argv)
 {
     int ret = EXIT_SUCCESS; //return code
@@ -174,6 +215,7 @@ int main (int argc, const char** argv)
     // pointer to the HOST buffers
     cl_float*   p_input = NULL;
     cl_float*   p_output = NULL;
+    cl_float*   p_native = NULL;
     cl_float*   p_ref = NULL;
     
     cl_uint     width;
@@ -181,19 +223,39 @@ int main (int argc, const char** argv)
     cl_uint     blend=1;
     size_t      global_work_size = 0; // global work size will be calculated from input image size and local size
 
-    
+    string      device_type = argc > 1 ? argv[1] : "all";
+    int         native_threads = argc > 2 ? atoi(argv[2]) : 0;
+
     // Create the necessary OpenCL objects up to device queue.
-    OpenCLBasic oclobjects;
+    // If the OpenCL runtime or the requested device is not available,
+    // the multithreaded native path is used instead of the kernel.
+    OpenCLBasic* oclobjects = NULL;
+    OpenCLProgramOneKernel* executable = NULL;
+    try
+    {
+        oclobjects = new OpenCLBasic("0", device_type);
 
-    // Build kernel
-    OpenCLProgramOneKernel executable(oclobjects,L"../GodRays.cl","","GodRays");
+        // Build kernel
+        executable = new OpenCLProgramOneKernel(*oclobjects,L"../GodRays.cl","","GodRays");
+    }
+    catch(const Error& error)
+    {
+        cerr << "[ WARNING ] OpenCL is not available: " << error.what() << endl;
+        cerr << "[ WARNING ] Falling back to the native host implementation." << endl;
+        delete executable;
+        delete oclobjects;
+        executable = NULL;
+        oclobjects = NULL;
+    }
 
     // read input image
-    cl_uint     dev_alignment = zeroCopyPtrAlignment(oclobjects.device);
+    cl_device_id device = oclobjects ? oclobjects->device : 0;
+    cl_uint     dev_alignment = zeroCopyPtrAlignment(device);
     p_input = readInput(&width, &height,dev_alignment);
-    size_t aligned_size = zeroCopySizeAlignment(sizeof(cl_float) * 4 * width * height, oclobjects.device);
+    size_t aligned_size = zeroCopySizeAlignment(sizeof(cl_float) * 4 * width * height, device);
     printf("Input size is %d X %d\n", width, height);
     p_output = (cl_float*)aligned_malloc(aligned_size, dev_alignment);
+    p_native = (cl_float*)aligned_malloc(aligned_size, dev_alignment);
     p_ref = (cl_float*)aligned_malloc(aligned_size, dev_alignment);
 
     SaveImageAsBMP_32FC4(p_input,255.0f,width,height,"GodRaysInput.bmp");
@@ -202,28 +264,32 @@ int main (int argc, const char** argv)
     global_work_size = 2*(width + height-2)/GOD_RAYS_BUNCH_SIZE+1;
 
     // do god rays
-    printf("Executing OpenCL kernel...\n");
-    float ocl_time = ExecuteGodRaysKernel(p_input, p_output, width, height, blend, &global_work_size, oclobjects,executable);
+    float ocl_time = 0.0f;
+    if(executable)
+    {
+        printf("Executing OpenCL kernel...\n");
+        ocl_time = ExecuteGodRaysKernel(p_input, p_output, width, height, blend, &global_work_size, *oclobjects, *executable);
+    }
 
     printf("Executing reference...\n");
-    ExecuteGodRaysReference(p_input, p_ref, width, height, blend, global_work_size);
+    float ref_time = ExecuteGodRaysReference(p_input, p_ref, width, height, blend, global_work_size);
+
+    printf("Executing native multithreaded path...\n");
+    float native_time = ExecuteGodRaysNative(p_input, p_native, width, height, blend, global_work_size, native_threads);
 
-    SaveImageAsBMP_32FC4(p_output,255.0f,width,height,"GodRaysOutput.bmp");
+    if(executable)
+    {
+        SaveImageAsBMP_32FC4(p_output,255.0f,width,height,"GodRaysOutput.bmp");
+    }
+    SaveImageAsBMP_32FC4(p_native,255.0f,width,height,"GodRaysOutputNative.bmp");
     SaveImageAsBMP_32FC4(p_ref,255.0f,width,height,"GodRaysOutputReference.bmp");
 
     // Do verification
     printf("Performing verification...\n");
-    int error_count = 0;
-    for(cl_uint i = 0; i < width*height*4; i++)
+    int error_count = VerifyOutput(p_native, p_ref, width, height, max_error_count);
+    if(executable)
     {
-            // Compare the data
-            if( fabsf(p_output[i] - p_ref[i]) > 0.01 )
-            {
-                printf("Error at location %d,  p_output = %f, p_ref = %f \n", i, p_output[i], p_ref[i]);
-                error_count++;
-                if(max_error_count>0 && error_count>=max_error_count)
-                    break;
-            }
+        error_count += VerifyOutput(p_output, p_ref, width, height, max_error_count);
     }
     if(error_count)
     {
@@ -235,9 +301,18 @@ int main (int argc, const char** argv)
             printf("Verification succeeded.\n");
     }
 
-    printf("NDRange perf. counter time %f ms.\n",1000.0f*ocl_time);
-    
+    printf("Reference (1 thread) time %f ms.\n",1000.0f*ref_time);
+    printf("Native multithreaded time %f ms.\n",1000.0f*native_time);
+    if(executable)
+    {
+        printf("NDRange perf. counter time %f ms.\n",1000.0f*ocl_time);
+        printf("Native / NDRange time ratio %f\n", native_time/ocl_time);
+    }
+
+    delete executable;
+    delete oclobjects;
     aligned_free( p_ref );
+    aligned_free( p_native );
     aligned_free( p_input );
     aligned_free( p_output );
     return ret;
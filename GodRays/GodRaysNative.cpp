@@ -5,6 +5,10 @@
 #include "math.h"
 #endif
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #define GOD_RAYS_BUNCH_SIZE 15
 #define DECAY -0.01f
 #define WEIGHT 3.0f
@@ -35,7 +39,6 @@ void EvaluateRay(
         float _decay = (float)DECAY;
         float _Weight = (float)WEIGHT;
         float _InvExposure = (float)INVEXPOSURE;
-        float _fThreshold = (float)FTHRESHOLD;
 
         // Width of the image
         int x_last = iw - 1;
@@ -509,33 +512,40 @@ void EvaluateRay(
 
         // Apply the Bresenham loop and perform general computation.
 
+        // Express both Bresenham walks through their major and minor axes, so the
+        // main loop below has no per-step dimension checks and only advances
+        // coordinates by precomputed increments.
+        int maj_x   = dx >= dy ? xstep : 0;
+        int maj_y   = dx >= dy ? 0 : ystep;
+        int min_x   = dx >= dy ? 0 : xstep;
+        int min_y   = dx >= dy ? ystep : 0;
+        int dmaj2   = 2 * ( dx >= dy ? dx : dy );
+        int dmin2   = 2 * ( dx >= dy ? dy : dx );
+        int maj_x_s = dx_s >= dy_s ? xstep_s : 0;
+        int maj_y_s = dx_s >= dy_s ? 0 : ystep_s;
+        int min_x_s = dx_s >= dy_s ? 0 : xstep_s;
+        int min_y_s = dx_s >= dy_s ? ystep_s : 0;
+        int dmaj2_s = 2 * ( dx_s >= dy_s ? dx_s : dy_s );
+        int dmin2_s = 2 * ( dx_s >= dy_s ? dy_s : dx_s );
+
         // Load method parameters.
         __m128 Weight_128 = _mm_load_ps1( &_Weight );
         __m128 Decay_128 = _mm_load_ps1( &FixedDecay );
         FixedDecay = 1.f - FixedDecay;
         __m128 nDecay_128 = _mm_load_ps1( &FixedDecay );
         __m128 NExposure_128 = _mm_set_ps1( _InvExposure );
+        // Blending is folded into a multiplier instead of a branch per pixel.
+        __m128 Blend_128 = _mm_set_ps1( blend == 1 ? 1.f : 0.f );
         __m128 summ_128 = _mm_setzero_ps( );
-        __m128 One_128 = _mm_set_ps1( _fThreshold );
 
         // Load the first pixel of the ray.
-        __m128 sample_128 = _mm_load_ps(
-            (float*)
-            (
-            (char*)inBuf +
-            x * 4 * sizeof( float ) +
-            y * iw * 4 * sizeof(float))
-            );
+        __m128 sample_128 = _mm_load_ps( inBuf + ( y * iw + x ) * 4 );
 
         // Apply the exposure to it to scale color values to appropriate ranges.
         sample_128 = _mm_mul_ps( sample_128, NExposure_128 );
 
-        // Check to see if this pixel can be used in a sum.
-        ///if( _mm_movemask_ps( _mm_cmpgt_ps( sample_128, One_128 )) & 7 )
-        {
-            // Update the sum if required.
-            summ_128 = _mm_mul_ps( sample_128, nDecay_128 );
-        }
+        // Update the sum.
+        summ_128 = _mm_mul_ps( sample_128, nDecay_128 );
 
         // Check to see if the result can be written to the output pixel (the pixel is not
         // shaded by the shadow ray and it is not the first ray that should
@@ -546,93 +556,55 @@ void EvaluateRay(
             // Add the current sum value corrected by the Weight parameter to
             // the output buffer if possible.
             __m128 answer_128 = _mm_mul_ps( summ_128, Weight_128 );
-            //sample_128 = _mm_load_ps(outBuf+y*iw*sizeof(float)*4+x*sizeof(float)*4);
             answer_128 = _mm_add_ps( answer_128, sample_128 );
-            _mm_store_ps(
-                (float*)(
-                (char*)outBuf +
-                x * 4 * sizeof( float ) +
-                y*iw*sizeof(float)*4 ),
-                answer_128
-                );
+            _mm_store_ps( outBuf + ( y * iw + x ) * 4, answer_128 );
         }
 
         // In the main loop, go along the original ray.
         for( int is = 0; is < steps; is++ )
         {
             // Make steps in the Bresenham loop for the original ray.
-            if( dx >= dy )
+            x += maj_x;
+            y += maj_y;
+            if( di >= 0 )
             {
-                x += xstep;
-                if( di >= 0 )
-                {
-                    y += ystep;
-                    di -= 2*dx;
-                }
-                di += 2 * dy;
-            }
-            else
-            {
-                y += ystep;
-                if( di >= 0 )
-                {
-                    x += xstep;
-                    di -= 2*dy;
-                }
-                di += 2 * dx;
+                x += min_x;
+                y += min_y;
+                di -= dmaj2;
             }
+            di += dmin2;
 
             // Make steps for the shadow rays if if they should not be omitted.
             if( steps_begin >= 0 )
             {
-                if( dx_s >= dy_s )
+                x_s += maj_x_s;
+                y_s += maj_y_s;
+                if( di_s >= 0 )
                 {
-                    x_s += xstep_s;
-                    if( di_s >= 0 )
-                    {
-                        y_s += ystep_s;
-                        di_s -= 2*dx_s;
-                    }
-                    di_s += 2 * dy_s;
-                }
-                else
-                {
-                    y_s += ystep_s;
-                    if( di_s >= 0 )
-                    {
-                        x_s += xstep_s;
-                        di_s -= 2*dy_s;
-                    }
-                    di_s += 2*dx_s;
+                    x_s += min_x_s;
+                    y_s += min_y_s;
+                    di_s -= dmaj2_s;
                 }
+                di_s += dmin2_s;
             }
             else
             {
                 steps_begin++;
             }
 
-            // For each step, load the next pixel of the ray.
-            sample_128 = _mm_load_ps(
-                (float*)
-                (
-                (char*)inBuf+
-                y*iw*sizeof(float)*4+
-                x*sizeof(float)*4 )
-                );
+            // For each step, load the next pixel of the ray once; the raw value
+            // is reused below for blending.
+            const float* pixel = inBuf + ( y * iw + x ) * 4;
+            __m128 pixel_128 = _mm_load_ps( pixel );
 
-            // Apply the exposure to it to scale color values to appropriate ranges.
+            // Apply the decay to the sum.
             summ_128   = _mm_mul_ps( summ_128, Decay_128 );
 
-            // Update the sum
-            sample_128 = _mm_mul_ps( sample_128, NExposure_128);
-
-            // check if this pixel can be used in a sum and
-            ///if(( _mm_movemask_ps( _mm_cmpgt_ps( sample_128, One_128 )) & 7 ) != 0)
-            {
-                // update the sum if required.
-                sample_128 = _mm_mul_ps( sample_128, nDecay_128 );
-                summ_128   = _mm_add_ps( summ_128, sample_128 );
-            }
+            // Apply the exposure to scale color values to appropriate ranges
+            // and update the sum.
+            sample_128 = _mm_mul_ps( pixel_128, NExposure_128 );
+            sample_128 = _mm_mul_ps( sample_128, nDecay_128 );
+            summ_128   = _mm_add_ps( summ_128, sample_128 );
 
             // Check if it is possible to write the result to the output pixel.
             if( x != x_s || y != y_s || is >= steps_lsat )
@@ -640,38 +612,59 @@ void EvaluateRay(
                 // Update the output buffer by the current sum value
                 // corrected by the Weight parameter.
                 __m128 answer_128 = _mm_mul_ps( summ_128, Weight_128 );
-
-                sample_128 =
-                    _mm_load_ps(
-                    (float*)
-                    (
-                    (char*)inBuf +
-                    x * 4 * sizeof( float ) +
-                    y*iw*sizeof(float)*4
-                    )
-                    );
-
-                if(blend == 1){
-                    answer_128 = _mm_add_ps( answer_128, sample_128 );
-                    _mm_store_ps(
-                        (float*)(
-                        (char*)outBuf +
-                        x * 4 * sizeof( float ) +
-                        y*iw*sizeof(float)*4 ),
-                        answer_128
-                        );
-                }
-                else
-                {
-                    _mm_store_ps(
-                        (float*)(
-                        (char*)outBuf +
-                        x * 4 * sizeof( float ) +
-                        y*iw*sizeof(float)*4 ),
-                        answer_128
-                        );
-                }
+                answer_128 = _mm_add_ps( answer_128, _mm_mul_ps( pixel_128, Blend_128 ));
+                _mm_store_ps( outBuf + ( pixel - inBuf ), answer_128 );
             }
         }
     }
 }
+
+// Evaluates rays [0, num_rays) on num_threads host threads. Rays differ in
+// length by several times depending on which border they hit, so instead of a
+// static split the threads grab small bunches of rays from a shared counter
+// until all of them are processed. Neighbouring rays never write the same
+// output pixel (the shadow ray check above guarantees that), so no extra
+// synchronization is needed on the output buffer.
+void EvaluateRaysParallel(
+                 float* inBuf,
+                 int iw,
+                 int ih,
+                 int blend,
+                 float* outBuf,
+                 int num_rays,
+                 int num_threads
+                 )
+{
+    if( num_threads <= 0 )
+    {
+        num_threads = (int)std::thread::hardware_concurrency();
+        if( num_threads <= 0 )
+        {
+            num_threads = 1;
+        }
+    }
+
+    std::atomic<int> next_bunch( 0 );
+    int num_bunches = ( num_rays + GOD_RAYS_BUNCH_SIZE - 1 ) / GOD_RAYS_BUNCH_SIZE;
+
+    auto worker = [&]()
+    {
+        for( int b = next_bunch++; b < num_bunches; b = next_bunch++ )
+        {
+            // Rays past the last border ray leave EvaluateRay immediately,
+            // so the tail bunch needs no special handling.
+            EvaluateRay( inBuf, iw, ih, blend, outBuf, b, GOD_RAYS_BUNCH_SIZE );
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( int t = 1; t < num_threads; t++ )
+    {
+        threads.push_back( std::thread( worker ));
+    }
+    worker();
+    for( size_t t = 0; t < threads.size(); t++ )
+    {
+        threads[t].join();
+    }
+}
@@ -6,6 +6,8 @@
 
 #include <CL/cl.h>
 
+#include "device_profile.h"
+
 using namespace std;
 
 int main (int argc, const char** argv)
@@ -20,6 +22,10 @@ int main (int argc, const char** argv)
     // In the code it is used with CAPSBASIC_CHECK_ERRORS macro defined next.
     cl_int err = CL_SUCCESS;
 
+    // With --refresh the device profiles are measured again instead of
+    // being taken from the cache.
+    bool refresh_profiles = argc > 1 && strcmp(argv[1], "--refresh") == 0;
+
     // Error handling strategy for this sample is fairly simple -- just print
     // a message and terminate the application if something goes wrong.
 #define CAPSBASIC_CHECK_ERRORS(ERR)        \
@@ -277,6 +283,42 @@ int main (int argc, const char** argv)
             OCLBASIC_PRINT_NUMERIC_PROPERTY(CL_DEVICE_NATIVE_VECTOR_WIDTH_LONG, cl_uint);
             OCLBASIC_PRINT_NUMERIC_PROPERTY(CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT, cl_uint);
             OCLBASIC_PRINT_NUMERIC_PROPERTY(CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE, cl_uint);
+
+            // The same device as a capability profile, with the measured
+            // peaks; the first run on a machine measures and caches it.
+            DeviceProfile profile = getDeviceProfile(device, true, "", refresh_profiles);
+
+            cout << "\n    Capability profile (" << deviceProfilePath(profile, "") << "):\n";
+            printDeviceProfile(cout, profile);
+
+            // Variants of the GEMM kernels in gemm/V2 and of the row pass
+            // in oclBoxFilter, best first, and the one the profile selects.
+            static const KernelVariant gemm_variants[] =
+            {
+                { "MediaBlockRW_SIMD_2x32", "cl_intel_subgroups", 8, true, false, false, 0, false },
+                { "L3_SIMD_4x8x8", "cl_intel_subgroups", 8, false, false, false, 0, false },
+                { "Unoptimized", "", 0, false, false, false, 0, false }
+            };
+            static const KernelVariant box_filter_variants[] =
+            {
+                { "BoxRowsTex", "", 0, true, false, false, 0, false },
+                { "BoxRowsLmem", "", 0, false, false, false, 8*1024, true }
+            };
+
+#define OCLBASIC_PRINT_SELECTED_VARIANT(SAMPLE, VARIANTS)                           \
+            {                                                                       \
+            int selected = selectKernelVariant(                                     \
+            profile,                                                                \
+            VARIANTS,                                                               \
+            sizeof(VARIANTS)/sizeof(VARIANTS[0])                                    \
+            );                                                                      \
+            cout                                                                    \
+            << "    " << SAMPLE << " kernel: "                                      \
+            << (selected < 0 ? "none supported" : VARIANTS[selected].name) << endl; \
+            }
+
+            OCLBASIC_PRINT_SELECTED_VARIANT("gemm/V2", gemm_variants);
+            OCLBASIC_PRINT_SELECTED_VARIANT("oclBoxFilter rows", box_filter_variants);
         }
 
         delete [] devices_of_type;
@@ -0,0 +1,106 @@
+// Capability profile of an OpenCL device: the properties kernels are usually
+// specialized on, plus peak memory bandwidth and arithmetic throughput
+// measured with two small kernels. Profiles are cached on disk per device
+// and driver, so only the first run on a machine pays for the measurement.
+//
+// A sample describes its kernel variants with their requirements, best
+// variant first, and selectKernelVariant picks the first one the device can
+// run, instead of asking the user with a command-line flag.
+
+#ifndef _DEVICE_PROFILE_H_
+#define _DEVICE_PROFILE_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <CL/cl.h>
+
+
+struct DeviceProfile
+{
+    std::string name;
+    std::string vendor;
+    std::string version;
+    std::string driver_version;
+    std::string opencl_c_version;
+    std::string extensions;             // space separated, as reported
+    cl_device_type type;
+
+    cl_uint compute_units;
+    cl_uint clock_mhz;
+    size_t max_work_group_size;
+    cl_ulong global_mem_size;
+    cl_ulong max_alloc_size;
+    cl_ulong local_mem_size;
+    bool local_mem_dedicated;           // CL_LOCAL, not emulated in global memory
+    bool image_support;
+    bool fp16;
+    bool fp64;
+    bool unified_memory;
+
+    cl_uint preferred_width_char;
+    cl_uint preferred_width_short;
+    cl_uint preferred_width_int;
+    cl_uint preferred_width_float;
+    cl_uint preferred_width_double;
+    cl_uint preferred_width_half;
+
+    // CL_DEVICE_SUB_GROUP_SIZES_INTEL; empty when the driver doesn't tell
+    std::vector<size_t> subgroup_sizes;
+
+    // Microbenchmark results, valid when measured is true
+    bool measured;
+    double bandwidth_gbs;               // device memory copy, read + write
+    double gflops;                      // single precision mad
+
+    bool hasExtension (const std::string& extension) const;
+    bool hasSubgroupSize (size_t size) const;
+};
+
+
+// Reads the properties from the driver; no measurement
+DeviceProfile queryDeviceProfile (cl_device_id device);
+
+// Runs the bandwidth and FLOPS microbenchmarks on the device
+void measureDeviceProfile (cl_device_id device, DeviceProfile& profile);
+
+// Profile of the device from the cache in cache_dir (the current directory
+// when empty), or queried, measured if requested, and stored there.
+// A cached profile is only used while the driver version doesn't change;
+// refresh ignores the cache.
+DeviceProfile getDeviceProfile (
+    cl_device_id device,
+    bool measure = true,
+    const std::string& cache_dir = "",
+    bool refresh = false
+);
+
+std::string deviceProfilePath (const DeviceProfile& profile, const std::string& cache_dir);
+bool loadDeviceProfile (const std::string& path, DeviceProfile& profile);
+bool saveDeviceProfile (const std::string& path, const DeviceProfile& profile);
+
+void printDeviceProfile (std::ostream& out, const DeviceProfile& profile);
+
+
+// One implementation of a kernel and what it needs from the device
+struct KernelVariant
+{
+    const char* name;
+    const char* extensions;             // space separated, all required; may be empty
+    size_t subgroup_size;               // required sub-group size, 0 for any
+    bool images;
+    bool fp16;
+    bool fp64;
+    cl_ulong local_mem;                 // bytes of local memory used
+    bool dedicated_local_mem;           // only worth it with CL_LOCAL memory
+};
+
+// Whether the device meets the requirements of the variant
+bool isVariantSupported (const DeviceProfile& profile, const KernelVariant& variant);
+
+// Index of the first supported variant in the list (ordered best first),
+// or -1 when none is supported
+int selectKernelVariant (const DeviceProfile& profile, const KernelVariant* variants, size_t count);
+
+#endif
@@ -24,6 +24,8 @@
 #include <CL/cl.h>
 #include <immintrin.h>
 
+#include "device_profile.h"
+
 // Linux-specific definitions
 #if defined(__linux__)
 #include <cstdint>
@@ -336,6 +338,7 @@ static double theoretical_peak_float_perf = 0.0;
 
 enum TEST_TYPE {
    TEST_TYPE_INVALID = 0,
+   TEST_TYPE_AUTO,
    TEST_TYPE_ALL = 100,
    TEST_TYPE_UNOPTIMIZED,
    TEST_TYPE_SIMD_4x8x8,
@@ -638,12 +641,40 @@ void runTests(cl_uint start, cl_uint end)
    }
 }
 
+// Kernels the "auto" test type chooses from, best first.  The fp16 kernel is
+// left out: it doesn't compute the same result as the float ones.
+static const KernelVariant auto_variants[] = {
+   {"MediaBlockRW_SIMD_2x32", "cl_intel_subgroups", 8, true, false, false, 0, false},
+   {"L3_SIMD_4x8x8", "cl_intel_subgroups", 8, false, false, false, 0, false},
+   {"Unoptimized", "", 0, false, false, false, 0, false},
+};
+static const cl_uint auto_test_types[] = {
+   TEST_TYPE_SIMD_IMAGESRW_2x32,
+   TEST_TYPE_SIMD_4x8x8,
+   TEST_TYPE_UNOPTIMIZED,
+};
+
+cl_uint selectTestType(cl_device_id device)
+{
+   // The profile only needs the device properties here; a cached profile
+   // from device_caps is used when there is one.
+   DeviceProfile profile = getDeviceProfile(device, false);
+   int selected = selectKernelVariant(profile, auto_variants,
+                                      sizeof(auto_variants) / sizeof(auto_variants[0]));
+   if (selected < 0)
+      return TEST_TYPE_INVALID;
+
+   printf("# auto selected kernel: %s\n", auto_variants[selected].name);
+   return auto_test_types[selected];
+}
+
 void help(int argc, char **argv)
 {
    printf
        ("Usage: %s [kernel name] [matrix size] [kernel build option] [max gpu frequency in MHz]\n",
         argv[0]);
-   printf("  kernel name             : all\n");
+   printf("  kernel name             : all, auto, unoptimized, SIMD_4x8x8,\n"
+          "                            SIMD_ImagesRW_2x32, SIMD_Images_1x16_2_fp16\n");
    printf
        ("  matrix size             : %d (square mat) or %dx%dx%d (non-square mat)\n",
         dimM, dimM, dimK, dimN);
@@ -670,6 +701,8 @@ int main(int argc, char **argv)
          std::string tmp = argv[1];
          if (tmp.compare("all") == 0)
             test_type = TEST_TYPE_ALL;
+         if (tmp.compare("auto") == 0)
+            test_type = TEST_TYPE_AUTO;
          if (tmp.compare("unoptimized") == 0)
             test_type = TEST_TYPE_UNOPTIMIZED;
          if (tmp.compare("SIMD_4x8x8") == 0)
@@ -746,6 +779,8 @@ int main(int argc, char **argv)
 
    context = clCreateContext(0, 1, &device, NULL, NULL, &err);
    CHK_ERR(err);
+   if (test_type == TEST_TYPE_AUTO)
+      test_type = selectTestType(device);
    if (test_type == TEST_TYPE_INVALID)
    {
       printf("Invalid test name!\n");
@@ -0,0 +1,542 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "device_profile.h"
+
+using namespace std;
+
+// cl_intel_required_subgroup_size
+#ifndef CL_DEVICE_SUB_GROUP_SIZES_INTEL
+#define CL_DEVICE_SUB_GROUP_SIZES_INTEL 0x4108
+#endif
+
+// Version of the cache file layout; older files are ignored
+#define DEVICE_PROFILE_FORMAT 1
+
+#define DEVICE_PROFILE_CHECK_ERRORS(ERR)   \
+    if(ERR != CL_SUCCESS)                  \
+    {                                      \
+    cerr                                   \
+    << "OpenCL error with code " << ERR    \
+    << " happened in file " << __FILE__    \
+    << " at line " << __LINE__             \
+    << ". Exiting...\n";                   \
+    exit(1);                               \
+    }
+
+
+namespace
+{
+
+string deviceString (cl_device_id device, cl_device_info name)
+{
+    size_t length = 0;
+    cl_int err = clGetDeviceInfo(device, name, 0, 0, &length);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    vector<char> value(length + 1, 0);
+    err = clGetDeviceInfo(device, name, length, &value[0], 0);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+    return string(&value[0]);
+}
+
+template <typename T>
+T deviceNumber (cl_device_id device, cl_device_info name)
+{
+    T value = 0;
+    cl_int err = clGetDeviceInfo(device, name, sizeof(value), &value, 0);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+    return value;
+}
+
+// Properties that appeared after OpenCL 1.0 or come from extensions;
+// zero when the driver doesn't know them
+template <typename T>
+T optionalDeviceNumber (cl_device_id device, cl_device_info name)
+{
+    T value = 0;
+    if(clGetDeviceInfo(device, name, sizeof(value), &value, 0) != CL_SUCCESS)
+    {
+        return 0;
+    }
+    return value;
+}
+
+// Kernels of the microbenchmarks. Four independent mad chains keep the ALUs
+// busy without depending on the latency of one chain; the result is stored
+// so the compiler cannot drop the loop.
+const char* benchmark_source =
+    "kernel void copyBandwidth (global const float4* src, global float4* dst)  \n"
+    "{                                                                          \n"
+    "    size_t i = get_global_id(0);                                           \n"
+    "    dst[i] = src[i];                                                       \n"
+    "}                                                                          \n"
+    "                                                                           \n"
+    "kernel void madThroughput (global float* out, float a, float b)            \n"
+    "{                                                                          \n"
+    "    float x0 = get_global_id(0), x1 = x0 + 1, x2 = x0 + 2, x3 = x0 + 3;    \n"
+    "    for(int i = 0; i < 256; ++i)                                           \n"
+    "    {                                                                      \n"
+    "        x0 = mad(x0, a, b); x1 = mad(x1, a, b);                            \n"
+    "        x2 = mad(x2, a, b); x3 = mad(x3, a, b);                            \n"
+    "        x0 = mad(x0, a, b); x1 = mad(x1, a, b);                            \n"
+    "        x2 = mad(x2, a, b); x3 = mad(x3, a, b);                            \n"
+    "    }                                                                      \n"
+    "    out[get_global_id(0)] = x0 + x1 + x2 + x3;                             \n"
+    "}                                                                          \n"
+;
+
+const double MAD_FLOPS_PER_ITEM = 256 * 8 * 2;
+
+// Best of a few runs, in seconds
+double timeKernel (
+    cl_command_queue queue,
+    cl_kernel kernel,
+    size_t global_size,
+    int runs
+)
+{
+    double best = 0;
+    for(int run = 0; run <= runs; ++run)
+    {
+        cl_event event;
+        cl_int err = clEnqueueNDRangeKernel(queue, kernel, 1, 0, &global_size, 0, 0, 0, &event);
+        DEVICE_PROFILE_CHECK_ERRORS(err);
+        err = clWaitForEvents(1, &event);
+        DEVICE_PROFILE_CHECK_ERRORS(err);
+
+        cl_ulong start = 0, end = 0;
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, 0);
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, 0);
+        clReleaseEvent(event);
+
+        // The first run only warms up
+        double time = double(end - start)*1e-9;
+        if(run > 0 && (best == 0 || time < best))
+        {
+            best = time;
+        }
+    }
+    return best;
+}
+
+string trim (const string& s)
+{
+    size_t first = s.find_first_not_of(" \t\r\n");
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return first == string::npos ? string() : s.substr(first, last - first + 1);
+}
+
+}   // anonymous namespace
+
+
+bool DeviceProfile::hasExtension (const string& extension) const
+{
+    istringstream words(extensions);
+    string word;
+    while(words >> word)
+    {
+        if(word == extension)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool DeviceProfile::hasSubgroupSize (size_t size) const
+{
+    return find(subgroup_sizes.begin(), subgroup_sizes.end(), size) != subgroup_sizes.end();
+}
+
+
+DeviceProfile queryDeviceProfile (cl_device_id device)
+{
+    DeviceProfile profile;
+
+    profile.name = trim(deviceString(device, CL_DEVICE_NAME));
+    profile.vendor = trim(deviceString(device, CL_DEVICE_VENDOR));
+    profile.version = trim(deviceString(device, CL_DEVICE_VERSION));
+    profile.driver_version = trim(deviceString(device, CL_DRIVER_VERSION));
+    profile.opencl_c_version = trim(deviceString(device, CL_DEVICE_OPENCL_C_VERSION));
+    profile.extensions = trim(deviceString(device, CL_DEVICE_EXTENSIONS));
+    profile.type = deviceNumber<cl_device_type>(device, CL_DEVICE_TYPE);
+
+    profile.compute_units = deviceNumber<cl_uint>(device, CL_DEVICE_MAX_COMPUTE_UNITS);
+    profile.clock_mhz = deviceNumber<cl_uint>(device, CL_DEVICE_MAX_CLOCK_FREQUENCY);
+    profile.max_work_group_size = deviceNumber<size_t>(device, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+    profile.global_mem_size = deviceNumber<cl_ulong>(device, CL_DEVICE_GLOBAL_MEM_SIZE);
+    profile.max_alloc_size = deviceNumber<cl_ulong>(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE);
+    profile.local_mem_size = deviceNumber<cl_ulong>(device, CL_DEVICE_LOCAL_MEM_SIZE);
+    profile.local_mem_dedicated =
+        deviceNumber<cl_device_local_mem_type>(device, CL_DEVICE_LOCAL_MEM_TYPE) == CL_LOCAL;
+    profile.image_support = deviceNumber<cl_bool>(device, CL_DEVICE_IMAGE_SUPPORT) != CL_FALSE;
+    profile.unified_memory = optionalDeviceNumber<cl_bool>(device, CL_DEVICE_HOST_UNIFIED_MEMORY) != CL_FALSE;
+
+    // Both are extensions before OpenCL 2.x made fp64 a query of its own
+    profile.fp16 = profile.hasExtension("cl_khr_fp16");
+    profile.fp64 =
+        profile.hasExtension("cl_khr_fp64") ||
+        optionalDeviceNumber<cl_device_fp_config>(device, CL_DEVICE_DOUBLE_FP_CONFIG) != 0;
+
+    profile.preferred_width_char = deviceNumber<cl_uint>(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR);
+    profile.preferred_width_short = deviceNumber<cl_uint>(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT);
+    profile.preferred_width_int = deviceNumber<cl_uint>(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT);
+    profile.preferred_width_float = deviceNumber<cl_uint>(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT);
+    profile.preferred_width_double = deviceNumber<cl_uint>(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE);
+    profile.preferred_width_half = optionalDeviceNumber<cl_uint>(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF);
+
+    size_t length = 0;
+    if(
+        profile.hasExtension("cl_intel_required_subgroup_size") &&
+        clGetDeviceInfo(device, CL_DEVICE_SUB_GROUP_SIZES_INTEL, 0, 0, &length) == CL_SUCCESS &&
+        length >= sizeof(size_t)
+    )
+    {
+        profile.subgroup_sizes.resize(length/sizeof(size_t));
+        cl_int err = clGetDeviceInfo(
+            device,
+            CL_DEVICE_SUB_GROUP_SIZES_INTEL,
+            length,
+            &profile.subgroup_sizes[0],
+            0
+        );
+        if(err != CL_SUCCESS)
+        {
+            profile.subgroup_sizes.clear();
+        }
+    }
+
+    profile.measured = false;
+    profile.bandwidth_gbs = 0;
+    profile.gflops = 0;
+
+    return profile;
+}
+
+
+void measureDeviceProfile (cl_device_id device, DeviceProfile& profile)
+{
+    cl_int err = CL_SUCCESS;
+
+    cl_context context = clCreateContext(0, 1, &device, 0, 0, &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    cl_command_queue queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    cl_program program = clCreateProgramWithSource(context, 1, &benchmark_source, 0, &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+    err = clBuildProgram(program, 1, &device, "", 0, 0);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    // Bandwidth: a copy large enough to leave every cache behind
+    size_t bytes = size_t(min<cl_ulong>(profile.max_alloc_size/2, 256*1024*1024));
+    bytes -= bytes % (16*1024);
+
+    cl_mem src = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, 0, &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+    cl_mem dst = clCreateBuffer(context, CL_MEM_WRITE_ONLY, bytes, 0, &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    cl_kernel copy = clCreateKernel(program, "copyBandwidth", &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+    err  = clSetKernelArg(copy, 0, sizeof(cl_mem), &src);
+    err |= clSetKernelArg(copy, 1, sizeof(cl_mem), &dst);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    double copy_time = timeKernel(queue, copy, bytes/(4*sizeof(float)), 5);
+    profile.bandwidth_gbs = copy_time > 0 ? 2*double(bytes)/copy_time*1e-9 : 0;
+
+    // FLOPS: enough work-items to fill every compute unit many times over
+    size_t items = size_t(profile.compute_units)*16384;
+    cl_mem out = clCreateBuffer(context, CL_MEM_WRITE_ONLY, items*sizeof(float), 0, &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    cl_kernel mad = clCreateKernel(program, "madThroughput", &err);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+    float a = 0.999f, b = 0.5f;
+    err  = clSetKernelArg(mad, 0, sizeof(cl_mem), &out);
+    err |= clSetKernelArg(mad, 1, sizeof(float), &a);
+    err |= clSetKernelArg(mad, 2, sizeof(float), &b);
+    DEVICE_PROFILE_CHECK_ERRORS(err);
+
+    double mad_time = timeKernel(queue, mad, items, 5);
+    profile.gflops = mad_time > 0 ? MAD_FLOPS_PER_ITEM*items/mad_time*1e-9 : 0;
+
+    profile.measured = true;
+
+    clReleaseKernel(mad);
+    clReleaseKernel(copy);
+    clReleaseMemObject(out);
+    clReleaseMemObject(dst);
+    clReleaseMemObject(src);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+}
+
+
+string deviceProfilePath (const DeviceProfile& profile, const string& cache_dir)
+{
+    // FNV-1a of what identifies the device and its driver
+    string key = profile.vendor + "|" + profile.name + "|" + profile.version + "|" + profile.driver_version;
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < key.size(); ++i)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+
+    ostringstream path;
+    if(!cache_dir.empty())
+    {
+        path << cache_dir << "/";
+    }
+    path << "device_profile_" << hex << setw(16) << setfill('0') << hash << ".txt";
+    return path.str();
+}
+
+
+bool saveDeviceProfile (const string& path, const DeviceProfile& p)
+{
+    ofstream file(path.c_str());
+    if(!file)
+    {
+        return false;
+    }
+
+    file
+        << "format=" << DEVICE_PROFILE_FORMAT << "\n"
+        << "name=" << p.name << "\n"
+        << "vendor=" << p.vendor << "\n"
+        << "version=" << p.version << "\n"
+        << "driver_version=" << p.driver_version << "\n"
+        << "opencl_c_version=" << p.opencl_c_version << "\n"
+        << "extensions=" << p.extensions << "\n"
+        << "type=" << p.type << "\n"
+        << "compute_units=" << p.compute_units << "\n"
+        << "clock_mhz=" << p.clock_mhz << "\n"
+        << "max_work_group_size=" << p.max_work_group_size << "\n"
+        << "global_mem_size=" << p.global_mem_size << "\n"
+        << "max_alloc_size=" << p.max_alloc_size << "\n"
+        << "local_mem_size=" << p.local_mem_size << "\n"
+        << "local_mem_dedicated=" << p.local_mem_dedicated << "\n"
+        << "image_support=" << p.image_support << "\n"
+        << "fp16=" << p.fp16 << "\n"
+        << "fp64=" << p.fp64 << "\n"
+        << "unified_memory=" << p.unified_memory << "\n"
+        << "preferred_width_char=" << p.preferred_width_char << "\n"
+        << "preferred_width_short=" << p.preferred_width_short << "\n"
+        << "preferred_width_int=" << p.preferred_width_int << "\n"
+        << "preferred_width_float=" << p.preferred_width_float << "\n"
+        << "preferred_width_double=" << p.preferred_width_double << "\n"
+        << "preferred_width_half=" << p.preferred_width_half << "\n"
+        << "subgroup_sizes=";
+    for(size_t i = 0; i < p.subgroup_sizes.size(); ++i)
+    {
+        file << (i ? " " : "") << p.subgroup_sizes[i];
+    }
+    file
+        << "\n"
+        << "measured=" << p.measured << "\n"
+        << "bandwidth_gbs=" << p.bandwidth_gbs << "\n"
+        << "gflops=" << p.gflops << "\n";
+
+    return bool(file);
+}
+
+
+bool loadDeviceProfile (const string& path, DeviceProfile& p)
+{
+    ifstream file(path.c_str());
+    if(!file)
+    {
+        return false;
+    }
+
+    p = DeviceProfile();
+    p.type = 0;
+    p.measured = false;
+    int format = 0;
+
+    string line;
+    while(getline(file, line))
+    {
+        size_t eq = line.find('=');
+        if(eq == string::npos)
+        {
+            continue;
+        }
+        string key = line.substr(0, eq);
+        string value = line.substr(eq + 1);
+        istringstream in(value);
+
+        if(key == "format") in >> format;
+        else if(key == "name") p.name = value;
+        else if(key == "vendor") p.vendor = value;
+        else if(key == "version") p.version = value;
+        else if(key == "driver_version") p.driver_version = value;
+        else if(key == "opencl_c_version") p.opencl_c_version = value;
+        else if(key == "extensions") p.extensions = value;
+        else if(key == "type") in >> p.type;
+        else if(key == "compute_units") in >> p.compute_units;
+        else if(key == "clock_mhz") in >> p.clock_mhz;
+        else if(key == "max_work_group_size") in >> p.max_work_group_size;
+        else if(key == "global_mem_size") in >> p.global_mem_size;
+        else if(key == "max_alloc_size") in >> p.max_alloc_size;
+        else if(key == "local_mem_size") in >> p.local_mem_size;
+        else if(key == "local_mem_dedicated") in >> p.local_mem_dedicated;
+        else if(key == "image_support") in >> p.image_support;
+        else if(key == "fp16") in >> p.fp16;
+        else if(key == "fp64") in >> p.fp64;
+        else if(key == "unified_memory") in >> p.unified_memory;
+        else if(key == "preferred_width_char") in >> p.preferred_width_char;
+        else if(key == "preferred_width_short") in >> p.preferred_width_short;
+        else if(key == "preferred_width_int") in >> p.preferred_width_int;
+        else if(key == "preferred_width_float") in >> p.preferred_width_float;
+        else if(key == "preferred_width_double") in >> p.preferred_width_double;
+        else if(key == "preferred_width_half") in >> p.preferred_width_half;
+        else if(key == "subgroup_sizes")
+        {
+            size_t size;
+            while(in >> size)
+            {
+                p.subgroup_sizes.push_back(size);
+            }
+        }
+        else if(key == "measured") in >> p.measured;
+        else if(key == "bandwidth_gbs") in >> p.bandwidth_gbs;
+        else if(key == "gflops") in >> p.gflops;
+    }
+
+    return format == DEVICE_PROFILE_FORMAT;
+}
+
+
+DeviceProfile getDeviceProfile (
+    cl_device_id device,
+    bool measure,
+    const string& cache_dir,
+    bool refresh
+)
+{
+    DeviceProfile queried = queryDeviceProfile(device);
+    string path = deviceProfilePath(queried, cache_dir);
+
+    DeviceProfile cached;
+    if(
+        !refresh &&
+        loadDeviceProfile(path, cached) &&
+        cached.name == queried.name &&
+        cached.driver_version == queried.driver_version &&
+        (cached.measured || !measure)
+    )
+    {
+        return cached;
+    }
+
+    if(measure)
+    {
+        measureDeviceProfile(device, queried);
+    }
+
+    // A profile without measurements is not worth caching
+    if(queried.measured && !saveDeviceProfile(path, queried))
+    {
+        cerr << "Cannot write the device profile cache " << path << "\n";
+    }
+
+    return queried;
+}
+
+
+void printDeviceProfile (ostream& out, const DeviceProfile& p)
+{
+    out
+        << "    Name: " << p.name << " (" << p.vendor << ")\n"
+        << "    Version: " << p.version << ", driver " << p.driver_version << "\n"
+        << "    Compute units: " << p.compute_units << " at " << p.clock_mhz << " MHz\n"
+        << "    Max work-group size: " << p.max_work_group_size << "\n"
+        << "    Local memory: " << p.local_mem_size/1024 << " KB, "
+        << (p.local_mem_dedicated ? "dedicated" : "emulated in global memory") << "\n"
+        << "    Images: " << (p.image_support ? "yes" : "no")
+        << ", fp16: " << (p.fp16 ? "yes" : "no")
+        << ", fp64: " << (p.fp64 ? "yes" : "no")
+        << ", unified memory: " << (p.unified_memory ? "yes" : "no") << "\n"
+        << "    Preferred vector widths char/short/int/float/double/half: "
+        << p.preferred_width_char << "/" << p.preferred_width_short << "/"
+        << p.preferred_width_int << "/" << p.preferred_width_float << "/"
+        << p.preferred_width_double << "/" << p.preferred_width_half << "\n"
+        << "    Sub-group sizes:";
+    if(p.subgroup_sizes.empty())
+    {
+        out << " unknown";
+    }
+    for(size_t i = 0; i < p.subgroup_sizes.size(); ++i)
+    {
+        out << " " << p.subgroup_sizes[i];
+    }
+    out << "\n";
+
+    if(p.measured)
+    {
+        out
+            << "    Measured copy bandwidth: " << fixed << setprecision(1) << p.bandwidth_gbs << " GB/s\n"
+            << "    Measured mad throughput: " << p.gflops << " GFLOPS\n";
+        out.unsetf(ios::fixed);
+    }
+    else
+    {
+        out << "    Not measured\n";
+    }
+}
+
+
+bool isVariantSupported (const DeviceProfile& profile, const KernelVariant& variant)
+{
+    istringstream words(variant.extensions ? variant.extensions : "");
+    string word;
+    while(words >> word)
+    {
+        if(!profile.hasExtension(word))
+        {
+            return false;
+        }
+    }
+
+    // Unknown sub-group sizes are not held against the variant
+    if(
+        variant.subgroup_size &&
+        !profile.subgroup_sizes.empty() &&
+        !profile.hasSubgroupSize(variant.subgroup_size)
+    )
+    {
+        return false;
+    }
+
+    return
+        (!variant.images || profile.image_support) &&
+        (!variant.fp16 || profile.fp16) &&
+        (!variant.fp64 || profile.fp64) &&
+        variant.local_mem <= profile.local_mem_size &&
+        (!variant.dedicated_local_mem || profile.local_mem_dedicated);
+}
+
+
+int selectKernelVariant (const DeviceProfile& profile, const KernelVariant* variants, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(isVariantSupported(profile, variants[i]))
+        {
+            return int(i);
+        }
+    }
+    return -1;
+}
@@ -24,18 +24,27 @@ int main (int argc, const char** argv)
     int instance_count = 2;
     int instance_index = 0;
     size_t work_size = 16*1024*1024;
+    size_t chunk_items = 256*1024;
 
-    if(argc ==2 )
+    if(argc >= 2 )
     {
         int scen_id= atoi(argv[1]);
         if (scen_id== 0)
            scenario=SCENARIO_SYSTEM_LEVEL;
         else if(scen_id ==2)
            scenario=SCENARIO_SHARED_CONTEXT;
+        else if(scen_id ==3)
+           scenario=SCENARIO_WORK_STEALING;
         else
            scenario=SCENARIO_MULTI_CONTEXT;
     }
 
+    // Chunk size of the work-stealing scenario, in work-items
+    if(argc >= 3)
+    {
+        chunk_items = size_t(atol(argv[2]));
+    }
+
     cl_platform_id platform = selectPlatform(platform_subname);
 
     switch(scenario)
@@ -52,6 +61,10 @@ int main (int argc, const char** argv)
             cout << "Executing shared-context scenario." << endl;
             shared_context_scenario(platform, device_type, work_size);
             break;
+        case SCENARIO_WORK_STEALING:
+            cout << "Executing work-stealing scenario." << endl;
+            work_stealing_scenario(platform, device_type, work_size, chunk_items);
+            break;
     }
 
     
@@ -53,11 +53,23 @@ void shared_context_scenario (
     size_t work_size
 );
 
+//    - Work-stealing scenario, the shared context with dynamic partitioning:
+//      the NDRange is cut into chunks of chunk_items work-items, each device
+//      works through its share of them and then steals the chunks other
+//      devices have not reached yet.
+void work_stealing_scenario (
+    cl_platform_id platform,
+    cl_device_type device_type,
+    size_t work_size,
+    size_t chunk_items
+);
+
 
 enum Scenario {
     SCENARIO_SYSTEM_LEVEL,
     SCENARIO_MULTI_CONTEXT,
-    SCENARIO_SHARED_CONTEXT
+    SCENARIO_SHARED_CONTEXT,
+    SCENARIO_WORK_STEALING
 };
 
 
@@ -0,0 +1,485 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <cmath>
+#include <cassert>
+
+#include <CL/cl.h>
+
+#include "basic.hpp"
+#include "oclobject.hpp"
+#include "multidevice.hpp"
+
+
+using namespace std;
+
+
+namespace
+{
+
+// Pool of chunks of the NDRange shared by all devices.
+//
+// Each device starts with a contiguous run of chunks in its own deque and
+// takes them from the front. When its deque is empty it steals from the back
+// of the deque with the most chunks left, so the chunks it takes are the
+// ones the owner would reach last and adjacent chunks mostly stay on one
+// device. With stealing disabled the pool degenerates to the static even
+// split of the other scenarios, which is used as the baseline.
+class WorkPool
+{
+public:
+
+    WorkPool (size_t number_of_chunks, size_t number_of_devices, bool stealing) :
+        deques(number_of_devices),
+        stealing(stealing)
+    {
+        for(size_t i = 0; i < number_of_devices; ++i)
+        {
+            size_t first = i*number_of_chunks/number_of_devices;
+            size_t last = (i + 1)*number_of_chunks/number_of_devices;
+            for(size_t chunk = first; chunk < last; ++chunk)
+            {
+                deques[i].push_back(chunk);
+            }
+        }
+    }
+
+    // Returns false when no work is left for the device
+    bool next (size_t device, size_t* chunk, bool* stolen)
+    {
+        lock_guard<mutex> lock(pool_mutex);
+
+        if(!deques[device].empty())
+        {
+            *chunk = deques[device].front();
+            deques[device].pop_front();
+            *stolen = false;
+            return true;
+        }
+
+        if(!stealing)
+        {
+            return false;
+        }
+
+        size_t victim = 0;
+        for(size_t i = 1; i < deques.size(); ++i)
+        {
+            if(deques[i].size() > deques[victim].size())
+            {
+                victim = i;
+            }
+        }
+
+        if(deques[victim].empty())
+        {
+            return false;
+        }
+
+        *chunk = deques[victim].back();
+        deques[victim].pop_back();
+        *stolen = true;
+        return true;
+    }
+
+private:
+
+    vector< deque<size_t> > deques;
+    bool stealing;
+    mutex pool_mutex;
+};
+
+
+// Everything one device needs to run chunks, and what it did
+struct DeviceWorker
+{
+    cl_device_id device;
+    cl_command_queue queue;
+    cl_kernel kernel;   // one per device: clSetKernelArg isn't thread-safe on a shared kernel
+
+    size_t own_chunks;
+    size_t stolen_chunks;
+    size_t work_items;
+    double finish_time;     // since the start of the run, seconds
+    string error;
+};
+
+
+// Sub-buffers of one chunk in flight and the event of its kernel
+struct ChunkInFlight
+{
+    cl_mem a, b, c;
+    cl_event event;
+};
+
+
+void releaseChunk (ChunkInFlight& chunk)
+{
+    clReleaseMemObject(chunk.a);
+    clReleaseMemObject(chunk.b);
+    clReleaseMemObject(chunk.c);
+    clReleaseEvent(chunk.event);
+}
+
+
+cl_mem createChunkSubBuffer (cl_mem buffer, const cl_buffer_region& region)
+{
+    cl_int err = 0;
+    cl_mem sub_buffer = clCreateSubBuffer(
+        buffer,
+        0,
+        CL_BUFFER_CREATE_TYPE_REGION,
+        &region,
+        &err
+    );
+    SAMPLE_CHECK_ERRORS(err);
+    return sub_buffer;
+}
+
+
+// Host thread driving one device. Keeps two chunks in flight, so the
+// device has the next chunk queued while the host waits for the previous.
+void runWorker (
+    DeviceWorker& worker,
+    WorkPool& pool,
+    size_t device_index,
+    cl_mem a_buffer,
+    cl_mem b_buffer,
+    cl_mem c_buffer,
+    size_t chunk_size,      // in bytes
+    size_t buffer_size,     // in bytes
+    double start_time
+)
+{
+    const size_t max_in_flight = 2;
+    deque<ChunkInFlight> in_flight;
+
+    try
+    {
+        size_t chunk = 0;
+        bool stolen = false;
+
+        while(pool.next(device_index, &chunk, &stolen))
+        {
+            cl_buffer_region region = { chunk*chunk_size, min(chunk_size, buffer_size - chunk*chunk_size) };
+
+            ChunkInFlight piece;
+            piece.a = createChunkSubBuffer(a_buffer, region);
+            piece.b = createChunkSubBuffer(b_buffer, region);
+            piece.c = createChunkSubBuffer(c_buffer, region);
+
+            cl_int err = clSetKernelArg(worker.kernel, 0, sizeof(cl_mem), &piece.a);
+            SAMPLE_CHECK_ERRORS(err);
+            err = clSetKernelArg(worker.kernel, 1, sizeof(cl_mem), &piece.b);
+            SAMPLE_CHECK_ERRORS(err);
+            err = clSetKernelArg(worker.kernel, 2, sizeof(cl_mem), &piece.c);
+            SAMPLE_CHECK_ERRORS(err);
+
+            size_t global_size = region.size/sizeof(float);
+            err = clEnqueueNDRangeKernel(worker.queue, worker.kernel, 1, 0, &global_size, 0, 0, 0, &piece.event);
+            SAMPLE_CHECK_ERRORS(err);
+
+            // Submit right away, the device shouldn't wait for the next wait call
+            err = clFlush(worker.queue);
+            SAMPLE_CHECK_ERRORS(err);
+
+            in_flight.push_back(piece);
+            (stolen ? worker.stolen_chunks : worker.own_chunks)++;
+            worker.work_items += global_size;
+
+            if(in_flight.size() == max_in_flight)
+            {
+                err = clWaitForEvents(1, &in_flight.front().event);
+                SAMPLE_CHECK_ERRORS(err);
+                releaseChunk(in_flight.front());
+                in_flight.pop_front();
+            }
+        }
+
+        cl_int err = clFinish(worker.queue);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+    catch(const exception& e)
+    {
+        // Exceptions cannot leave the thread, the scenario rethrows it after join
+        worker.error = e.what();
+        clFinish(worker.queue);
+    }
+
+    while(!in_flight.empty())
+    {
+        releaseChunk(in_flight.front());
+        in_flight.pop_front();
+    }
+
+    worker.finish_time = time_stamp() - start_time;
+}
+
+
+// Runs the whole NDRange once through the pool and prints per-device statistics.
+// Returns the wall time of the run.
+double runPool (
+    vector<DeviceWorker>& workers,
+    bool stealing,
+    cl_mem a_buffer,
+    cl_mem b_buffer,
+    cl_mem c_buffer,
+    size_t chunk_size,
+    size_t buffer_size
+)
+{
+    size_t number_of_chunks = (buffer_size + chunk_size - 1)/chunk_size;
+    WorkPool pool(number_of_chunks, workers.size(), stealing);
+
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].own_chunks = 0;
+        workers[i].stolen_chunks = 0;
+        workers[i].work_items = 0;
+        workers[i].finish_time = 0;
+        workers[i].error.clear();
+    }
+
+    double start_time = time_stamp();
+
+    vector<thread> threads;
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        threads.push_back(
+            thread(
+                runWorker,
+                ref(workers[i]), ref(pool), i,
+                a_buffer, b_buffer, c_buffer,
+                chunk_size, buffer_size, start_time
+            )
+        );
+    }
+
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+
+    double total_time = time_stamp() - start_time;
+
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        if(!workers[i].error.empty())
+        {
+            throw Error("Device " + to_str(i) + " failed: " + workers[i].error);
+        }
+    }
+
+    cout << (stealing ? "Work-stealing" : "Static even split") << " run:\n";
+    cout
+        << setw(8) << "device" << setw(12) << "own" << setw(12) << "stolen"
+        << setw(14) << "work-items" << setw(14) << "finish, s" << "\n";
+
+    double first_finish = total_time;
+    size_t processed = 0;
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        const DeviceWorker& w = workers[i];
+        cout
+            << setw(8) << i << setw(12) << w.own_chunks << setw(12) << w.stolen_chunks
+            << setw(14) << w.work_items << setw(14) << fixed << setprecision(3) << w.finish_time << "\n";
+
+        first_finish = min(first_finish, w.finish_time);
+        processed += w.work_items;
+    }
+
+    if(processed != buffer_size/sizeof(float))
+    {
+        throw Error("Not all work-items were processed by the pool.");
+    }
+
+    cout
+        << "Total time: " << total_time << " s, devices idle at the end for up to "
+        << total_time - first_finish << " s.\n" << endl;
+
+    return total_time;
+}
+
+}   // anonymous namespace
+
+
+void work_stealing_scenario (
+    cl_platform_id platform,
+    cl_device_type device_type,
+    size_t work_size,
+    size_t chunk_items
+)
+{
+    // This scenario builds on the shared-context one: all devices share one
+    // context and the buffers, and each piece of work is a set of sub-buffers.
+    // Unlike there, the work is not divided once. The NDRange is cut into
+    // many chunks, and one host thread per device keeps its device fed from a
+    // shared pool. A device that runs out of its own chunks steals the
+    // remaining ones of slower devices, so a CPU and an accelerator of very
+    // different speed finish at about the same time.
+
+    cl_int err = 0;
+
+    cl_context_properties context_props[] = {
+        CL_CONTEXT_PLATFORM,
+        cl_context_properties(platform),
+        0
+    };
+
+    cl_context context = clCreateContextFromType(context_props, device_type, 0, 0, &err);
+    SAMPLE_CHECK_ERRORS(err);
+
+    cl_program program = create_program(context);
+    err = clBuildProgram(program, 0, 0, "", 0, 0);
+    SAMPLE_CHECK_ERRORS(err);
+
+    cl_uint number_of_devices;
+    err = clGetContextInfo(
+        context,
+        CL_CONTEXT_NUM_DEVICES,
+        sizeof(number_of_devices),
+        &number_of_devices,
+        0
+    );
+    SAMPLE_CHECK_ERRORS(err);
+
+    vector<cl_device_id> devices(number_of_devices);
+    err = clGetContextInfo(
+        context,
+        CL_CONTEXT_DEVICES,
+        number_of_devices * sizeof(cl_device_id),
+        &devices[0],
+        0
+    );
+    SAMPLE_CHECK_ERRORS(err);
+
+    cout << "Number of devices in the context: " << number_of_devices << "." << endl;
+
+    // Sub-buffer origins have to meet the alignment of every device,
+    // so chunks are whole multiples of the largest one.
+    size_t alignment = 4096;
+    vector<DeviceWorker> workers(number_of_devices);
+
+    for(cl_uint i = 0; i < number_of_devices; ++i)
+    {
+        cl_uint device_alignment_in_bits = 1;
+
+        err = clGetDeviceInfo(
+            devices[i],
+            CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+            sizeof(device_alignment_in_bits),
+            &device_alignment_in_bits,
+            0
+        );
+        SAMPLE_CHECK_ERRORS(err);
+
+        alignment = max(alignment, size_t(device_alignment_in_bits/8));
+
+        workers[i].device = devices[i];
+        workers[i].queue = clCreateCommandQueue(context, devices[i], 0, &err);
+        SAMPLE_CHECK_ERRORS(err);
+        workers[i].kernel = clCreateKernel(program, "simple", &err);
+        SAMPLE_CHECK_ERRORS(err);
+
+        string name(256, '\0');
+        err = clGetDeviceInfo(devices[i], CL_DEVICE_NAME, name.size(), &name[0], 0);
+        SAMPLE_CHECK_ERRORS(err);
+        cout << "    device " << i << ": " << name.c_str() << endl;
+    }
+
+    size_t buffer_size = sizeof(float)*work_size;
+    size_t chunk_size = round_up_aligned(max(chunk_items, size_t(1))*sizeof(float), alignment);
+    size_t aligned_buffer_size = buffer_size + (~buffer_size + 1) % 64;
+
+    cout
+        << "Chunk size: " << chunk_size/sizeof(float) << " work-items, "
+        << (buffer_size + chunk_size - 1)/chunk_size << " chunks." << endl;
+
+    float
+        *a_host = (float*)aligned_malloc(aligned_buffer_size, alignment),
+        *b_host = (float*)aligned_malloc(aligned_buffer_size, alignment),
+        *c_host = (float*)aligned_malloc(aligned_buffer_size, alignment)
+    ;
+
+    for(size_t i = 0; i < work_size; ++i)
+    {
+        float init_value = static_cast<float>(i);
+        a_host[i] = init_value;
+        b_host[i] = 2*init_value;
+        c_host[i] = 0;
+    }
+
+    cl_mem a_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, aligned_buffer_size, a_host, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl_mem b_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, aligned_buffer_size, b_host, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl_mem c_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, aligned_buffer_size, c_host, &err);
+    SAMPLE_CHECK_ERRORS(err);
+
+    double static_time = runPool(workers, false, a_buffer, b_buffer, c_buffer, chunk_size, buffer_size);
+    double stealing_time = runPool(workers, true, a_buffer, b_buffer, c_buffer, chunk_size, buffer_size);
+
+    cout << "Speedup of work-stealing over the static split: " << static_time/stealing_time << "x." << endl;
+
+    // Check a sample of the results; the kernel sums in float,
+    // so repeat the very same summation order.
+    float* c = (float*)clEnqueueMapBuffer(
+        workers[0].queue,
+        c_buffer,
+        CL_TRUE,
+        CL_MAP_READ,
+        0, buffer_size,
+        0, 0, 0,
+        &err
+    );
+    SAMPLE_CHECK_ERRORS(err);
+
+    for(size_t i = 0; i < work_size; i += max(work_size/256, size_t(1)))
+    {
+        float tmp = 0;
+        for(int j = 0; j < 100000; ++j)
+        {
+            tmp += a_host[i] + b_host[i];
+        }
+        if(c[i] != tmp && fabs(c[i] - tmp) > 1e-5f*fabs(tmp))
+        {
+            clEnqueueUnmapMemObject(workers[0].queue, c_buffer, c, 0, 0, 0);
+            throw Error("Wrong result for work-item " + to_str(i) + ": " + to_str(c[i]) + " instead of " + to_str(tmp));
+        }
+    }
+
+    err = clEnqueueUnmapMemObject(workers[0].queue, c_buffer, c, 0, 0, 0);
+    SAMPLE_CHECK_ERRORS(err);
+    err = clFinish(workers[0].queue);
+    SAMPLE_CHECK_ERRORS(err);
+
+    cout << "Results verified." << endl;
+
+    err = clReleaseMemObject(a_buffer);
+    SAMPLE_CHECK_ERRORS(err);
+    err = clReleaseMemObject(b_buffer);
+    SAMPLE_CHECK_ERRORS(err);
+    err = clReleaseMemObject(c_buffer);
+    SAMPLE_CHECK_ERRORS(err);
+
+    aligned_free(a_host);
+    aligned_free(b_host);
+    aligned_free(c_host);
+
+    for(cl_uint i = 0; i < number_of_devices; ++i)
+    {
+        err = clReleaseKernel(workers[i].kernel);
+        SAMPLE_CHECK_ERRORS(err);
+        err = clReleaseCommandQueue(workers[i].queue);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+
+    err = clReleaseProgram(program);
+    SAMPLE_CHECK_ERRORS(err);
+    err = clReleaseContext(context);
+    SAMPLE_CHECK_ERRORS(err);
+}
@@ -10,6 +10,9 @@
 #include <memory>
 #include <iostream>
 #include <cassert>
+#include <vector>
+#include <algorithm>
+#include "multithreading.h"
 
 // defines, project
 #define MEMCOPY_ITERATIONS  100
@@ -17,8 +20,12 @@
 #define DEFAULT_INCREMENT   (1 << 22)               //4 M
 #define CACHE_CLEAR_SIZE    (1 << 24)               //16 M
 
+#define DEFAULT_ROW_SIZE    4096                    //rect mode row, pitch is twice that
+#define DEFAULT_BATCH_SIZE  4096                    //batch mode transfer size
+#define MAX_THREADS         16
+
 //shmoo mode defines
-#define SHMOO_MEMSIZE_MAX     (1 << 26)         //64 M
+#define SHMOO_MEMSIZE_MAX     (1 << 26)         //64 M, sizes beyond double up to --max
 #define SHMOO_MEMSIZE_START   (1 << 10)         //1 KB
 #define SHMOO_INCREMENT_1KB   (1 << 10)         //1 KB
 #define SHMOO_INCREMENT_2KB   (1 << 11)         //2 KB
@@ -38,31 +45,73 @@
 enum testMode { QUICK_MODE, RANGE_MODE, SHMOO_MODE };
 enum memcpyKind { DEVICE_TO_HOST, HOST_TO_DEVICE, DEVICE_TO_DEVICE };
 enum printMode { USER_READABLE, CSV };
-enum memoryMode { PAGEABLE, PINNED };
-enum accessMode { MAPPED, DIRECT };
+enum memoryMode { PAGEABLE, PINNED, HOST_PTR, SVM_COARSE, SVM_FINE };
+enum accessMode { MAPPED, DIRECT, RECT, BATCH };
 
 // CL objects
 cl_context cxGPUContext;
 cl_command_queue cqCommandQueue;
 cl_device_id *devices;
+cl_device_id cdCurrentDevice;
+
+// extended mode settings from the command line
+size_t rowSize = DEFAULT_ROW_SIZE;                  // rect:  bytes per row
+size_t batchSize = DEFAULT_BATCH_SIZE;              // batch: bytes per transfer
+int numThreads = 1;                                 // concurrent host threads
+bool bLatency = false;                              // per-transfer percentiles
+
+// per-transfer durations (s) of the last test, filled when bLatency is set
+std::vector<double> transferTimes;
+std::vector<cl_event> pendingEvents;
 
 ////////////////////////////////////////////////////////////////////////////////
 // declaration, forward
 int runTest(const int argc, const char **argv);
 void createQueue(unsigned int device);
-void testBandwidth( unsigned int start, unsigned int end, unsigned int increment, 
+void testBandwidth( size_t start, size_t end, size_t increment, size_t shmooMax,
                     testMode mode, memcpyKind kind, printMode printmode, accessMode accMode, memoryMode memMode, int startDevice, int endDevice);
-void testBandwidthQuick(unsigned int size, memcpyKind kind, printMode printmode, accessMode accMode, memoryMode memMode, int startDevice, int endDevice);
-void testBandwidthRange(unsigned int start, unsigned int end, unsigned int increment, 
+void testBandwidthQuick(size_t size, memcpyKind kind, printMode printmode, accessMode accMode, memoryMode memMode, int startDevice, int endDevice);
+void testBandwidthRange(size_t start, size_t end, size_t increment, 
                         memcpyKind kind, printMode printmode, accessMode accMode, memoryMode memMode, int startDevice, int endDevice);
-void testBandwidthShmoo(memcpyKind kind, printMode printmode,accessMode accMode,  memoryMode memMode, int startDevice, int endDevice);
-double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memoryMode memMode);
-double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memoryMode memMode);
-double testDeviceToDeviceTransfer(unsigned int memSize);
-void printResultsReadable(unsigned int *memSizes, double* bandwidths, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs);
-void printResultsCSV(unsigned int *memSizes, double* bandwidths, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs);
+void testBandwidthShmoo(size_t shmooMax, memcpyKind kind, printMode printmode,accessMode accMode,  memoryMode memMode, int startDevice, int endDevice);
+double testTransfer(size_t memSize, memcpyKind kind, accessMode accMode, memoryMode memMode);
+double testDeviceToHostTransfer(size_t memSize, accessMode accMode, memoryMode memMode);
+double testHostToDeviceTransfer(size_t memSize, accessMode accMode, memoryMode memMode);
+double testDeviceToDeviceTransfer(size_t memSize);
+double testRectTransfer(size_t memSize, memcpyKind kind, memoryMode memMode);
+double testBatchTransfer(size_t memSize, memcpyKind kind, memoryMode memMode);
+double testSVMTransfer(size_t memSize, memcpyKind kind, accessMode accMode, bool bFineGrain);
+double testConcurrentTransfer(size_t memSize, memcpyKind kind, memoryMode memMode);
+unsigned char *allocHostData(size_t memSize, memoryMode memMode, cl_mem *cmHostData);
+void freeHostData(unsigned char *h_data, memoryMode memMode, cl_mem cmHostData);
+void printResultsReadable(size_t *memSizes, double* bandwidths, std::vector<double> *times, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs);
+void printResultsCSV(size_t *memSizes, double* bandwidths, std::vector<double> *times, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs);
 void printHelp(void);
 
+///////////////////////////////////////////////////////////////////////////////
+// Size argument in bytes, with an optional K, M or G suffix (powers of 1024)
+///////////////////////////////////////////////////////////////////////////////
+bool getSizeArg(const int argc, const char **argv, const char *name, size_t *value)
+{
+    char *str = NULL;
+    if(!shrGetCmdLineArgumentstr(argc, argv, name, &str))
+    {
+        return false;
+    }
+    char *end = NULL;
+    double dValue = strtod(str, &end);
+    switch(*end)
+    {
+    // each suffix falls through to the smaller ones: g = 1024 * 1024 * 1024
+    case 'g': case 'G': dValue *= 1024.0;   // fall through
+    case 'm': case 'M': dValue *= 1024.0;   // fall through
+    case 'k': case 'K': dValue *= 1024.0;
+    default: break;
+    }
+    *value = (dValue > 0.0) ? (size_t)dValue : 0;
+    return true;
+}
+
 int main(int argc, char** argv) 
 {
     shrQAStart(argc, argv);
@@ -83,11 +132,12 @@ int main(int argc, char** argv)
 ///////////////////////////////////////////////////////////////////////////////
 int runTest(const int argc, const char **argv)
 {
-    int start = DEFAULT_SIZE;
-    int end = DEFAULT_SIZE;
+    size_t start = DEFAULT_SIZE;
+    size_t end = DEFAULT_SIZE;
     int startDevice = 0;
     int endDevice = 0;
-    int increment = DEFAULT_INCREMENT;
+    size_t increment = DEFAULT_INCREMENT;
+    size_t shmooMax = SHMOO_MEMSIZE_MAX;
     testMode mode = QUICK_MODE;
     bool htod = false;
     bool dtoh = false;
@@ -122,9 +172,21 @@ int runTest(const int argc, const char **argv)
         {
             memMode = PINNED;
         }
+        else if(strcmp(memModeStr, "hostptr") == 0)
+        {
+            memMode = HOST_PTR;
+        }
+        else if(strcmp(memModeStr, "svm-coarse") == 0)
+        {
+            memMode = SVM_COARSE;
+        }
+        else if(strcmp(memModeStr, "svm-fine") == 0)
+        {
+            memMode = SVM_FINE;
+        }
         else
         {
-            shrLog("Invalid memory mode - valid modes are pageable or pinned\n");
+            shrLog("Invalid memory mode - valid modes are pageable, pinned, hostptr, svm-coarse or svm-fine\n");
             shrLog("See --help for more information\n");
             return -1000;
         }
@@ -146,9 +208,17 @@ int runTest(const int argc, const char **argv)
         {
             accMode = MAPPED;
         }
+        else if(strcmp(memModeStr, "rect") == 0)
+        {
+            accMode = RECT;
+        }
+        else if(strcmp(memModeStr, "batch") == 0)
+        {
+            accMode = BATCH;
+        }
         else
         {
-            shrLog("Invalid access mode - valid modes are direct or mapped\n");
+            shrLog("Invalid access mode - valid modes are direct, mapped, rect or batch\n");
             shrLog("See --help for more information\n");
             return -2000;
         }
@@ -159,6 +229,21 @@ int runTest(const int argc, const char **argv)
         accMode = DIRECT;
     }
 
+    // Extended mode settings
+    getSizeArg(argc, argv, "row", &rowSize);
+    getSizeArg(argc, argv, "batch", &batchSize);
+    rowSize = MAX(rowSize, (size_t)1);
+    batchSize = MAX(batchSize, (size_t)1);
+    shrGetCmdLineArgumenti(argc, argv, "threads", &numThreads);
+    numThreads = CLAMP(numThreads, 1, MAX_THREADS);
+    bLatency = (shrTRUE == shrCheckCmdLineFlag(argc, argv, "latency"));
+    if(numThreads > 1 && (accMode != DIRECT || memMode == SVM_COARSE || memMode == SVM_FINE))
+    {
+        shrLog("Concurrent transfers (--threads) use direct access to buffers\n");
+        shrLog("See --help for more information\n");
+        return -2500;
+    }
+
     // Get OpenCL platform ID for NVIDIA if available, otherwise default
     cl_platform_id clSelectedPlatformID = NULL; 
     cl_int ciErrNum = oclGetPlatformID (&clSelectedPlatformID);
@@ -259,7 +344,7 @@ int runTest(const int argc, const char **argv)
 
     if(RANGE_MODE == mode)
     {
-        if(shrGetCmdLineArgumenti( argc, argv, "start", &start))
+        if(getSizeArg( argc, argv, "start", &start))
         {
             if( start <= 0 )
             {
@@ -274,7 +359,7 @@ int runTest(const int argc, const char **argv)
             return -5000;
         }
 
-        if(shrGetCmdLineArgumenti( argc, argv, "end", &end))
+        if(getSizeArg( argc, argv, "end", &end))
         {
             if(end <= 0)
             {
@@ -295,7 +380,7 @@ int runTest(const int argc, const char **argv)
             return -8000;
         }
 
-        if(shrGetCmdLineArgumenti( argc, argv, "increment", &increment))
+        if(getSizeArg( argc, argv, "increment", &increment))
         {
             if(increment <= 0)
             {
@@ -310,6 +395,11 @@ int runTest(const int argc, const char **argv)
             return -10000;
         }
     }
+
+    if(SHMOO_MODE == mode && getSizeArg(argc, argv, "max", &shmooMax))
+    {
+        shmooMax = MAX(shmooMax, (size_t)SHMOO_MEMSIZE_MAX);
+    }
    
     // Create the OpenCL context
     cxGPUContext = clCreateContext(0, ciDeviceCount, devices, NULL, NULL, NULL);
@@ -322,17 +412,17 @@ int runTest(const int argc, const char **argv)
     // Run tests
     if(htod)
     {
-        testBandwidth((unsigned int)start, (unsigned int)end, (unsigned int)increment, 
+        testBandwidth(start, end, increment, shmooMax,
                       mode, HOST_TO_DEVICE, printmode, accMode, memMode, startDevice, endDevice);
     }                       
     if(dtoh)
     {
-        testBandwidth((unsigned int)start, (unsigned int)end, (unsigned int)increment,
+        testBandwidth(start, end, increment, shmooMax,
                       mode, DEVICE_TO_HOST, printmode, accMode, memMode, startDevice, endDevice);
     }                       
     if(dtod)
     {
-        testBandwidth((unsigned int)start, (unsigned int)end, (unsigned int)increment,
+        testBandwidth(start, end, increment, shmooMax,
                       mode, DEVICE_TO_DEVICE, printmode, accMode, memMode, startDevice, endDevice);
     }                       
 
@@ -357,13 +447,14 @@ createQueue(unsigned int device)
     }
   
     cqCommandQueue = clCreateCommandQueue(cxGPUContext, devices[device], CL_QUEUE_PROFILING_ENABLE, NULL);
+    cdCurrentDevice = devices[device];
 }
   
 ///////////////////////////////////////////////////////////////////////////////
 //  Run a bandwidth test
 ///////////////////////////////////////////////////////////////////////////////
 void
-testBandwidth(unsigned int start, unsigned int end, unsigned int increment, 
+testBandwidth(size_t start, size_t end, size_t increment, size_t shmooMax,
               testMode mode, memcpyKind kind, printMode printmode, accessMode accMode, 
               memoryMode memMode, int startDevice, int endDevice)
 {
@@ -376,7 +467,7 @@ testBandwidth(unsigned int start, unsigned int end, unsigned int increment,
         testBandwidthRange(start, end, increment, kind, printmode, accMode, memMode, startDevice, endDevice);
         break;
     case SHMOO_MODE: 
-        testBandwidthShmoo(kind, printmode, accMode, memMode, startDevice, endDevice);
+        testBandwidthShmoo(shmooMax, kind, printmode, accMode, memMode, startDevice, endDevice);
         break;
     default:  
         break;
@@ -387,7 +478,7 @@ testBandwidth(unsigned int start, unsigned int end, unsigned int increment,
 //  Run a quick mode bandwidth test
 //////////////////////////////////////////////////////////////////////
 void
-testBandwidthQuick(unsigned int size, memcpyKind kind, printMode printmode, accessMode accMode, 
+testBandwidthQuick(size_t size, memcpyKind kind, printMode printmode, accessMode accMode, 
                    memoryMode memMode, int startDevice, int endDevice)
 {
     testBandwidthRange(size, size, DEFAULT_INCREMENT, kind, printmode, accMode, memMode, startDevice, endDevice);
@@ -397,14 +488,15 @@ testBandwidthQuick(unsigned int size, memcpyKind kind, printMode printmode, acce
 //  Run a range mode bandwidth test
 //////////////////////////////////////////////////////////////////////
 void
-testBandwidthRange(unsigned int start, unsigned int end, unsigned int increment, 
+testBandwidthRange(size_t start, size_t end, size_t increment, 
                    memcpyKind kind, printMode printmode, accessMode accMode, memoryMode memMode, int startDevice, int endDevice)
 {
     //count the number of copies we're going to run
-    unsigned int count = 1 + ((end - start) / increment);
+    unsigned int count = 1 + (unsigned int)((end - start) / increment);
     
-    unsigned int * memSizes = (unsigned int *)malloc(count * sizeof( unsigned int ));
+    size_t * memSizes = (size_t *)malloc(count * sizeof( size_t ));
     double* bandwidths = (double*)malloc(count * sizeof(double));
+    std::vector<double> *times = new std::vector<double>[count];
 
     // Before calculating the cumulative bandwidth, initialize bandwidths array to NULL
     for (unsigned int i = 0; i < count; i++)
@@ -420,37 +512,31 @@ testBandwidthRange(unsigned int start, unsigned int end, unsigned int increment,
         for(unsigned int i = 0; i < count; i++)
         {
             memSizes[i] = start + i * increment;
-            switch(kind)
-            {
-            case DEVICE_TO_HOST:    bandwidths[i] += testDeviceToHostTransfer(memSizes[i], accMode, memMode);
-                break;
-            case HOST_TO_DEVICE:    bandwidths[i] += testHostToDeviceTransfer(memSizes[i], accMode, memMode);
-                break;
-            case DEVICE_TO_DEVICE:  bandwidths[i] += testDeviceToDeviceTransfer(memSizes[i]);
-                break;
-            }
+            bandwidths[i] += testTransfer(memSizes[i], kind, accMode, memMode);
+            times[i].insert(times[i].end(), transferTimes.begin(), transferTimes.end());
         }
     } // Complete the bandwidth computation on all the devices
 
     //print results
     if(printmode == CSV)
     {
-        printResultsCSV(memSizes, bandwidths, count, kind, accMode, memMode, (1 + endDevice - startDevice));
+        printResultsCSV(memSizes, bandwidths, times, count, kind, accMode, memMode, (1 + endDevice - startDevice));
     }
     else
     {
-        printResultsReadable(memSizes, bandwidths, count, kind, accMode, memMode, (1 + endDevice - startDevice));
+        printResultsReadable(memSizes, bandwidths, times, count, kind, accMode, memMode, (1 + endDevice - startDevice));
     }
 
     //clean up
     free(memSizes);
     free(bandwidths);
+    delete [] times;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 // Intense shmoo mode - covers a large range of values with varying increments
 //////////////////////////////////////////////////////////////////////////////
-void testBandwidthShmoo(memcpyKind kind, printMode printmode, accessMode accMode, 
+void testBandwidthShmoo(size_t shmooMax, memcpyKind kind, printMode printmode, accessMode accMode, 
                    memoryMode memMode, int startDevice, int endDevice)
 {
     //count the number of copies to make
@@ -462,8 +548,13 @@ void testBandwidthShmoo(memcpyKind kind, printMode printmode, accessMode accMode
         + ((SHMOO_LIMIT_32MB - SHMOO_LIMIT_16MB) / SHMOO_INCREMENT_2MB)
         + ((SHMOO_MEMSIZE_MAX - SHMOO_LIMIT_32MB) / SHMOO_INCREMENT_4MB);
 
-    unsigned int *memSizes = (unsigned int *)malloc(count * sizeof(unsigned int));
+    // beyond SHMOO_MEMSIZE_MAX sizes double up to shmooMax
+    for(size_t size = 2 * (size_t)SHMOO_MEMSIZE_MAX; size <= shmooMax; size *= 2)
+        count++;
+
+    size_t *memSizes = (size_t *)malloc(count * sizeof(size_t));
     double* bandwidths = (double*)malloc(count * sizeof(double));
+    std::vector<double> *times = new std::vector<double>[count];
 
     // Before calculating the cumulative bandwidth, initialize bandwidths array to NULL
     for (unsigned int i = 0; i < count; i++)
@@ -476,9 +567,9 @@ void testBandwidthShmoo(memcpyKind kind, printMode printmode, accessMode accMode
         createQueue(currentDevice);
 
         //Run the shmoo
-        int iteration = 0;
-        unsigned int memSize = 0;
-        while(memSize <= SHMOO_MEMSIZE_MAX )
+        unsigned int iteration = 0;
+        size_t memSize = 0;
+        while(iteration < count)
         {
             if(memSize < SHMOO_LIMIT_20KB )
             {
@@ -504,21 +595,18 @@ void testBandwidthShmoo(memcpyKind kind, printMode printmode, accessMode accMode
             {
                 memSize += SHMOO_INCREMENT_2MB;
             }
-            else 
+            else if( memSize <= SHMOO_MEMSIZE_MAX)
             {
                 memSize += SHMOO_INCREMENT_4MB;
             }
-
-            memSizes[iteration] = memSize;
-            switch(kind)
+            else 
             {
-            case DEVICE_TO_HOST:    bandwidths[iteration] += testDeviceToHostTransfer(memSizes[iteration], accMode, memMode);
-                break;
-            case HOST_TO_DEVICE:    bandwidths[iteration] += testHostToDeviceTransfer(memSizes[iteration], accMode, memMode);
-                break;
-            case DEVICE_TO_DEVICE:  bandwidths[iteration] += testDeviceToDeviceTransfer(memSizes[iteration]);
-                break;
+                memSize = (memSize < 2 * (size_t)SHMOO_MEMSIZE_MAX) ? 2 * (size_t)SHMOO_MEMSIZE_MAX : 2 * memSize;
             }
+
+            memSizes[iteration] = memSize;
+            bandwidths[iteration] += testTransfer(memSizes[iteration], kind, accMode, memMode);
+            times[iteration].insert(times[iteration].end(), transferTimes.begin(), transferTimes.end());
             iteration++;
             shrLog(".");
         }
@@ -528,32 +616,189 @@ void testBandwidthShmoo(memcpyKind kind, printMode printmode, accessMode accMode
     shrLog("\n");
     if( CSV == printmode)
     {
-        printResultsCSV(memSizes, bandwidths, count,  kind, accMode, memMode, (endDevice - startDevice));
+        printResultsCSV(memSizes, bandwidths, times, count,  kind, accMode, memMode, (endDevice - startDevice));
     }
     else
     {
-        printResultsReadable(memSizes, bandwidths, count, kind, accMode, memMode, (endDevice - startDevice));
+        printResultsReadable(memSizes, bandwidths, times, count, kind, accMode, memMode, (endDevice - startDevice));
     }
 
     //clean up
     free(memSizes);
     free(bandwidths);
+    delete [] times;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Copies per measurement: MEMCOPY_ITERATIONS up to the classic shmoo range,
+//  fewer for the multi-GB sizes so they finish in a comparable time
+///////////////////////////////////////////////////////////////////////////////
+unsigned int copyIterations(size_t memSize)
+{
+    double dScaled = (double)MEMCOPY_ITERATIONS * (double)SHMOO_MEMSIZE_MAX / (double)memSize;
+    return (unsigned int)CLAMP(dScaled, 4.0, (double)MEMCOPY_ITERATIONS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Latency bookkeeping: event for one transfer (NULL unless --latency) and
+//  collection of the profiled durations once the queue is finished
+///////////////////////////////////////////////////////////////////////////////
+cl_event *latencyEvent(std::vector<cl_event> &events)
+{
+    if(!bLatency)
+    {
+        return NULL;
+    }
+    events.push_back(NULL);
+    return &events.back();
+}
+
+void collectLatencies(std::vector<cl_event> &events, std::vector<double> &times)
+{
+    for(size_t i = 0; i < events.size(); i++)
+    {
+        cl_ulong ulStart = 0, ulEnd = 0;
+        clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &ulStart, NULL);
+        clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &ulEnd, NULL);
+        times.push_back((double)(ulEnd - ulStart) * 1.0e-9);
+        clReleaseEvent(events[i]);
+    }
+    events.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Run the test matching the modes for one size, returns MB/s or 0 when the
+//  size does not fit the device; transferTimes receives the latencies
+///////////////////////////////////////////////////////////////////////////////
+double testTransfer(size_t memSize, memcpyKind kind, accessMode accMode, memoryMode memMode)
+{
+    transferTimes.clear();
+
+    // rect mode spreads the payload over rows of twice the row size
+    cl_ulong ulMaxAlloc = 0;
+    clGetDeviceInfo(cdCurrentDevice, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &ulMaxAlloc, NULL);
+    size_t szDevBytes = (accMode == RECT) ? 2 * memSize : memSize;
+    if((cl_ulong)szDevBytes > ulMaxAlloc)
+    {
+        shrLog("   %llu Bytes exceed the max allocation of %llu Bytes, skipped\n", 
+               (unsigned long long)szDevBytes, (unsigned long long)ulMaxAlloc);
+        return 0.0;
+    }
+
+    if(numThreads > 1)
+    {
+        return testConcurrentTransfer(memSize, kind, memMode);
+    }
+    if(memMode == SVM_COARSE || memMode == SVM_FINE)
+    {
+        return testSVMTransfer(memSize, kind, accMode, memMode == SVM_FINE);
+    }
+    if(accMode == RECT)
+    {
+        return testRectTransfer(memSize, kind, memMode);
+    }
+    if(accMode == BATCH)
+    {
+        return testBatchTransfer(memSize, kind, memMode);
+    }
+
+    switch(kind)
+    {
+    case DEVICE_TO_HOST:    return testDeviceToHostTransfer(memSize, accMode, memMode);
+    case HOST_TO_DEVICE:    return testHostToDeviceTransfer(memSize, accMode, memMode);
+    case DEVICE_TO_DEVICE:  return testDeviceToDeviceTransfer(memSize);
+    }
+    return 0.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Host side of a transfer, filled with a byte ramp:
+//    PINNED   - mapped CL_MEM_ALLOC_HOST_PTR buffer
+//    HOST_PTR - page aligned user memory wrapped with CL_MEM_USE_HOST_PTR, so
+//               the runtime can copy from it without staging (zero-copy)
+//    others   - plain malloc
+///////////////////////////////////////////////////////////////////////////////
+unsigned char *allocHostData(size_t memSize, memoryMode memMode, cl_mem *cmHostData)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    unsigned char *h_data = NULL;
+    *cmHostData = NULL;
+
+    if(memMode == PINNED)
+    {
+        *cmHostData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, memSize, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        h_data = (unsigned char*)clEnqueueMapBuffer(cqCommandQueue, *cmHostData, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, memSize, 0, NULL, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    else if(memMode == HOST_PTR)
+    {
+    #ifdef _WIN32
+        h_data = (unsigned char *)_aligned_malloc(memSize, 4096);
+    #else
+        void *ptr = NULL;
+        h_data = (posix_memalign(&ptr, 4096, memSize) == 0) ? (unsigned char *)ptr : NULL;
+    #endif
+        oclCheckError(h_data != NULL, shrTRUE);
+        *cmHostData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, memSize, h_data, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    else
+    {
+        h_data = (unsigned char *)malloc(memSize);
+        oclCheckError(h_data != NULL, shrTRUE);
+    }
+
+    for(size_t i = 0; i < memSize; i++)
+    {
+        h_data[i] = (unsigned char)(i & 0xff);
+    }
+    return h_data;
+}
+
+void freeHostData(unsigned char *h_data, memoryMode memMode, cl_mem cmHostData)
+{
+    if(memMode == PINNED)
+    {
+        clEnqueueUnmapMemObject(cqCommandQueue, cmHostData, (void*)h_data, 0, NULL, NULL);
+        clFinish(cqCommandQueue);
+        clReleaseMemObject(cmHostData);
+    }
+    else if(memMode == HOST_PTR)
+    {
+        clReleaseMemObject(cmHostData);
+    #ifdef _WIN32
+        _aligned_free(h_data);
+    #else
+        free(h_data);
+    #endif
+    }
+    else
+    {
+        free(h_data);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 //  test the bandwidth of a device to host memcopy of a specific size
 ///////////////////////////////////////////////////////////////////////////////
-double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memoryMode memMode)
+double testDeviceToHostTransfer(size_t memSize, accessMode accMode, memoryMode memMode)
 {
     double elapsedTimeInSec = 0.0;
     double bandwidthInMBs = 0.0;
     unsigned char *h_data = NULL;
     cl_mem cmPinnedData = NULL;
+    cl_mem cmHostPtrData = NULL;
     cl_mem cmDevData = NULL;
     cl_int ciErrNum = CL_SUCCESS;
+    unsigned int iterations = copyIterations(memSize);
 
-    //allocate and init host memory, pinned or conventional
-    if(memMode == PINNED)
+    //allocate and init host memory, pinned, wrapped user memory or conventional
+    if(memMode == HOST_PTR)
+    {
+        h_data = allocHostData(memSize, memMode, &cmHostPtrData);
+    }
+    else if(memMode == PINNED)
     {
         // Create a host buffer
         cmPinnedData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, memSize, NULL, &ciErrNum);
@@ -564,7 +809,7 @@ double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memory
         oclCheckError(ciErrNum, CL_SUCCESS);
 
         //initialize 
-        for(unsigned int i = 0; i < memSize/sizeof(unsigned char); i++)
+        for(size_t i = 0; i < memSize/sizeof(unsigned char); i++)
         {
             h_data[i] = (unsigned char)(i & 0xff);
         }
@@ -579,7 +824,7 @@ double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memory
         h_data = (unsigned char *)malloc(memSize);
 
         //initialize 
-        for(unsigned int i = 0; i < memSize/sizeof(unsigned char); i++)
+        for(size_t i = 0; i < memSize/sizeof(unsigned char); i++)
         {
             h_data[i] = (unsigned char)(i & 0xff);
         }
@@ -610,10 +855,17 @@ double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memory
     shrDeltaT(0);
     if(accMode == DIRECT)
     { 
-        // DIRECT:  API access to device buffer 
-        for(unsigned int i = 0; i < MEMCOPY_ITERATIONS; i++)
+        // DIRECT:  API access to device buffer, a buffer copy for wrapped user memory
+        for(unsigned int i = 0; i < iterations; i++)
         {
-            ciErrNum = clEnqueueReadBuffer(cqCommandQueue, cmDevData, CL_FALSE, 0, memSize, h_data, 0, NULL, NULL);
+            if(memMode == HOST_PTR)
+            {
+                ciErrNum = clEnqueueCopyBuffer(cqCommandQueue, cmDevData, cmHostPtrData, 0, 0, memSize, 0, NULL, latencyEvent(pendingEvents));
+            }
+            else
+            {
+                ciErrNum = clEnqueueReadBuffer(cqCommandQueue, cmDevData, CL_FALSE, 0, memSize, h_data, 0, NULL, latencyEvent(pendingEvents));
+            }
             oclCheckError(ciErrNum, CL_SUCCESS);
         }
         ciErrNum = clFinish(cqCommandQueue);
@@ -624,9 +876,11 @@ double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memory
         // MAPPED: mapped pointers to device buffer for conventional pointer access
         void* dm_idata = clEnqueueMapBuffer(cqCommandQueue, cmDevData, CL_TRUE, CL_MAP_WRITE, 0, memSize, 0, NULL, NULL, &ciErrNum);
         oclCheckError(ciErrNum, CL_SUCCESS);
-        for(unsigned int i = 0; i < MEMCOPY_ITERATIONS; i++)
+        for(unsigned int i = 0; i < iterations; i++)
         {
+            if(bLatency) shrDeltaT(1);
             memcpy(h_data, dm_idata, memSize);
+            if(bLatency) transferTimes.push_back(shrDeltaT(1));
         }
         ciErrNum = clEnqueueUnmapMemObject(cqCommandQueue, cmDevData, dm_idata, 0, NULL, NULL);
         oclCheckError(ciErrNum, CL_SUCCESS);
@@ -634,12 +888,14 @@ double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memory
     
     //get the the elapsed time in seconds
     elapsedTimeInSec = shrDeltaT(0);
+    collectLatencies(pendingEvents, transferTimes);
     
     //calculate bandwidth in MB/s
-    bandwidthInMBs = ((double)memSize * (double)MEMCOPY_ITERATIONS) / (elapsedTimeInSec * (double)(1 << 20));
+    bandwidthInMBs = ((double)memSize * (double)iterations) / (elapsedTimeInSec * (double)(1 << 20));
 
     //clean up memory
     if(cmDevData)clReleaseMemObject(cmDevData);
+    if(cmHostPtrData)freeHostData(h_data, memMode, cmHostPtrData);
     if(cmPinnedData) 
     {
 	    clEnqueueUnmapMemObject(cqCommandQueue, cmPinnedData, (void*)h_data, 0, NULL, NULL);	
@@ -652,17 +908,23 @@ double testDeviceToHostTransfer(unsigned int memSize, accessMode accMode, memory
 ///////////////////////////////////////////////////////////////////////////////
 //  test the bandwidth of a device to host memcopy of a specific size
 ///////////////////////////////////////////////////////////////////////////////
-double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memoryMode memMode)
+double testHostToDeviceTransfer(size_t memSize, accessMode accMode, memoryMode memMode)
 {
     double elapsedTimeInSec = 0.0;
     double bandwidthInMBs = 0.0;
     unsigned char* h_data = NULL;
     cl_mem cmPinnedData = NULL;
+    cl_mem cmHostPtrData = NULL;
     cl_mem cmDevData = NULL;
     cl_int ciErrNum = CL_SUCCESS;
+    unsigned int iterations = copyIterations(memSize);
 
-    // Allocate and init host memory, pinned or conventional
-    if(memMode == PINNED)
+    // Allocate and init host memory, pinned, wrapped user memory or conventional
+    if(memMode == HOST_PTR)
+    {
+        h_data = allocHostData(memSize, memMode, &cmHostPtrData);
+    }
+    else if(memMode == PINNED)
    { 
         // Create a host buffer
         cmPinnedData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, memSize, NULL, &ciErrNum);
@@ -673,7 +935,7 @@ double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memory
         oclCheckError(ciErrNum, CL_SUCCESS);
 
         //initialize 
-        for(unsigned int i = 0; i < memSize/sizeof(unsigned char); i++)
+        for(size_t i = 0; i < memSize/sizeof(unsigned char); i++)
         {
             h_data[i] = (unsigned char)(i & 0xff);
         }
@@ -689,7 +951,7 @@ double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memory
         h_data = (unsigned char *)malloc(memSize);
 
         //initialize 
-        for(unsigned int i = 0; i < memSize/sizeof(unsigned char); i++)
+        for(size_t i = 0; i < memSize/sizeof(unsigned char); i++)
         {
             h_data[i] = (unsigned char)(i & 0xff);
         }
@@ -711,11 +973,18 @@ double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memory
             oclCheckError(ciErrNum, CL_SUCCESS);
 	    }
 
-        // DIRECT:  API access to device buffer 
-        for(unsigned int i = 0; i < MEMCOPY_ITERATIONS; i++)
+        // DIRECT:  API access to device buffer, a buffer copy for wrapped user memory
+        for(unsigned int i = 0; i < iterations; i++)
         {
-                ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, cmDevData, CL_FALSE, 0, memSize, h_data, 0, NULL, NULL);
-                oclCheckError(ciErrNum, CL_SUCCESS);
+            if(memMode == HOST_PTR)
+            {
+                ciErrNum = clEnqueueCopyBuffer(cqCommandQueue, cmHostPtrData, cmDevData, 0, 0, memSize, 0, NULL, latencyEvent(pendingEvents));
+            }
+            else
+            {
+                ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, cmDevData, CL_FALSE, 0, memSize, h_data, 0, NULL, latencyEvent(pendingEvents));
+            }
+            oclCheckError(ciErrNum, CL_SUCCESS);
         }
         ciErrNum = clFinish(cqCommandQueue);
         oclCheckError(ciErrNum, CL_SUCCESS);
@@ -730,9 +999,11 @@ double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memory
 			h_data = (unsigned char*)clEnqueueMapBuffer(cqCommandQueue, cmPinnedData, CL_TRUE, CL_MAP_READ, 0, memSize, 0, NULL, NULL, &ciErrNum); 
             oclCheckError(ciErrNum, CL_SUCCESS); 
         } 
-        for(unsigned int i = 0; i < MEMCOPY_ITERATIONS; i++)
+        for(unsigned int i = 0; i < iterations; i++)
         {
+            if(bLatency) shrDeltaT(1);
             memcpy(dm_idata, h_data, memSize);
+            if(bLatency) transferTimes.push_back(shrDeltaT(1));
         }
         ciErrNum = clEnqueueUnmapMemObject(cqCommandQueue, cmDevData, dm_idata, 0, NULL, NULL);
         oclCheckError(ciErrNum, CL_SUCCESS);
@@ -740,12 +1011,14 @@ double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memory
     
     //get the the elapsed time in seconds
     elapsedTimeInSec = shrDeltaT(0);
+    collectLatencies(pendingEvents, transferTimes);
     
     //calculate bandwidth in MB/s
-    bandwidthInMBs = ((double)memSize * (double)MEMCOPY_ITERATIONS)/(elapsedTimeInSec * (double)(1 << 20));
+    bandwidthInMBs = ((double)memSize * (double)iterations)/(elapsedTimeInSec * (double)(1 << 20));
 
     //clean up memory
     if(cmDevData)clReleaseMemObject(cmDevData);
+    if(cmHostPtrData)freeHostData(h_data, memMode, cmHostPtrData);
     if(cmPinnedData) 
     {
 	    clEnqueueUnmapMemObject(cqCommandQueue, cmPinnedData, (void*)h_data, 0, NULL, NULL);
@@ -758,18 +1031,19 @@ double testHostToDeviceTransfer(unsigned int memSize, accessMode accMode, memory
 ///////////////////////////////////////////////////////////////////////////////
 //  test the bandwidth of a device to host memcopy of a specific size
 ///////////////////////////////////////////////////////////////////////////////
-double testDeviceToDeviceTransfer(unsigned int memSize)
+double testDeviceToDeviceTransfer(size_t memSize)
 {
     double elapsedTimeInSec = 0.0;
     double bandwidthInMBs = 0.0;
     unsigned char* h_idata = NULL;
     cl_int ciErrNum = CL_SUCCESS;
+    unsigned int iterations = copyIterations(memSize);
     
     //allocate host memory
     h_idata = (unsigned char *)malloc( memSize );
         
     //initialize the memory
-    for(unsigned int i = 0; i < memSize/sizeof(unsigned char); i++)
+    for(size_t i = 0; i < memSize/sizeof(unsigned char); i++)
     {
         h_idata[i] = (unsigned char) (i & 0xff);
     }
@@ -785,9 +1059,9 @@ double testDeviceToDeviceTransfer(unsigned int memSize)
     // Sync queue to host, start timer 0, and copy data from one GPU buffer to another GPU bufffer
     clFinish(cqCommandQueue);
     shrDeltaT(0);
-    for(unsigned int i = 0; i < MEMCOPY_ITERATIONS; i++)
+    for(unsigned int i = 0; i < iterations; i++)
     {
-        ciErrNum = clEnqueueCopyBuffer(cqCommandQueue, d_idata, d_odata, 0, 0, memSize, 0, NULL, NULL);                
+        ciErrNum = clEnqueueCopyBuffer(cqCommandQueue, d_idata, d_odata, 0, 0, memSize, 0, NULL, latencyEvent(pendingEvents));
         oclCheckError(ciErrNum, CL_SUCCESS);
     }    
 
@@ -796,11 +1070,12 @@ double testDeviceToDeviceTransfer(unsigned int memSize)
     
     //get the the elapsed time in seconds
     elapsedTimeInSec = shrDeltaT(0);
+    collectLatencies(pendingEvents, transferTimes);
     
     // Calculate bandwidth in MB/s 
     //      This is for kernels that read and write GMEM simultaneously 
     //      Obtained Throughput for unidirectional block copies will be 1/2 of this #
-    bandwidthInMBs = 2.0 * ((double)memSize * (double)MEMCOPY_ITERATIONS)/(elapsedTimeInSec * (double)(1 << 20));
+    bandwidthInMBs = 2.0 * ((double)memSize * (double)iterations)/(elapsedTimeInSec * (double)(1 << 20));
 
     //clean up memory on host and device
     free(h_idata);
@@ -810,15 +1085,347 @@ double testDeviceToDeviceTransfer(unsigned int memSize)
     return bandwidthInMBs;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//  test the bandwidth of 2D strided copies: the payload is rowSize-byte rows,
+//  dense on the host and at a pitch of twice the row size on the device
+///////////////////////////////////////////////////////////////////////////////
+double testRectTransfer(size_t memSize, memcpyKind kind, memoryMode memMode)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    unsigned int iterations = copyIterations(memSize);
+    size_t row = MIN(rowSize, memSize);
+    size_t rows = memSize / row;
+    size_t pitch = 2 * row;
+    size_t origin[3] = {0, 0, 0};
+    size_t region[3] = {row, rows, 1};
+
+    // dense host rows, pitched device rows (two pitched buffers for device to device)
+    cl_mem cmHostData = NULL;
+    unsigned char *h_data = allocHostData(row * rows, memMode, &cmHostData);
+    cl_mem cmDevData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, pitch * rows, NULL, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    cl_mem cmDevData2 = NULL;
+    if(kind == DEVICE_TO_DEVICE)
+    {
+        cmDevData2 = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, pitch * rows, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    ciErrNum = clEnqueueWriteBufferRect(cqCommandQueue, cmDevData, CL_TRUE, origin, origin, region, pitch, 0, row, 0, h_data, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    // Sync queue to host, start timer 0, and copy the rows
+    clFinish(cqCommandQueue);
+    shrDeltaT(0);
+    for(unsigned int i = 0; i < iterations; i++)
+    {
+        switch(kind)
+        {
+        case HOST_TO_DEVICE:
+            ciErrNum = clEnqueueWriteBufferRect(cqCommandQueue, cmDevData, CL_FALSE, origin, origin, region, 
+                                                pitch, 0, row, 0, h_data, 0, NULL, latencyEvent(pendingEvents));
+            break;
+        case DEVICE_TO_HOST:
+            ciErrNum = clEnqueueReadBufferRect(cqCommandQueue, cmDevData, CL_FALSE, origin, origin, region, 
+                                               pitch, 0, row, 0, h_data, 0, NULL, latencyEvent(pendingEvents));
+            break;
+        case DEVICE_TO_DEVICE:
+            ciErrNum = clEnqueueCopyBufferRect(cqCommandQueue, cmDevData, cmDevData2, origin, origin, region, 
+                                               pitch, 0, pitch, 0, 0, NULL, latencyEvent(pendingEvents));
+            break;
+        }
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    clFinish(cqCommandQueue);
+    double elapsedTimeInSec = shrDeltaT(0);
+    collectLatencies(pendingEvents, transferTimes);
+
+    // payload only, device to device reads and writes it
+    double dFactor = (kind == DEVICE_TO_DEVICE) ? 2.0 : 1.0;
+    double bandwidthInMBs = dFactor * ((double)(row * rows) * (double)iterations)/(elapsedTimeInSec * (double)(1 << 20));
+
+    freeHostData(h_data, memMode, cmHostData);
+    clReleaseMemObject(cmDevData);
+    if(cmDevData2)clReleaseMemObject(cmDevData2);
+    return bandwidthInMBs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  test the bandwidth of many small transfers: memSize is moved as batchSize
+//  pieces, all enqueued without a sync and finished once per measurement
+///////////////////////////////////////////////////////////////////////////////
+double testBatchTransfer(size_t memSize, memcpyKind kind, memoryMode memMode)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    size_t chunk = MIN(batchSize, memSize);
+    size_t numChunks = (memSize + chunk - 1) / chunk;
+
+    // bound the number of enqueued commands so tiny pieces finish in time
+    unsigned int iterations = (unsigned int)MAX((size_t)1, MIN((size_t)copyIterations(memSize), (size_t)100000 / numChunks));
+
+    cl_mem cmHostData = NULL;
+    unsigned char *h_data = allocHostData(memSize, memMode, &cmHostData);
+    cl_mem cmDevData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, NULL, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    cl_mem cmDevData2 = NULL;
+    if(kind == DEVICE_TO_DEVICE)
+    {
+        cmDevData2 = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, cmDevData, CL_TRUE, 0, memSize, h_data, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    // Sync queue to host, start timer 0, and copy piece by piece
+    clFinish(cqCommandQueue);
+    shrDeltaT(0);
+    for(unsigned int i = 0; i < iterations; i++)
+    {
+        for(size_t offset = 0; offset < memSize; offset += chunk)
+        {
+            size_t size = MIN(chunk, memSize - offset);
+            switch(kind)
+            {
+            case HOST_TO_DEVICE:
+                ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, cmDevData, CL_FALSE, offset, size, h_data + offset, 0, NULL, latencyEvent(pendingEvents));
+                break;
+            case DEVICE_TO_HOST:
+                ciErrNum = clEnqueueReadBuffer(cqCommandQueue, cmDevData, CL_FALSE, offset, size, h_data + offset, 0, NULL, latencyEvent(pendingEvents));
+                break;
+            case DEVICE_TO_DEVICE:
+                ciErrNum = clEnqueueCopyBuffer(cqCommandQueue, cmDevData, cmDevData2, offset, offset, size, 0, NULL, latencyEvent(pendingEvents));
+                break;
+            }
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+    }
+    clFinish(cqCommandQueue);
+    double elapsedTimeInSec = shrDeltaT(0);
+    collectLatencies(pendingEvents, transferTimes);
+
+    double dFactor = (kind == DEVICE_TO_DEVICE) ? 2.0 : 1.0;
+    double bandwidthInMBs = dFactor * ((double)memSize * (double)iterations)/(elapsedTimeInSec * (double)(1 << 20));
+
+    freeHostData(h_data, memMode, cmHostData);
+    clReleaseMemObject(cmDevData);
+    if(cmDevData2)clReleaseMemObject(cmDevData2);
+    return bandwidthInMBs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  test the bandwidth of shared virtual memory (OpenCL 2.0 buffer SVM):
+//    direct - clEnqueueSVMMemcpy between pageable host memory and the SVM
+//             allocation (or between two SVM allocations, device to device)
+//    mapped - host memcpy through the SVM pointer itself; coarse-grained
+//             allocations are mapped around it, fine-grained ones need nothing
+///////////////////////////////////////////////////////////////////////////////
+double testSVMTransfer(size_t memSize, memcpyKind kind, accessMode accMode, bool bFineGrain)
+{
+#ifdef CL_VERSION_2_0
+    cl_int ciErrNum = CL_SUCCESS;
+    unsigned int iterations = copyIterations(memSize);
+
+    cl_device_svm_capabilities svmCaps = 0;
+    clGetDeviceInfo(cdCurrentDevice, CL_DEVICE_SVM_CAPABILITIES, sizeof(svmCaps), &svmCaps, NULL);
+    if(!(svmCaps & (bFineGrain ? CL_DEVICE_SVM_FINE_GRAIN_BUFFER : CL_DEVICE_SVM_COARSE_GRAIN_BUFFER)))
+    {
+        shrLog("   Device has no %s-grained buffer SVM, skipped\n", bFineGrain ? "fine" : "coarse");
+        return 0.0;
+    }
+
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE | (bFineGrain ? CL_MEM_SVM_FINE_GRAIN_BUFFER : 0);
+    unsigned char *svm_data = (unsigned char *)clSVMAlloc(cxGPUContext, flags, memSize, 0);
+    oclCheckError(svm_data != NULL, shrTRUE);
+    unsigned char *svm_data2 = NULL;
+    if(kind == DEVICE_TO_DEVICE)
+    {
+        svm_data2 = (unsigned char *)clSVMAlloc(cxGPUContext, flags, memSize, 0);
+        oclCheckError(svm_data2 != NULL, shrTRUE);
+    }
+    cl_mem cmHostData = NULL;
+    unsigned char *h_data = allocHostData(memSize, PAGEABLE, &cmHostData);
+    ciErrNum = clEnqueueSVMMemcpy(cqCommandQueue, CL_TRUE, svm_data, h_data, memSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    // Sync queue to host, start timer 0, and copy
+    clFinish(cqCommandQueue);
+    shrDeltaT(0);
+    if(accMode != MAPPED || kind == DEVICE_TO_DEVICE)
+    {
+        void *dst = (kind == HOST_TO_DEVICE) ? (void *)svm_data : (kind == DEVICE_TO_HOST) ? (void *)h_data : (void *)svm_data2;
+        void *src = (kind == HOST_TO_DEVICE) ? (void *)h_data : (void *)svm_data;
+        for(unsigned int i = 0; i < iterations; i++)
+        {
+            ciErrNum = clEnqueueSVMMemcpy(cqCommandQueue, CL_FALSE, dst, src, memSize, 0, NULL, latencyEvent(pendingEvents));
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+    }
+    else
+    {
+        if(!bFineGrain)
+        {
+            ciErrNum = clEnqueueSVMMap(cqCommandQueue, CL_TRUE, (kind == HOST_TO_DEVICE) ? CL_MAP_WRITE : CL_MAP_READ, 
+                                       svm_data, memSize, 0, NULL, NULL);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+        for(unsigned int i = 0; i < iterations; i++)
+        {
+            if(bLatency) shrDeltaT(1);
+            if(kind == HOST_TO_DEVICE)
+                memcpy(svm_data, h_data, memSize);
+            else
+                memcpy(h_data, svm_data, memSize);
+            if(bLatency) transferTimes.push_back(shrDeltaT(1));
+        }
+        if(!bFineGrain)
+        {
+            ciErrNum = clEnqueueSVMUnmap(cqCommandQueue, svm_data, 0, NULL, NULL);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+    }
+    clFinish(cqCommandQueue);
+    double elapsedTimeInSec = shrDeltaT(0);
+    collectLatencies(pendingEvents, transferTimes);
+
+    double dFactor = (kind == DEVICE_TO_DEVICE) ? 2.0 : 1.0;
+    double bandwidthInMBs = dFactor * ((double)memSize * (double)iterations)/(elapsedTimeInSec * (double)(1 << 20));
+
+    freeHostData(h_data, PAGEABLE, cmHostData);
+    clSVMFree(cxGPUContext, svm_data);
+    if(svm_data2)clSVMFree(cxGPUContext, svm_data2);
+    return bandwidthInMBs;
+#else
+    (void)memSize; (void)kind; (void)accMode; (void)bFineGrain;
+    shrLog("   SVM needs OpenCL 2.0 headers, skipped\n");
+    return 0.0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Concurrent transfers: every host thread owns a queue and its buffers on the
+//  current device and runs the direct copies of the single-thread test
+///////////////////////////////////////////////////////////////////////////////
+struct TransferThreadData
+{
+    cl_command_queue queue;
+    cl_mem cmDevData;
+    cl_mem cmDevData2;                              // device to device target
+    cl_mem cmHostData;                              // pinned or wrapped host memory
+    unsigned char *h_data;
+    size_t memSize;
+    memcpyKind kind;
+    memoryMode memMode;
+    unsigned int iterations;
+    std::vector<cl_event> events;
+};
+
+static CUT_THREADPROC transferThread(void *data)
+{
+    TransferThreadData *t = (TransferThreadData *)data;
+    cl_int ciErrNum = CL_SUCCESS;
+    for(unsigned int i = 0; i < t->iterations; i++)
+    {
+        cl_event *ev = latencyEvent(t->events);
+        switch(t->kind)
+        {
+        case HOST_TO_DEVICE:
+            if(t->memMode == HOST_PTR)
+                ciErrNum = clEnqueueCopyBuffer(t->queue, t->cmHostData, t->cmDevData, 0, 0, t->memSize, 0, NULL, ev);
+            else
+                ciErrNum = clEnqueueWriteBuffer(t->queue, t->cmDevData, CL_FALSE, 0, t->memSize, t->h_data, 0, NULL, ev);
+            break;
+        case DEVICE_TO_HOST:
+            if(t->memMode == HOST_PTR)
+                ciErrNum = clEnqueueCopyBuffer(t->queue, t->cmDevData, t->cmHostData, 0, 0, t->memSize, 0, NULL, ev);
+            else
+                ciErrNum = clEnqueueReadBuffer(t->queue, t->cmDevData, CL_FALSE, 0, t->memSize, t->h_data, 0, NULL, ev);
+            break;
+        case DEVICE_TO_DEVICE:
+            ciErrNum = clEnqueueCopyBuffer(t->queue, t->cmDevData, t->cmDevData2, 0, 0, t->memSize, 0, NULL, ev);
+            break;
+        }
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    clFinish(t->queue);
+    CUT_THREADEND;
+}
+
+double testConcurrentTransfer(size_t memSize, memcpyKind kind, memoryMode memMode)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    TransferThreadData data[MAX_THREADS];
+    CUTThread threads[MAX_THREADS];
+
+    // all resources are set up before the clock starts
+    for(int t = 0; t < numThreads; t++)
+    {
+        data[t].queue = clCreateCommandQueue(cxGPUContext, cdCurrentDevice, CL_QUEUE_PROFILING_ENABLE, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        data[t].h_data = allocHostData(memSize, memMode, &data[t].cmHostData);
+        data[t].cmDevData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        data[t].cmDevData2 = NULL;
+        if(kind == DEVICE_TO_DEVICE)
+        {
+            data[t].cmDevData2 = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, NULL, &ciErrNum);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+        ciErrNum = clEnqueueWriteBuffer(data[t].queue, data[t].cmDevData, CL_TRUE, 0, memSize, data[t].h_data, 0, NULL, NULL);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        data[t].memSize = memSize;
+        data[t].kind = kind;
+        data[t].memMode = memMode;
+        data[t].iterations = copyIterations(memSize);
+    }
+
+    shrDeltaT(0);
+    for(int t = 0; t < numThreads; t++)
+    {
+        threads[t] = cutStartThread((CUT_THREADROUTINE)transferThread, (void *)&data[t]);
+    }
+    cutWaitForThreads(threads, numThreads);
+    double elapsedTimeInSec = shrDeltaT(0);
+
+    // aggregate bandwidth of all threads over the wall clock time
+    double dBytes = 0.0;
+    for(int t = 0; t < numThreads; t++)
+    {
+        dBytes += (double)memSize * (double)data[t].iterations;
+        collectLatencies(data[t].events, transferTimes);
+        freeHostData(data[t].h_data, memMode, data[t].cmHostData);
+        clReleaseMemObject(data[t].cmDevData);
+        if(data[t].cmDevData2)clReleaseMemObject(data[t].cmDevData2);
+        clReleaseCommandQueue(data[t].queue);
+    }
+    double dFactor = (kind == DEVICE_TO_DEVICE) ? 2.0 : 1.0;
+    return dFactor * dBytes / (elapsedTimeInSec * (double)(1 << 20));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Percentile of sorted per-transfer durations, in microseconds
+///////////////////////////////////////////////////////////////////////////////
+double latencyPercentile(const std::vector<double> &sortedTimes, double p)
+{
+    if(sortedTimes.empty())
+    {
+        return 0.0;
+    }
+    size_t index = (size_t)(p * (double)(sortedTimes.size() - 1) + 0.5);
+    return 1.0e6 * sortedTimes[MIN(index, sortedTimes.size() - 1)];
+}
+
 /////////////////////////////////////////////////////////
 //print results in an easily read format
 ////////////////////////////////////////////////////////
-void printResultsReadable(unsigned int *memSizes, double* bandwidths, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs)
+void printResultsReadable(size_t *memSizes, double* bandwidths, std::vector<double> *times, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs)
 {
     // log config information 
     if (kind == DEVICE_TO_DEVICE)
     {
-        shrLog("Device to Device Bandwidth, %i Device(s)\n", iNumDevs);
+        shrLog("Device to Device Bandwidth, %i Device(s)", iNumDevs);
+        if(memMode == SVM_COARSE || memMode == SVM_FINE)
+        {
+            shrLog(", %s-grained SVM", (memMode == SVM_FINE) ? "fine" : "coarse");
+        }
     }
     else 
     {
@@ -838,29 +1445,67 @@ void printResultsReadable(unsigned int *memSizes, double* bandwidths, unsigned i
         {
             shrLog("Pinned memory");
         }
+        else if (memMode == HOST_PTR)
+        {
+            shrLog("USE_HOST_PTR memory");
+        }
+        else if (memMode == SVM_COARSE)
+        {
+            shrLog("coarse-grained SVM");
+        }
+        else if (memMode == SVM_FINE)
+        {
+            shrLog("fine-grained SVM");
+        }
         if(accMode == DIRECT)
         {
-            shrLog(", direct access\n");
+            shrLog(", direct access");
         }
         else if (accMode == MAPPED)
         {
-            shrLog(", mapped access\n");
+            shrLog(", mapped access");
         }
     }
+    if(accMode == RECT)
+    {
+        shrLog(", rect access (%llu Byte rows)", (unsigned long long)rowSize);
+    }
+    else if(accMode == BATCH)
+    {
+        shrLog(", batched access (%llu Byte pieces)", (unsigned long long)batchSize);
+    }
+    if(numThreads > 1)
+    {
+        shrLog(", %i threads", numThreads);
+    }
+    shrLog("\n");
 
-    shrLog("   Transfer Size (Bytes)\tBandwidth(MB/s)\n");
-    unsigned int i; 
-    for(i = 0; i < (count - 1); i++)
+    if(bLatency)
+    {
+        shrLog("   Transfer Size (Bytes)\tBandwidth(MB/s)\tp50(us)\tp90(us)\tp99(us)\tMax(us)\n");
+    }
+    else
     {
-        shrLog("   %u\t\t\t%s%.1f\n", memSizes[i], (memSizes[i] < 10000)? "\t" : "", bandwidths[i]);
+        shrLog("   Transfer Size (Bytes)\tBandwidth(MB/s)\n");
     }
-    shrLog("   %u\t\t\t%s%.1f\n\n", memSizes[i], (memSizes[i] < 10000)? "\t" : "", bandwidths[i]);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        shrLog("   %llu\t\t\t%s%.1f", (unsigned long long)memSizes[i], (memSizes[i] < 10000)? "\t" : "", bandwidths[i]);
+        if(bLatency)
+        {
+            std::sort(times[i].begin(), times[i].end());
+            shrLog("\t\t%.2f\t%.2f\t%.2f\t%.2f", latencyPercentile(times[i], 0.5), latencyPercentile(times[i], 0.9),
+                   latencyPercentile(times[i], 0.99), latencyPercentile(times[i], 1.0));
+        }
+        shrLog("\n");
+    }
+    shrLog("\n");
 }
 
 ///////////////////////////////////////////////////////////////////////////
 //print results in a database format
 ///////////////////////////////////////////////////////////////////////////
-void printResultsCSV(unsigned int *memSizes, double* bandwidths, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs)
+void printResultsCSV(size_t *memSizes, double* bandwidths, std::vector<double> *times, unsigned int count, memcpyKind kind, accessMode accMode, memoryMode memMode, int iNumDevs)
 {
     unsigned int i; 
     double dSeconds = 0.0;
@@ -870,6 +1515,14 @@ void printResultsCSV(unsigned int *memSizes, double* bandwidths, unsigned int co
     if (kind == DEVICE_TO_DEVICE)
     {
         sConfig += "D2D";
+        if(memMode == SVM_COARSE)
+        {
+            sConfig += "-SVMCoarse";
+        }
+        else if (memMode == SVM_FINE)
+        {
+            sConfig += "-SVMFine";
+        }
     }
     else 
     {
@@ -890,6 +1543,18 @@ void printResultsCSV(unsigned int *memSizes, double* bandwidths, unsigned int co
         {
             sConfig += "-Pinned";
         }
+        else if (memMode == HOST_PTR)
+        {
+            sConfig += "-HostPtr";
+        }
+        else if (memMode == SVM_COARSE)
+        {
+            sConfig += "-SVMCoarse";
+        }
+        else if (memMode == SVM_FINE)
+        {
+            sConfig += "-SVMFine";
+        }
 
         if(accMode == DIRECT)
         {
@@ -900,12 +1565,37 @@ void printResultsCSV(unsigned int *memSizes, double* bandwidths, unsigned int co
             sConfig += "-Mapped";            
         }
     }
-
+    if(accMode == RECT)
+    {
+        sConfig += "-Rect";
+    }
+    else if(accMode == BATCH)
+    {
+        sConfig += "-Batch";
+    }
+    if(numThreads > 1)
+    {
+        char cThreads[16];
+        sprintf(cThreads, "-T%i", numThreads);
+        sConfig += cThreads;
+    }
 
     for(i = 0; i < count; i++)
     {
         dSeconds = (double)memSizes[i] / (bandwidths[i] * (double)(1<<20));
-        shrLogEx(LOGBOTH | MASTER, 0, "oclBandwidthTest-%s, Bandwidth = %.1f MB/s, Time = %.5f s, Size = %u Bytes, NumDevsUsed = %i\n", sConfig.c_str(), bandwidths[i], dSeconds, memSizes[i], iNumDevs);
+        shrLogEx(LOGBOTH | MASTER, 0, "oclBandwidthTest-%s, Bandwidth = %.1f MB/s, Time = %.5f s, Size = %llu Bytes, NumDevsUsed = %i\n", 
+                 sConfig.c_str(), bandwidths[i], dSeconds, (unsigned long long)memSizes[i], iNumDevs);
+    }
+
+    if(bLatency)
+    {
+        for(i = 0; i < count; i++)
+        {
+            std::sort(times[i].begin(), times[i].end());
+            shrLogEx(LOGBOTH | MASTER, 0, "oclBandwidthTest-%s-Latency, P50 = %.2f us, P90 = %.2f us, P99 = %.2f us, Max = %.2f us, Size = %llu Bytes, NumDevsUsed = %i\n", 
+                     sConfig.c_str(), latencyPercentile(times[i], 0.5), latencyPercentile(times[i], 0.9), latencyPercentile(times[i], 0.99), 
+                     latencyPercentile(times[i], 1.0), (unsigned long long)memSizes[i], iNumDevs);
+        }
     }
 }
 
@@ -930,9 +1620,16 @@ void printHelp(void)
     shrLog("--access=[ACCESSMODE]\tSpecify which memory access mode to use\n");
     shrLog("  direct   - direct device memory\n");
     shrLog("  mapped   - mapped device memory\n");
+    shrLog("  rect     - 2D strided copies of --row sized rows\n");
+    shrLog("  batch    - the transfer split into --batch sized pieces\n");
     shrLog("--memory=[MEMMODE]\tSpecify which memory mode to use\n");
-    shrLog("  pageable  - pageable system memory\n");
-    shrLog("  pinned    - pinned system memory\n");
+    shrLog("  pageable   - pageable system memory\n");
+    shrLog("  pinned     - pinned system memory\n");
+    shrLog("  hostptr    - page aligned system memory wrapped with CL_MEM_USE_HOST_PTR\n");
+    shrLog("  svm-coarse - coarse-grained buffer SVM (OpenCL 2.0)\n");
+    shrLog("  svm-fine   - fine-grained buffer SVM (OpenCL 2.0)\n");
+    shrLog("--threads=[N]\tRun direct transfers from N host threads at once (1 to %i)\n", MAX_THREADS);
+    shrLog("--latency\tReport p50/p90/p99/max duration of the single transfers\n");
     shrLog("--mode=[MODE]\tSpecify the mode to use\n");
     shrLog("  quick - performs a quick measurement\n");
     shrLog("  range - measures a user-specified range of values\n");
@@ -946,4 +1643,8 @@ void printHelp(void)
     shrLog("--start=[SIZE]\tStarting transfer size in bytes\n");
     shrLog("--end=[SIZE]\tEnding transfer size in bytes\n");
     shrLog("--increment=[SIZE]\tIncrement size in bytes\n");
+    shrLog("Sizes accept a K, M or G suffix\n");
+    shrLog("--row=[SIZE]\tRow size of rect access (default %i)\n", DEFAULT_ROW_SIZE);
+    shrLog("--batch=[SIZE]\tPiece size of batched access (default %i)\n", DEFAULT_BATCH_SIZE);
+    shrLog("--max=[SIZE]\tLargest shmoo size, doubling past 64 MB while allocations fit the device\n");
 }
@@ -0,0 +1,107 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _COPY_COMPUTE_PIPELINE_H_
+#define _COPY_COMPUTE_PIPELINE_H_
+
+#include <CL/cl.h>
+
+#define PIPELINE_MAX_STREAMS 8
+#define PIPELINE_MAX_DEPTH   8
+
+// Streams host arrays through a kernel in chunks, overlapping the upload of
+// chunk i+1 and the download of chunk i-1 with the computation of chunk i.
+//
+// Every stage has its own in-order command queue, a ring of 'depth' device
+// buffer slots carries the chunks and events link the stages:
+//   upload(c)   waits for download(c - depth), which frees the slot
+//   compute(c)  waits for upload(c)
+//   download(c) waits for compute(c)
+//
+// The kernel sees one chunk at a time: every input and output argument is set
+// to the slot buffer of the chunk and the count argument to the number of
+// work-items the chunk needs (elements / elementsPerItem). Any other argument
+// is set by the caller once. The kernel must only access elements of its own
+// chunk; host pointers should be pinned for the copies to be asynchronous.
+class CopyComputePipeline
+{
+public:
+    CopyComputePipeline(cl_context GPUContext,
+                        cl_device_id Device,
+                        cl_kernel Kernel,
+                        size_t localWorkSize,
+                        cl_uint countArg,
+                        cl_uint elementsPerItem);
+    ~CopyComputePipeline();
+
+    // host arrays of numElements elements of elementBytes each
+    void AddInput(cl_uint arg, const void *host, size_t elementBytes);
+    void AddOutput(cl_uint arg, void *host, size_t elementBytes);
+
+    // chunk size in elements (multiple of elementsPerItem) and ring depth
+    void Configure(size_t chunkElements, int depth);
+
+    // whole arrays through the pipeline, returns the elapsed time in seconds
+    double Run(size_t numElements);
+
+    // reference path on one queue: upload everything, one launch, download,
+    // every stage timed on its own; returns the total time in seconds
+    double RunSerial(size_t numElements);
+
+    // tries chunk counts and depths, keeps the fastest configuration
+    double Tune(size_t numElements);
+
+    // share of the serial time saved by the last Run, in percent, and the
+    // best possible share, when only the slowest stage is left
+    double OverlapPercent() {return 100.0 * (1.0 - dRunTime / dSerialTime);}
+    double IdealOverlapPercent();
+    double GetStageTime(int stage) {return dStageTime[stage];}
+
+    size_t GetChunkElements() {return szChunk;}
+    int GetDepth() {return iDepth;}
+    size_t GetNumChunks(size_t numElements) {return (numElements + szChunk - 1) / szChunk;}
+
+private:
+    struct Stream
+    {
+        cl_uint arg;
+        void *host;
+        size_t elementBytes;
+        bool bInput;
+        cl_mem slot[PIPELINE_MAX_DEPTH];
+    };
+
+    cl_context cxGPUContext;
+    cl_device_id cdDevice;
+    cl_kernel ckKernel;
+    cl_command_queue cqUpload;
+    cl_command_queue cqCompute;
+    cl_command_queue cqDownload;
+    Stream streams[PIPELINE_MAX_STREAMS];
+    int nStreams;
+    size_t szLocalWorkSize;
+    cl_uint uiCountArg;
+    cl_uint uiElementsPerItem;
+    size_t szChunk;                      // elements per chunk
+    size_t szAllocated;                  // elements per slot buffer
+    int iAllocated;                      // slots allocated
+    int iDepth;
+    double dRunTime;
+    double dSerialTime;
+    double dStageTime[3];                // upload, compute, download of RunSerial
+
+    void allocSlots(size_t elements, int depth);
+    void releaseSlots();
+    void enqueueKernel(cl_command_queue queue, int slot, size_t elements,
+                       cl_uint numEvents, const cl_event *waitList, cl_event *event);
+};
+
+#endif
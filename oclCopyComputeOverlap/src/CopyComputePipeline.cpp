@@ -0,0 +1,294 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include <oclUtils.h>
+#include "CopyComputePipeline.h"
+
+// chunks below this size are dominated by launch and copy latency
+#define PIPELINE_MIN_CHUNK_BYTES (256 * 1024)
+#define PIPELINE_MAX_CHUNKS      64
+
+CopyComputePipeline::CopyComputePipeline(cl_context GPUContext,
+                                         cl_device_id Device,
+                                         cl_kernel Kernel,
+                                         size_t localWorkSize,
+                                         cl_uint countArg,
+                                         cl_uint elementsPerItem)
+{
+    cl_int ciErrNum;
+
+    cxGPUContext = GPUContext;
+    cdDevice = Device;
+    ckKernel = Kernel;
+    szLocalWorkSize = localWorkSize;
+    uiCountArg = countArg;
+    uiElementsPerItem = elementsPerItem;
+    nStreams = 0;
+    szChunk = 0;
+    szAllocated = 0;
+    iAllocated = 0;
+    iDepth = 2;
+    dRunTime = dSerialTime = 0.0;
+    dStageTime[0] = dStageTime[1] = dStageTime[2] = 0.0;
+
+    // one in-order queue per stage, so copies in both directions can run
+    // next to the kernel on devices with separate copy engines
+    cqUpload = clCreateCommandQueue(cxGPUContext, cdDevice, 0, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    cqCompute = clCreateCommandQueue(cxGPUContext, cdDevice, 0, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    cqDownload = clCreateCommandQueue(cxGPUContext, cdDevice, 0, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+CopyComputePipeline::~CopyComputePipeline()
+{
+    releaseSlots();
+    clReleaseCommandQueue(cqUpload);
+    clReleaseCommandQueue(cqCompute);
+    clReleaseCommandQueue(cqDownload);
+}
+
+void CopyComputePipeline::AddInput(cl_uint arg, const void *host, size_t elementBytes)
+{
+    oclCheckError(nStreams < PIPELINE_MAX_STREAMS, shrTRUE);
+    Stream &s = streams[nStreams++];
+    s.arg = arg;
+    s.host = (void *)host;
+    s.elementBytes = elementBytes;
+    s.bInput = true;
+    releaseSlots();
+}
+
+void CopyComputePipeline::AddOutput(cl_uint arg, void *host, size_t elementBytes)
+{
+    oclCheckError(nStreams < PIPELINE_MAX_STREAMS, shrTRUE);
+    Stream &s = streams[nStreams++];
+    s.arg = arg;
+    s.host = host;
+    s.elementBytes = elementBytes;
+    s.bInput = false;
+    releaseSlots();
+}
+
+void CopyComputePipeline::Configure(size_t chunkElements, int depth)
+{
+    szChunk = MAX(chunkElements, (size_t)uiElementsPerItem);
+    szChunk = ((szChunk + uiElementsPerItem - 1) / uiElementsPerItem) * uiElementsPerItem;
+    iDepth = CLAMP(depth, 1, PIPELINE_MAX_DEPTH);
+}
+
+// slot buffers are only reallocated when they are too small or too few
+void CopyComputePipeline::allocSlots(size_t elements, int depth)
+{
+    if (elements <= szAllocated && depth <= iAllocated) return;
+
+    releaseSlots();
+    cl_int ciErrNum;
+    for (int k = 0; k < nStreams; k++)
+    {
+        cl_mem_flags flags = streams[k].bInput ? CL_MEM_READ_ONLY : CL_MEM_WRITE_ONLY;
+        for (int s = 0; s < depth; s++)
+        {
+            streams[k].slot[s] = clCreateBuffer(cxGPUContext, flags, elements * streams[k].elementBytes, NULL, &ciErrNum);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+    }
+    szAllocated = elements;
+    iAllocated = depth;
+}
+
+void CopyComputePipeline::releaseSlots()
+{
+    for (int k = 0; k < nStreams; k++)
+        for (int s = 0; s < iAllocated; s++)
+            clReleaseMemObject(streams[k].slot[s]);
+    szAllocated = 0;
+    iAllocated = 0;
+}
+
+void CopyComputePipeline::enqueueKernel(cl_command_queue queue, int slot, size_t elements,
+                                        cl_uint numEvents, const cl_event *waitList, cl_event *event)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    for (int k = 0; k < nStreams; k++)
+        ciErrNum |= clSetKernelArg(ckKernel, streams[k].arg, sizeof(cl_mem), (void*)&streams[k].slot[slot]);
+    cl_uint uiItems = (cl_uint)((elements + uiElementsPerItem - 1) / uiElementsPerItem);
+    ciErrNum |= clSetKernelArg(ckKernel, uiCountArg, sizeof(cl_uint), (void*)&uiItems);
+    size_t szGlobalWorkSize = shrRoundUp((int)szLocalWorkSize, (int)uiItems);
+    ciErrNum |= clEnqueueNDRangeKernel(queue, ckKernel, 1, NULL, &szGlobalWorkSize, &szLocalWorkSize,
+                                       numEvents, waitList, event);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+double CopyComputePipeline::Run(size_t numElements)
+{
+    if (szChunk == 0) Configure(numElements, 1);
+    allocSlots(szChunk, iDepth);
+
+    // last event of every stage per slot, NULL while the slot is unused
+    cl_event evUpload[PIPELINE_MAX_DEPTH] = {0};
+    cl_event evCompute[PIPELINE_MAX_DEPTH] = {0};
+    cl_event evDownload[PIPELINE_MAX_DEPTH] = {0};
+    cl_int ciErrNum = CL_SUCCESS;
+
+    clFinish(cqUpload);
+    clFinish(cqCompute);
+    clFinish(cqDownload);
+    shrDeltaT(1);
+
+    size_t nChunks = GetNumChunks(numElements);
+    for (size_t c = 0; c < nChunks; c++)
+    {
+        int s = (int)(c % iDepth);
+        size_t szOffset = c * szChunk;
+        size_t szElements = MIN(szChunk, numElements - szOffset);
+
+        // the slot is free once its previous chunk has been downloaded
+        cl_event evFree = evDownload[s];
+        cl_uint nFree = evFree ? 1 : 0;
+        evDownload[s] = NULL;
+        if (evUpload[s]) clReleaseEvent(evUpload[s]);
+        if (evCompute[s]) clReleaseEvent(evCompute[s]);
+        evUpload[s] = evCompute[s] = NULL;
+
+        // upload: the in-order queue makes the last write stand for all of them
+        for (int k = 0; k < nStreams; k++)
+        {
+            if (!streams[k].bInput) continue;
+            if (evUpload[s]) clReleaseEvent(evUpload[s]);
+            ciErrNum |= clEnqueueWriteBuffer(cqUpload, streams[k].slot[s], CL_FALSE, 0, szElements * streams[k].elementBytes,
+                                             (char *)streams[k].host + szOffset * streams[k].elementBytes,
+                                             nFree, nFree ? &evFree : NULL, &evUpload[s]);
+        }
+        oclCheckError(ciErrNum, CL_SUCCESS);
+
+        // compute, after the upload or, without inputs, after the slot is free
+        if (evUpload[s])
+            enqueueKernel(cqCompute, s, szElements, 1, &evUpload[s], &evCompute[s]);
+        else
+            enqueueKernel(cqCompute, s, szElements, nFree, nFree ? &evFree : NULL, &evCompute[s]);
+
+        // download
+        for (int k = 0; k < nStreams; k++)
+        {
+            if (streams[k].bInput) continue;
+            if (evDownload[s]) clReleaseEvent(evDownload[s]);
+            ciErrNum |= clEnqueueReadBuffer(cqDownload, streams[k].slot[s], CL_FALSE, 0, szElements * streams[k].elementBytes,
+                                            (char *)streams[k].host + szOffset * streams[k].elementBytes,
+                                            1, &evCompute[s], &evDownload[s]);
+        }
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        if (!evDownload[s])
+        {
+            evDownload[s] = evCompute[s];
+            clRetainEvent(evDownload[s]);
+        }
+        if (evFree) clReleaseEvent(evFree);
+
+        // Push the work of every stage to the driver
+        // (not necessary on Linux, Mac OSX or WinXP)
+        clFlush(cqUpload);
+        clFlush(cqCompute);
+        clFlush(cqDownload);
+    }
+
+    clFinish(cqUpload);
+    clFinish(cqCompute);
+    clFinish(cqDownload);
+    dRunTime = shrDeltaT(1);
+
+    for (int s = 0; s < iDepth; s++)
+    {
+        if (evUpload[s]) clReleaseEvent(evUpload[s]);
+        if (evCompute[s]) clReleaseEvent(evCompute[s]);
+        if (evDownload[s]) clReleaseEvent(evDownload[s]);
+    }
+    return dRunTime;
+}
+
+double CopyComputePipeline::RunSerial(size_t numElements)
+{
+    allocSlots(numElements, 1);
+    cl_int ciErrNum = CL_SUCCESS;
+
+    clFinish(cqCompute);
+    shrDeltaT(1);
+    for (int k = 0; k < nStreams; k++)
+    {
+        if (!streams[k].bInput) continue;
+        ciErrNum |= clEnqueueWriteBuffer(cqCompute, streams[k].slot[0], CL_FALSE, 0, numElements * streams[k].elementBytes,
+                                         streams[k].host, 0, NULL, NULL);
+    }
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    clFinish(cqCompute);
+    dStageTime[0] = shrDeltaT(1);
+
+    enqueueKernel(cqCompute, 0, numElements, 0, NULL, NULL);
+    clFinish(cqCompute);
+    dStageTime[1] = shrDeltaT(1);
+
+    for (int k = 0; k < nStreams; k++)
+    {
+        if (streams[k].bInput) continue;
+        ciErrNum |= clEnqueueReadBuffer(cqCompute, streams[k].slot[0], CL_FALSE, 0, numElements * streams[k].elementBytes,
+                                        streams[k].host, 0, NULL, NULL);
+    }
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    clFinish(cqCompute);
+    dStageTime[2] = shrDeltaT(1);
+
+    dSerialTime = dStageTime[0] + dStageTime[1] + dStageTime[2];
+    return dSerialTime;
+}
+
+double CopyComputePipeline::IdealOverlapPercent()
+{
+    double dSlowest = MAX(dStageTime[0], MAX(dStageTime[1], dStageTime[2]));
+    return (dSerialTime > 0.0) ? 100.0 * (1.0 - dSlowest / dSerialTime) : 0.0;
+}
+
+double CopyComputePipeline::Tune(size_t numElements)
+{
+    size_t szElementBytes = 0;
+    for (int k = 0; k < nStreams; k++)
+        szElementBytes = MAX(szElementBytes, streams[k].elementBytes);
+    size_t szGranularity = szLocalWorkSize * uiElementsPerItem;
+
+    // more chunks shorten the fill and drain of the pipeline but add latency
+    // per chunk, a deeper ring absorbs jitter between the stages
+    double dBest = -1.0;
+    size_t szBestChunk = numElements;
+    int iBestDepth = 1;
+    for (int nChunks = 2; nChunks <= PIPELINE_MAX_CHUNKS; nChunks *= 2)
+    {
+        size_t szTryChunk = (numElements + nChunks - 1) / nChunks;
+        szTryChunk = ((szTryChunk + szGranularity - 1) / szGranularity) * szGranularity;
+        if (nChunks > 2 && szTryChunk * szElementBytes < PIPELINE_MIN_CHUNK_BYTES) break;
+
+        for (int depth = 2; depth <= MIN(4, nChunks); depth++)
+        {
+            Configure(szTryChunk, depth);
+            Run(numElements);                               // warm up the slots
+            double dTime = Run(numElements);
+            if (dBest < 0.0 || dTime < dBest)
+            {
+                dBest = dTime;
+                szBestChunk = szChunk;
+                iBestDepth = iDepth;
+            }
+        }
+    }
+
+    Configure(szBestChunk, iBestDepth);
+    dRunTime = dBest;
+    return dBest;
+}
@@ -31,6 +31,12 @@
 //
 //      The 2-command queue approach ought to be substantially faster
 //
+//      C) Computations through the N-stage pipeline (CopyComputePipeline)
+//         Upload, compute and download each get a queue, chunks rotate through a ring of
+//         device buffers linked by events. Chunk count and ring depth are tuned on the system
+//         (or given with "chunks=<n>" and "depth=<n>") and the overlap is reported against
+//         the serial path and against the ideal, where only the slowest stage is left
+//
 // For developmental purposes, the "iInnerLoopCount" variable passes into kernel and independently 
 // increases compute time without increasing data size (via a loop inside the kernel)
 //
@@ -57,6 +63,7 @@
 // common SDK header for standard utilities and system libs 
 #include <oclUtils.h>
 #include <shrQATest.h>
+#include "CopyComputePipeline.h"
 
 // Best possible and Min ratio of compute/copy overlap timing benefit to pass the test
 // values greater than 0.0f represent a speed-up relative to non-overlapped
@@ -105,6 +112,7 @@ bool bQATest = false;                               // Command line switch to te
 // *********************************************************************
 double DualQueueSequence(int iCycles, unsigned int uiNumElements, bool bShowConfig);
 double OneQueueSequence(int iCycles, unsigned int uiNumElements, bool bShowConfig);
+bool PipelineSequence(cl_device_id cdTargetDevice, unsigned int uiNumElements, int iInnerLoopCount);
 int AdjustCompute(cl_device_id cdTargetDevice, unsigned int uiNumElements, int iInitialLoopCount, int iCycles); 
 void VectorHypotHost(const float* pfData1, const float* pfData2, float* pfResult, unsigned int uiNumElements, int iInnerLoopCount);
 void Cleanup (int iExitCode);
@@ -425,6 +433,11 @@ int main(int argc, const char **argv)
 		shrLog("  Measured and (Acceptable) Avg Overlap\t= %.1f %% (%.1f %%)  -> Retry %d more time(s)...\n\n", dAvgOverlap, fMinPassCriteria[1], RETRIES_ON_FAILURE - iRun);
 	}
 
+    //*******************************************
+    // Run the N-stage pipeline
+    //*******************************************
+    bPassFlag &= PipelineSequence(cdDevices[uiTargetDevice], uiNumElements, iInnerLoopCount);
+
 
     //*******************************************
     // Report pass/fail, cleanup and exit
@@ -572,6 +585,70 @@ double DualQueueSequence(int iCycles, unsigned int uiNumElements, bool bShowConf
     return dAvgTime;
 }
 
+// Run the whole arrays through the N-stage pipeline and compare with the serial path
+// *********************************************************************
+bool PipelineSequence(cl_device_id cdTargetDevice, unsigned int uiNumElements, int iInnerLoopCount)
+{
+    // Own kernel instance, the pipeline sets the buffers and the count per chunk
+    cl_uint uiOffset = 0;
+    cl_kernel ckPipeline = clCreateKernel(cpProgram, "VectorHypot", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(ckPipeline, 3, sizeof(cl_uint), (void*)&uiOffset);
+    ciErrNum |= clSetKernelArg(ckPipeline, 4, sizeof(cl_int), (void*)&iInnerLoopCount);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    // VectorHypot processes 4 elements per work item and bound checks the float4 index
+    // against arg 5, so the count handed to the kernel is in work items
+    CopyComputePipeline pipeline(cxGPUContext, cdTargetDevice, ckPipeline, szLocalWorkSize, 5, 4);
+    pipeline.AddInput(0, fSourceA, sizeof(cl_float));
+    pipeline.AddInput(1, fSourceB, sizeof(cl_float));
+    pipeline.AddOutput(2, fResult, sizeof(cl_float));
+
+    // Serial reference: all data up, one launch, all data down
+    shrLog("N-stage pipeline:\n");
+    pipeline.RunSerial(uiNumElements);
+    pipeline.RunSerial(uiNumElements);
+
+    // Fixed configuration from the command line, otherwise tuned on this system
+    cl_uint uiChunks = 0;
+    cl_uint uiDepth = 0;
+    shrGetCmdLineArgumentu(*gp_argc, *gp_argv, "chunks", &uiChunks);
+    shrGetCmdLineArgumentu(*gp_argc, *gp_argv, "depth", &uiDepth);
+    if (uiChunks > 0 || uiDepth > 0)
+    {
+        uiChunks = CLAMP(uiChunks > 0 ? uiChunks : 8, 1, 1024);
+        uiDepth = CLAMP(uiDepth > 0 ? uiDepth : 3, 1, PIPELINE_MAX_DEPTH);
+        pipeline.Configure((uiNumElements + uiChunks - 1) / uiChunks, (int)uiDepth);
+        pipeline.Run(uiNumElements);
+    }
+    else
+    {
+        shrLog("  Tuning chunk count and depth...\n");
+        pipeline.Tune(uiNumElements);
+    }
+
+    // Timed run on fresh output, checked against the host
+    memset(fResult, 0, szBuffBytes);
+    double dPipeTime = pipeline.Run(uiNumElements);
+    shrBOOL bMatch = shrComparefet(Golden, fResult, uiNumElements, 0.0f, 0);
+
+    shrLog("  Chunks x Elements, Depth\t\t= %u x %u, %d\n", (unsigned int)pipeline.GetNumChunks(uiNumElements), 
+           (unsigned int)pipeline.GetChunkElements(), pipeline.GetDepth());
+    shrLog("  Serial Upload / Compute / Download\t= %.5f / %.5f / %.5f s\n", 
+           pipeline.GetStageTime(0), pipeline.GetStageTime(1), pipeline.GetStageTime(2));
+    shrLog("  Serial vs Pipeline Elapsed Time\t= %.5f s vs %.5f s\n", 
+           pipeline.GetStageTime(0) + pipeline.GetStageTime(1) + pipeline.GetStageTime(2), dPipeTime);
+    shrLog("  Measured and (Ideal) Overlap\t\t= %.1f %% (%.1f %%)\n", pipeline.OverlapPercent(), pipeline.IdealOverlapPercent());
+    shrLog("  Device vs Host Result Comparison\t: gpu %s cpu\n\n", (bMatch == shrTRUE) ? "MATCHES" : "DOESN'T MATCH"); 
+
+    // Log info to master log in standard format
+    shrLogEx(LOGBOTH | MASTER, 0, "oclCopyComputeOverlap-Pipeline, Throughput = %.4f OverlapPercent, Time = %.5f s, Size = %u Elements, NumDevsUsed = %u, Workgroup = %u\n", 
+             pipeline.OverlapPercent(), dPipeTime, uiNumElements, 1, szLocalWorkSize); 
+
+    clReleaseKernel(ckPipeline);
+    return (bMatch == shrTRUE);
+}
+
 // Function to adjust compute task according to device capability
 // This allows a consistent overlap % across a wide variety of GPU's for test purposes
 // It also implitly illustrates the relationship between compute capability and overlap at fixed work size
@@ -0,0 +1,113 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _HMM_BATCH_H_
+#define _HMM_BATCH_H_
+
+#include <CL/cl.h>
+
+// log(0) stand-in, kept finite so the kernels do not depend on IEEE infinities
+#define HMM_LOG_ZERO (-1.0e30f)
+
+// Log-space decoding and training of one model over many independent
+// observation sequences of varying length.
+//
+// Sequences are concatenated in obs, sequence b covers obs[seqOffset[b]] ..
+// obs[seqOffset[b] + seqLength[b] - 1]. Every pass launches one kernel per
+// time step for the whole batch; work-groups of sequences that are already
+// finished return immediately.
+//
+// The model is given as natural logarithms, in the layout used by HMM:
+//   logInit[nState]
+//   logState[iState*nState + preState]  log P(preState -> iState)
+//   logEmit[symbol*nState + iState]
+class HMMBatch
+{
+public:
+    HMMBatch(cl_context GPUContext,
+             cl_command_queue CommandQue,
+             const float *logInit,
+             const float *logState,
+             const float *logEmit,
+             int numState,
+             int numEmit,
+             const int *obs,
+             const int *seqLength,
+             int numSeq,
+             const char *path,
+             int workgroupSize);
+    ~HMMBatch();
+
+    // most probable state path of every sequence
+    // vProb: numSeq floats (log probability of the path), vPath: totalObs ints
+    void ViterbiBatch(cl_mem vProb, cl_mem vPath);
+
+    // forward and backward lattices of every sequence, logLik (numSeq floats)
+    // receives log P(obs | model) when not NULL
+    void ForwardBackwardBatch(float *logLik);
+
+    // posterior state probabilities, gamma holds totalObs*nState floats
+    // (not logarithms); needs a preceding ForwardBackwardBatch
+    void PosteriorBatch(cl_mem gamma);
+
+    // one Baum-Welch iteration over the batch, the model is re-estimated in
+    // place; returns the total log-likelihood under the model before the update
+    double BaumWelchStep();
+
+    // current model, same layout as the constructor arguments
+    void ReadModel(float *logInit, float *logState, float *logEmit);
+
+    int getTotalObs() {return totalObs;}
+    size_t getWorkgroupSize() {return localSize;}
+
+private:
+    cl_context cxGPUContext;             // OpenCL context
+    cl_command_queue cqCommandQue;       // OpenCL command que
+    cl_program cpProgram;                // OpenCL program
+    cl_kernel ckForwardStep;
+    cl_kernel ckBackwardStep;
+    cl_kernel ckViterbiStep;
+    cl_kernel ckViterbiPath;
+    cl_kernel ckLogLikelihood;
+    cl_kernel ckPosterior;
+    cl_kernel ckAccumTrans;
+    cl_kernel ckAccumEmit;
+    cl_kernel ckAccumInit;
+    cl_kernel ckReestimate;
+    cl_mem d_logInit;
+    cl_mem d_logState;                   // destination-major, as logState
+    cl_mem d_logStateT;                  // source-major copy for the forward pass
+    cl_mem d_logEmit;
+    cl_mem d_obs;
+    cl_mem d_seqOffset;
+    cl_mem d_seqLength;
+    cl_mem d_seqOf;                      // sequence of every observation
+    cl_mem d_symStart;                   // observations sorted by symbol,
+    cl_mem d_symPos;                     // for the emission counts
+    cl_mem d_alpha;                      // forward (or Viterbi) lattice
+    cl_mem d_beta;                       // backward lattice
+    cl_mem d_psi;                        // Viterbi back pointers
+    cl_mem d_logLik;
+    cl_mem d_numTrans;                   // expected counts, nSlice partial sums
+    cl_mem d_numEmit;
+    cl_mem d_numInit;
+    int nState;
+    int nEmit;
+    int nSeq;
+    int totalObs;
+    int maxLength;
+    int nSlice;
+    size_t localSize;
+    void launchSteps(cl_kernel kernel, cl_uint tArg, int t);
+    void launch1D(cl_kernel kernel, size_t n);
+};
+
+#endif
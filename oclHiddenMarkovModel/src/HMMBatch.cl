@@ -0,0 +1,424 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+// Batched log-space HMM passes, see HMMBatch.h for the data layout.
+//
+// The per-step kernels run on a 2D range: dimension 0 covers the states of
+// one sequence in a single row of work-groups, dimension 1 is the sequence.
+// A work-group therefore never spans two sequences and can leave as a whole
+// when its sequence is shorter than the current step.
+
+#define LOG_ZERO (-1.0e30f)
+
+// running log-sum-exp, one exp per term
+//*****************************************************************************
+inline void lseAdd(float *m, float *s, float x)
+{
+    if (x > *m)
+    {
+        *s = *s * exp(*m - x) + 1.0f;
+        *m = x;
+    }
+    else
+    {
+        *s += exp(x - *m);
+    }
+}
+
+inline float lseResult(float m, float s)
+{
+    return (s > 0.0f) ? m + log(s) : LOG_ZERO;
+}
+
+inline float safeLog(float x)
+{
+    return (x > 0.0f) ? log(x) : LOG_ZERO;
+}
+
+
+// alpha[t](j) = logsum_i(alpha[t-1](i) + logState(i->j)) + logEmit(obs[t], j)
+//*****************************************************************************
+__kernel void BatchForwardStep(__global float *alpha,
+                               __global const float *logStateT,
+                               __global const float *logEmit,
+                               __global const float *logInit,
+                               __global const int *obs,
+                               __global const int *seqOffset,
+                               __global const int *seqLength,
+                               __local  float *prev,
+                               int nState,
+                               int t)
+{
+    int b         = get_global_id(1);
+    int j         = get_global_id(0);
+    int localId   = get_local_id(0);
+    int localSize = get_local_size(0);
+
+    if (t >= seqLength[b]) return;
+    int base = seqOffset[b] + t;
+    float emit = (j < nState) ? logEmit[obs[base]*nState + j] : 0.0f;
+
+    if (t == 0)
+    {
+        if (j < nState) alpha[base*nState + j] = logInit[j] + emit;
+        return;
+    }
+
+    __global const float *alphaPrev = alpha + (base - 1)*nState;
+    float m = LOG_ZERO, s = 0.0f;
+    for (int i0 = 0; i0 < nState; i0 += localSize)
+    {
+        int n = min(localSize, nState - i0);
+        if (localId < n) prev[localId] = alphaPrev[i0 + localId];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (j < nState)
+        {
+            for (int i = 0; i < n; i++)
+                lseAdd(&m, &s, prev[i] + logStateT[(i0 + i)*nState + j]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (j < nState) alpha[base*nState + j] = lseResult(m, s) + emit;
+}
+
+
+// beta[t](i) = logsum_j(logState(i->j) + logEmit(obs[t+1], j) + beta[t+1](j))
+//*****************************************************************************
+__kernel void BatchBackwardStep(__global float *beta,
+                                __global const float *logState,
+                                __global const float *logEmit,
+                                __global const int *obs,
+                                __global const int *seqOffset,
+                                __global const int *seqLength,
+                                __local  float *next,
+                                int nState,
+                                int t)
+{
+    int b         = get_global_id(1);
+    int i         = get_global_id(0);
+    int localId   = get_local_id(0);
+    int localSize = get_local_size(0);
+
+    int len = seqLength[b];
+    if (t >= len) return;
+    int base = seqOffset[b] + t;
+
+    if (t == len - 1)
+    {
+        if (i < nState) beta[base*nState + i] = 0.0f;
+        return;
+    }
+
+    __global const float *betaNext = beta + (base + 1)*nState;
+    __global const float *emitNext = logEmit + obs[base + 1]*nState;
+    float m = LOG_ZERO, s = 0.0f;
+    for (int j0 = 0; j0 < nState; j0 += localSize)
+    {
+        int n = min(localSize, nState - j0);
+        if (localId < n) next[localId] = betaNext[j0 + localId] + emitNext[j0 + localId];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (i < nState)
+        {
+            for (int j = 0; j < n; j++)
+                lseAdd(&m, &s, next[j] + logState[(j0 + j)*nState + i]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (i < nState) beta[base*nState + i] = lseResult(m, s);
+}
+
+
+// delta[t](j) = max_i(delta[t-1](i) + logState(i->j)) + logEmit(obs[t], j)
+// the delta lattice shares the alpha buffer
+//*****************************************************************************
+__kernel void BatchViterbiStep(__global float *delta,
+                               __global int   *psi,
+                               __global const float *logStateT,
+                               __global const float *logEmit,
+                               __global const float *logInit,
+                               __global const int *obs,
+                               __global const int *seqOffset,
+                               __global const int *seqLength,
+                               __local  float *prev,
+                               int nState,
+                               int t)
+{
+    int b         = get_global_id(1);
+    int j         = get_global_id(0);
+    int localId   = get_local_id(0);
+    int localSize = get_local_size(0);
+
+    if (t >= seqLength[b]) return;
+    int base = seqOffset[b] + t;
+    float emit = (j < nState) ? logEmit[obs[base]*nState + j] : 0.0f;
+
+    if (t == 0)
+    {
+        if (j < nState) delta[base*nState + j] = logInit[j] + emit;
+        return;
+    }
+
+    __global const float *deltaPrev = delta + (base - 1)*nState;
+    float mValue = -FLT_MAX;
+    int mInd = 0;
+    for (int i0 = 0; i0 < nState; i0 += localSize)
+    {
+        int n = min(localSize, nState - i0);
+        if (localId < n) prev[localId] = deltaPrev[i0 + localId];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (j < nState)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                float value = prev[i] + logStateT[(i0 + i)*nState + j];
+                if (value > mValue)
+                {
+                    mValue = value;
+                    mInd = i0 + i;
+                }
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (j < nState)
+    {
+        delta[base*nState + j] = mValue + emit;
+        psi[base*nState + j] = mInd;
+    }
+}
+
+
+// final state and backtrace, one work-item per sequence
+//*****************************************************************************
+__kernel void BatchViterbiPath(__global float *vProb,
+                               __global int   *vPath,
+                               __global const float *delta,
+                               __global const int *psi,
+                               __global const int *seqOffset,
+                               __global const int *seqLength,
+                               int nSeq,
+                               int nState)
+{
+    int b = get_global_id(0);
+    if (b >= nSeq) return;
+
+    int offset = seqOffset[b];
+    int last = offset + seqLength[b] - 1;
+
+    __global const float *d = delta + last*nState;
+    float maxProb = d[0];
+    int state = 0;
+    for (int i = 1; i < nState; i++)
+    {
+        if (d[i] > maxProb)
+        {
+            maxProb = d[i];
+            state = i;
+        }
+    }
+    vProb[b] = maxProb;
+
+    vPath[last] = state;
+    for (int t = last; t > offset; t--)
+    {
+        state = psi[t*nState + state];
+        vPath[t - 1] = state;
+    }
+}
+
+
+// log P(obs | model) of every sequence from the last forward column
+//*****************************************************************************
+__kernel void BatchLogLikelihood(__global float *logLik,
+                                 __global const float *alpha,
+                                 __global const int *seqOffset,
+                                 __global const int *seqLength,
+                                 int nSeq,
+                                 int nState)
+{
+    int b = get_global_id(0);
+    if (b >= nSeq) return;
+
+    __global const float *a = alpha + (seqOffset[b] + seqLength[b] - 1)*nState;
+    float m = LOG_ZERO, s = 0.0f;
+    for (int i = 0; i < nState; i++) lseAdd(&m, &s, a[i]);
+    logLik[b] = lseResult(m, s);
+}
+
+
+// gamma[t](j) = P(state j at t | obs), one work-item per lattice cell
+//*****************************************************************************
+__kernel void BatchPosterior(__global float *gamma,
+                             __global const float *alpha,
+                             __global const float *beta,
+                             __global const float *logLik,
+                             __global const int *seqOf,
+                             int totalObs,
+                             int nState)
+{
+    int idx = get_global_id(0);
+    if (idx >= totalObs*nState) return;
+
+    gamma[idx] = exp(alpha[idx] + beta[idx] - logLik[seqOf[idx/nState]]);
+}
+
+
+// expected transition counts i->j over one slice of the concatenated time axis,
+// transitions across sequence boundaries are skipped
+//*****************************************************************************
+__kernel void BatchAccumTrans(__global float *numTrans,
+                              __global const float *alpha,
+                              __global const float *beta,
+                              __global const float *logStateT,
+                              __global const float *logEmit,
+                              __global const float *logLik,
+                              __global const int *obs,
+                              __global const int *seqOf,
+                              int totalObs,
+                              int nState)
+{
+    int j      = get_global_id(0);
+    int i      = get_global_id(1);
+    int slice  = get_global_id(2);
+    int nSlice = get_global_size(2);
+    if (j >= nState) return;
+
+    int chunk = (totalObs - 1 + nSlice - 1) / nSlice;
+    int t0 = slice*chunk;
+    int t1 = min(t0 + chunk, totalObs - 1);
+
+    float a = logStateT[i*nState + j];
+    float sum = 0.0f;
+    for (int t = t0; t < t1; t++)
+    {
+        int b = seqOf[t];
+        if (seqOf[t + 1] != b) continue;
+        sum += exp(alpha[t*nState + i] + a + logEmit[obs[t + 1]*nState + j] +
+                   beta[(t + 1)*nState + j] - logLik[b]);
+    }
+    numTrans[(slice*nState + i)*nState + j] = sum;
+}
+
+
+// expected emission counts of symbol k in state j over one slice of the
+// observations carrying k
+//*****************************************************************************
+__kernel void BatchAccumEmit(__global float *numEmit,
+                             __global const float *alpha,
+                             __global const float *beta,
+                             __global const float *logLik,
+                             __global const int *seqOf,
+                             __global const int *symStart,
+                             __global const int *symPos,
+                             int nEmit,
+                             int nState)
+{
+    int j      = get_global_id(0);
+    int k      = get_global_id(1);
+    int slice  = get_global_id(2);
+    int nSlice = get_global_size(2);
+    if (j >= nState) return;
+
+    int start = symStart[k];
+    int count = symStart[k + 1] - start;
+    int chunk = (count + nSlice - 1) / nSlice;
+    int p0 = start + min(slice*chunk, count);
+    int p1 = start + min(slice*chunk + chunk, count);
+
+    float sum = 0.0f;
+    for (int p = p0; p < p1; p++)
+    {
+        int t = symPos[p];
+        sum += exp(alpha[t*nState + j] + beta[t*nState + j] - logLik[seqOf[t]]);
+    }
+    numEmit[(slice*nEmit + k)*nState + j] = sum;
+}
+
+
+// expected initial state counts
+//*****************************************************************************
+__kernel void BatchAccumInit(__global float *numInit,
+                             __global const float *alpha,
+                             __global const float *beta,
+                             __global const float *logLik,
+                             __global const int *seqOffset,
+                             int nSeq,
+                             int nState)
+{
+    int j = get_global_id(0);
+    if (j >= nState) return;
+
+    float sum = 0.0f;
+    for (int b = 0; b < nSeq; b++)
+    {
+        int t = seqOffset[b];
+        sum += exp(alpha[t*nState + j] + beta[t*nState + j] - logLik[b]);
+    }
+    numInit[j] = sum;
+}
+
+
+// M-step for state i: its outgoing transitions, its emission column and its
+// initial probability. Rows without any expected count keep their old values.
+//*****************************************************************************
+__kernel void BatchReestimate(__global float *logInit,
+                              __global float *logState,
+                              __global float *logStateT,
+                              __global float *logEmit,
+                              __global const float *numTrans,
+                              __global const float *numEmit,
+                              __global const float *numInit,
+                              int nSlice,
+                              int nSeq,
+                              int nEmit,
+                              int nState)
+{
+    int i = get_global_id(0);
+    if (i >= nState) return;
+
+    float total = 0.0f;
+    for (int j = 0; j < nState; j++)
+        for (int p = 0; p < nSlice; p++)
+            total += numTrans[(p*nState + i)*nState + j];
+    if (total > 0.0f)
+    {
+        for (int j = 0; j < nState; j++)
+        {
+            float c = 0.0f;
+            for (int p = 0; p < nSlice; p++) c += numTrans[(p*nState + i)*nState + j];
+            float l = safeLog(c / total);
+            logStateT[i*nState + j] = l;
+            logState[j*nState + i] = l;
+        }
+    }
+
+    total = 0.0f;
+    for (int k = 0; k < nEmit; k++)
+        for (int p = 0; p < nSlice; p++)
+            total += numEmit[(p*nEmit + k)*nState + i];
+    if (total > 0.0f)
+    {
+        for (int k = 0; k < nEmit; k++)
+        {
+            float c = 0.0f;
+            for (int p = 0; p < nSlice; p++) c += numEmit[(p*nEmit + k)*nState + i];
+            logEmit[k*nState + i] = safeLog(c / total);
+        }
+    }
+
+    logInit[i] = safeLog(numInit[i] / (float)nSeq);
+}
@@ -0,0 +1,377 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include <oclUtils.h>
+#include <limits.h>
+#include "HMMBatch.h"
+
+// constructer
+//*****************************************************************************
+HMMBatch::HMMBatch(cl_context GPUContext,
+                   cl_command_queue CommandQue,
+                   const float *logInit,
+                   const float *logState,
+                   const float *logEmit,
+                   int numState,
+                   int numEmit,
+                   const int *obs,
+                   const int *seqLength,
+                   int numSeq,
+                   const char *path,
+                   int workgroupSize) :
+                   cxGPUContext(GPUContext),
+                   cqCommandQue(CommandQue),
+                   nState(numState),
+                   nEmit(numEmit),
+                   nSeq(numSeq),
+                   totalObs(0),
+                   maxLength(0)
+{
+    cl_int err;
+
+    // per sequence offsets and per observation bookkeeping
+    int *seqOffset = (int*)malloc(sizeof(int)*nSeq);
+    for (int b = 0; b < nSeq; b++)
+    {
+        seqOffset[b] = totalObs;
+        totalObs += seqLength[b];
+        maxLength = MAX(maxLength, seqLength[b]);
+    }
+    // lattice indices are 32 bit in the kernels
+    oclCheckErrorEX((long long)totalObs*nState < INT_MAX, true, NULL);
+
+    int *seqOf = (int*)malloc(sizeof(int)*totalObs);
+    for (int b = 0; b < nSeq; b++)
+        for (int t = 0; t < seqLength[b]; t++)
+            seqOf[seqOffset[b] + t] = b;
+
+    // counting sort of the observation positions by symbol
+    int *symStart = (int*)calloc(nEmit + 1, sizeof(int));
+    int *symPos   = (int*)malloc(sizeof(int)*totalObs);
+    for (int t = 0; t < totalObs; t++) symStart[obs[t] + 1]++;
+    for (int k = 0; k < nEmit; k++) symStart[k + 1] += symStart[k];
+    int *fill = (int*)malloc(sizeof(int)*nEmit);
+    memcpy(fill, symStart, sizeof(int)*nEmit);
+    for (int t = 0; t < totalObs; t++) symPos[fill[obs[t]]++] = t;
+    free(fill);
+
+    float *logStateT = (float*)malloc(sizeof(float)*nState*nState);
+    for (int i = 0; i < nState; i++)
+        for (int j = 0; j < nState; j++)
+            logStateT[i*nState + j] = logState[j*nState + i];
+
+    // split the time axis of the count kernels so that they still fill the
+    // device when the model is small
+    nSlice = CLAMP(65536 / (nState*nState), 1, 64);
+
+    d_logInit   = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float)*nState, (void*)logInit, &err);
+    d_logState  = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float)*nState*nState, (void*)logState, &err);
+    d_logStateT = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float)*nState*nState, logStateT, &err);
+    d_logEmit   = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float)*nEmit*nState, (void*)logEmit, &err);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    d_obs       = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*totalObs, (void*)obs, &err);
+    d_seqOffset = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*nSeq, seqOffset, &err);
+    d_seqLength = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*nSeq, (void*)seqLength, &err);
+    d_seqOf     = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*totalObs, seqOf, &err);
+    d_symStart  = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*(nEmit + 1), symStart, &err);
+    d_symPos    = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int)*totalObs, symPos, &err);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    d_alpha     = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float)*totalObs*nState, NULL, &err);
+    d_beta      = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float)*totalObs*nState, NULL, &err);
+    d_psi       = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(int)*totalObs*nState, NULL, &err);
+    d_logLik    = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float)*nSeq, NULL, &err);
+    d_numTrans  = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float)*nSlice*nState*nState, NULL, &err);
+    d_numEmit   = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float)*nSlice*nEmit*nState, NULL, &err);
+    d_numInit   = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float)*nState, NULL, &err);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+
+    free(seqOffset);
+    free(seqOf);
+    free(symStart);
+    free(symPos);
+    free(logStateT);
+
+    size_t szKernelLength; // Byte size of kernel code
+    char *cSource = oclLoadProgSource(shrFindFilePath("HMMBatch.cl", path), "// My comment\n", &szKernelLength);
+    oclCheckErrorEX(cSource == NULL, false, NULL);
+    cpProgram = clCreateProgramWithSource(cxGPUContext, 1, (const char **)&cSource, &szKernelLength, &err);
+    // no relaxed math, the log-sum-exp relies on exp/log accuracy near 0
+    err = clBuildProgram(cpProgram, 0, NULL, "-cl-mad-enable", NULL, NULL);
+    if (err != CL_SUCCESS)
+    {
+        // write out standard error, Build Log and PTX, then cleanup and exit
+        shrLogEx(LOGBOTH | ERRORMSG, (double)err, STDERROR);
+        oclLogBuildInfo(cpProgram, oclGetFirstDev(cxGPUContext));
+        oclLogPtx(cpProgram, oclGetFirstDev(cxGPUContext), "HMMBatch.ptx");
+        shrEXIT(0, NULL);
+    }
+    free(cSource);
+
+    ckForwardStep   = clCreateKernel(cpProgram, "BatchForwardStep", &err);
+    ckBackwardStep  = clCreateKernel(cpProgram, "BatchBackwardStep", &err);
+    ckViterbiStep   = clCreateKernel(cpProgram, "BatchViterbiStep", &err);
+    ckViterbiPath   = clCreateKernel(cpProgram, "BatchViterbiPath", &err);
+    ckLogLikelihood = clCreateKernel(cpProgram, "BatchLogLikelihood", &err);
+    ckPosterior     = clCreateKernel(cpProgram, "BatchPosterior", &err);
+    ckAccumTrans    = clCreateKernel(cpProgram, "BatchAccumTrans", &err);
+    ckAccumEmit     = clCreateKernel(cpProgram, "BatchAccumEmit", &err);
+    ckAccumInit     = clCreateKernel(cpProgram, "BatchAccumInit", &err);
+    ckReestimate    = clCreateKernel(cpProgram, "BatchReestimate", &err);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+
+    // one row of work-groups per sequence, no wider than the state count needs
+    cl_device_id device;
+    err = clGetCommandQueueInfo(cqCommandQue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    size_t maxWgSize;
+    err = clGetKernelWorkGroupInfo(ckForwardStep, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxWgSize, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    localSize = MIN((size_t)workgroupSize, maxWgSize);
+    while (localSize > 32 && localSize/2 >= (size_t)nState) localSize /= 2;
+}
+
+// destructor
+//*****************************************************************************
+HMMBatch::~HMMBatch()
+{
+    cl_int err;
+    err  = clReleaseMemObject(d_logInit);
+    err |= clReleaseMemObject(d_logState);
+    err |= clReleaseMemObject(d_logStateT);
+    err |= clReleaseMemObject(d_logEmit);
+    err |= clReleaseMemObject(d_obs);
+    err |= clReleaseMemObject(d_seqOffset);
+    err |= clReleaseMemObject(d_seqLength);
+    err |= clReleaseMemObject(d_seqOf);
+    err |= clReleaseMemObject(d_symStart);
+    err |= clReleaseMemObject(d_symPos);
+    err |= clReleaseMemObject(d_alpha);
+    err |= clReleaseMemObject(d_beta);
+    err |= clReleaseMemObject(d_psi);
+    err |= clReleaseMemObject(d_logLik);
+    err |= clReleaseMemObject(d_numTrans);
+    err |= clReleaseMemObject(d_numEmit);
+    err |= clReleaseMemObject(d_numInit);
+    err |= clReleaseKernel(ckForwardStep);
+    err |= clReleaseKernel(ckBackwardStep);
+    err |= clReleaseKernel(ckViterbiStep);
+    err |= clReleaseKernel(ckViterbiPath);
+    err |= clReleaseKernel(ckLogLikelihood);
+    err |= clReleaseKernel(ckPosterior);
+    err |= clReleaseKernel(ckAccumTrans);
+    err |= clReleaseKernel(ckAccumEmit);
+    err |= clReleaseKernel(ckAccumInit);
+    err |= clReleaseKernel(ckReestimate);
+    err |= clReleaseProgram(cpProgram);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+}
+
+// one launch of a per-step kernel for all sequences, argument tArg is the
+// time step
+//*****************************************************************************
+void HMMBatch::launchSteps(cl_kernel kernel, cl_uint tArg, int t)
+{
+    cl_int err = clSetKernelArg(kernel, tArg, sizeof(int), (void*)&t);
+
+    size_t localWorkSize[2]  = {localSize, 1};
+    size_t globalWorkSize[2] = {shrRoundUp((int)localSize, nState), (size_t)nSeq};
+    err |= clEnqueueNDRangeKernel(cqCommandQue, kernel, 2, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+}
+
+void HMMBatch::launch1D(cl_kernel kernel, size_t n)
+{
+    size_t localWorkSize[1]  = {localSize};
+    size_t globalWorkSize[1] = {shrRoundUp((int)localSize, (int)n)};
+    cl_int err = clEnqueueNDRangeKernel(cqCommandQue, kernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+}
+
+// Viterbi decoding of the whole batch
+//*****************************************************************************
+void HMMBatch::ViterbiBatch(cl_mem vProb, cl_mem vPath)
+{
+    cl_int err;
+    err  = clSetKernelArg(ckViterbiStep, 0, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckViterbiStep, 1, sizeof(cl_mem), (void*)&d_psi);
+    err |= clSetKernelArg(ckViterbiStep, 2, sizeof(cl_mem), (void*)&d_logStateT);
+    err |= clSetKernelArg(ckViterbiStep, 3, sizeof(cl_mem), (void*)&d_logEmit);
+    err |= clSetKernelArg(ckViterbiStep, 4, sizeof(cl_mem), (void*)&d_logInit);
+    err |= clSetKernelArg(ckViterbiStep, 5, sizeof(cl_mem), (void*)&d_obs);
+    err |= clSetKernelArg(ckViterbiStep, 6, sizeof(cl_mem), (void*)&d_seqOffset);
+    err |= clSetKernelArg(ckViterbiStep, 7, sizeof(cl_mem), (void*)&d_seqLength);
+    err |= clSetKernelArg(ckViterbiStep, 8, sizeof(float)*localSize, NULL);
+    err |= clSetKernelArg(ckViterbiStep, 9, sizeof(int), (void*)&nState);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+
+    for (int t = 0; t < maxLength; t++)
+    {
+        launchSteps(ckViterbiStep, 10, t);
+    }
+
+    err  = clSetKernelArg(ckViterbiPath, 0, sizeof(cl_mem), (void*)&vProb);
+    err |= clSetKernelArg(ckViterbiPath, 1, sizeof(cl_mem), (void*)&vPath);
+    err |= clSetKernelArg(ckViterbiPath, 2, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckViterbiPath, 3, sizeof(cl_mem), (void*)&d_psi);
+    err |= clSetKernelArg(ckViterbiPath, 4, sizeof(cl_mem), (void*)&d_seqOffset);
+    err |= clSetKernelArg(ckViterbiPath, 5, sizeof(cl_mem), (void*)&d_seqLength);
+    err |= clSetKernelArg(ckViterbiPath, 6, sizeof(int), (void*)&nSeq);
+    err |= clSetKernelArg(ckViterbiPath, 7, sizeof(int), (void*)&nState);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    launch1D(ckViterbiPath, nSeq);
+}
+
+// forward pass, backward pass and per sequence likelihood
+//*****************************************************************************
+void HMMBatch::ForwardBackwardBatch(float *logLik)
+{
+    cl_int err;
+    err  = clSetKernelArg(ckForwardStep, 0, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckForwardStep, 1, sizeof(cl_mem), (void*)&d_logStateT);
+    err |= clSetKernelArg(ckForwardStep, 2, sizeof(cl_mem), (void*)&d_logEmit);
+    err |= clSetKernelArg(ckForwardStep, 3, sizeof(cl_mem), (void*)&d_logInit);
+    err |= clSetKernelArg(ckForwardStep, 4, sizeof(cl_mem), (void*)&d_obs);
+    err |= clSetKernelArg(ckForwardStep, 5, sizeof(cl_mem), (void*)&d_seqOffset);
+    err |= clSetKernelArg(ckForwardStep, 6, sizeof(cl_mem), (void*)&d_seqLength);
+    err |= clSetKernelArg(ckForwardStep, 7, sizeof(float)*localSize, NULL);
+    err |= clSetKernelArg(ckForwardStep, 8, sizeof(int), (void*)&nState);
+
+    err |= clSetKernelArg(ckBackwardStep, 0, sizeof(cl_mem), (void*)&d_beta);
+    err |= clSetKernelArg(ckBackwardStep, 1, sizeof(cl_mem), (void*)&d_logState);
+    err |= clSetKernelArg(ckBackwardStep, 2, sizeof(cl_mem), (void*)&d_logEmit);
+    err |= clSetKernelArg(ckBackwardStep, 3, sizeof(cl_mem), (void*)&d_obs);
+    err |= clSetKernelArg(ckBackwardStep, 4, sizeof(cl_mem), (void*)&d_seqOffset);
+    err |= clSetKernelArg(ckBackwardStep, 5, sizeof(cl_mem), (void*)&d_seqLength);
+    err |= clSetKernelArg(ckBackwardStep, 6, sizeof(float)*localSize, NULL);
+    err |= clSetKernelArg(ckBackwardStep, 7, sizeof(int), (void*)&nState);
+
+    err |= clSetKernelArg(ckLogLikelihood, 0, sizeof(cl_mem), (void*)&d_logLik);
+    err |= clSetKernelArg(ckLogLikelihood, 1, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckLogLikelihood, 2, sizeof(cl_mem), (void*)&d_seqOffset);
+    err |= clSetKernelArg(ckLogLikelihood, 3, sizeof(cl_mem), (void*)&d_seqLength);
+    err |= clSetKernelArg(ckLogLikelihood, 4, sizeof(int), (void*)&nSeq);
+    err |= clSetKernelArg(ckLogLikelihood, 5, sizeof(int), (void*)&nState);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+
+    for (int t = 0; t < maxLength; t++)
+    {
+        launchSteps(ckForwardStep, 9, t);
+    }
+    // sequences end at different steps, so the backward pass walks down from
+    // the longest one and each sequence joins at its own last observation
+    for (int t = maxLength - 1; t >= 0; t--)
+    {
+        launchSteps(ckBackwardStep, 8, t);
+    }
+    launch1D(ckLogLikelihood, nSeq);
+
+    if (logLik)
+    {
+        err = clEnqueueReadBuffer(cqCommandQue, d_logLik, CL_TRUE, 0, sizeof(float)*nSeq, logLik, 0, NULL, NULL);
+        oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    }
+}
+
+// posterior state probabilities from the current lattices
+//*****************************************************************************
+void HMMBatch::PosteriorBatch(cl_mem gamma)
+{
+    cl_int err;
+    err  = clSetKernelArg(ckPosterior, 0, sizeof(cl_mem), (void*)&gamma);
+    err |= clSetKernelArg(ckPosterior, 1, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckPosterior, 2, sizeof(cl_mem), (void*)&d_beta);
+    err |= clSetKernelArg(ckPosterior, 3, sizeof(cl_mem), (void*)&d_logLik);
+    err |= clSetKernelArg(ckPosterior, 4, sizeof(cl_mem), (void*)&d_seqOf);
+    err |= clSetKernelArg(ckPosterior, 5, sizeof(int), (void*)&totalObs);
+    err |= clSetKernelArg(ckPosterior, 6, sizeof(int), (void*)&nState);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    launch1D(ckPosterior, (size_t)totalObs*nState);
+}
+
+// E-step (forward-backward and expected counts) followed by the M-step
+//*****************************************************************************
+double HMMBatch::BaumWelchStep()
+{
+    float *logLik = (float*)malloc(sizeof(float)*nSeq);
+    ForwardBackwardBatch(NULL);
+
+    cl_int err;
+    err  = clSetKernelArg(ckAccumTrans, 0, sizeof(cl_mem), (void*)&d_numTrans);
+    err |= clSetKernelArg(ckAccumTrans, 1, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckAccumTrans, 2, sizeof(cl_mem), (void*)&d_beta);
+    err |= clSetKernelArg(ckAccumTrans, 3, sizeof(cl_mem), (void*)&d_logStateT);
+    err |= clSetKernelArg(ckAccumTrans, 4, sizeof(cl_mem), (void*)&d_logEmit);
+    err |= clSetKernelArg(ckAccumTrans, 5, sizeof(cl_mem), (void*)&d_logLik);
+    err |= clSetKernelArg(ckAccumTrans, 6, sizeof(cl_mem), (void*)&d_obs);
+    err |= clSetKernelArg(ckAccumTrans, 7, sizeof(cl_mem), (void*)&d_seqOf);
+    err |= clSetKernelArg(ckAccumTrans, 8, sizeof(int), (void*)&totalObs);
+    err |= clSetKernelArg(ckAccumTrans, 9, sizeof(int), (void*)&nState);
+
+    err |= clSetKernelArg(ckAccumEmit, 0, sizeof(cl_mem), (void*)&d_numEmit);
+    err |= clSetKernelArg(ckAccumEmit, 1, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckAccumEmit, 2, sizeof(cl_mem), (void*)&d_beta);
+    err |= clSetKernelArg(ckAccumEmit, 3, sizeof(cl_mem), (void*)&d_logLik);
+    err |= clSetKernelArg(ckAccumEmit, 4, sizeof(cl_mem), (void*)&d_seqOf);
+    err |= clSetKernelArg(ckAccumEmit, 5, sizeof(cl_mem), (void*)&d_symStart);
+    err |= clSetKernelArg(ckAccumEmit, 6, sizeof(cl_mem), (void*)&d_symPos);
+    err |= clSetKernelArg(ckAccumEmit, 7, sizeof(int), (void*)&nEmit);
+    err |= clSetKernelArg(ckAccumEmit, 8, sizeof(int), (void*)&nState);
+
+    err |= clSetKernelArg(ckAccumInit, 0, sizeof(cl_mem), (void*)&d_numInit);
+    err |= clSetKernelArg(ckAccumInit, 1, sizeof(cl_mem), (void*)&d_alpha);
+    err |= clSetKernelArg(ckAccumInit, 2, sizeof(cl_mem), (void*)&d_beta);
+    err |= clSetKernelArg(ckAccumInit, 3, sizeof(cl_mem), (void*)&d_logLik);
+    err |= clSetKernelArg(ckAccumInit, 4, sizeof(cl_mem), (void*)&d_seqOffset);
+    err |= clSetKernelArg(ckAccumInit, 5, sizeof(int), (void*)&nSeq);
+    err |= clSetKernelArg(ckAccumInit, 6, sizeof(int), (void*)&nState);
+
+    err |= clSetKernelArg(ckReestimate, 0, sizeof(cl_mem), (void*)&d_logInit);
+    err |= clSetKernelArg(ckReestimate, 1, sizeof(cl_mem), (void*)&d_logState);
+    err |= clSetKernelArg(ckReestimate, 2, sizeof(cl_mem), (void*)&d_logStateT);
+    err |= clSetKernelArg(ckReestimate, 3, sizeof(cl_mem), (void*)&d_logEmit);
+    err |= clSetKernelArg(ckReestimate, 4, sizeof(cl_mem), (void*)&d_numTrans);
+    err |= clSetKernelArg(ckReestimate, 5, sizeof(cl_mem), (void*)&d_numEmit);
+    err |= clSetKernelArg(ckReestimate, 6, sizeof(cl_mem), (void*)&d_numInit);
+    err |= clSetKernelArg(ckReestimate, 7, sizeof(int), (void*)&nSlice);
+    err |= clSetKernelArg(ckReestimate, 8, sizeof(int), (void*)&nSeq);
+    err |= clSetKernelArg(ckReestimate, 9, sizeof(int), (void*)&nEmit);
+    err |= clSetKernelArg(ckReestimate, 10, sizeof(int), (void*)&nState);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+
+    size_t localWorkSize[3]  = {localSize, 1, 1};
+    size_t globalWorkSize[3] = {shrRoundUp((int)localSize, nState), (size_t)nState, (size_t)nSlice};
+    err = clEnqueueNDRangeKernel(cqCommandQue, ckAccumTrans, 3, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+    globalWorkSize[1] = nEmit;
+    err |= clEnqueueNDRangeKernel(cqCommandQue, ckAccumEmit, 3, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    launch1D(ckAccumInit, nState);
+
+    err = clEnqueueReadBuffer(cqCommandQue, d_logLik, CL_FALSE, 0, sizeof(float)*nSeq, logLik, 0, NULL, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+    launch1D(ckReestimate, nState);
+    clFinish(cqCommandQue);
+
+    double total = 0.0;
+    for (int b = 0; b < nSeq; b++) total += logLik[b];
+    free(logLik);
+    return total;
+}
+
+// copy the current model back to the host
+//*****************************************************************************
+void HMMBatch::ReadModel(float *logInit, float *logState, float *logEmit)
+{
+    cl_int err;
+    err  = clEnqueueReadBuffer(cqCommandQue, d_logInit, CL_FALSE, 0, sizeof(float)*nState, logInit, 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(cqCommandQue, d_logState, CL_FALSE, 0, sizeof(float)*nState*nState, logState, 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(cqCommandQue, d_logEmit, CL_TRUE, 0, sizeof(float)*nEmit*nState, logEmit, 0, NULL, NULL);
+    oclCheckErrorEX(err, CL_SUCCESS, NULL);
+}
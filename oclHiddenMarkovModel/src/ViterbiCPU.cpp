@@ -11,6 +11,8 @@
  
 #include <cstdlib>
 #include <cstdio>
+#include <cmath>
+#include <cfloat>
 
 ///////////////////////////////////////////////////////////////////////////////
 // Using Viterbi algorithm to search for a Hidden Markov Model for the most
@@ -90,3 +92,232 @@ int ViterbiCPU(float &viterbiProb,
     free(path);
     return 1;
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Batched log-space references for HMMBatch, same data layout and the same
+// order of operations as HMMBatch.cl
+///////////////////////////////////////////////////////////////////////////////
+static const float LOG_ZERO = -1.0e30f;
+
+static inline void lseAdd(float &m, float &s, float x)
+{
+    if (x > m)
+    {
+        s = s * expf(m - x) + 1.0f;
+        m = x;
+    }
+    else
+    {
+        s += expf(x - m);
+    }
+}
+
+static inline float lseResult(float m, float s)
+{
+    return (s > 0.0f) ? m + logf(s) : LOG_ZERO;
+}
+
+static inline float safeLog(double x)
+{
+    return (x > 0.0) ? (float)log(x) : LOG_ZERO;
+}
+
+// Viterbi path and its log probability for every sequence,
+// viterbiPath holds the concatenated paths
+int ViterbiBatchCPU(float *viterbiProb,
+                    int *viterbiPath,
+                    const int *obs,
+                    const int *seqLength,
+                    const int &nSeq,
+                    const float *logInit,
+                    const float *logState,
+                    const int &nState,
+                    const float *logEmit)
+{
+    float *delta = (float*)malloc(sizeof(float)*nState*2);
+    int maxLength = 0;
+    for (int b = 0; b < nSeq; b++) maxLength = (seqLength[b] > maxLength) ? seqLength[b] : maxLength;
+    int *psi = (int*)malloc(sizeof(int)*maxLength*nState);
+
+    int offset = 0;
+    for (int b = 0; b < nSeq; b++)
+    {
+        const int *o = obs + offset;
+        float *deltaOld = delta, *deltaNew = delta + nState;
+        for (int j = 0; j < nState; j++) deltaOld[j] = logInit[j] + logEmit[o[0]*nState + j];
+
+        for (int t = 1; t < seqLength[b]; t++)
+        {
+            for (int j = 0; j < nState; j++)
+            {
+                float maxProb = -FLT_MAX;
+                int maxState = 0;
+                for (int i = 0; i < nState; i++)
+                {
+                    float p = deltaOld[i] + logState[j*nState + i];
+                    if (p > maxProb)
+                    {
+                        maxProb = p;
+                        maxState = i;
+                    }
+                }
+                deltaNew[j] = maxProb + logEmit[o[t]*nState + j];
+                psi[t*nState + j] = maxState;
+            }
+            float *tmp = deltaOld; deltaOld = deltaNew; deltaNew = tmp;
+        }
+
+        float maxProb = deltaOld[0];
+        int state = 0;
+        for (int i = 1; i < nState; i++)
+        {
+            if (deltaOld[i] > maxProb)
+            {
+                maxProb = deltaOld[i];
+                state = i;
+            }
+        }
+        viterbiProb[b] = maxProb;
+
+        int *path = viterbiPath + offset;
+        path[seqLength[b] - 1] = state;
+        for (int t = seqLength[b] - 1; t > 0; t--)
+        {
+            state = psi[t*nState + state];
+            path[t - 1] = state;
+        }
+        offset += seqLength[b];
+    }
+
+    free(delta);
+    free(psi);
+    return 1;
+}
+
+// forward and backward lattices (totalObs*nState floats each) and the
+// log-likelihood of every sequence
+int ForwardBackwardBatchCPU(float *logLik,
+                            float *alpha,
+                            float *beta,
+                            const int *obs,
+                            const int *seqLength,
+                            const int &nSeq,
+                            const float *logInit,
+                            const float *logState,
+                            const int &nState,
+                            const float *logEmit)
+{
+    int offset = 0;
+    for (int b = 0; b < nSeq; b++)
+    {
+        const int *o = obs + offset;
+        float *a = alpha + offset*nState;
+        float *be = beta + offset*nState;
+        int len = seqLength[b];
+
+        for (int j = 0; j < nState; j++) a[j] = logInit[j] + logEmit[o[0]*nState + j];
+        for (int t = 1; t < len; t++)
+        {
+            for (int j = 0; j < nState; j++)
+            {
+                float m = LOG_ZERO, s = 0.0f;
+                for (int i = 0; i < nState; i++)
+                    lseAdd(m, s, a[(t-1)*nState + i] + logState[j*nState + i]);
+                a[t*nState + j] = lseResult(m, s) + logEmit[o[t]*nState + j];
+            }
+        }
+
+        float m = LOG_ZERO, s = 0.0f;
+        for (int i = 0; i < nState; i++) lseAdd(m, s, a[(len-1)*nState + i]);
+        logLik[b] = lseResult(m, s);
+
+        for (int i = 0; i < nState; i++) be[(len-1)*nState + i] = 0.0f;
+        for (int t = len - 2; t >= 0; t--)
+        {
+            for (int i = 0; i < nState; i++)
+            {
+                float m = LOG_ZERO, s = 0.0f;
+                for (int j = 0; j < nState; j++)
+                    lseAdd(m, s, (be[(t+1)*nState + j] + logEmit[o[t+1]*nState + j]) + logState[j*nState + i]);
+                be[t*nState + i] = lseResult(m, s);
+            }
+        }
+        offset += len;
+    }
+    return 1;
+}
+
+// one Baum-Welch iteration, the log model is updated in place;
+// returns the total log-likelihood before the update
+double BaumWelchBatchCPU(const int *obs,
+                         const int *seqLength,
+                         const int &nSeq,
+                         float *logInit,
+                         float *logState,
+                         const int &nState,
+                         float *logEmit,
+                         const int &nEmit)
+{
+    int totalObs = 0;
+    for (int b = 0; b < nSeq; b++) totalObs += seqLength[b];
+
+    float *logLik = (float*)malloc(sizeof(float)*nSeq);
+    float *alpha  = (float*)malloc(sizeof(float)*totalObs*nState);
+    float *beta   = (float*)malloc(sizeof(float)*totalObs*nState);
+    double *numTrans = (double*)calloc(nState*nState, sizeof(double)); // [i][j], i -> j
+    double *numEmit  = (double*)calloc(nEmit*nState, sizeof(double));
+    double *numInit  = (double*)calloc(nState, sizeof(double));
+    ForwardBackwardBatchCPU(logLik, alpha, beta, obs, seqLength, nSeq, logInit, logState, nState, logEmit);
+
+    double total = 0.0;
+    int offset = 0;
+    for (int b = 0; b < nSeq; b++)
+    {
+        total += logLik[b];
+        for (int t = 0; t < seqLength[b]; t++)
+        {
+            const float *a  = alpha + (offset + t)*nState;
+            const float *be = beta + (offset + t)*nState;
+            int o = obs[offset + t];
+            for (int j = 0; j < nState; j++)
+            {
+                double g = exp((double)a[j] + be[j] - logLik[b]);
+                numEmit[o*nState + j] += g;
+                if (t == 0) numInit[j] += g;
+            }
+            if (t == seqLength[b] - 1) continue;
+
+            const float *beNext = be + nState;
+            int oNext = obs[offset + t + 1];
+            for (int i = 0; i < nState; i++)
+                for (int j = 0; j < nState; j++)
+                    numTrans[i*nState + j] += exp((double)a[i] + logState[j*nState + i] +
+                                                  logEmit[oNext*nState + j] + beNext[j] - logLik[b]);
+        }
+        offset += seqLength[b];
+    }
+
+    for (int i = 0; i < nState; i++)
+    {
+        double sum = 0.0;
+        for (int j = 0; j < nState; j++) sum += numTrans[i*nState + j];
+        if (sum > 0.0)
+            for (int j = 0; j < nState; j++) logState[j*nState + i] = safeLog(numTrans[i*nState + j] / sum);
+
+        sum = 0.0;
+        for (int k = 0; k < nEmit; k++) sum += numEmit[k*nState + i];
+        if (sum > 0.0)
+            for (int k = 0; k < nEmit; k++) logEmit[k*nState + i] = safeLog(numEmit[k*nState + i] / sum);
+
+        logInit[i] = safeLog(numInit[i] / nSeq);
+    }
+
+    free(logLik);
+    free(alpha);
+    free(beta);
+    free(numTrans);
+    free(numEmit);
+    free(numInit);
+    return total;
+}
@@ -11,7 +11,9 @@
 
 #include <oclUtils.h>
 #include <shrQATest.h>
+#include <float.h>
 #include "HMM.h"
+#include "HMMBatch.h"
 
 #define MAX_GPU_COUNT 8
 
@@ -25,7 +27,13 @@ int ViterbiCPU(float &viterbiProb,
                float *mtState, 
                const int &nState,
                float *mtEmit);
-
+int ViterbiBatchCPU(float *viterbiProb, int *viterbiPath, const int *obs, const int *seqLength, const int &nSeq,
+                    const float *logInit, const float *logState, const int &nState, const float *logEmit);
+int ForwardBackwardBatchCPU(float *logLik, float *alpha, float *beta, const int *obs, const int *seqLength, const int &nSeq,
+                            const float *logInit, const float *logState, const int &nState, const float *logEmit);
+double BaumWelchBatchCPU(const int *obs, const int *seqLength, const int &nSeq,
+                         float *logInit, float *logState, const int &nState, float *logEmit, const int &nEmit);
+bool runBatchTest(int argc, const char **argv, cl_context cxGPUContext, cl_command_queue cqCommandQue, int wgSize);
 
 
 // main function
@@ -114,6 +122,16 @@ int main(int argc, const char **argv)
 		wgSize = 256;
 	}
 
+    // many independent sequences, log-space Viterbi, forward-backward and Baum-Welch
+    if (shrCheckCmdLineFlag(argc, argv, "batch"))
+    {
+        bool pass = runBatchTest(argc, argv, cxGPUContext, cqCommandQue[0], wgSize);
+        for (cl_uint iDevice = 0; iDevice < nDevice; iDevice++) clReleaseCommandQueue(cqCommandQue[iDevice]);
+        free(cdDevices);
+        clReleaseContext(cxGPUContext);
+        shrQAFinishExit(argc, (const char **)argv, pass ? QA_PASSED : QA_FAILED);
+    }
+
     shrLog("Init Hidden Markov Model parameters\n");
     int nState = 256*16; // number of states, must be a multiple of 256
     int nEmit  = 128; // number of possible observations
@@ -283,3 +301,236 @@ int initHMM(float *initProb, float *mtState, float *mtObs, const int &nState, co
 
     return 1;
 }
+
+// Batch mode helpers
+//*****************************************************************************
+// random model whose rows really are distributions: transitions out of every
+// state, emissions of every state and the initial probabilities sum to 1
+static void initHMMNormalized(float *initProb, float *mtState, float *mtEmit, int nState, int nEmit)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < nState; i++) sum += (initProb[i] = (float)rand() + 1.0f);
+    for (int i = 0; i < nState; i++) initProb[i] /= sum;
+
+    for (int i = 0; i < nState; i++)
+    {
+        sum = 0.0f;
+        for (int j = 0; j < nState; j++) sum += (mtState[j*nState + i] = (float)rand() + 1.0f);
+        for (int j = 0; j < nState; j++) mtState[j*nState + i] /= sum;
+
+        sum = 0.0f;
+        for (int k = 0; k < nEmit; k++) sum += (mtEmit[k*nState + i] = (float)rand() + 1.0f);
+        for (int k = 0; k < nEmit; k++) mtEmit[k*nState + i] /= sum;
+    }
+}
+
+static void logTable(float *dst, const float *src, int n)
+{
+    for (int i = 0; i < n; i++) dst[i] = (src[i] > 0.0f) ? logf(src[i]) : HMM_LOG_ZERO;
+}
+
+// draw from the distribution p[0], p[stride], ... p[(n-1)*stride]
+static int sampleIndex(const float *p, int stride, int n)
+{
+    float u = (float)rand() / ((float)RAND_MAX + 1.0f);
+    for (int i = 0; i < n - 1; i++)
+    {
+        u -= p[i*stride];
+        if (u < 0.0f) return i;
+    }
+    return n - 1;
+}
+
+static bool closeTo(double a, double b, double relTol)
+{
+    return fabs(a - b) <= relTol * MAX(fabs(a), fabs(b)) + 1.0e-3;
+}
+
+// Decodes and trains on a batch of sequences drawn from a random model and
+// compares every pass with the CPU references in ViterbiCPU.cpp
+//*****************************************************************************
+bool runBatchTest(int argc, const char **argv, cl_context cxGPUContext, cl_command_queue cqCommandQue, int wgSize)
+{
+    int nSeq = 512;        // number of sequences
+    int nState = 64;       // number of states
+    int nEmit = 32;        // number of possible observations
+    int minLength = 50;    // sequence lengths are uniform in [minLength, maxLength]
+    int maxLength = 200;
+    int nIter = 3;         // Baum-Welch iterations
+    shrGetCmdLineArgumenti(argc, argv, "sequences", &nSeq);
+    shrGetCmdLineArgumenti(argc, argv, "states", &nState);
+    shrGetCmdLineArgumenti(argc, argv, "symbols", &nEmit);
+    shrGetCmdLineArgumenti(argc, argv, "min-length", &minLength);
+    shrGetCmdLineArgumenti(argc, argv, "max-length", &maxLength);
+    shrGetCmdLineArgumenti(argc, argv, "iterations", &nIter);
+    nSeq = MAX(nSeq, 1);
+    nState = MAX(nState, 2);
+    nEmit = MAX(nEmit, 2);
+    minLength = MAX(minLength, 1);
+    maxLength = MAX(maxLength, minLength);
+    nIter = MAX(nIter, 1);
+
+    // generating model, and a second random model as starting point for training
+    float *initProb = (float*)malloc(sizeof(float)*nState);
+    float *mtState  = (float*)malloc(sizeof(float)*nState*nState);
+    float *mtEmit   = (float*)malloc(sizeof(float)*nEmit*nState);
+    float *logInit  = (float*)malloc(sizeof(float)*nState);
+    float *logState = (float*)malloc(sizeof(float)*nState*nState);
+    float *logEmit  = (float*)malloc(sizeof(float)*nEmit*nState);
+    float *logInitCPU  = (float*)malloc(sizeof(float)*nState);
+    float *logStateCPU = (float*)malloc(sizeof(float)*nState*nState);
+    float *logEmitCPU  = (float*)malloc(sizeof(float)*nEmit*nState);
+    initHMMNormalized(initProb, mtState, mtEmit, nState, nEmit);
+
+    int *seqLength = (int*)malloc(sizeof(int)*nSeq);
+    int totalObs = 0;
+    for (int b = 0; b < nSeq; b++)
+    {
+        seqLength[b] = minLength + rand() % (maxLength - minLength + 1);
+        totalObs += seqLength[b];
+    }
+    int *obs = (int*)malloc(sizeof(int)*totalObs);
+    for (int b = 0, t0 = 0; b < nSeq; t0 += seqLength[b++])
+    {
+        int state = sampleIndex(initProb, 1, nState);
+        for (int t = 0; t < seqLength[b]; t++)
+        {
+            if (t > 0) state = sampleIndex(mtState + state, nState, nState);
+            obs[t0 + t] = sampleIndex(mtEmit + state, nState, nEmit);
+        }
+    }
+    logTable(logInit, initProb, nState);
+    logTable(logState, mtState, nState*nState);
+    logTable(logEmit, mtEmit, nEmit*nState);
+
+    // one transition matrix row per state and observation
+    double cells = (double)totalObs * nState * nState;
+    shrLog("\nBatch mode\n# of sequences = %d\n# of states = %d\n# of possible observations = %d\n"
+           "Sequence length = %d..%d, %d observations in total\n\n", nSeq, nState, nEmit, minLength, maxLength, totalObs);
+
+    cl_int ciErrNum;
+    HMMBatch oBatch(cxGPUContext, cqCommandQue, logInit, logState, logEmit, nState, nEmit, obs, seqLength, nSeq, argv[0], wgSize);
+    cl_mem vProb = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY, sizeof(float)*nSeq, NULL, &ciErrNum);
+    cl_mem vPath = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY, sizeof(int)*totalObs, NULL, &ciErrNum);
+    cl_mem vGamma = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY, sizeof(float)*totalObs*nState, NULL, &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, NULL);
+
+    float *probGPU   = (float*)malloc(sizeof(float)*nSeq);
+    float *probCPU   = (float*)malloc(sizeof(float)*nSeq);
+    int   *pathGPU   = (int*)malloc(sizeof(int)*totalObs);
+    int   *pathCPU   = (int*)malloc(sizeof(int)*totalObs);
+    float *logLikGPU = (float*)malloc(sizeof(float)*nSeq);
+    float *logLikCPU = (float*)malloc(sizeof(float)*nSeq);
+    float *alphaCPU  = (float*)malloc(sizeof(float)*totalObs*nState);
+    float *betaCPU   = (float*)malloc(sizeof(float)*totalObs*nState);
+    float *gamma     = (float*)malloc(sizeof(float)*totalObs*nState);
+    bool pass = true;
+
+    // Viterbi
+    clFinish(cqCommandQue);
+    shrDeltaT(1);
+    oBatch.ViterbiBatch(vProb, vPath);
+    clFinish(cqCommandQue);
+    double tGPU = shrDeltaT(1);
+    ciErrNum  = clEnqueueReadBuffer(cqCommandQue, vProb, CL_FALSE, 0, sizeof(float)*nSeq, probGPU, 0, NULL, NULL);
+    ciErrNum |= clEnqueueReadBuffer(cqCommandQue, vPath, CL_TRUE, 0, sizeof(int)*totalObs, pathGPU, 0, NULL, NULL);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, NULL);
+
+    shrDeltaT(1);
+    ViterbiBatchCPU(probCPU, pathCPU, obs, seqLength, nSeq, logInit, logState, nState, logEmit);
+    double tCPU = shrDeltaT(1);
+
+    // equal scores with different paths are ties, only the score must agree
+    int pathMismatch = 0;
+    for (int b = 0, t0 = 0; b < nSeq; t0 += seqLength[b++])
+    {
+        if (!closeTo(probGPU[b], probCPU[b], 1.0e-5)) pass = false;
+        if (memcmp(pathGPU + t0, pathCPU + t0, sizeof(int)*seqLength[b]) != 0) pathMismatch++;
+    }
+    shrLog("Viterbi:          GPU %.5f s (%.3f GCells/s), CPU %.5f s (%.3f GCells/s), speedup %.1fx, %d paths differ\n",
+           tGPU, 1.0e-9 * cells / tGPU, tCPU, 1.0e-9 * cells / tCPU, tCPU / tGPU, pathMismatch);
+    shrLogEx(LOGBOTH | MASTER, 0, "oclHiddenMarkovModel-batch, Throughput = %.4f GCells/s, Time = %.5f s, Size = %u items, NumDevsUsed = %u, Workgroup = %u\n",
+             1.0e-9 * cells / tGPU, tGPU, totalObs, 1, oBatch.getWorkgroupSize());
+
+    // forward-backward and posteriors
+    clFinish(cqCommandQue);
+    shrDeltaT(1);
+    oBatch.ForwardBackwardBatch(logLikGPU);
+    tGPU = shrDeltaT(1);
+    oBatch.PosteriorBatch(vGamma);
+    ciErrNum = clEnqueueReadBuffer(cqCommandQue, vGamma, CL_TRUE, 0, sizeof(float)*totalObs*nState, gamma, 0, NULL, NULL);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, NULL);
+
+    shrDeltaT(1);
+    ForwardBackwardBatchCPU(logLikCPU, alphaCPU, betaCPU, obs, seqLength, nSeq, logInit, logState, nState, logEmit);
+    tCPU = shrDeltaT(1);
+
+    for (int b = 0; b < nSeq; b++)
+    {
+        if (!closeTo(logLikGPU[b], logLikCPU[b], 1.0e-4)) pass = false;
+    }
+    // every posterior column is a distribution
+    float maxGammaError = 0.0f;
+    for (int t = 0; t < totalObs; t++)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < nState; i++) sum += gamma[t*nState + i];
+        maxGammaError = MAX(maxGammaError, fabsf(sum - 1.0f));
+    }
+    if (maxGammaError > 1.0e-3f) pass = false;
+    shrLog("Forward-backward: GPU %.5f s (%.3f GCells/s), CPU %.5f s (%.3f GCells/s), speedup %.1fx, max |sum(gamma)-1| = %.2e\n",
+           tGPU, 2.0e-9 * cells / tGPU, tCPU, 2.0e-9 * cells / tCPU, tCPU / tGPU, maxGammaError);
+
+    // Baum-Welch from a second random model on both sides
+    initHMMNormalized(initProb, mtState, mtEmit, nState, nEmit);
+    logTable(logInit, initProb, nState);
+    logTable(logState, mtState, nState*nState);
+    logTable(logEmit, mtEmit, nEmit*nState);
+    memcpy(logInitCPU, logInit, sizeof(float)*nState);
+    memcpy(logStateCPU, logState, sizeof(float)*nState*nState);
+    memcpy(logEmitCPU, logEmit, sizeof(float)*nEmit*nState);
+    HMMBatch oTrain(cxGPUContext, cqCommandQue, logInit, logState, logEmit, nState, nEmit, obs, seqLength, nSeq, argv[0], wgSize);
+
+    tGPU = tCPU = 0.0;
+    double lastGPU = -DBL_MAX;
+    for (int iter = 0; iter < nIter; iter++)
+    {
+        shrDeltaT(1);
+        double llGPU = oTrain.BaumWelchStep();
+        tGPU += shrDeltaT(1);
+        double llCPU = BaumWelchBatchCPU(obs, seqLength, nSeq, logInitCPU, logStateCPU, nState, logEmitCPU, nEmit);
+        tCPU += shrDeltaT(1);
+
+        // EM never lowers the likelihood
+        if (!closeTo(llGPU, llCPU, 1.0e-4) || llGPU < lastGPU - 1.0e-4 * fabs(lastGPU)) pass = false;
+        lastGPU = llGPU;
+        shrLog("Baum-Welch iteration %d: log-likelihood GPU %.4f, CPU %.4f\n", iter, llGPU, llCPU);
+    }
+    shrLog("Baum-Welch:       GPU %.5f s/iteration, CPU %.5f s/iteration, speedup %.1fx\n\n",
+           tGPU / nIter, tCPU / nIter, tCPU / tGPU);
+
+    clReleaseMemObject(vProb);
+    clReleaseMemObject(vPath);
+    clReleaseMemObject(vGamma);
+    free(initProb);
+    free(mtState);
+    free(mtEmit);
+    free(logInit);
+    free(logState);
+    free(logEmit);
+    free(logInitCPU);
+    free(logStateCPU);
+    free(logEmitCPU);
+    free(seqLength);
+    free(obs);
+    free(probGPU);
+    free(probCPU);
+    free(pathGPU);
+    free(pathCPU);
+    free(logLikGPU);
+    free(logLikCPU);
+    free(alphaCPU);
+    free(betaCPU);
+    free(gamma);
+    return pass;
+}
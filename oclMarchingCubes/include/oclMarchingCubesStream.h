@@ -0,0 +1,53 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef OCLMARCHINGCUBESSTREAM_H
+#define OCLMARCHINGCUBESSTREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Read-only mapping of a raw 8-bit volume file, slabs are uploaded straight
+// from the page cache so the volume never has to fit in host memory
+////////////////////////////////////////////////////////////////////////////////
+struct MappedVolume
+{
+    const unsigned char *data;
+    size_t size;
+#ifdef _WIN32
+    void *hFile;
+    void *hMapping;
+#else
+    int fd;
+#endif
+};
+
+// returns false if the file cannot be mapped or is shorter than size bytes
+bool MapVolume(const char *filename, size_t size, MappedVolume &volume);
+void UnmapVolume(MappedVolume &volume);
+
+////////////////////////////////////////////////////////////////////////////////
+// Binary STL mesh output
+// 80 byte header, 32-bit triangle count, then per triangle a unit normal,
+// three vertices (3 floats each) and a 16-bit attribute word
+////////////////////////////////////////////////////////////////////////////////
+// writes the header with a zero count, CloseMeshFile patches it
+FILE *OpenMeshFile(const char *filename);
+
+// pos and norm hold one float4 per vertex, three vertices per triangle, as
+// written by generateTriangles2; zOffset moves a slab to its place in the volume
+bool WriteMeshTriangles(FILE *file, const float *pos, const float *norm, unsigned int numVerts, float zOffset);
+
+// returns false on I/O errors or when the count does not fit the format
+bool CloseMeshFile(FILE *file, unsigned long long numTriangles);
+
+#endif
@@ -49,6 +49,15 @@ extern "C" size_t scanExclusiveLarge(
     uint arrayLength
 );
 
+//Single array of any length, no padding or power-of-two size required;
+//d_Dst may be the same buffer as d_Src
+extern "C" size_t scanExclusiveAny(
+    cl_command_queue cqCommandQueue,
+    cl_mem d_Dst,
+    cl_mem d_Src,
+    uint arrayLength
+);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Reference CPU batched inclusive scan
 ////////////////////////////////////////////////////////////////////////////////
@@ -185,3 +185,49 @@ void uniformUpdate(
     data4 += (uint4)buf[0];
     d_Data[get_global_id(0)] = data4;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// Arbitrary length scan kernels
+////////////////////////////////////////////////////////////////////////////////
+//Exclusive scan of the 4 * WORKGROUP_SIZE element blocks of an array of any
+//length N, the block totals go to d_Buf; d_Dst may alias d_Src
+__kernel __attribute__((reqd_work_group_size(WORKGROUP_SIZE, 1, 1)))
+void scanExclusiveBlocks(
+    __global uint *d_Dst,
+    __global uint *d_Buf,
+    __global uint *d_Src,
+    __local uint *l_Data,
+    uint N
+){
+    uint pos = 4 * get_global_id(0);
+
+    //Load data, zero-padding the last block
+    uint4 idata4;
+    idata4.x = (pos + 0 < N) ? d_Src[pos + 0] : 0;
+    idata4.y = (pos + 1 < N) ? d_Src[pos + 1] : 0;
+    idata4.z = (pos + 2 < N) ? d_Src[pos + 2] : 0;
+    idata4.w = (pos + 3 < N) ? d_Src[pos + 3] : 0;
+
+    //Calculate exclusive scan
+    uint4 odata4 = scan4Exclusive(idata4, l_Data, 4 * WORKGROUP_SIZE);
+
+    //Write back
+    if(pos + 0 < N) d_Dst[pos + 0] = odata4.x;
+    if(pos + 1 < N) d_Dst[pos + 1] = odata4.y;
+    if(pos + 2 < N) d_Dst[pos + 2] = odata4.z;
+    if(pos + 3 < N) d_Dst[pos + 3] = odata4.w;
+
+    if(get_local_id(0) == WORKGROUP_SIZE - 1)
+        d_Buf[get_group_id(0)] = odata4.w + idata4.w;
+}
+
+//Add the exclusive scan of the block totals to every element of the block
+__kernel __attribute__((reqd_work_group_size(WORKGROUP_SIZE, 1, 1)))
+void uniformUpdateAny(
+    __global uint *d_Data,
+    __global uint *d_Buf,
+    uint N
+){
+    if(get_global_id(0) < N)
+        d_Data[get_global_id(0)] += d_Buf[get_global_id(0) / (4 * WORKGROUP_SIZE)];
+}
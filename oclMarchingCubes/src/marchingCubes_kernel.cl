@@ -21,29 +21,109 @@ sampler_t volumeSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDG
 sampler_t tableSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
 
 
-// compute position in 3d grid from 1d index
-// only works for power of 2 sizes
-int4 calcGridPos(uint i, uint4 gridSizeShift, uint4 gridSizeMask)
+// compute position in 3d grid of classification slot i
+// dense grids (brickSizeLog2 == 0) have one slot per cell, x fastest;
+// sparse grids have one slot per cell of each active brick, brick after brick
+int4 calcGridPos(uint i, uint4 gridSize, __global const uint *activeBricks, uint brickSizeLog2)
 {
     int4 gridPos;
-    gridPos.x = (i & gridSizeMask.x);
-    gridPos.y = ((i >> gridSizeShift.y) & gridSizeMask.y);
-    gridPos.z = ((i >> gridSizeShift.z) & gridSizeMask.z);
+    if (brickSizeLog2 == 0) {
+        gridPos.x = i % gridSize.x;
+        gridPos.y = (i / gridSize.x) % gridSize.y;
+        gridPos.z = i / (gridSize.x * gridSize.y);
+    } else {
+        uint brickMask = (1 << brickSizeLog2) - 1;
+        uint numBricksX = (gridSize.x + brickMask) >> brickSizeLog2;
+        uint numBricksY = (gridSize.y + brickMask) >> brickSizeLog2;
+        uint brick = activeBricks[i >> (3 * brickSizeLog2)];
+        gridPos.x = ((brick % numBricksX) << brickSizeLog2) | (i & brickMask);
+        gridPos.y = (((brick / numBricksX) % numBricksY) << brickSizeLog2) | ((i >> brickSizeLog2) & brickMask);
+        gridPos.z = ((brick / (numBricksX * numBricksY)) << brickSizeLog2) | ((i >> (2 * brickSizeLog2)) & brickMask);
+    }
+    gridPos.w = 0;
     return gridPos;
 }
 
+// slot of the cell at gridPos, inverse of calcGridPos
+// brickSlot is the exclusive scan of the active brick flags
+uint calcSlot(int4 gridPos, uint4 gridSize, __global const uint *brickSlot, uint brickSizeLog2)
+{
+    if (brickSizeLog2 == 0) {
+        return gridPos.x + gridSize.x * (gridPos.y + gridSize.y * gridPos.z);
+    }
+    uint brickMask = (1 << brickSizeLog2) - 1;
+    uint numBricksX = (gridSize.x + brickMask) >> brickSizeLog2;
+    uint numBricksY = (gridSize.y + brickMask) >> brickSizeLog2;
+    uint brick = (gridPos.x >> brickSizeLog2) + numBricksX * ((gridPos.y >> brickSizeLog2) + numBricksY * (gridPos.z >> brickSizeLog2));
+    uint local = (gridPos.x & brickMask) | ((gridPos.y & brickMask) << brickSizeLog2) | ((gridPos.z & brickMask) << (2 * brickSizeLog2));
+    return (brickSlot[brick] << (3 * brickSizeLog2)) | local;
+}
+
+// min and max of the samples touched by the cells of each brick
+// one thread per brick, run once per volume
+__kernel
+void
+computeBrickMinMax(__global float2 *brickMinMax, __read_only image3d_t volume,
+                   uint4 gridSize, uint brickSizeLog2, uint numBricks)
+{
+    uint b = get_global_id(0);
+    if (b >= numBricks) return;
+
+    uint brickMask = (1 << brickSizeLog2) - 1;
+    uint numBricksX = (gridSize.x + brickMask) >> brickSizeLog2;
+    uint numBricksY = (gridSize.y + brickMask) >> brickSizeLog2;
+    int4 origin = (int4)((int)(b % numBricksX), (int)((b / numBricksX) % numBricksY), (int)(b / (numBricksX * numBricksY)), 0) << (int)brickSizeLog2;
+
+    // cells on the upper brick faces also read the next sample along each axis
+    int n = brickMask + 1;
+    float lo = MAXFLOAT;
+    float hi = -MAXFLOAT;
+    for(int z = 0; z <= n; z++) {
+        for(int y = 0; y <= n; y++) {
+            for(int x = 0; x <= n; x++) {
+                float f = read_imagef(volume, volumeSampler, origin + (int4)(x, y, z, 0)).x;
+                lo = min(lo, f);
+                hi = max(hi, f);
+            }
+        }
+    }
+    brickMinMax[b] = (float2)(lo, hi);
+}
+
+// flag the bricks whose value range straddles the isovalue
+// cells of other bricks have all corners on one side and generate nothing
+__kernel
+void
+classifyBricks(__global uint *brickActive, __global const float2 *brickMinMax, uint numBricks, float isoValue)
+{
+    uint b = get_global_id(0);
+    if (b < numBricks) {
+        float2 range = brickMinMax[b];
+        brickActive[b] = (range.x < isoValue) && (range.y >= isoValue);
+    }
+}
+
 // classify voxel based on number of vertices it will generate
 // one thread per voxel
 __kernel
 void
-classifyVoxel(__global uint* voxelVerts, __global uint *voxelOccupied, __read_only image3d_t volume,
-              uint4 gridSize, uint4 gridSizeShift, uint4 gridSizeMask, uint numVoxels,
-              float4 voxelSize, float isoValue,  __read_only image2d_t numVertsTex)
+classifyVoxel(__global uint* voxelVerts, __global uint *voxelOccupied, __global uint *voxelEdgeVerts,
+              __read_only image3d_t volume,
+              uint4 gridSize, __global const uint *activeBricks, uint brickSizeLog2, uint numSlots,
+              float isoValue, uint weld, __read_only image2d_t numVertsTex)
 {
-    uint blockId = get_group_id(0);
     uint i = get_global_id(0);
+    if (i >= numSlots) return;
 
-    int4 gridPos = calcGridPos(i, gridSizeShift, gridSizeMask);
+    int4 gridPos = calcGridPos(i, gridSize, activeBricks, brickSizeLog2);
+
+    // slots of partial bricks past the end of the grid
+    if (gridPos.x >= gridSize.x || gridPos.y >= gridSize.y || gridPos.z >= gridSize.z) {
+        voxelVerts[i] = 0;
+        voxelOccupied[i] = 0;
+        if (weld) voxelEdgeVerts[i] = 0;
+        return;
+    }
 
     // read field values at neighbouring grid vertices
     float field[8];
@@ -70,9 +150,21 @@ classifyVoxel(__global uint* voxelVerts, __global uint *voxelOccupied, __read_on
     // read number of vertices from texture
     uint numVerts = read_imageui(numVertsTex, tableSampler, (int2)(cubeindex,0)).x;
 
-    if (i < numVoxels) {
-        voxelVerts[i] = numVerts;
-        voxelOccupied[i] = (numVerts > 0);
+    // welded meshes only triangulate cells with all corners inside the volume,
+    // the vertices of the outer cells would belong to cells past the edge
+    if (weld && (gridPos.x + 1 >= gridSize.x || gridPos.y + 1 >= gridSize.y || gridPos.z + 1 >= gridSize.z)) {
+        numVerts = 0;
+    }
+
+    voxelVerts[i] = numVerts;
+    voxelOccupied[i] = (numVerts > 0);
+
+    // welded meshes: count the crossed edges the cell owns, the ones leaving
+    // corner 0 along +x, +y and +z (edges 0, 3 and 8)
+    if (weld) {
+        voxelEdgeVerts[i] = ((field[1] < isoValue) != (field[0] < isoValue)) +
+                            ((field[3] < isoValue) != (field[0] < isoValue)) +
+                            ((field[4] < isoValue) != (field[0] < isoValue));
     }
 }
      
@@ -84,7 +176,7 @@ compactVoxels(__global uint *compactedVoxelArray, __global uint *voxelOccupied,
 {
     uint i = get_global_id(0);
 
-    if (voxelOccupied[i] && (i < numVoxels)) {
+    if ((i < numVoxels) && voxelOccupied[i]) {
         compactedVoxelArray[ voxelOccupiedScan[i] ] = i;
     }
 }
@@ -125,7 +217,7 @@ __kernel
 void
 generateTriangles2(__global float4 *pos, __global float4 *norm, __global uint *compactedVoxelArray, __global uint *numVertsScanned, 
                    __read_only image3d_t volume,
-                   uint4 gridSize, uint4 gridSizeShift, uint4 gridSizeMask,
+                   uint4 gridSize, __global const uint *activeBricks, uint brickSizeLog2,
                    float4 voxelSize, float isoValue, uint activeVoxels, uint maxVerts, 
                    __read_only image2d_t numVertsTex, __read_only image2d_t triTex)
 {
@@ -139,7 +231,7 @@ generateTriangles2(__global float4 *pos, __global float4 *norm, __global uint *c
     uint voxel = compactedVoxelArray[i];
 
     // compute position in 3d grid
-    int4 gridPos = calcGridPos(voxel, gridSizeShift, gridSizeMask);
+    int4 gridPos = calcGridPos(voxel, gridSize, activeBricks, brickSizeLog2);
 
     float4 p;
     p.x = -1.0f + (gridPos.x * voxelSize.x);
@@ -216,7 +308,7 @@ generateTriangles2(__global float4 *pos, __global float4 *norm, __global uint *c
         // calculate triangle surface normal
         float4 n = calcNormal(v[0], v[1], v[2]);
 
-        if (index < (maxVerts - 3)) {
+        if (index + 2 < maxVerts) {
             pos[index] = v[0];
             norm[index] = n;
 
@@ -229,3 +321,113 @@ generateTriangles2(__global float4 *pos, __global float4 *norm, __global uint *c
     }
 }
 
+
+// welded output: every cell owns the edges leaving its corner 0 along
+// +x, +y and +z, the vertex of a crossed edge is written once by its owner
+// and triangles refer to it through an index buffer
+
+// owner cell offset (xyz) and axis (w) of the 12 cube edges
+__constant int4 edgeOwner[12] = {
+    (int4)(0, 0, 0, 0), (int4)(1, 0, 0, 1), (int4)(0, 1, 0, 0), (int4)(0, 0, 0, 1),
+    (int4)(0, 0, 1, 0), (int4)(1, 0, 1, 1), (int4)(0, 1, 1, 0), (int4)(0, 0, 1, 1),
+    (int4)(0, 0, 0, 2), (int4)(1, 0, 0, 2), (int4)(1, 1, 0, 2), (int4)(0, 1, 0, 2)
+};
+
+// field value (w) and central difference gradient (xyz) at a grid vertex
+float4 fieldGradient(__read_only image3d_t volume, int4 p)
+{
+    float4 f;
+    f.x = read_imagef(volume, volumeSampler, p + (int4)(1, 0, 0, 0)).x - read_imagef(volume, volumeSampler, p - (int4)(1, 0, 0, 0)).x;
+    f.y = read_imagef(volume, volumeSampler, p + (int4)(0, 1, 0, 0)).x - read_imagef(volume, volumeSampler, p - (int4)(0, 1, 0, 0)).x;
+    f.z = read_imagef(volume, volumeSampler, p + (int4)(0, 0, 1, 0)).x - read_imagef(volume, volumeSampler, p - (int4)(0, 0, 1, 0)).x;
+    f.xyz *= 0.5f;
+    f.w = read_imagef(volume, volumeSampler, p).x;
+    return f;
+}
+
+// one thread per slot, writes the vertices of the crossed edges the cell owns
+// in x, y, z order starting at its edge vertex scan
+__kernel
+void
+generateWeldedVertices(__global float4 *pos, __global float4 *norm,
+                       __global const uint *voxelEdgeVerts, __global const uint *voxelEdgeVertsScan,
+                       __read_only image3d_t volume,
+                       uint4 gridSize, __global const uint *activeBricks, uint brickSizeLog2, uint numSlots,
+                       float4 voxelSize, float isoValue, uint maxVerts)
+{
+    uint i = get_global_id(0);
+    if ((i >= numSlots) || (voxelEdgeVerts[i] == 0)) return;
+
+    int4 gridPos = calcGridPos(i, gridSize, activeBricks, brickSizeLog2);
+
+    float4 p;
+    p.x = -1.0f + (gridPos.x * voxelSize.x);
+    p.y = -1.0f + (gridPos.y * voxelSize.y);
+    p.z = -1.0f + (gridPos.z * voxelSize.z);
+    p.w = 1.0f;
+
+    float4 f0 = fieldGradient(volume, gridPos);
+    uint index = voxelEdgeVertsScan[i];
+
+    for(int axis = 0; axis < 3; axis++) {
+        int4 d = (int4)(axis == 0, axis == 1, axis == 2, 0);
+        float4 f1 = fieldGradient(volume, gridPos + d);
+        if ((f0.w < isoValue) != (f1.w < isoValue)) {
+            float4 v, n;
+            vertexInterp2(isoValue, p, p + convert_float4(d) * voxelSize, f0, f1, &v, &n);
+            if (index < maxVerts) {
+                pos[index] = v;
+                // the field grows away from the faces generateTriangles2 emits
+                norm[index] = (float4)(-n.xyz, 0.0f);
+            }
+            index++;
+        }
+    }
+}
+
+// one thread per active voxel, writes the vertex index of every triangle
+// corner; brickSlot maps bricks to their first slot for sparse grids
+__kernel
+void
+generateTriangleIndices(__global uint *indices, __global uint *compactedVoxelArray, __global uint *numVertsScanned,
+                        __global const uint *voxelEdgeVertsScan, __global const uint *brickSlot,
+                        __read_only image3d_t volume,
+                        uint4 gridSize, __global const uint *activeBricks, uint brickSizeLog2,
+                        float isoValue, uint activeVoxels, uint maxIndices,
+                        __read_only image2d_t numVertsTex, __read_only image2d_t triTex)
+{
+    uint i = get_global_id(0);
+    if (i >= activeVoxels) return;
+
+    uint voxel = compactedVoxelArray[i];
+    int4 gridPos = calcGridPos(voxel, gridSize, activeBricks, brickSizeLog2);
+
+    int cubeindex;
+    cubeindex =  (read_imagef(volume, volumeSampler, gridPos).x < isoValue);
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(1, 0, 0, 0)).x < isoValue)*2;
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(1, 1, 0, 0)).x < isoValue)*4;
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(0, 1, 0, 0)).x < isoValue)*8;
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(0, 0, 1, 0)).x < isoValue)*16;
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(1, 0, 1, 0)).x < isoValue)*32;
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(1, 1, 1, 0)).x < isoValue)*64;
+    cubeindex += (read_imagef(volume, volumeSampler, gridPos + (int4)(0, 1, 1, 0)).x < isoValue)*128;
+
+    uint numVerts = read_imageui(numVertsTex, tableSampler, (int2)(cubeindex,0)).x;
+    uint base = numVertsScanned[voxel];
+
+    for(uint j=0; j<numVerts; j++) {
+        uint edge = read_imageui(triTex, tableSampler, (int2)(j,cubeindex)).x;
+        int4 owner = edgeOwner[edge];
+        int4 ownerPos = gridPos + (int4)(owner.xyz, 0);
+
+        // the owner writes its crossed edges in x, y, z order
+        bool inside = read_imagef(volume, volumeSampler, ownerPos).x < isoValue;
+        uint rank = 0;
+        if (owner.w > 0) rank += (read_imagef(volume, volumeSampler, ownerPos + (int4)(1, 0, 0, 0)).x < isoValue) != inside;
+        if (owner.w > 1) rank += (read_imagef(volume, volumeSampler, ownerPos + (int4)(0, 1, 0, 0)).x < isoValue) != inside;
+
+        if (base + j < maxIndices) {
+            indices[base + j] = voxelEdgeVertsScan[calcSlot(ownerPos, gridSize, brickSlot, brickSizeLog2)] + rank;
+        }
+    }
+}
@@ -60,6 +60,25 @@
 
     6. Render geometry
     Using number of vertices from readback.
+
+    Sparse grids (--brick=n) split the volume into bricks of 2^n cells per side
+    and keep the min and max sample of each brick. Every frame "classifyBricks"
+    flags the bricks straddling the isovalue, and only the cells of those
+    bricks are classified, scanned and compacted.
+
+    Welded output (--weld) writes each isosurface vertex once: every cell owns
+    the crossed edges leaving its first corner along +x, +y and +z, a third
+    scan numbers them, and the triangles become an index buffer.
+
+    Output buffers are sized from the scanned counts, so they grow with the
+    isosurface rather than being allocated for the worst case up front. Grid
+    sizes need not be powers of two (--size, --sizex, --sizey, --sizez).
+
+    Streaming mode (--stream=mesh.stl) meshes volumes larger than device or
+    host memory: the raw file is memory mapped and processed in slabs of
+    --slab cell layers, each uploaded with one overlap slice so the cells on
+    the slab boundary see their upper corners. The triangles of every slab are
+    appended to a binary STL file as soon as they are generated.
 */
 // OpenGL Graphics includes
 #include <GL/glew.h>
@@ -117,6 +136,7 @@
 #define REFRESH_DELAY	  10 //ms
 
 #include "oclScan_common.h"
+#include "oclMarchingCubesStream.h"
 
 // OpenCL vars
 cl_platform_id cpPlatform;
@@ -131,6 +151,10 @@ cl_program cpProgram;
 cl_kernel classifyVoxelKernel;
 cl_kernel compactVoxelsKernel;
 cl_kernel generateTriangles2Kernel;
+cl_kernel computeBrickMinMaxKernel;
+cl_kernel classifyBricksKernel;
+cl_kernel generateWeldedVerticesKernel;
+cl_kernel generateTriangleIndicesKernel;
 cl_int ciErrNum;
 char* cPathAndName = NULL;          // var for full paths to data, src, etc.
 char* cSourceCL;                    // Buffer to hold source for compilation 
@@ -156,33 +180,51 @@ const unsigned int window_height = 512;
 const char *volumeFilename = "Bucky.raw";
 
 cl_uint gridSizeLog2[4] = {5, 5, 5,0};
-cl_uint gridSizeShift[4];
 cl_uint gridSize[4];
-cl_uint gridSizeMask[4];
 
 cl_float voxelSize[4];
 uint numVoxels    = 0;
-uint maxVerts     = 0;
 uint activeVoxels = 0;
 uint totalVerts   = 0;
+uint totalUniqueVerts = 0;      // welded vertices, indexed by the totalVerts triangle corners
+
+// sparse grid: bricks of 2^brickSizeLog2 cells per side, 0 classifies every cell
+cl_uint brickSizeLog2 = 0;
+uint numBricks       = 0;
+uint numActiveBricks = 0;
+uint numSlots        = 0;       // cells classified per frame
+bool weld            = false;
+
+// allocated sizes, in elements, of the buffers that grow on demand
+uint slotCapacity    = 0;
+uint vertexCapacity  = 0;
+uint indexCapacity   = 0;
 
 float isoValue		= 0.2f;
 float dIsoValue		= 0.005f;
 
 // device data
-GLuint posVbo, normalVbo;
+GLuint posVbo, normalVbo, indexVbo;
 
 GLint  gl_Shader;
 
 cl_mem d_pos = 0;
 cl_mem d_normal = 0;
+cl_mem d_indices = 0;
 
 cl_mem d_volume = 0;
 cl_mem d_voxelVerts = 0;
 cl_mem d_voxelVertsScan = 0;
 cl_mem d_voxelOccupied = 0;
 cl_mem d_voxelOccupiedScan = 0;
-cl_mem d_compVoxelArray;
+cl_mem d_compVoxelArray = 0;
+cl_mem d_voxelEdgeVerts = 0;
+cl_mem d_voxelEdgeVertsScan = 0;
+
+cl_mem d_brickMinMax = 0;
+cl_mem d_brickActive = 0;
+cl_mem d_brickActiveScan = 0;
+cl_mem d_activeBricks = 0;
 
 // tables
 cl_mem d_numVertsTable = 0;
@@ -213,17 +255,24 @@ int g_Index = 0;
 unsigned int frameCount = 0;
 unsigned int g_TotalErrors = 0;
 bool g_bNoprompt = false;
-bool bQATest = false;	
+bool bQATest = false;
+bool bStream = false;               // out-of-core extraction to a mesh file
+char* cMeshFilename = NULL;	
 const char* cpExecutableName;
 
 // forward declarations
 void runTest(int argc, char** argv);
 void initMC(int argc, char** argv);
+void parseGridOptions(int argc, char** argv);
+void StreamIsosurface(int argc, char** argv, const char* meshFilename);
 void computeIsosurface();
 
 bool initGL(int argc, char **argv);
 void createVBO(GLuint* vbo, unsigned int size, cl_mem &vbo_cl);
 void deleteVBO(GLuint* vbo, cl_mem vbo_cl );
+void createDeviceBuffer(cl_mem &buffer, size_t size);
+void allocateSlotBuffers(uint numSlots);
+void allocateOutputBuffers(uint numVertices, uint numIndices);
 
 void display();
 void keyboard(unsigned char key, int x, int y);
@@ -263,49 +312,118 @@ void allocateTextures(	cl_mem *d_triTable, cl_mem* d_numVertsTable )
 
 void
 openclScan(cl_mem d_voxelOccupiedScan, cl_mem d_voxelOccupied, int numVoxels) {
-    scanExclusiveLarge(
-                       cqCommandQueue,
-                       d_voxelOccupiedScan,
-                       d_voxelOccupied,
-                       1,
-                       numVoxels);
-    
-    
+    // the large scan only takes power-of-two lengths within its limits,
+    // everything else goes through the arbitrary length scan
+    uint n = (uint)numVoxels;
+    if (((n & (n - 1)) == 0) && (n >= MIN_LARGE_ARRAY_SIZE) && (n <= MAX_LARGE_ARRAY_SIZE)) {
+        scanExclusiveLarge(
+                           cqCommandQueue,
+                           d_voxelOccupiedScan,
+                           d_voxelOccupied,
+                           1,
+                           numVoxels);
+    } else {
+        scanExclusiveAny(
+                         cqCommandQueue,
+                         d_voxelOccupiedScan,
+                         d_voxelOccupied,
+                         numVoxels);
+    }
+}
+
+// since we are using an exclusive scan, the total is the last value of
+// the scan result plus the last value in the input array
+uint
+scanTotal(cl_mem d_input, cl_mem d_scan, uint n)
+{
+    uint lastElement, lastScanElement;
+
+    ciErrNum  = clEnqueueReadBuffer(cqCommandQueue, d_input, CL_TRUE, (n-1) * sizeof(uint), sizeof(uint), &lastElement, 0, 0, 0);
+    ciErrNum |= clEnqueueReadBuffer(cqCommandQueue, d_scan, CL_TRUE, (n-1) * sizeof(uint), sizeof(uint), &lastScanElement, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    return lastElement + lastScanElement;
+}
+
+// global work size covering n items in groups of localSize
+size_t
+roundUp(size_t n, size_t localSize)
+{
+    return ((n + localSize - 1) / localSize) * localSize;
+}
+
+void
+launch_computeBrickMinMax(size_t threads, cl_mem brickMinMax, cl_mem volume,
+                          cl_uint gridSize[4], cl_uint brickSizeLog2, uint numBricks)
+{
+    ciErrNum = clSetKernelArg(computeBrickMinMaxKernel, 0, sizeof(cl_mem), &brickMinMax);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(computeBrickMinMaxKernel, 1, sizeof(cl_mem), &volume);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(computeBrickMinMaxKernel, 2, 4 * sizeof(cl_uint), gridSize);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(computeBrickMinMaxKernel, 3, sizeof(cl_uint), &brickSizeLog2);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(computeBrickMinMaxKernel, 4, sizeof(uint), &numBricks);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    size_t grid = roundUp(numBricks, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, computeBrickMinMaxKernel, 1, NULL, &grid, &threads, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
+void
+launch_classifyBricks(size_t threads, cl_mem brickActive, cl_mem brickMinMax, uint numBricks, float isoValue)
+{
+    ciErrNum = clSetKernelArg(classifyBricksKernel, 0, sizeof(cl_mem), &brickActive);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(classifyBricksKernel, 1, sizeof(cl_mem), &brickMinMax);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(classifyBricksKernel, 2, sizeof(uint), &numBricks);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(classifyBricksKernel, 3, sizeof(float), &isoValue);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    size_t grid = roundUp(numBricks, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, classifyBricksKernel, 1, NULL, &grid, &threads, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 }
 
 void
-launch_classifyVoxel( dim3 grid, dim3 threads, cl_mem voxelVerts, cl_mem voxelOccupied, cl_mem volume,
-					  cl_uint gridSize[4], cl_uint gridSizeShift[4], cl_uint gridSizeMask[4], uint numVoxels,
-					  cl_float voxelSize[4], float isoValue)
+launch_classifyVoxel(size_t threads, cl_mem voxelVerts, cl_mem voxelOccupied, cl_mem voxelEdgeVerts, cl_mem volume,
+					  cl_uint gridSize[4], cl_mem activeBricks, cl_uint brickSizeLog2, uint numSlots,
+					  float isoValue, cl_uint weld)
 {
     ciErrNum = clSetKernelArg(classifyVoxelKernel, 0, sizeof(cl_mem), &voxelVerts);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     ciErrNum = clSetKernelArg(classifyVoxelKernel, 1, sizeof(cl_mem), &voxelOccupied);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 2, sizeof(cl_mem), &volume);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 2, sizeof(cl_mem), &voxelEdgeVerts);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 3, 4 * sizeof(cl_uint), gridSize);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 3, sizeof(cl_mem), &volume);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 4, 4 * sizeof(cl_uint), gridSizeShift);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 4, 4 * sizeof(cl_uint), gridSize);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 5, 4 * sizeof(cl_uint), gridSizeMask);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 5, sizeof(cl_mem), &activeBricks);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 6, sizeof(uint), &numVoxels);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 6, sizeof(cl_uint), &brickSizeLog2);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 7, 4 * sizeof(cl_float), voxelSize);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 7, sizeof(uint), &numSlots);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     ciErrNum = clSetKernelArg(classifyVoxelKernel, 8, sizeof(float), &isoValue);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(classifyVoxelKernel, 9, sizeof(cl_mem), &d_numVertsTable);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 9, sizeof(cl_uint), &weld);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(classifyVoxelKernel, 10, sizeof(cl_mem), &d_numVertsTable);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
-    grid.x *= threads.x;
-    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, classifyVoxelKernel, 1, NULL, (size_t*) &grid, (size_t*) &threads, 0, 0, 0);
+    size_t grid = roundUp(numSlots, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, classifyVoxelKernel, 1, NULL, &grid, &threads, 0, 0, 0);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 }
 
 void
-launch_compactVoxels(dim3 grid, dim3 threads, cl_mem compVoxelArray, cl_mem voxelOccupied, cl_mem voxelOccupiedScan, uint numVoxels)
+launch_compactVoxels(size_t threads, cl_mem compVoxelArray, cl_mem voxelOccupied, cl_mem voxelOccupiedScan, uint numVoxels)
 {
     ciErrNum = clSetKernelArg(compactVoxelsKernel, 0, sizeof(cl_mem), &compVoxelArray);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
@@ -315,16 +433,16 @@ launch_compactVoxels(dim3 grid, dim3 threads, cl_mem compVoxelArray, cl_mem voxe
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     ciErrNum = clSetKernelArg(compactVoxelsKernel, 3, sizeof(cl_uint), &numVoxels);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    
-    grid.x *= threads.x;
-    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, compactVoxelsKernel, 1, NULL, (size_t*) &grid, (size_t*) &threads, 0, 0, 0);
+
+    size_t grid = roundUp(numVoxels, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, compactVoxelsKernel, 1, NULL, &grid, &threads, 0, 0, 0);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 }
 
 void
-launch_generateTriangles2(dim3 grid, dim3 threads,
+launch_generateTriangles2(size_t threads,
                           cl_mem pos, cl_mem norm, cl_mem compactedVoxelArray, cl_mem numVertsScanned, cl_mem volume,
-                          cl_uint gridSize[4], cl_uint gridSizeShift[4], cl_uint gridSizeMask[4],
+                          cl_uint gridSize[4], cl_mem activeBricks, cl_uint brickSizeLog2,
                           cl_float voxelSize[4], float isoValue, uint activeVoxels, uint maxVerts)
 {
     ciErrNum = clSetKernelArg(generateTriangles2Kernel, 0, sizeof(cl_mem), &pos);
@@ -336,12 +454,12 @@ launch_generateTriangles2(dim3 grid, dim3 threads,
     ciErrNum = clSetKernelArg(generateTriangles2Kernel, 3, sizeof(cl_mem), &numVertsScanned);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     ciErrNum = clSetKernelArg(generateTriangles2Kernel, 4, sizeof(cl_mem), &volume);
-    oclCheckErrorEX(ciErrNum, CL_SUCCESS,  pCleanup); 
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS,  pCleanup);
     ciErrNum = clSetKernelArg(generateTriangles2Kernel, 5, 4 * sizeof(cl_uint), gridSize);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(generateTriangles2Kernel, 6, 4 * sizeof(cl_uint), gridSizeShift);
+    ciErrNum = clSetKernelArg(generateTriangles2Kernel, 6, sizeof(cl_mem), &activeBricks);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    ciErrNum = clSetKernelArg(generateTriangles2Kernel, 7, 4 * sizeof(cl_uint), gridSizeMask);
+    ciErrNum = clSetKernelArg(generateTriangles2Kernel, 7, sizeof(cl_uint), &brickSizeLog2);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     ciErrNum = clSetKernelArg(generateTriangles2Kernel, 8, 4 * sizeof(cl_float), voxelSize);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
@@ -357,12 +475,87 @@ launch_generateTriangles2(dim3 grid, dim3 threads,
     ciErrNum = clSetKernelArg(generateTriangles2Kernel, 13, sizeof(cl_mem), &d_triTable);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
-    grid.x *= threads.x;
-    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, generateTriangles2Kernel, 1, NULL, (size_t*) &grid, (size_t*) &threads, 0, 0, 0);
+    size_t grid = roundUp(activeVoxels, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, generateTriangles2Kernel, 1, NULL, &grid, &threads, 0, 0, 0);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
 }
 
+void
+launch_generateWeldedVertices(size_t threads, cl_mem pos, cl_mem norm, cl_mem voxelEdgeVerts, cl_mem voxelEdgeVertsScan,
+                              cl_mem volume, cl_uint gridSize[4], cl_mem activeBricks, cl_uint brickSizeLog2, uint numSlots,
+                              cl_float voxelSize[4], float isoValue, uint maxVerts)
+{
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 0, sizeof(cl_mem), &pos);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 1, sizeof(cl_mem), &norm);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 2, sizeof(cl_mem), &voxelEdgeVerts);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 3, sizeof(cl_mem), &voxelEdgeVertsScan);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 4, sizeof(cl_mem), &volume);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 5, 4 * sizeof(cl_uint), gridSize);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 6, sizeof(cl_mem), &activeBricks);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 7, sizeof(cl_uint), &brickSizeLog2);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 8, sizeof(uint), &numSlots);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 9, 4 * sizeof(cl_float), voxelSize);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 10, sizeof(float), &isoValue);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateWeldedVerticesKernel, 11, sizeof(uint), &maxVerts);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    size_t grid = roundUp(numSlots, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, generateWeldedVerticesKernel, 1, NULL, &grid, &threads, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
+void
+launch_generateTriangleIndices(size_t threads, cl_mem indices, cl_mem compactedVoxelArray, cl_mem numVertsScanned,
+                               cl_mem voxelEdgeVertsScan, cl_mem brickSlot, cl_mem volume,
+                               cl_uint gridSize[4], cl_mem activeBricks, cl_uint brickSizeLog2,
+                               float isoValue, uint activeVoxels, uint maxIndices)
+{
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 0, sizeof(cl_mem), &indices);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 1, sizeof(cl_mem), &compactedVoxelArray);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 2, sizeof(cl_mem), &numVertsScanned);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 3, sizeof(cl_mem), &voxelEdgeVertsScan);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 4, sizeof(cl_mem), &brickSlot);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 5, sizeof(cl_mem), &volume);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 6, 4 * sizeof(cl_uint), gridSize);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 7, sizeof(cl_mem), &activeBricks);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 8, sizeof(cl_uint), &brickSizeLog2);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 9, sizeof(float), &isoValue);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 10, sizeof(uint), &activeVoxels);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 11, sizeof(uint), &maxIndices);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 12, sizeof(cl_mem), &d_numVertsTable);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ciErrNum = clSetKernelArg(generateTriangleIndicesKernel, 13, sizeof(cl_mem), &d_triTable);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    size_t grid = roundUp(activeVoxels, threads);
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, generateTriangleIndicesKernel, 1, NULL, &grid, &threads, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
 void animation()
 {
     if (animate) {
@@ -406,7 +599,7 @@ void computeFPS()
 ////////////////////////////////////////////////////////////////////////////////
 // Load raw data from disk
 ////////////////////////////////////////////////////////////////////////////////
-uchar *loadRawFile(char *filename, int size)
+uchar *loadRawFile(char *filename, size_t size)
 {
 	FILE *fp = fopen(filename, "rb");
     if (!fp) {
@@ -414,7 +607,7 @@ uchar *loadRawFile(char *filename, int size)
         return 0;
     }
 
-	uchar *data = (uchar *) malloc(size);
+	uchar *data = (uchar *) calloc(size, 1);
 	size_t read = fread(data, 1, size, fp);
 	fclose(fp);
 
@@ -569,6 +762,18 @@ void initCL(int argc, char** argv) {
     generateTriangles2Kernel = clCreateKernel(cpProgram, "generateTriangles2", &ciErrNum);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
+    computeBrickMinMaxKernel = clCreateKernel(cpProgram, "computeBrickMinMax", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    classifyBricksKernel = clCreateKernel(cpProgram, "classifyBricks", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    generateWeldedVerticesKernel = clCreateKernel(cpProgram, "generateWeldedVertices", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    generateTriangleIndicesKernel = clCreateKernel(cpProgram, "generateTriangleIndices", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
     // Setup Scan
     initScan(cxGPUContext, cqCommandQueue, (const char**)argv);
 }
@@ -594,6 +799,11 @@ main(int argc, char** argv)
         g_bNoprompt = true;
     }
 
+    if (shrGetCmdLineArgumentstr(argc, (const char **)argv, "stream", &cMeshFilename) ) {
+        bStream = true;
+        animate = false;
+    }
+
     if (shrCheckCmdLineFlag(argc, (const char **)argv, "qatest") ) {    
         bQATest = true;
 	animate = false;
@@ -605,12 +815,11 @@ main(int argc, char** argv)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// initialize marching cubes
+// parse volume file, grid size and extraction options
 ////////////////////////////////////////////////////////////////////////////////
 void
-initMC(int argc, char** argv)
+parseGridOptions(int argc, char** argv)
 {
-    // parse command line arguments
     int n;
     if (shrGetCmdLineArgumenti( argc, (const char**) argv, "grid", &n)) {
         gridSizeLog2[0] = gridSizeLog2[1] = gridSizeLog2[2] = n;
@@ -634,26 +843,46 @@ initMC(int argc, char** argv)
     gridSize[1] = 1<<gridSizeLog2[1];
     gridSize[2] = 1<<gridSizeLog2[2];
 
+    // explicit sizes, any number of samples
+    if (shrGetCmdLineArgumenti( argc, (const char**) argv, "size", &n)) {
+        gridSize[0] = gridSize[1] = gridSize[2] = n;
+    }
+    if (shrGetCmdLineArgumenti( argc, (const char**) argv, "sizex", &n)) {
+        gridSize[0] = n;
+    }
+    if (shrGetCmdLineArgumenti( argc, (const char**) argv, "sizey", &n)) {
+        gridSize[1] = n;
+    }
+    if (shrGetCmdLineArgumenti( argc, (const char**) argv, "sizez", &n)) {
+        gridSize[2] = n;
+    }
+    for (int i = 0; i < 3; i++) {
+        gridSize[i] = MAX(gridSize[i], 2);
+    }
 
-    gridSizeMask[0] = gridSize[0]-1;
-    gridSizeMask[1] = gridSize[1]-1;
-    gridSizeMask[2] = gridSize[2]-1;
-
-    gridSizeShift[0] = 0;
-    gridSizeShift[1] = gridSizeLog2[0];
-    gridSizeShift[2] = gridSizeLog2[0]+gridSizeLog2[1];
+    if (shrGetCmdLineArgumenti( argc, (const char**) argv, "brick", &n)) {
+        brickSizeLog2 = CLAMP(n, 0, 5);
+    }
+    weld = shrCheckCmdLineFlag(argc, (const char**) argv, "weld") != shrFALSE;
 
     numVoxels = gridSize[0]*gridSize[1]*gridSize[2];
 
-    
+
     voxelSize[0] = 2.0f / gridSize[0];
     voxelSize[1] = 2.0f / gridSize[1];
     voxelSize[2] = 2.0f / gridSize[2];
 
-    maxVerts = gridSize[0]*gridSize[1]*100;
+    shrLog("grid: %d x %d x %d = %.0f voxels\n", gridSize[0], gridSize[1], gridSize[2],
+           (double)gridSize[0] * gridSize[1] * gridSize[2]);
+}
 
-    shrLog("grid: %d x %d x %d = %d voxels\n", gridSize[0], gridSize[1], gridSize[2], numVoxels);
-    shrLog("max verts = %d\n", maxVerts);
+////////////////////////////////////////////////////////////////////////////////
+// initialize marching cubes
+////////////////////////////////////////////////////////////////////////////////
+void
+initMC(int argc, char** argv)
+{
+    parseGridOptions(argc, argv);
 
     // load volume data
     char* path = shrFindFilePath(volumeFilename, argv[0]);
@@ -662,46 +891,53 @@ initMC(int argc, char** argv)
         exit(EXIT_FAILURE);
     }
 
-    int size = gridSize[0]*gridSize[1]*gridSize[2]*sizeof(uchar);
+    size_t size = (size_t)gridSize[0]*gridSize[1]*gridSize[2]*sizeof(uchar);
     uchar *volume = loadRawFile(path, size);
     cl_image_format volumeFormat;
     volumeFormat.image_channel_order = CL_R;
     volumeFormat.image_channel_data_type = CL_UNORM_INT8;
 
-    d_volume = clCreateImage3D(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &volumeFormat, 
+    d_volume = clCreateImage3D(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &volumeFormat,
                                     gridSize[0], gridSize[1], gridSize[2],
                                     gridSize[0], gridSize[0] * gridSize[1],
                                     volume, &ciErrNum);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     free(volume);
 
-    // create VBOs
-    if( !bQATest) {
-        createVBO(&posVbo, maxVerts*sizeof(float)*4, d_pos);
-        createVBO(&normalVbo, maxVerts*sizeof(float)*4, d_normal);
-    }
-    
     // allocate textures
 	allocateTextures(&d_triTable, &d_numVertsTable );
 
     // allocate device memory
-    unsigned int memSize = sizeof(uint) * numVoxels;
-    d_voxelVerts = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, 0, &ciErrNum);
-    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    d_voxelVertsScan = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, 0, &ciErrNum);
-    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    d_voxelOccupied = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, 0, &ciErrNum);
-    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    d_voxelOccupiedScan = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, 0, &ciErrNum);
-    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
-    d_compVoxelArray = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, memSize, 0, &ciErrNum);
-    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    // the output buffers are allocated by computeIsosurface once it knows their size
+    if (brickSizeLog2 > 0) {
+        uint brickMask = (1 << brickSizeLog2) - 1;
+        numBricks = ((gridSize[0] + brickMask) >> brickSizeLog2) *
+                    ((gridSize[1] + brickMask) >> brickSizeLog2) *
+                    ((gridSize[2] + brickMask) >> brickSizeLog2);
+
+        createDeviceBuffer(d_brickMinMax, numBricks * 2 * sizeof(float));
+        createDeviceBuffer(d_brickActive, numBricks * sizeof(uint));
+        createDeviceBuffer(d_brickActiveScan, numBricks * sizeof(uint));
+        createDeviceBuffer(d_activeBricks, numBricks * sizeof(uint));
+
+        // the value range of each brick does not depend on the isovalue
+        launch_computeBrickMinMax(128, d_brickMinMax, d_volume, gridSize, brickSizeLog2, numBricks);
+
+        shrLog("bricks: %u of %u^3 cells\n", numBricks, 1 << brickSizeLog2);
+    } else {
+        numSlots = numVoxels;
+        allocateSlotBuffers(numSlots);
+    }
+    if (weld) {
+        shrLog("welding vertices into an indexed mesh\n");
+    }
 }
 
 void Cleanup(int iExitCode)
 {
     deleteVBO(&posVbo, d_pos);
     deleteVBO(&normalVbo, d_normal);
+    deleteVBO(&indexVbo, d_indices);
 
     if( d_triTable ) clReleaseMemObject(d_triTable);
     if( d_numVertsTable ) clReleaseMemObject(d_numVertsTable);
@@ -711,6 +947,13 @@ void Cleanup(int iExitCode)
     if( d_voxelOccupied) clReleaseMemObject(d_voxelOccupied);
     if( d_voxelOccupiedScan) clReleaseMemObject(d_voxelOccupiedScan);
     if( d_compVoxelArray) clReleaseMemObject(d_compVoxelArray);
+    if( d_voxelEdgeVerts) clReleaseMemObject(d_voxelEdgeVerts);
+    if( d_voxelEdgeVertsScan) clReleaseMemObject(d_voxelEdgeVertsScan);
+
+    if( d_brickMinMax) clReleaseMemObject(d_brickMinMax);
+    if( d_brickActive) clReleaseMemObject(d_brickActive);
+    if( d_brickActiveScan) clReleaseMemObject(d_brickActiveScan);
+    if( d_activeBricks) clReleaseMemObject(d_activeBricks);
 
     if( d_volume) clReleaseMemObject(d_volume);
 
@@ -718,7 +961,11 @@ void Cleanup(int iExitCode)
     
     if(compactVoxelsKernel)clReleaseKernel(compactVoxelsKernel);  
     if(compactVoxelsKernel)clReleaseKernel(generateTriangles2Kernel);  
-    if(compactVoxelsKernel)clReleaseKernel(classifyVoxelKernel);  
+    if(compactVoxelsKernel)clReleaseKernel(classifyVoxelKernel);
+    if(computeBrickMinMaxKernel)clReleaseKernel(computeBrickMinMaxKernel);
+    if(classifyBricksKernel)clReleaseKernel(classifyBricksKernel);
+    if(generateWeldedVerticesKernel)clReleaseKernel(generateWeldedVerticesKernel);
+    if(generateTriangleIndicesKernel)clReleaseKernel(generateTriangleIndicesKernel);
     if(cpProgram)clReleaseProgram(cpProgram);
 
     if(cqCommandQueue)clReleaseCommandQueue(cqCommandQueue);
@@ -760,12 +1007,17 @@ runTest(int argc, char** argv)
 {
     // First initialize OpenGL context, so we can properly set the GL for CUDA.
     // This is necessary in order to achieve optimal performance with OpenGL/CUDA interop.
-    if( !bQATest ) {
+    if( !bQATest && !bStream ) {
         initGL(argc, argv);
     }
     
     initCL(argc, argv);
 
+    if( bStream ) {
+        StreamIsosurface(argc, argv, cMeshFilename);
+        return;
+    }
+
     if( !bQATest ) {
         // register callbacks
         glutDisplayFunc(display);
@@ -797,91 +1049,112 @@ runTest(int argc, char** argv)
 void
 computeIsosurface()
 {
-    int threads = 128;
-    dim3 grid(numVoxels / threads, 1, 1);
-    // get around maximum grid size of 65535 in each dimension
-    if (grid.x > 65535) {
-        grid.y = grid.x / 32768;
-        grid.x = 32768;
+    size_t threads = 128;
+
+    // sparse grid: only the cells of bricks straddling the isovalue are classified
+    if (brickSizeLog2 > 0) {
+        launch_classifyBricks(threads, d_brickActive, d_brickMinMax, numBricks, isoValue);
+        openclScan(d_brickActiveScan, d_brickActive, numBricks);
+        numActiveBricks = scanTotal(d_brickActive, d_brickActiveScan, numBricks);
+
+        if (numActiveBricks == 0) {
+            activeVoxels = 0;
+            totalVerts = 0;
+            totalUniqueVerts = 0;
+            return;
+        }
+
+        launch_compactVoxels(threads, d_activeBricks, d_brickActive, d_brickActiveScan, numBricks);
+
+        numSlots = numActiveBricks << (3 * brickSizeLog2);
+        if (numSlots > slotCapacity) {
+            // leave some room so a moving isovalue does not reallocate every frame
+            allocateSlotBuffers(numSlots + numSlots / 4);
+        }
     }
 
     // calculate number of vertices need per voxel
-    launch_classifyVoxel(grid, threads, 
-						d_voxelVerts, d_voxelOccupied, d_volume, 
-						gridSize, gridSizeShift, gridSizeMask, 
-                         numVoxels, voxelSize, isoValue);
+    launch_classifyVoxel(threads,
+						d_voxelVerts, d_voxelOccupied, d_voxelEdgeVerts, d_volume,
+						gridSize, d_activeBricks, brickSizeLog2,
+                         numSlots, isoValue, weld);
 
     // scan voxel occupied array
-    openclScan(d_voxelOccupiedScan, d_voxelOccupied, numVoxels);
+    openclScan(d_voxelOccupiedScan, d_voxelOccupied, numSlots);
 
     // read back values to calculate total number of non-empty voxels
-    // since we are using an exclusive scan, the total is the last value of
-    // the scan result plus the last value in the input array
-    {
-        uint lastElement, lastScanElement;
-
-        clEnqueueReadBuffer(cqCommandQueue, d_voxelOccupied,CL_TRUE, (numVoxels-1) * sizeof(uint), sizeof(uint), &lastElement, 0, 0, 0);
-        clEnqueueReadBuffer(cqCommandQueue, d_voxelOccupiedScan,CL_TRUE, (numVoxels-1) * sizeof(uint), sizeof(uint), &lastScanElement, 0, 0, 0);
-
-        activeVoxels = lastElement + lastScanElement;
-    }
+    activeVoxels = scanTotal(d_voxelOccupied, d_voxelOccupiedScan, numSlots);
 
     if (activeVoxels==0) {
         // return if there are no full voxels
         totalVerts = 0;
+        totalUniqueVerts = 0;
         return;
     }
 
     //printf("activeVoxels = %d\n", activeVoxels);
 
     // compact voxel index array
-    launch_compactVoxels(grid, threads, d_compVoxelArray, d_voxelOccupied, d_voxelOccupiedScan, numVoxels);
+    launch_compactVoxels(threads, d_compVoxelArray, d_voxelOccupied, d_voxelOccupiedScan, numSlots);
 
 
     // scan voxel vertex count array
-    openclScan(d_voxelVertsScan, d_voxelVerts, numVoxels);
+    openclScan(d_voxelVertsScan, d_voxelVerts, numSlots);
 
     // readback total number of vertices
-    {
-        uint lastElement, lastScanElement;
-        clEnqueueReadBuffer(cqCommandQueue, d_voxelVerts,CL_TRUE, (numVoxels-1) * sizeof(uint), sizeof(uint), &lastElement, 0, 0, 0);
-        clEnqueueReadBuffer(cqCommandQueue, d_voxelVertsScan,CL_TRUE, (numVoxels-1) * sizeof(uint), sizeof(uint), &lastScanElement, 0, 0, 0);
+    totalVerts = scanTotal(d_voxelVerts, d_voxelVertsScan, numSlots);
 
-        totalVerts = lastElement + lastScanElement;
+    // welded mesh: number the vertices of the crossed edges each cell owns
+    if (weld) {
+        openclScan(d_voxelEdgeVertsScan, d_voxelEdgeVerts, numSlots);
+        totalUniqueVerts = scanTotal(d_voxelEdgeVerts, d_voxelEdgeVertsScan, numSlots);
     }
 
     //printf("totalVerts = %d\n", totalVerts);
 
+    // size the output from the counts above
+    if (weld) {
+        allocateOutputBuffers(totalUniqueVerts, totalVerts);
+    } else {
+        allocateOutputBuffers(totalVerts, 0);
+    }
+
+    cl_mem interopBuffers[] = {d_pos, d_normal, d_indices};
+    cl_uint numInteropBuffers = weld ? 3 : 2;
 
-    cl_mem interopBuffers[] = {d_pos, d_normal};
-    
     // generate triangles, writing to vertex buffers
 	if( g_glInterop ) {
 		// Acquire PBO for OpenCL writing
 		glFlush();
-		ciErrNum = clEnqueueAcquireGLObjects(cqCommandQueue, 2, interopBuffers, 0, 0, 0);
+		ciErrNum = clEnqueueAcquireGLObjects(cqCommandQueue, numInteropBuffers, interopBuffers, 0, 0, 0);
         oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     }
-    
-    dim3 grid2((int) ceil(activeVoxels / (float) NTHREADS), 1, 1);
 
-    while(grid2.x > 65535) {
-        grid2.x/=2;
-        grid2.y*=2;
+    if (weld) {
+        launch_generateWeldedVertices(threads, d_pos, d_normal,
+                                      d_voxelEdgeVerts, d_voxelEdgeVertsScan, d_volume,
+                                      gridSize, d_activeBricks, brickSizeLog2, numSlots,
+                                      voxelSize, isoValue, vertexCapacity);
+        launch_generateTriangleIndices(threads, d_indices,
+                                       d_compVoxelArray, d_voxelVertsScan,
+                                       d_voxelEdgeVertsScan, d_brickActiveScan, d_volume,
+                                       gridSize, d_activeBricks, brickSizeLog2,
+                                       isoValue, activeVoxels, indexCapacity);
+    } else {
+        launch_generateTriangles2(NTHREADS, d_pos, d_normal,
+                                                d_compVoxelArray,
+                                                d_voxelVertsScan, d_volume,
+                                                gridSize, d_activeBricks, brickSizeLog2,
+                                                voxelSize, isoValue, activeVoxels,
+                                  vertexCapacity);
     }
-    launch_generateTriangles2(grid2, NTHREADS, d_pos, d_normal, 
-                                            d_compVoxelArray, 
-                                            d_voxelVertsScan, d_volume, 
-                                            gridSize, gridSizeShift, gridSizeMask, 
-                                            voxelSize, isoValue, activeVoxels, 
-                              maxVerts);
 
 	if( g_glInterop ) {
-		// Transfer ownership of buffer back from CL to GL    
-		ciErrNum = clEnqueueReleaseGLObjects(cqCommandQueue, 2, interopBuffers, 0, 0, 0);
+		// Transfer ownership of buffer back from CL to GL
+		ciErrNum = clEnqueueReleaseGLObjects(cqCommandQueue, numInteropBuffers, interopBuffers, 0, 0, 0);
 		oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 		clFinish( cqCommandQueue );
-	} 
+	}
 
 }
 
@@ -1005,6 +1278,66 @@ deleteVBO(GLuint* vbo, cl_mem vbo_cl)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//! (Re)create a device buffer, releasing the old one
+////////////////////////////////////////////////////////////////////////////////
+void
+createDeviceBuffer(cl_mem &buffer, size_t size)
+{
+    if( buffer ) clReleaseMemObject(buffer);
+
+    buffer = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, size, 0, &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Allocate the per cell arrays for numSlots classified cells
+////////////////////////////////////////////////////////////////////////////////
+void
+allocateSlotBuffers(uint numSlots)
+{
+    size_t memSize = sizeof(uint) * numSlots;
+    createDeviceBuffer(d_voxelVerts, memSize);
+    createDeviceBuffer(d_voxelVertsScan, memSize);
+    createDeviceBuffer(d_voxelOccupied, memSize);
+    createDeviceBuffer(d_voxelOccupiedScan, memSize);
+    createDeviceBuffer(d_compVoxelArray, memSize);
+    if (weld) {
+        createDeviceBuffer(d_voxelEdgeVerts, memSize);
+        createDeviceBuffer(d_voxelEdgeVertsScan, memSize);
+    }
+    slotCapacity = numSlots;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Grow the output to hold exactly numVertices vertices and numIndices
+//! indices, shared with GL when rendering
+////////////////////////////////////////////////////////////////////////////////
+void
+allocateOutputBuffer(GLuint* vbo, cl_mem &buffer, size_t size)
+{
+    if( g_glInterop ) {
+        deleteVBO(vbo, buffer);
+        createVBO(vbo, (unsigned int)size, buffer);
+    } else {
+        createDeviceBuffer(buffer, size);
+    }
+}
+
+void
+allocateOutputBuffers(uint numVertices, uint numIndices)
+{
+    if (numVertices > vertexCapacity) {
+        allocateOutputBuffer(&posVbo, d_pos, numVertices*sizeof(float)*4);
+        allocateOutputBuffer(&normalVbo, d_normal, numVertices*sizeof(float)*4);
+        vertexCapacity = numVertices;
+    }
+    if (numIndices > indexCapacity) {
+        allocateOutputBuffer(&indexVbo, d_indices, numIndices*sizeof(uint));
+        indexCapacity = numIndices;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Render isosurface geometry from the vertex buffers
 ////////////////////////////////////////////////////////////////////////////////
@@ -1019,7 +1352,13 @@ void renderIsosurface()
     glEnableClientState(GL_NORMAL_ARRAY);
 
     glColor3f(1.0, 0.0, 0.0);
-    glDrawArrays(GL_TRIANGLES, 0, totalVerts);
+    if (weld) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVbo);
+        glDrawElements(GL_TRIANGLES, totalVerts, GL_UNSIGNED_INT, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, totalVerts);
+    }
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
 
@@ -1195,10 +1534,6 @@ void dumpBuffer(cl_mem d_buffer, T *h_buffer, int nelements) {
 //*****************************************************************************
 void TestNoGL()
 {
-    d_normal = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY,  maxVerts*sizeof(float)*4, NULL, &ciErrNum);
-    d_pos = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY,  maxVerts*sizeof(float)*4, NULL, &ciErrNum);
-        
-    
     // Warmup
     computeIsosurface();
     clFinish(cqCommandQueue);
@@ -1216,5 +1551,150 @@ void TestNoGL()
     // Get elapsed time and throughput, then log to sample and master logs
     double dAvgTime = shrDeltaT(0)/nIter;
     shrLogEx(LOGBOTH | MASTER, 0, "oclMarchingCubes, Throughput = %.4f MVoxels/s, Time = %.5f s, Size = %u Voxels, NumDevsUsed = %u, Workgroup = %u\n", 
-           (1.0e-6 * numVoxels)/dAvgTime, dAvgTime, numVoxels, 1, NTHREADS); 
+           (1.0e-6 * numVoxels)/dAvgTime, dAvgTime, numVoxels, 1, NTHREADS);
+
+    shrLog("active voxels: %u, triangle vertices: %u\n", activeVoxels, totalVerts);
+    if (brickSizeLog2 > 0) {
+        shrLog("active bricks: %u / %u, cells classified: %u / %u\n",
+               numActiveBricks, numBricks, numSlots, numVoxels);
+    }
+    if (weld) {
+        shrLog("welded vertices: %u (%.1f triangle corners per vertex)\n",
+               totalUniqueVerts, totalUniqueVerts ? (double)totalVerts / totalUniqueVerts : 0.0);
+    }
+    shrLog("output buffers: %.2f MB\n",
+           (vertexCapacity * 2 * 4 * sizeof(float) + indexCapacity * sizeof(uint)) / (1024.0 * 1024.0));
+}
+
+// Stream a raw volume through the pipeline slab by slab, writing the mesh
+// as it is produced; device memory is bounded by the slab size
+//*****************************************************************************
+void StreamIsosurface(int argc, char** argv, const char* meshFilename)
+{
+    parseGridOptions(argc, argv);
+
+    // slabs are meshed as triangle soup on the dense path
+    if (brickSizeLog2 > 0 || weld) {
+        shrLog("streaming ignores --brick and --weld\n");
+        brickSizeLog2 = 0;
+        weld = false;
+    }
+
+    cl_uint volumeSize[3] = {gridSize[0], gridSize[1], gridSize[2]};
+    size_t sliceSize = (size_t)volumeSize[0] * volumeSize[1];
+
+    // default slab: about 8M cells, whatever the slice size
+    int n;
+    uint slabCells = MAX((uint)((8u << 20) / sliceSize), 1u);
+    if (shrGetCmdLineArgumenti(argc, (const char**)argv, "slab", &n)) {
+        slabCells = MAX(n, 1);
+    }
+    slabCells = MIN(slabCells, volumeSize[2]);
+
+    // the slab image is slabCells + 1 slices deep
+    size_t maxDepth = 0;
+    clGetDeviceInfo(cdDevices[uiDeviceUsed], CL_DEVICE_IMAGE3D_MAX_DEPTH, sizeof(maxDepth), &maxDepth, NULL);
+    if (maxDepth > 1) {
+        slabCells = MIN(slabCells, (uint)(maxDepth - 1));
+    }
+
+    // streamed volumes usually live outside the sample's data directory
+    char* path = shrFindFilePath(volumeFilename, argv[0]);
+    const char* volumePath = path ? path : volumeFilename;
+
+    MappedVolume volume;
+    if (!MapVolume(volumePath, sliceSize * volumeSize[2], volume)) {
+        shrLog("Error mapping '%s', expected %u x %u x %u bytes\n", volumePath, volumeSize[0], volumeSize[1], volumeSize[2]);
+        Cleanup(EXIT_FAILURE);
+    }
+
+    FILE* mesh = OpenMeshFile(meshFilename);
+    if (!mesh) {
+        shrLog("Error creating mesh file '%s'\n", meshFilename);
+        UnmapVolume(volume);
+        Cleanup(EXIT_FAILURE);
+    }
+
+    shrLog("streaming %u slabs of %u layers to '%s'\n",
+           (volumeSize[2] + slabCells - 1) / slabCells, slabCells, meshFilename);
+
+    allocateTextures(&d_triTable, &d_numVertsTable);
+
+    // the slab image holds slabCells layers plus the overlap slice
+    cl_image_format volumeFormat;
+    volumeFormat.image_channel_order = CL_R;
+    volumeFormat.image_channel_data_type = CL_UNORM_INT8;
+    d_volume = clCreateImage3D(cxGPUContext, CL_MEM_READ_ONLY, &volumeFormat,
+                               volumeSize[0], volumeSize[1], slabCells + 1, 0, 0, NULL, &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    allocateSlotBuffers((uint)(sliceSize * slabCells));
+
+    float* h_pos = NULL;
+    float* h_normal = NULL;
+    uint hostCapacity = 0;
+    unsigned long long totalTriangles = 0;
+    bool ok = true;
+
+    shrDeltaT(0);
+    for (uint z0 = 0; ok && z0 < volumeSize[2]; z0 += slabCells) {
+        uint cells = MIN(slabCells, volumeSize[2] - z0);
+        uint samples = MIN(cells + 1, volumeSize[2] - z0);
+
+        // upload sample slices z0 .. z0 + cells; at the end of the volume the
+        // last slice is repeated, as clamp to edge addressing would return
+        size_t origin[3] = {0, 0, 0};
+        size_t region[3] = {volumeSize[0], volumeSize[1], samples};
+        ciErrNum = clEnqueueWriteImage(cqCommandQueue, d_volume, CL_FALSE, origin, region, volumeSize[0], sliceSize,
+                                       volume.data + z0 * sliceSize, 0, 0, 0);
+        if (samples == cells) {
+            origin[2] = cells;
+            region[2] = 1;
+            ciErrNum |= clEnqueueWriteImage(cqCommandQueue, d_volume, CL_FALSE, origin, region, volumeSize[0], sliceSize,
+                                            volume.data + (volumeSize[2] - 1) * sliceSize, 0, 0, 0);
+        }
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+        // run the slab as a grid of its own, positions are shifted back below
+        gridSize[2] = cells + 1;
+        numSlots = (uint)(sliceSize * cells);
+        computeIsosurface();
+
+        if (totalVerts > 0) {
+            if (totalVerts > hostCapacity) {
+                free(h_pos);
+                free(h_normal);
+                h_pos = (float*)malloc(totalVerts * sizeof(float) * 4);
+                h_normal = (float*)malloc(totalVerts * sizeof(float) * 4);
+                oclCheckErrorEX(h_pos != NULL && h_normal != NULL, shrTRUE, pCleanup);
+                hostCapacity = totalVerts;
+            }
+            ciErrNum  = clEnqueueReadBuffer(cqCommandQueue, d_pos, CL_FALSE, 0, totalVerts * sizeof(float) * 4, h_pos, 0, 0, 0);
+            ciErrNum |= clEnqueueReadBuffer(cqCommandQueue, d_normal, CL_TRUE, 0, totalVerts * sizeof(float) * 4, h_normal, 0, 0, 0);
+            oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+            ok = WriteMeshTriangles(mesh, h_pos, h_normal, totalVerts, z0 * voxelSize[2]);
+            totalTriangles += totalVerts / 3;
+        }
+    }
+    clFinish(cqCommandQueue);
+    double dTime = shrDeltaT(0);
+
+    ok = CloseMeshFile(mesh, totalTriangles) && ok;
+    UnmapVolume(volume);
+    free(h_pos);
+    free(h_normal);
+    gridSize[2] = volumeSize[2];
+
+    if (!ok) {
+        shrLog("Error writing mesh file '%s'\n", meshFilename);
+        Cleanup(EXIT_FAILURE);
+    }
+
+    double voxels = (double)sliceSize * volumeSize[2];
+    double deviceMB = (sliceSize * (slabCells + 1) + 5.0 * slotCapacity * sizeof(uint) +
+                       2.0 * vertexCapacity * 4 * sizeof(float)) / (1024.0 * 1024.0);
+    shrLog("%llu triangles, %.1f MB of device memory for slabs and output\n", totalTriangles, deviceMB);
+    shrLogEx(LOGBOTH | MASTER, 0, "oclMarchingCubes-stream, Throughput = %.4f MVoxels/s, Time = %.5f s, Size = %.0f Voxels, Slab = %u, NumDevsUsed = %u\n",
+           (1.0e-6 * voxels)/dTime, dTime, voxels, slabCells, 1);
 }
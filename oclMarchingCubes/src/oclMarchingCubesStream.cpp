@@ -0,0 +1,184 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifdef _WIN32
+#  define WINDOWS_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include "oclMarchingCubesStream.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Volume mapping
+////////////////////////////////////////////////////////////////////////////////
+#ifdef _WIN32
+bool MapVolume(const char *filename, size_t size, MappedVolume &volume)
+{
+    memset(&volume, 0, sizeof(volume));
+
+    HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || (unsigned long long)fileSize.QuadPart < size || size == 0) {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    void *data = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, size) : NULL;
+    if (!data) {
+        if (hMapping) CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    volume.data = (const unsigned char *)data;
+    volume.size = size;
+    volume.hFile = hFile;
+    volume.hMapping = hMapping;
+    return true;
+}
+
+void UnmapVolume(MappedVolume &volume)
+{
+    if (volume.data) UnmapViewOfFile(volume.data);
+    if (volume.hMapping) CloseHandle((HANDLE)volume.hMapping);
+    if (volume.hFile) CloseHandle((HANDLE)volume.hFile);
+    memset(&volume, 0, sizeof(volume));
+}
+#else
+bool MapVolume(const char *filename, size_t size, MappedVolume &volume)
+{
+    memset(&volume, 0, sizeof(volume));
+    volume.fd = -1;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < size || size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    // slabs are read once, front to back
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    volume.data = (const unsigned char *)data;
+    volume.size = size;
+    volume.fd = fd;
+    return true;
+}
+
+void UnmapVolume(MappedVolume &volume)
+{
+    if (volume.data) munmap((void *)volume.data, volume.size);
+    if (volume.fd >= 0) close(volume.fd);
+    memset(&volume, 0, sizeof(volume));
+    volume.fd = -1;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// STL output
+////////////////////////////////////////////////////////////////////////////////
+static const long STL_COUNT_OFFSET = 80;
+
+FILE *OpenMeshFile(const char *filename)
+{
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return NULL;
+    }
+
+    char header[80];
+    memset(header, 0, sizeof(header));
+    strncpy(header, "oclMarchingCubes isosurface", sizeof(header) - 1);
+    unsigned int count = 0;
+
+    if (fwrite(header, sizeof(header), 1, file) != 1 ||
+        fwrite(&count, sizeof(count), 1, file) != 1) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+bool WriteMeshTriangles(FILE *file, const float *pos, const float *norm, unsigned int numVerts, float zOffset)
+{
+    // 50 bytes per triangle, packed by hand since the record is not aligned
+    const unsigned int batch = 1024;
+    unsigned char record[batch * 50];
+
+    unsigned int numTriangles = numVerts / 3;
+    for (unsigned int t0 = 0; t0 < numTriangles; t0 += batch) {
+        unsigned int count = (numTriangles - t0 < batch) ? (numTriangles - t0) : batch;
+        unsigned char *dst = record;
+
+        for (unsigned int t = t0; t < t0 + count; t++) {
+            const float *n = norm + 12 * t;
+            float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float unit[3] = {0.0f, 0.0f, 0.0f};
+            if (len > 0.0f) {
+                unit[0] = n[0] / len;
+                unit[1] = n[1] / len;
+                unit[2] = n[2] / len;
+            }
+            memcpy(dst, unit, sizeof(unit));
+            dst += sizeof(unit);
+
+            for (int v = 0; v < 3; v++) {
+                const float *p = pos + 12 * t + 4 * v;
+                float xyz[3] = {p[0], p[1], p[2] + zOffset};
+                memcpy(dst, xyz, sizeof(xyz));
+                dst += sizeof(xyz);
+            }
+            memset(dst, 0, 2);
+            dst += 2;
+        }
+
+        if (fwrite(record, 50, count, file) != count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CloseMeshFile(FILE *file, unsigned long long numTriangles)
+{
+    unsigned int count = (unsigned int)numTriangles;
+    bool ok = (numTriangles <= 0xffffffffULL) &&
+              fseek(file, STL_COUNT_OFFSET, SEEK_SET) == 0 &&
+              fwrite(&count, sizeof(count), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
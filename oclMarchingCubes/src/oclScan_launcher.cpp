@@ -20,7 +20,8 @@ static cl_program
 
 //OpenCL scan kernel handles
 static cl_kernel
-    ckScanExclusiveLocal1, ckScanExclusiveLocal2, ckUniformUpdate;
+    ckScanExclusiveLocal1, ckScanExclusiveLocal2, ckUniformUpdate,
+    ckScanExclusiveBlocks, ckUniformUpdateAny;
 
 static cl_mem
     d_Buffer;
@@ -30,6 +31,13 @@ static cl_mem
 static const uint  WORKGROUP_SIZE = 256;
 static const char *compileOptions = "-D WORKGROUP_SIZE=256";
 
+//Block totals of each level of the arbitrary length scan, grown on demand;
+//four levels of 4 * WORKGROUP_SIZE cover any 32-bit length
+static const uint MAX_ANY_LEVELS = 4;
+static cl_mem d_AnyBuffer[MAX_ANY_LEVELS];
+static uint   anyBufferSize[MAX_ANY_LEVELS];
+static cl_context cxScanContext;
+
 extern "C" void initScan(cl_context cxGPUContext, cl_command_queue cqParamCommandQue, const char **argv){
     cl_int ciErrNum;
     size_t kernelLength;
@@ -60,6 +68,10 @@ extern "C" void initScan(cl_context cxGPUContext, cl_command_queue cqParamComman
         oclCheckError(ciErrNum, CL_SUCCESS);
         ckUniformUpdate = clCreateKernel(cpProgram, "uniformUpdate", &ciErrNum);
         oclCheckError(ciErrNum, CL_SUCCESS);
+        ckScanExclusiveBlocks = clCreateKernel(cpProgram, "scanExclusiveBlocks", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckUniformUpdateAny = clCreateKernel(cpProgram, "uniformUpdateAny", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
 
     shrLog( " ...checking minimum supported workgroup size\n");
         //Check for work group size
@@ -80,6 +92,7 @@ extern "C" void initScan(cl_context cxGPUContext, cl_command_queue cqParamComman
     shrLog(" ...allocating internal buffers\n");
         d_Buffer = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, (MAX_BATCH_ELEMENTS / (4 * WORKGROUP_SIZE)) * sizeof(uint), NULL, &ciErrNum);
         oclCheckError(ciErrNum, CL_SUCCESS);
+        cxScanContext = cxGPUContext;
 
     //Discard temp storage
     free(cScan);
@@ -88,6 +101,14 @@ extern "C" void initScan(cl_context cxGPUContext, cl_command_queue cqParamComman
 extern "C" void closeScan(void){
     cl_int ciErrNum;
     ciErrNum  = clReleaseMemObject(d_Buffer);
+    for(uint level = 0; level < MAX_ANY_LEVELS; level++)
+        if(d_AnyBuffer[level]){
+            ciErrNum |= clReleaseMemObject(d_AnyBuffer[level]);
+            d_AnyBuffer[level] = NULL;
+            anyBufferSize[level] = 0;
+        }
+    ciErrNum |= clReleaseKernel(ckUniformUpdateAny);
+    ciErrNum |= clReleaseKernel(ckScanExclusiveBlocks);
     ciErrNum |= clReleaseKernel(ckUniformUpdate);
     ciErrNum |= clReleaseKernel(ckScanExclusiveLocal2);
     ciErrNum |= clReleaseKernel(ckScanExclusiveLocal1);
@@ -270,3 +291,68 @@ extern "C" size_t scanExclusiveLarge(
         (batchSize * arrayLength) / (4 * WORKGROUP_SIZE)
     );
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// Arbitrary length scan launcher
+////////////////////////////////////////////////////////////////////////////////
+static size_t scanExclusiveAnyLevel(
+    cl_command_queue cqCommandQueue,
+    cl_mem d_Dst,
+    cl_mem d_Src,
+    uint arrayLength,
+    uint level
+){
+    cl_int ciErrNum;
+    size_t localWorkSize, globalWorkSize;
+    uint numBlocks = (arrayLength + 4 * WORKGROUP_SIZE - 1) / (4 * WORKGROUP_SIZE);
+
+    oclCheckError(level < MAX_ANY_LEVELS, shrTRUE);
+    if(numBlocks > anyBufferSize[level]){
+        if(d_AnyBuffer[level])
+            clReleaseMemObject(d_AnyBuffer[level]);
+        d_AnyBuffer[level] = clCreateBuffer(cxScanContext, CL_MEM_READ_WRITE, numBlocks * sizeof(uint), NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        anyBufferSize[level] = numBlocks;
+    }
+
+    ciErrNum  = clSetKernelArg(ckScanExclusiveBlocks, 0, sizeof(cl_mem), (void *)&d_Dst);
+    ciErrNum |= clSetKernelArg(ckScanExclusiveBlocks, 1, sizeof(cl_mem), (void *)&d_AnyBuffer[level]);
+    ciErrNum |= clSetKernelArg(ckScanExclusiveBlocks, 2, sizeof(cl_mem), (void *)&d_Src);
+    ciErrNum |= clSetKernelArg(ckScanExclusiveBlocks, 3, 2 * WORKGROUP_SIZE * sizeof(uint), NULL);
+    ciErrNum |= clSetKernelArg(ckScanExclusiveBlocks, 4, sizeof(uint), (void *)&arrayLength);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    localWorkSize = WORKGROUP_SIZE;
+    globalWorkSize = numBlocks * WORKGROUP_SIZE;
+
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, ckScanExclusiveBlocks, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    if(numBlocks > 1){
+        //Scan the block totals in place, one level up
+        scanExclusiveAnyLevel(cqCommandQueue, d_AnyBuffer[level], d_AnyBuffer[level], numBlocks, level + 1);
+
+        ciErrNum  = clSetKernelArg(ckUniformUpdateAny, 0, sizeof(cl_mem), (void *)&d_Dst);
+        ciErrNum |= clSetKernelArg(ckUniformUpdateAny, 1, sizeof(cl_mem), (void *)&d_AnyBuffer[level]);
+        ciErrNum |= clSetKernelArg(ckUniformUpdateAny, 2, sizeof(uint), (void *)&arrayLength);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+
+        globalWorkSize = iSnapUp(arrayLength, WORKGROUP_SIZE);
+
+        ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, ckUniformUpdateAny, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+
+    return localWorkSize;
+}
+
+extern "C" size_t scanExclusiveAny(
+    cl_command_queue cqCommandQueue,
+    cl_mem d_Dst,
+    cl_mem d_Src,
+    uint arrayLength
+){
+    oclCheckError(arrayLength > 0, shrTRUE);
+
+    return scanExclusiveAnyLevel(cqCommandQueue, d_Dst, d_Src, arrayLength, 0);
+}
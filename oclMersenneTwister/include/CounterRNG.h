@@ -0,0 +1,56 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+// Engines and output distributions of CounterRNG.cl, keep in sync
+#define RNG_PHILOX      0
+#define RNG_THREEFRY    1
+
+#define RNG_UNIFORM     0
+#define RNG_NORMAL      1
+#define RNG_EXPONENTIAL 2
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+#define THREEFRY_PARITY 0x1BD11BDAU
+
+// histogram bins of the chi-square spot-check
+#define RNG_CHI2_BINS 256
+
+// Moments and goodness of fit of a sample, see RNGSpotCheck
+typedef struct{
+  double mean;
+  double var;
+  double chi2;        // against the expected distribution, RNG_CHI2_BINS - 1 dof
+  double lag1;        // serial correlation of neighbouring numbers
+} rng_stats;
+
+// One block of 4 x 32 bits in place, the published ten and twenty rounds
+extern "C" void Philox4x32Ref(unsigned int ctr[4], const unsigned int key[2]);
+extern "C" void Threefry4x32Ref(unsigned int ctr[4], const unsigned int key[4]);
+
+// Known-answer vectors of Random123 for both engines, returns 1 when all match
+extern "C" int CounterRNGSelfTest();
+
+// Host version of the PhiloxRNG / ThreefryRNG kernels: n4 blocks of 4 floats
+extern "C" void CounterRNGRef(float *h_Rand, int n4, int engine, const unsigned int key[4],
+                              unsigned long long offset, unsigned long long stream,
+                              int distribution, float lambda);
+
+// Statistics of n numbers drawn from the given distribution
+extern "C" void RNGSpotCheck(const float *h_Rand, size_t n, int distribution, float lambda, rng_stats *stats);
+
+#endif
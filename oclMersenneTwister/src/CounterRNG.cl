@@ -0,0 +1,159 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Counter-based random number generators, Philox4x32-10 and Threefry4x32-20
+// (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC11).
+//
+// Every float4 of output is a pure function of (key, stream, index): element i
+// is generated from the counter {offset + i, stream}. There is no state, so
+// any work-item count gives the same sequence, skip-ahead is an addition to
+// offset and the 64-bit stream word gives 2^64 independent streams per key.
+////////////////////////////////////////////////////////////////////////////////
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+#define THREEFRY_PARITY 0x1BD11BDAU
+
+#define RNG_UNIFORM     0
+#define RNG_NORMAL      1
+#define RNG_EXPONENTIAL 2
+
+#define PI 3.14159265358979f
+
+uint4 philox4x32_10(uint4 ctr, uint2 key)
+{
+    for (int r = 0; r < 10; r++)
+    {
+        if (r > 0)
+        {
+            key.x += PHILOX_W0;
+            key.y += PHILOX_W1;
+        }
+        uint lo0 = PHILOX_M0 * ctr.x;
+        uint hi0 = mul_hi(PHILOX_M0, ctr.x);
+        uint lo1 = PHILOX_M1 * ctr.z;
+        uint hi1 = mul_hi(PHILOX_M1, ctr.z);
+        ctr = (uint4)(hi1 ^ ctr.y ^ key.x, lo1, hi0 ^ ctr.w ^ key.y, lo0);
+    }
+    return ctr;
+}
+
+// one Threefry round: mix (a, b) and (c, d), rounds alternate the pairing
+#define THREEFRY_MIX(a, b, c, d, ra, rb)             \
+    a += b; b = rotate(b, (uint)(ra)); b ^= a;       \
+    c += d; d = rotate(d, (uint)(rb)); d ^= c;
+
+// four rounds with the first or the second half of the rotation table
+#define THREEFRY_ROUNDS_A                            \
+    THREEFRY_MIX(x.x, x.y, x.z, x.w, 10, 26)         \
+    THREEFRY_MIX(x.x, x.w, x.z, x.y, 11, 21)         \
+    THREEFRY_MIX(x.x, x.y, x.z, x.w, 13, 27)         \
+    THREEFRY_MIX(x.x, x.w, x.z, x.y, 23, 5)
+
+#define THREEFRY_ROUNDS_B                            \
+    THREEFRY_MIX(x.x, x.y, x.z, x.w, 6, 20)          \
+    THREEFRY_MIX(x.x, x.w, x.z, x.y, 17, 11)         \
+    THREEFRY_MIX(x.x, x.y, x.z, x.w, 25, 10)         \
+    THREEFRY_MIX(x.x, x.w, x.z, x.y, 18, 20)
+
+#define THREEFRY_INJECT(s)                           \
+    x.x += ks[(s) % 5];                              \
+    x.y += ks[((s) + 1) % 5];                        \
+    x.z += ks[((s) + 2) % 5];                        \
+    x.w += ks[((s) + 3) % 5] + (uint)(s);
+
+uint4 threefry4x32_20(uint4 ctr, uint4 key)
+{
+    uint ks[5];
+    ks[0] = key.x;
+    ks[1] = key.y;
+    ks[2] = key.z;
+    ks[3] = key.w;
+    ks[4] = THREEFRY_PARITY ^ key.x ^ key.y ^ key.z ^ key.w;
+
+    uint4 x = ctr + key;
+    for (int s = 1; s < 5; s += 2)
+    {
+        THREEFRY_ROUNDS_A
+        THREEFRY_INJECT(s)
+        THREEFRY_ROUNDS_B
+        THREEFRY_INJECT(s + 1)
+    }
+    THREEFRY_ROUNDS_A
+    THREEFRY_INJECT(5)
+    return x;
+}
+
+// 32 random bits to (0, 1], same mapping as the Mersenne Twister kernel; the
+// scale is an exact power of two so the host reference matches bit for bit
+float4 toUniform(uint4 x)
+{
+    return (convert_float4(x) + 1.0f) * 2.3283064365386963e-10f;
+}
+
+float4 distribute(uint4 bits, int distribution, float lambda)
+{
+    float4 u = toUniform(bits);
+    if (distribution == RNG_NORMAL)
+    {
+        // Box-Muller on (u.x, u.y) and (u.z, u.w), fused into the generator
+        float r0 = sqrt(-2.0f * log(u.x));
+        float r1 = sqrt(-2.0f * log(u.z));
+        float c0, c1;
+        float s0 = sincos(2.0f * PI * u.y, &c0);
+        float s1 = sincos(2.0f * PI * u.w, &c1);
+        return (float4)(r0 * c0, r0 * s0, r1 * c1, r1 * s1);
+    }
+    if (distribution == RNG_EXPONENTIAL)
+    {
+        return -log(u) / lambda;
+    }
+    return u;
+}
+
+// counter of element i: low words offset + i, high words the stream
+uint4 counterOf(ulong offset, ulong stream, int i)
+{
+    ulong index = offset + (ulong)i;
+    return (uint4)((uint)index, (uint)(index >> 32), (uint)stream, (uint)(stream >> 32));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Fill d_Rand[0 .. n4) with float4s of the given distribution, grid-stride so
+// the launch size only affects speed. Element i depends on offset + i alone.
+////////////////////////////////////////////////////////////////////////////////
+__kernel void PhiloxRNG(__global float4 *d_Rand,
+                        uint4 key,
+                        ulong offset,
+                        ulong stream,
+                        int n4,
+                        int distribution,
+                        float lambda)
+{
+    for (int i = get_global_id(0); i < n4; i += get_global_size(0))
+        d_Rand[i] = distribute(philox4x32_10(counterOf(offset, stream, i), key.xy), distribution, lambda);
+}
+
+__kernel void ThreefryRNG(__global float4 *d_Rand,
+                          uint4 key,
+                          ulong offset,
+                          ulong stream,
+                          int n4,
+                          int distribution,
+                          float lambda)
+{
+    for (int i = get_global_id(0); i < n4; i += get_global_size(0))
+        d_Rand[i] = distribute(threefry4x32_20(counterOf(offset, stream, i), key), distribution, lambda);
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include <oclUtils.h>
+#include <math.h>
+#include "MersenneTwister.h"
+#include "CounterRNG.h"
+
+static unsigned int mulhi32(unsigned int a, unsigned int b)
+{
+    return (unsigned int)(((unsigned long long)a * b) >> 32);
+}
+
+static unsigned int rotl32(unsigned int x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+extern "C" void Philox4x32Ref(unsigned int ctr[4], const unsigned int key[2])
+{
+    unsigned int k0 = key[0], k1 = key[1];
+    for (int r = 0; r < 10; r++)
+    {
+        if (r > 0)
+        {
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        unsigned int lo0 = PHILOX_M0 * ctr[0];
+        unsigned int hi0 = mulhi32(PHILOX_M0, ctr[0]);
+        unsigned int lo1 = PHILOX_M1 * ctr[2];
+        unsigned int hi1 = mulhi32(PHILOX_M1, ctr[2]);
+        unsigned int x1 = ctr[1], x3 = ctr[3];
+        ctr[0] = hi1 ^ x1 ^ k0;
+        ctr[1] = lo1;
+        ctr[2] = hi0 ^ x3 ^ k1;
+        ctr[3] = lo0;
+    }
+}
+
+extern "C" void Threefry4x32Ref(unsigned int ctr[4], const unsigned int key[4])
+{
+    static const int R[8][2] = {{10, 26}, {11, 21}, {13, 27}, {23, 5},
+                                {6, 20}, {17, 11}, {25, 10}, {18, 20}};
+    unsigned int ks[5];
+    ks[4] = THREEFRY_PARITY;
+    for (int i = 0; i < 4; i++)
+    {
+        ks[i] = key[i];
+        ks[4] ^= key[i];
+        ctr[i] += key[i];
+    }
+
+    for (int r = 0; r < 20; r++)
+    {
+        // even rounds mix (0,1) (2,3), odd rounds (0,3) (2,1)
+        int b = (r & 1) ? 3 : 1;
+        int d = (r & 1) ? 1 : 3;
+        ctr[0] += ctr[b]; ctr[b] = rotl32(ctr[b], R[r % 8][0]); ctr[b] ^= ctr[0];
+        ctr[2] += ctr[d]; ctr[d] = rotl32(ctr[d], R[r % 8][1]); ctr[d] ^= ctr[2];
+        if (r % 4 == 3)
+        {
+            unsigned int s = (r + 1) / 4;
+            for (int i = 0; i < 4; i++)
+                ctr[i] += ks[(s + i) % 5];
+            ctr[3] += s;
+        }
+    }
+}
+
+extern "C" int CounterRNGSelfTest()
+{
+    // zero, all ones and digits of pi, from the Random123 kat_vectors
+    static const unsigned int ctr[3][4] = {{0, 0, 0, 0},
+                                           {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                                           {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+    static const unsigned int key[3][4] = {{0, 0, 0, 0},
+                                           {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                                           {0xa4093822, 0x299f31d0, 0x082efa98, 0xec4e6c89}};
+    static const unsigned int philox[3][4] = {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+                                              {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+                                              {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+    static const unsigned int threefry[3][4] = {{0x9c6ca96a, 0xe17eae66, 0xfc10ecd4, 0x5256a7d8},
+                                                {0x2a881696, 0x57012287, 0xf6c7446e, 0xa16a6732},
+                                                {0x59cd1dbb, 0xb8879579, 0x86b5d00c, 0xac8b6d84}};
+    int ok = 1;
+    for (int t = 0; t < 3; t++)
+    {
+        unsigned int x[4], y[4];
+        for (int i = 0; i < 4; i++)
+            x[i] = y[i] = ctr[t][i];
+        Philox4x32Ref(x, key[t]);
+        Threefry4x32Ref(y, key[t]);
+        for (int i = 0; i < 4; i++)
+            ok &= (x[i] == philox[t][i]) && (y[i] == threefry[t][i]);
+    }
+    return ok;
+}
+
+extern "C" void CounterRNGRef(float *h_Rand, int n4, int engine, const unsigned int key[4],
+                              unsigned long long offset, unsigned long long stream,
+                              int distribution, float lambda)
+{
+    for (int i = 0; i < n4; i++)
+    {
+        unsigned long long index = offset + i;
+        unsigned int x[4] = {(unsigned int)index, (unsigned int)(index >> 32),
+                             (unsigned int)stream, (unsigned int)(stream >> 32)};
+        if (engine == RNG_THREEFRY)
+            Threefry4x32Ref(x, key);
+        else
+            Philox4x32Ref(x, key);
+
+        float u[4];
+        for (int j = 0; j < 4; j++)
+            u[j] = ((float)x[j] + 1.0f) * 2.3283064365386963e-10f;
+
+        float *out = h_Rand + 4 * i;
+        if (distribution == RNG_NORMAL)
+        {
+            for (int j = 0; j < 4; j += 2)
+            {
+                float   r = sqrtf(-2.0f * logf(u[j]));
+                float phi = 2.0f * PI * u[j + 1];
+                out[j + 0] = r * cosf(phi);
+                out[j + 1] = r * sinf(phi);
+            }
+        }
+        else if (distribution == RNG_EXPONENTIAL)
+        {
+            for (int j = 0; j < 4; j++)
+                out[j] = -logf(u[j]) / lambda;
+        }
+        else
+        {
+            for (int j = 0; j < 4; j++)
+                out[j] = u[j];
+        }
+    }
+}
+
+extern "C" void RNGSpotCheck(const float *h_Rand, size_t n, int distribution, float lambda, rng_stats *stats)
+{
+    double sum = 0, sum2 = 0, lag = 0;
+    double hist[RNG_CHI2_BINS] = {0};
+    for (size_t i = 0; i < n; i++)
+    {
+        double x = h_Rand[i];
+        sum  += x;
+        sum2 += x * x;
+        if (i > 0) lag += x * h_Rand[i - 1];
+
+        // probability integral transform, uniform on [0, 1] for a good generator
+        double p;
+        if (distribution == RNG_NORMAL)
+            p = 0.5 * erfc(-x / sqrt(2.0));
+        else if (distribution == RNG_EXPONENTIAL)
+            p = 1.0 - exp(-lambda * x);
+        else
+            p = x;
+        int bin = (int)(p * RNG_CHI2_BINS);
+        hist[CLAMP(bin, 0, RNG_CHI2_BINS - 1)] += 1.0;
+    }
+
+    stats->mean = sum / n;
+    stats->var  = sum2 / n - stats->mean * stats->mean;
+    stats->lag1 = (lag / (n - 1) - stats->mean * stats->mean) / stats->var;
+
+    double expected = (double)n / RNG_CHI2_BINS;
+    stats->chi2 = 0;
+    for (int b = 0; b < RNG_CHI2_BINS; b++)
+        stats->chi2 += (hist[b] - expected) * (hist[b] - expected) / expected;
+}
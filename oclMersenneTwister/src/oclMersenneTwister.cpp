@@ -18,6 +18,7 @@
 #include <oclUtils.h>
 #include <shrQATest.h>
 #include "MersenneTwister.h"
+#include "CounterRNG.h"
 
 // comment the below line if not doing Box-Muller transformation
 #define DO_BOXMULLER
@@ -63,6 +64,203 @@ void loadMTGPU(const char *fname,
         h_MT[i].seed = seed;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Spot-check of one sample against the moments of its distribution: mean and
+// variance within 6 sigma of their sampling error, chi-square and lag-1
+// serial correlation within 6 sigma of their expectation
+///////////////////////////////////////////////////////////////////////////////
+bool checkStats(const char *name, const char *dist, const float *h_Rand, size_t n, int distribution, float lambda)
+{
+    double mu = 0.5, sigma = sqrt(1.0 / 12.0), kurt = 1.8;      // uniform
+    if (distribution == RNG_NORMAL)
+    {
+        mu = 0.0; sigma = 1.0; kurt = 3.0;
+    }
+    else if (distribution == RNG_EXPONENTIAL)
+    {
+        mu = sigma = 1.0 / lambda; kurt = 9.0;
+    }
+
+    rng_stats stats;
+    RNGSpotCheck(h_Rand, n, distribution, lambda, &stats);
+    double dof = RNG_CHI2_BINS - 1;
+    bool ok = fabs(stats.mean - mu) < 6.0 * sigma / sqrt((double)n) &&
+              fabs(stats.var / (sigma * sigma) - 1.0) < 6.0 * sqrt((kurt - 1.0) / n) &&
+              stats.chi2 < dof + 6.0 * sqrt(2.0 * dof) &&
+              fabs(stats.lag1) < 6.0 / sqrt((double)n);
+    shrLog("  %-9s %-11s mean %+.5f (%+.5f)  var %.5f (%.5f)  chi2 %6.1f (%d dof)  lag1 %+.5f  %s\n",
+           name, dist, stats.mean, mu, stats.var, sigma * sigma, stats.chi2, (int)dof, stats.lag1, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Counter-based generators (CounterRNG.cl): every number is a function of
+// (key, stream, index), so there is no parameter table, no per work-item state
+// and skipping ahead costs nothing. Checks the GPU output against the host
+// reference and a skip-ahead launch against the full sequence, measures GB/s
+// of every fused distribution and compares the statistics with the output of
+// the Mersenne Twister gold generator.
+///////////////////////////////////////////////////////////////////////////////
+bool runCounterRNG(int argc, const char **argv, cl_context cxGPUContext, cl_command_queue cqCommandQueue,
+                   cl_device_id cdDevice, int nPerRng, unsigned int seed)
+{
+    static const char *distName[3] = {"uniform", "normal", "exponential"};
+    const int numIterations = 20;
+    const float lambda = 1.0f;
+    cl_int ciErr1 = CL_SUCCESS;
+
+    int engine = RNG_PHILOX;
+    char *cEngine = NULL;
+    if (shrGetCmdLineArgumentstr(argc, argv, "engine", &cEngine) && strcmp(cEngine, "threefry") == 0)
+    {
+        engine = RNG_THREEFRY;
+    }
+    const char *engineName = (engine == RNG_THREEFRY) ? "Threefry" : "Philox";
+
+    // same amount of numbers as the Mersenne Twister run unless given, multiple of 4
+    unsigned int nRand = MT_RNG_COUNT * nPerRng;
+    shrGetCmdLineArgumentu(argc, argv, "rng-size", &nRand);
+    int n4 = (int)(MAX(nRand, 4u) / 4);
+    nRand = 4 * n4;
+
+    shrLog("Counter-based RNG: %s, %u numbers...\n", (engine == RNG_THREEFRY) ? "Threefry4x32-20" : "Philox4x32-10", nRand);
+    if (!CounterRNGSelfTest())
+    {
+        shrLog("  host reference fails the known-answer test\n");
+        return false;
+    }
+
+    size_t szKernelLength;
+    char *cSourcePath = shrFindFilePath("CounterRNG.cl", argv[0]);
+    shrCheckError(cSourcePath != NULL, shrTRUE);
+    char *cCounterRNG = oclLoadProgSource(cSourcePath, "// My comment\n", &szKernelLength);
+    oclCheckError(cCounterRNG != NULL, shrTRUE);
+    cl_program cpProgram = clCreateProgramWithSource(cxGPUContext, 1, (const char **)&cCounterRNG, &szKernelLength, &ciErr1);
+    ciErr1 |= clBuildProgram(cpProgram, 1, &cdDevice, NULL, NULL, NULL);
+    if (ciErr1 != CL_SUCCESS)
+    {
+        // write out standard error, Build Log and PTX, then cleanup and exit
+        shrLogEx(LOGBOTH | ERRORMSG, (double)ciErr1, STDERROR);
+        oclLogBuildInfo(cpProgram, cdDevice);
+        oclLogPtx(cpProgram, cdDevice, "CounterRNG.ptx");
+        oclCheckError(ciErr1, CL_SUCCESS); 
+    }
+    cl_kernel ckRNG = clCreateKernel(cpProgram, (engine == RNG_THREEFRY) ? "ThreefryRNG" : "PhiloxRNG", &ciErr1);
+    oclCheckError(ciErr1, CL_SUCCESS);
+
+    // grid-stride kernel: enough work-groups to fill the device, not one item per float4
+    cl_uint nComputeUnits = 1;
+    clGetDeviceInfo(cdDevice, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &nComputeUnits, NULL);
+    size_t localWorkSize[1] = {128};
+    size_t globalWorkSize[1] = {shrRoundUp((int)localWorkSize[0], MIN(n4, (int)nComputeUnits * 2048))};
+
+    cl_mem d_Rand = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(cl_float) * nRand, NULL, &ciErr1);
+    oclCheckError(ciErr1, CL_SUCCESS);
+    float *h_RandGPU = (float *)malloc(sizeof(float) * nRand);
+    float *h_RandCPU = (float *)malloc(sizeof(float) * nRand);
+
+    cl_uint4 key;
+    key.s[0] = seed;
+    key.s[1] = key.s[2] = key.s[3] = 0;
+    cl_ulong stream = 0;
+
+    // generate nBlocks float4 blocks starting at counter offset
+    #define ENQUEUE_RNG(offset, nBlocks, distribution)                                       \
+    {                                                                                        \
+        cl_ulong ulOffset = (offset);                                                        \
+        cl_int iBlocks = (nBlocks), iDist = (distribution);                                  \
+        ciErr1 |= clSetKernelArg(ckRNG, 0, sizeof(cl_mem), (void*)&d_Rand);                  \
+        ciErr1 |= clSetKernelArg(ckRNG, 1, sizeof(cl_uint4), (void*)&key);                   \
+        ciErr1 |= clSetKernelArg(ckRNG, 2, sizeof(cl_ulong), (void*)&ulOffset);              \
+        ciErr1 |= clSetKernelArg(ckRNG, 3, sizeof(cl_ulong), (void*)&stream);                \
+        ciErr1 |= clSetKernelArg(ckRNG, 4, sizeof(cl_int), (void*)&iBlocks);                 \
+        ciErr1 |= clSetKernelArg(ckRNG, 5, sizeof(cl_int), (void*)&iDist);                   \
+        ciErr1 |= clSetKernelArg(ckRNG, 6, sizeof(cl_float), (void*)&lambda);                \
+        ciErr1 |= clEnqueueNDRangeKernel(cqCommandQueue, ckRNG, 1, NULL,                     \
+            globalWorkSize, localWorkSize, 0, NULL, NULL);                                   \
+        oclCheckError(ciErr1, CL_SUCCESS);                                                   \
+    }
+
+    // Mersenne Twister gold output of the same size for the statistical comparison
+    float *h_RandMT = (float *)malloc(sizeof(float) * MT_RNG_COUNT * nPerRng);
+    size_t nMT = MIN((size_t)nRand, (size_t)MT_RNG_COUNT * nPerRng);
+
+    bool bPass = true;
+    for (int dist = RNG_UNIFORM; dist <= RNG_EXPONENTIAL; dist++)
+    {
+        // warm up, then time the fused generator alone
+        ENQUEUE_RNG(0, n4, dist);
+        clFinish(cqCommandQueue);
+        shrDeltaT(1);
+        for (int i = 0; i < numIterations; i++)
+        {
+            ENQUEUE_RNG(0, n4, dist);
+        }
+        clFinish(cqCommandQueue);
+        double gpuTime = shrDeltaT(1) / (double)numIterations;
+        shrLog("  %-11s %.4f GB/s, %.4f GNumbers/s\n", distName[dist], 
+               sizeof(cl_float) * (double)nRand * 1.0E-9 / gpuTime, (double)nRand * 1.0E-9 / gpuTime);
+        shrLogEx(LOGBOTH | MASTER, 0, "oclMersenneTwister-%s-%s, Throughput = %.4f GB/s, Time = %.5f s, Size = %u Numbers, NumDevsUsed = %u, Workgroup = %u\n",
+                 (engine == RNG_THREEFRY) ? "threefry" : "philox", distName[dist], 
+                 sizeof(cl_float) * (double)nRand * 1.0E-9 / gpuTime, gpuTime, nRand, 1, localWorkSize[0]);
+
+        ciErr1 = clEnqueueReadBuffer(cqCommandQueue, d_Rand, CL_TRUE, 0, sizeof(cl_float) * nRand, h_RandGPU, 0, NULL, NULL);
+        oclCheckError(ciErr1, CL_SUCCESS);
+        CounterRNGRef(h_RandCPU, n4, engine, key.s, 0, stream, dist, lambda);
+
+        double sum_delta = 0;
+        double sum_ref   = 0;
+        for (unsigned int i = 0; i < nRand; i++)
+        {
+            sum_delta += fabs((double)h_RandCPU[i] - h_RandGPU[i]);
+            sum_ref   += fabs((double)h_RandCPU[i]);
+        }
+        double L1norm = sum_delta / sum_ref;
+        shrLog("  %-11s L1 norm vs host reference: %E\n", distName[dist], L1norm);
+        bPass &= (L1norm < 1e-6);
+
+        // statistics of the GPU output next to the gold generator where it has one
+        bPass &= checkStats(engineName, distName[dist], h_RandGPU, nRand, dist, lambda);
+        if (dist == RNG_UNIFORM)
+        {
+            RandomRef(h_RandMT, nPerRng, seed);
+            checkStats("MT (gold)", distName[dist], h_RandMT, nMT, dist, lambda);
+        }
+#ifdef DO_BOXMULLER
+        if (dist == RNG_NORMAL)
+        {
+            RandomRef(h_RandMT, nPerRng, seed);
+            BoxMullerRef(h_RandMT, nPerRng);
+            checkStats("MT (gold)", distName[dist], h_RandMT, nMT, dist, lambda);
+        }
+#endif
+
+        // skip-ahead: the second half on its own equals the tail of the full run
+        if (dist == RNG_UNIFORM)
+        {
+            int nSkip = n4 / 2;
+            ENQUEUE_RNG(nSkip, n4 - nSkip, dist);
+            ciErr1 = clEnqueueReadBuffer(cqCommandQueue, d_Rand, CL_TRUE, 0, sizeof(cl_float) * 4 * (n4 - nSkip), h_RandGPU, 0, NULL, NULL);
+            oclCheckError(ciErr1, CL_SUCCESS);
+            bool bSkip = memcmp(h_RandGPU, h_RandCPU + 4 * nSkip, sizeof(float) * 4 * (n4 - nSkip)) == 0;
+            shrLog("  skip-ahead by %d blocks: %s\n", nSkip, bSkip ? "matches" : "MISMATCH");
+            bPass &= bSkip;
+        }
+        shrLog("\n");
+    }
+    #undef ENQUEUE_RNG
+
+    free(h_RandMT);
+    free(h_RandGPU);
+    free(h_RandCPU);
+    free(cCounterRNG);
+    free(cSourcePath);
+    clReleaseMemObject(d_Rand);
+    clReleaseKernel(ckRNG);
+    clReleaseProgram(cpProgram);
+    return bPass;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Main function 
 ///////////////////////////////////////////////////////////////////////////////
@@ -261,6 +459,12 @@ int main(int argc, const char **argv)
     double L1norm = sum_delta / sum_ref;
     shrLog("L1 norm: %E\n\n", L1norm);
 
+    // stateless generators on the first device
+    cl_device_id cdQueueDevice;
+    ciErr1 = clGetCommandQueueInfo(cqCommandQueue[0], CL_QUEUE_DEVICE, sizeof(cl_device_id), &cdQueueDevice, NULL);
+    oclCheckError(ciErr1, CL_SUCCESS);
+    bool bCounterPass = runCounterRNG(argc, argv, cxGPUContext, cqCommandQueue[0], cdQueueDevice, nPerRng, seed);
+
     // NOTE:  Most properly this should be done at any of the exit points above, but it is omitted elsewhere for clarity.
     shrLog("Release CPU buffers and OpenCL objects...\n"); 
     clReleaseKernel(ckMersenneTwister);
@@ -289,7 +493,7 @@ int main(int argc, const char **argv)
     clReleaseContext(cxGPUContext);
 
     // finish
-    shrQAFinishExit(argc, (const char **)argv, (L1norm < 1e-6) ? QA_PASSED : QA_FAILED);
+    shrQAFinishExit(argc, (const char **)argv, (L1norm < 1e-6 && bCounterPass) ? QA_PASSED : QA_FAILED);
 
     shrEXIT(argc, argv);
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright 1993-2011 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _MPMC_QUEUE_H_
+#define _MPMC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free multi-producer multi-consumer queue (D. Vyukov's ring).
+//
+// Every cell carries a sequence number telling whose turn it is: a producer
+// may fill cell pos when seq == pos, a consumer may empty it when
+// seq == pos + 1. The head and tail counters are claimed with one CAS each,
+// so producers and consumers never block each other; TryPush and TryPop
+// fail instead of waiting when the queue is full or empty.
+template <typename T>
+class MPMCQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit MPMCQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        mask = size - 1;
+        cells = new Cell[size];
+        for (size_t i = 0; i < size; i++)
+        {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~MPMCQueue()
+    {
+        delete [] cells;
+    }
+
+    bool TryPush(const T &value)
+    {
+        Cell *cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (dif == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                return false;   // full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &value)
+    {
+        Cell *cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+            if (dif == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                return false;   // empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->data;
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    // keep the producer and consumer counters on separate cache lines
+    char pad0[64];
+    Cell *cells;
+    size_t mask;
+    char pad1[64];
+    std::atomic<size_t> enqueuePos;
+    char pad2[64];
+    std::atomic<size_t> dequeuePos;
+    char pad3[64];
+
+    MPMCQueue(const MPMCQueue &);
+    MPMCQueue &operator=(const MPMCQueue &);
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Copyright 1993-2011 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _SUBMISSION_SERVICE_H_
+#define _SUBMISSION_SERVICE_H_
+
+#include <CL/cl.h>
+#include <atomic>
+#include <vector>
+#include <cstring>
+
+#include "MPMCQueue.h"
+
+#define SUBMIT_MAX_ARGS      8
+#define SUBMIT_MAX_ARG_BYTES 16
+#define SUBMIT_QUEUE_DEPTH   1024
+
+struct SubmitRequest;
+class SubmissionService;
+
+// Called once per request, from an OpenCL callback thread, when the last
+// command of the request has completed (status CL_COMPLETE) or failed
+// (negative status). Must not block.
+typedef void (*SubmitCallback)(SubmitRequest *request, void *userData);
+
+// One kernel launch, optionally followed by a download of a buffer.
+// Argument values are copied into the request, buffers are owned by the
+// caller and have to stay alive until the callback.
+struct SubmitRequest
+{
+    const char *kernelName;
+    cl_uint numArgs;
+    size_t argSize[SUBMIT_MAX_ARGS];
+    unsigned char argValue[SUBMIT_MAX_ARGS][SUBMIT_MAX_ARG_BYTES];
+    bool argLocal[SUBMIT_MAX_ARGS];
+
+    cl_uint workDim;
+    size_t globalWorkSize[3];
+    size_t localWorkSize[3];             // all 0: the runtime chooses
+
+    cl_mem readBuffer;                   // 0: no download
+    void *readHost;
+    size_t readBytes;
+
+    SubmitCallback pfnCallback;
+    void *userData;
+
+    // filled in by the service
+    cl_int status;
+    int queueIndex;
+    double dSubmitTime;                  // seconds, SubmissionService::Now
+    double dCompleteTime;
+    SubmissionService *pService;
+
+    SubmitRequest()
+    {
+        memset(this, 0, sizeof(*this));
+        workDim = 1;
+    }
+
+    void SetArg(cl_uint index, size_t size, const void *value)
+    {
+        argSize[index] = size;
+        argLocal[index] = false;
+        memcpy(argValue[index], value, size);
+        numArgs = (index + 1 > numArgs) ? index + 1 : numArgs;
+    }
+
+    void SetArgLocal(cl_uint index, size_t size)
+    {
+        argSize[index] = size;
+        argLocal[index] = true;
+        numArgs = (index + 1 > numArgs) ? index + 1 : numArgs;
+    }
+};
+
+// Serves kernel launches from many client threads on a fixed pool of
+// command queues.
+//
+// Clients hand requests to Submit, which puts them into a lock-free MPMC
+// queue. One worker thread per command queue takes requests out, sets the
+// arguments on its own instance of the kernel and enqueues it without
+// waiting; completion is reported through an event callback. Programs are
+// built once and shared, kernels are created per worker because
+// clSetKernelArg on a kernel object shared between threads is not safe.
+class SubmissionService
+{
+public:
+    // queuesPerDevice command queues (and worker threads) on every device
+    SubmissionService(cl_context GPUContext,
+                      const cl_device_id *devices,
+                      cl_uint numDevices,
+                      int queuesPerDevice);
+    ~SubmissionService();
+
+    // programs built for the devices of the service, before Start
+    void AddProgram(cl_program program);
+
+    void Start();
+    void Stop();
+
+    // false when the service is stopped; spins while the request queue is full
+    bool Submit(SubmitRequest *request);
+
+    // waits until every submitted request has completed
+    void Drain();
+
+    int GetNumQueues() {return (int)workers.size();}
+    size_t GetSubmitted() {return uiSubmitted.load();}
+    size_t GetCompleted() {return uiCompleted.load();}
+
+    static double Now();
+
+private:
+    // queue, kernel instances and thread of one worker, see SubmissionService.cpp
+    struct Worker;
+
+    cl_context cxGPUContext;
+    std::vector<cl_program> programs;
+    std::vector<Worker *> workers;
+    MPMCQueue<SubmitRequest *> requests;
+    std::atomic<bool> bStop;
+    std::atomic<size_t> uiSubmitted;
+    std::atomic<size_t> uiCompleted;
+    bool bStarted;
+
+    static void CL_CALLBACK eventCallback(cl_event event, cl_int status, void *userData);
+
+    cl_kernel getKernel(Worker *worker, const char *name);
+    void dispatch(Worker *worker, SubmitRequest *request);
+    void complete(SubmitRequest *request, cl_int status);
+
+    SubmissionService(const SubmissionService &);
+    SubmissionService &operator=(const SubmissionService &);
+};
+
+#endif
@@ -0,0 +1,293 @@
+/*
+ * Copyright 1993-2011 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include <oclUtils.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "multithreading.h"
+#include "SubmissionService.h"
+
+// empty polls of a worker before it starts sleeping between polls
+#define SERVICE_SPIN_POLLS 1024
+#define SERVICE_IDLE_SLEEP_US 50
+
+struct SubmissionService::Worker
+{
+    SubmissionService *pService;
+    cl_command_queue queue;
+    int index;
+    std::map<std::string, cl_kernel> kernels;
+    CUTThread thread;
+
+    static CUT_THREADPROC Thread(void *arg);
+};
+
+SubmissionService::SubmissionService(cl_context GPUContext,
+                                     const cl_device_id *devices,
+                                     cl_uint numDevices,
+                                     int queuesPerDevice)
+    : requests(SUBMIT_QUEUE_DEPTH)
+{
+    cl_int ciErrNum;
+
+    cxGPUContext = GPUContext;
+    bStop = false;
+    uiSubmitted = 0;
+    uiCompleted = 0;
+    bStarted = false;
+
+    // queues round-robin over the devices, so neighbouring workers
+    // feed different devices
+    for (int q = 0; q < queuesPerDevice; q++)
+    {
+        for (cl_uint d = 0; d < numDevices; d++)
+        {
+            Worker *worker = new Worker;
+            worker->pService = this;
+            worker->index = (int)workers.size();
+            worker->queue = clCreateCommandQueue(cxGPUContext, devices[d], 0, &ciErrNum);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+            workers.push_back(worker);
+        }
+    }
+}
+
+SubmissionService::~SubmissionService()
+{
+    Stop();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        Worker *worker = workers[i];
+        for (std::map<std::string, cl_kernel>::iterator it = worker->kernels.begin(); it != worker->kernels.end(); it++)
+        {
+            clReleaseKernel(it->second);
+        }
+        clReleaseCommandQueue(worker->queue);
+        delete worker;
+    }
+}
+
+void SubmissionService::AddProgram(cl_program program)
+{
+    oclCheckError(bStarted, false);
+    programs.push_back(program);
+}
+
+void SubmissionService::Start()
+{
+    if (bStarted)
+    {
+        return;
+    }
+    bStop = false;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->thread = cutStartThread(&Worker::Thread, workers[i]);
+    }
+    bStarted = true;
+}
+
+void SubmissionService::Stop()
+{
+    if (!bStarted)
+    {
+        return;
+    }
+
+    // workers finish dispatching what is queued before they leave
+    bStop = true;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        cutEndThread(workers[i]->thread);
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        clFinish(workers[i]->queue);
+    }
+    bStarted = false;
+}
+
+bool SubmissionService::Submit(SubmitRequest *request)
+{
+    if (bStop || !bStarted)
+    {
+        return false;
+    }
+
+    request->pService = this;
+    request->status = CL_QUEUED;
+    request->dSubmitTime = Now();
+    uiSubmitted++;
+
+    // back-pressure: a full queue means all workers are busy
+    while (!requests.TryPush(request))
+    {
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void SubmissionService::Drain()
+{
+    while (uiCompleted.load() < uiSubmitted.load())
+    {
+        std::this_thread::yield();
+    }
+}
+
+double SubmissionService::Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CUT_THREADPROC SubmissionService::Worker::Thread(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    SubmissionService *service = worker->pService;
+    int idle = 0;
+
+    for (;;)
+    {
+        SubmitRequest *request;
+        if (service->requests.TryPop(request))
+        {
+            service->dispatch(worker, request);
+            idle = 0;
+            continue;
+        }
+
+        if (service->bStop)
+        {
+            break;
+        }
+
+        // nothing to do: spin a little for low latency, then back off
+        if (++idle < SERVICE_SPIN_POLLS)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            // make sure the device isn't waiting for us meanwhile
+            clFlush(worker->queue);
+            std::this_thread::sleep_for(std::chrono::microseconds(SERVICE_IDLE_SLEEP_US));
+        }
+    }
+
+    clFlush(worker->queue);
+    CUT_THREADEND;
+}
+
+cl_kernel SubmissionService::getKernel(Worker *worker, const char *name)
+{
+    std::map<std::string, cl_kernel>::iterator it = worker->kernels.find(name);
+    if (it != worker->kernels.end())
+    {
+        return it->second;
+    }
+
+    // this worker's own instance, from the first program that has the kernel
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        cl_int ciErrNum;
+        cl_kernel kernel = clCreateKernel(programs[i], name, &ciErrNum);
+        if (ciErrNum == CL_SUCCESS)
+        {
+            worker->kernels[name] = kernel;
+            return kernel;
+        }
+    }
+    return 0;
+}
+
+void SubmissionService::dispatch(Worker *worker, SubmitRequest *request)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    request->queueIndex = worker->index;
+
+    cl_kernel kernel = getKernel(worker, request->kernelName);
+    if (!kernel)
+    {
+        shrLog("SubmissionService: kernel %s not found in the programs!\n", request->kernelName);
+        complete(request, CL_INVALID_KERNEL_NAME);
+        return;
+    }
+
+    for (cl_uint i = 0; i < request->numArgs && ciErrNum == CL_SUCCESS; i++)
+    {
+        ciErrNum = clSetKernelArg(kernel, i, request->argSize[i], request->argLocal[i] ? NULL : request->argValue[i]);
+    }
+    if (ciErrNum != CL_SUCCESS)
+    {
+        complete(request, ciErrNum);
+        return;
+    }
+
+    bool bLocal = request->localWorkSize[0] != 0;
+    cl_event event;
+    ciErrNum = clEnqueueNDRangeKernel(worker->queue, kernel, request->workDim, NULL,
+                                      request->globalWorkSize, bLocal ? request->localWorkSize : NULL,
+                                      0, NULL, &event);
+    if (ciErrNum != CL_SUCCESS)
+    {
+        complete(request, ciErrNum);
+        return;
+    }
+
+    // the in-order queue runs the download after the kernel
+    if (request->readBuffer)
+    {
+        clReleaseEvent(event);
+        ciErrNum = clEnqueueReadBuffer(worker->queue, request->readBuffer, CL_FALSE, 0,
+                                       request->readBytes, request->readHost, 0, NULL, &event);
+        if (ciErrNum != CL_SUCCESS)
+        {
+            clFinish(worker->queue);
+            complete(request, ciErrNum);
+            return;
+        }
+    }
+
+    ciErrNum = clSetEventCallback(event, CL_COMPLETE, &SubmissionService::eventCallback, request);
+    clReleaseEvent(event);
+    if (ciErrNum != CL_SUCCESS)
+    {
+        clFinish(worker->queue);
+        complete(request, ciErrNum);
+        return;
+    }
+
+    // submit now, the next request may be a while away
+    clFlush(worker->queue);
+}
+
+void CL_CALLBACK SubmissionService::eventCallback(cl_event event, cl_int status, void *userData)
+{
+    (void)event;
+    SubmitRequest *request = (SubmitRequest *)userData;
+    request->pService->complete(request, status);
+}
+
+void SubmissionService::complete(SubmitRequest *request, cl_int status)
+{
+    request->status = status;
+    request->dCompleteTime = Now();
+    if (request->pfnCallback)
+    {
+        request->pfnCallback(request, request->userData);
+    }
+
+    // counted last, Drain also waits for the callbacks
+    uiCompleted++;
+}
@@ -40,7 +40,7 @@
     typedef void *(*CUT_THREADROUTINE)(void *);
 
     #define CUT_THREADPROC void*
-    #define  CUT_THREADEND 
+    #define  CUT_THREADEND return NULL
 
 	struct CUTBarrier {
 		pthread_mutex_t mutex;
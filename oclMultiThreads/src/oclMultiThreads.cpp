@@ -29,6 +29,9 @@
 #include <shrQATest.h>
 #include <oclUtils.h>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #ifdef _WIN32
 	#include <windows.h>
@@ -68,6 +71,7 @@
 #ifdef CL_VERSION_1_1 
 
 #include "multithreading.h"
+#include "SubmissionService.h"
 
 const int N = 8;
 const int buffer_size    = 1 << 23;
@@ -472,13 +476,149 @@ int compileOCLKernel(cl_context cxGPUContext, cl_device_id cdDevices,
     return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Submission service benchmark: client threads each send simpleIncrement
+// requests on their own buffer through one shared SubmissionService, one
+// request in flight per client, and measure the time from Submit to the
+// completion callback.
+////////////////////////////////////////////////////////////////////////////////
+const int SERVICE_ITEMS = 64 * 1024;
+const int SERVICE_MAX_CLIENTS = 64;
+
+struct service_client_arg_t{
+	SubmissionService* service;
+	cl_mem buffer;
+	float* data_fp;
+	int requests;
+	std::atomic<int> done;
+	std::vector<double> latency;
+	bool bOK;
+};
+
+void service_request_done(SubmitRequest* request, void* user_data)
+{
+	(void)request;
+	((service_client_arg_t*)user_data)->done.store(1, std::memory_order_release);
+}
+
+CUT_THREADPROC service_client(void* void_arg)
+{
+	service_client_arg_t* arg = (service_client_arg_t*) void_arg;
+
+	for( int k=0; k < arg->requests; ++k ) {
+		SubmitRequest request;
+		request.kernelName = "simpleIncrement";
+		request.SetArg(0, sizeof(cl_mem), &arg->buffer);
+		request.globalWorkSize[0] = SERVICE_ITEMS;
+		request.localWorkSize[0] = 256;
+		request.readBuffer = arg->buffer;
+		request.readHost = arg->data_fp;
+		request.readBytes = SERVICE_ITEMS * sizeof(float);
+		request.pfnCallback = &service_request_done;
+		request.userData = arg;
+
+		arg->done.store(0, std::memory_order_relaxed);
+		if( !arg->service->Submit(&request) ) {
+			arg->bOK = false;
+			break;
+		}
+		while( !arg->done.load(std::memory_order_acquire) ) {
+			std::this_thread::yield();
+		}
+
+		// every request adds one to the whole buffer and reads it back
+		if( request.status != CL_COMPLETE ||
+		    arg->data_fp[0] != (float)(k + 1) ||
+		    arg->data_fp[SERVICE_ITEMS - 1] != (float)(k + 1) ) {
+			arg->bOK = false;
+			break;
+		}
+		arg->latency.push_back(request.dCompleteTime - request.dSubmitTime);
+	}
+	CUT_THREADEND;
+}
+
+double percentile(std::vector<double>& v, double p)
+{
+	if( v.empty() ) return 0.0;
+	size_t i = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
+
+void run_service_benchmark(cl_context context, cl_device_id* devices, cl_uint device_count,
+                           cl_program program, int queues_per_device, int requests)
+{
+	cl_int ciErrNum;
+
+	SubmissionService service(context, devices, device_count, queues_per_device);
+	service.AddProgram(program);
+	service.Start();
+
+	shrLog("\nSubmission service: %d command queues on %u device(s), %d requests per client\n",
+	       service.GetNumQueues(), device_count, requests);
+	shrLog("clients   requests/s   latency p50 (ms)   p99 (ms)   max (ms)\n");
+
+	std::vector<float> zeros(SERVICE_ITEMS, 0.0f);
+
+	for( int clients = 1; clients <= SERVICE_MAX_CLIENTS && bOK; clients *= 2 ) {
+		std::vector<service_client_arg_t*> args(clients);
+		std::vector<CUTThread> threads(clients);
+
+		for( int c=0; c < clients; ++c ) {
+			args[c] = new service_client_arg_t;
+			args[c]->service = &service;
+			args[c]->buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			                                 SERVICE_ITEMS * sizeof(float), &zeros[0], &ciErrNum);
+			oclCheckError(ciErrNum, CL_SUCCESS);
+			args[c]->data_fp = (float*) malloc(SERVICE_ITEMS * sizeof(float));
+			args[c]->requests = requests;
+			args[c]->done = 0;
+			args[c]->bOK = true;
+		}
+
+		double start = SubmissionService::Now();
+		for( int c=0; c < clients; ++c ) {
+			threads[c] = cutStartThread(&service_client, args[c]);
+		}
+		for( int c=0; c < clients; ++c ) {
+			cutEndThread(threads[c]);
+		}
+		double elapsed = SubmissionService::Now() - start;
+		service.Drain();
+
+		std::vector<double> latency;
+		for( int c=0; c < clients; ++c ) {
+			if( !args[c]->bOK ) {
+				bOK = false;
+				shrLog("Results don't match for client %d of %d!\n", c, clients);
+			}
+			latency.insert(latency.end(), args[c]->latency.begin(), args[c]->latency.end());
+			clReleaseMemObject(args[c]->buffer);
+			free(args[c]->data_fp);
+			delete args[c];
+		}
+
+		shrLog("%7d %12.0f %18.3f %10.3f %10.3f\n", clients,
+		       latency.size() / elapsed,
+		       1e3 * percentile(latency, 0.5),
+		       1e3 * percentile(latency, 0.99),
+		       1e3 * percentile(latency, 1.0));
+	}
+
+	service.Stop();
+}
+
 
 int main(int argc, char** argv) 
 {
     if(shrCheckCmdLineFlag(argc, (const char**)argv, "help")) {
         printf("[oclMultiThreads] - help\n");
-        printf("\t-profile   - Enable OpenCL profiling counters.\n");
-        printf("\t-device=n  - Specify one specific GPU device to enable OpenCL kernels.\n");
+        printf("\t-profile    - Enable OpenCL profiling counters.\n");
+        printf("\t-device=n   - Specify one specific GPU device to enable OpenCL kernels.\n");
+        printf("\t-service    - Benchmark the submission service with 1 to %d client threads.\n", SERVICE_MAX_CLIENTS);
+        printf("\t-queues=n   - Command queues per device of the submission service (default 2).\n");
+        printf("\t-requests=n - Requests per client thread of the service benchmark (default 200).\n");
         return 0;
     }
 
@@ -591,6 +731,32 @@ int main(int argc, char** argv)
 	} 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Submission service benchmark instead of the workloads
+////////////////////////////////////////////////////////////////////////////////
+	if(shrCheckCmdLineFlag(argc, (const char**)argv, "service"))
+	{
+		int iQueues = 2;
+		int iRequests = 200;
+		shrGetCmdLineArgumenti(argc, (const char**)argv, "queues", &iQueues);
+		shrGetCmdLineArgumenti(argc, (const char**)argv, "requests", &iRequests);
+
+		// one program for all clients, each service worker creates its own kernel
+		ciErrNum = compileOCLKernel(cxGPUContext, cdDevices[0], "kernel.cl", &program[0], argv);
+		oclCheckError(ciErrNum, CL_SUCCESS);
+
+		run_service_benchmark(cxGPUContext, cdDevices, ciDeviceCount, program[0],
+		                      CLAMP(iQueues, 1, 16), CLAMP(iRequests, 1, 100000));
+
+		clReleaseProgram(program[0]);
+		clReleaseContext(cxGPUContext);
+		delete [] cDevicesName;
+		free(cdDevices);
+
+		shrQAFinishExit(argc, (const char **)argv, (bOK ? QA_PASSED : QA_FAILED));
+		return 0;
+	}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Launch Heterogeneous Workloads
 ////////////////////////////////////////////////////////////////////////////////
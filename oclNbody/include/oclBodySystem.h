@@ -22,6 +22,14 @@
         NBODY_NUM_CONFIGS
     };
 
+    enum NBodyIntegrator
+    {
+        NBODY_INTEGRATOR_EULER,     // damped Euler-style update, one force evaluation per step
+        NBODY_INTEGRATOR_LEAPFROG,  // kick-drift-kick leapfrog, 2nd order, one force evaluation per step
+        NBODY_INTEGRATOR_YOSHIDA4,  // Yoshida 4th order composition of leapfrogs, three force evaluations per step
+        NBODY_NUM_INTEGRATORS
+    };
+
     // utility function
     void randomizeBodies(NBodyConfig config, float* pos, float* vel, float* color, float clusterScale, 
 		         float velocityScale, int numBodies);
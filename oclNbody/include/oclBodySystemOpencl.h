@@ -34,6 +34,11 @@ class BodySystemOpenCL : public BodySystem
         virtual float* getArray(BodyArray array);
         virtual void   setArray(BodyArray array, const float* data);
 
+        // The state of a double precision system without the float round trip
+        // of getArray/setArray, numBodies double4 (for checkpoints)
+        void getArrayDouble(BodyArray array, double* data);
+        void setArrayDouble(BodyArray array, const double* data);
+
         virtual size_t getCurrentReadBuffer() const 
         {
             if (m_bUsePBO) 
@@ -48,11 +53,31 @@ class BodySystemOpenCL : public BodySystem
 
         virtual void synchronizeThreads() const;
 
+        // Euler (default), leapfrog or Yoshida integrator.
+        // Block time steps (maxLevel > 0) split every step into up to 2^maxLevel
+        // substeps, every body takes deltaTime / 2^level with the level from
+        // dt <= eta * sqrt(softening / |a|); they are used with the leapfrog only.
+        void setIntegrator(NBodyIntegrator integrator, int maxLevel, float eta);
+
+        // # of single body force evaluations since creation
+        // (numBodies per step for the Euler and leapfrog without block steps)
+        unsigned long long getForceEvaluations() const { return m_forceEvaluations; }
+
     protected: // methods
         BodySystemOpenCL() {}
 
         virtual void _initialize(int numBodies);
         virtual void _finalize();
+
+        cl_mem currentPos() const;
+        void computeAccel(cl_mem pos, int numActive, bool allBodies);
+        void kick(cl_mem vel, int numActive, bool allBodies, float deltaTime, float factor, float damping);
+        void drift(cl_mem pos, cl_mem vel, float deltaTime);
+        int  selectActive(int minLevel);
+        void assignLevels(int numActive, bool allBodies, float deltaTime, int minLevel);
+        void updateLeapfrog(float deltaTime);
+        void updateBlockSteps(float deltaTime);
+        void updateYoshida(float deltaTime);
         
     protected: // data
         cl_device_id device;
@@ -85,6 +110,24 @@ class BodySystemOpenCL : public BodySystem
 
 		//for double precision
 		bool m_bDouble;
+
+        // integrators other than Euler
+        NBodyIntegrator m_integrator;
+        int   m_maxLevel;
+        float m_eta;
+        bool  m_bAccelValid;
+        unsigned long long m_forceEvaluations;
+
+        cl_kernel accelKernel;
+        cl_kernel kickKernel;
+        cl_kernel driftKernel;
+        cl_kernel selectKernel;
+        cl_kernel levelsKernel;
+
+        cl_mem m_dAccel;
+        cl_mem m_dLevels;
+        cl_mem m_dActiveList;
+        cl_mem m_dActiveCount;
 };
 
 #endif // __CLH_BODYSYSTEMOPENCL_H__
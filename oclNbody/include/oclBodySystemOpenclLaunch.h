@@ -28,6 +28,8 @@
 #include "oclBodySystemOpencl.h"
 
 int  CreateProgramAndKernel(cl_context ctx, cl_device_id* cdDevices, const char* kernel_name, cl_kernel* kernel, bool bDouble);
+int  CreateProgramAndKernels(cl_context ctx, cl_device_id* cdDevices, const char** kernel_names, cl_kernel* kernels, int numKernels, bool bDouble);
+cl_int SetRealKernelArg(cl_kernel kernel, cl_uint index, float value, bool bDouble);
 void AllocateNBodyArrays(cl_context ctx, cl_mem* vel, int numBodies, int dFlag);
 void DeleteNBodyArrays(cl_mem* vel);
 
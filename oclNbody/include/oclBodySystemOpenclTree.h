@@ -0,0 +1,95 @@
+#ifndef __CL_BODYSYSTEMOPENCLTREE_H__
+#define __CL_BODYSYSTEMOPENCLTREE_H__
+
+#if defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/opencl.h>
+#endif
+#include "oclBodySystem.h"
+
+// OpenCL BodySystem with Barnes-Hut force approximation: O(N log N) per step.
+// The tree is rebuilt on the device every step from Morton-sorted bodies
+// (see oclNbodyTreeKernel.cl), nothing but positions and velocities
+// lives on the host. Single precision only.
+class BodySystemOpenCLTree : public BodySystem
+{
+    public:
+        BodySystemOpenCLTree(int numBodies, cl_device_id dev, cl_context ctx, cl_command_queue cmdq, float theta);
+        virtual ~BodySystemOpenCLTree();
+
+        virtual void update(float deltaTime);
+
+        virtual void setSoftening(float softening);
+        virtual void setDamping(float damping);
+
+        // opening angle: a cell is replaced by its centre of mass
+        // when cell size / distance < theta, 0 gives the exact all-pairs sum
+        void setTheta(float theta);
+
+        virtual float* getArray(BodyArray array);
+        virtual void   setArray(BodyArray array, const float* data);
+
+        virtual size_t getCurrentReadBuffer() const
+        {
+            return (size_t) m_hPos;
+        }
+
+        virtual void synchronizeThreads() const;
+
+    protected: // methods
+        BodySystemOpenCLTree() {}
+
+        virtual void _initialize(int numBodies);
+        virtual void _finalize();
+
+        void buildProgram();
+        void sortMortonCodes();
+        void enqueueKernel(cl_kernel kernel, size_t globalSize, size_t localSize);
+
+    protected: // data
+        cl_device_id device;
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+
+        cl_program cpProgram;
+        cl_kernel reduceBoundsKernel;
+        cl_kernel mortonKernel;
+        cl_kernel histogramKernel;
+        cl_kernel scanKernel;
+        cl_kernel scatterKernel;
+        cl_kernel gatherKernel;
+        cl_kernel buildTreeKernel;
+        cl_kernel centresOfMassKernel;
+        cl_kernel integrateKernel;
+
+        size_t m_wgSize;
+        int    m_boundsGroups;
+        int    m_sortGroups;
+
+        // CPU data
+        float* m_hPos;
+        float* m_hVel;
+
+        // GPU data
+        cl_mem m_dPos[2];
+        cl_mem m_dVel[2];
+
+        cl_mem m_dPartialMin, m_dPartialMax;
+        cl_mem m_dBoundsMin, m_dBoundsMax;
+        cl_mem m_dKeys[2];
+        cl_mem m_dValues[2];
+        cl_mem m_dHistogram;
+        cl_mem m_dSortedPos;
+        cl_mem m_dChildL, m_dChildR, m_dParent, m_dFlags;
+        cl_mem m_dNodeCom, m_dNodeMin, m_dNodeMax;
+
+        float m_softeningSq;
+        float m_damping;
+        float m_thetaSq;
+
+        unsigned int m_currentRead;
+        unsigned int m_currentWrite;
+};
+
+#endif // __CL_BODYSYSTEMOPENCLTREE_H__
@@ -0,0 +1,49 @@
+#ifndef __CLH_NBODYCHECKPOINT_H__
+    #define __CLH_NBODYCHECKPOINT_H__
+
+    // Binary snapshot of a running simulation, used by the batch mode
+    // to survive preemption of long runs.
+    //
+    // Layout: NBodyCheckpointHeader followed by numBodies positions
+    // (xyz, mass) and numBodies velocities, all little endian as written
+    // by the host. They are double4 when bDouble is set, float4 otherwise,
+    // so a --double run restarts from its full precision state.
+
+    #define NBODY_CHECKPOINT_MAGIC   "NBODYCKP"
+    #define NBODY_CHECKPOINT_VERSION 3
+
+    struct NBodyCheckpointHeader
+    {
+        char         magic[8];
+        unsigned int version;
+        int          numBodies;
+        int          bDouble;
+        int          bTree;
+        int          p;             // workgroup dims of the all-pairs kernel
+        int          q;
+        int          integrator;    // NBodyIntegrator
+        int          blockLevels;   // block time step levels, 0 = none
+        float        eta;
+        long long    step;          // count of steps already done
+        float        timestep;
+        float        softening;
+        float        damping;
+        float        theta;
+    };
+
+    // Writes to "<filename>.tmp" first and renames it when complete,
+    // so an interrupted write never destroys the previous snapshot.
+    // pos and vel are double4 arrays when header.bDouble is set, float4 ones
+    // otherwise. Returns false on any I/O error.
+    bool WriteCheckpoint(const char* filename, const NBodyCheckpointHeader& header,
+                         const void* pos, const void* vel);
+
+    // Reads the header only, to size the simulation before allocating it
+    bool ReadCheckpointHeader(const char* filename, NBodyCheckpointHeader& header);
+
+    // Reads the whole snapshot, pos and vel must hold header.numBodies*4
+    // doubles or floats, as given by the bDouble of ReadCheckpointHeader
+    bool ReadCheckpoint(const char* filename, NBodyCheckpointHeader& header,
+                        void* pos, void* vel);
+
+#endif // __CLH_NBODYCHECKPOINT_H__
@@ -31,6 +31,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <algorithm>
+#include <cmath>
 #include "oclBodySystemOpenclLaunch.h"
 
 BodySystemOpenCL::BodySystemOpenCL(int numBodies, cl_device_id dev, cl_context ctx, cl_command_queue cmdq, 
@@ -46,7 +47,12 @@ BodySystemOpenCL::BodySystemOpenCL(int numBodies, cl_device_id dev, cl_context c
   m_currentWrite(1),
   m_p(p),
   m_q(q),
-  m_bDouble(bDouble)
+  m_bDouble(bDouble),
+  m_integrator(NBODY_INTEGRATOR_EULER),
+  m_maxLevel(0),
+  m_eta(0.1f),
+  m_bAccelValid(false),
+  m_forceEvaluations(0)
 {
     m_dPos[0] = m_dPos[1] = 0;
     m_dVel[0] = m_dVel[1] = 0;
@@ -67,6 +73,20 @@ BodySystemOpenCL::BodySystemOpenCL(int numBodies, cl_device_id dev, cl_context c
         exit(shrLogEx(LOGBOTH | CLOSELOG, -1, "CreateProgramAndKernel _MT ", STDERROR)); 
     }
 
+    // create kernels for the other integrators
+    shrLog("\nCreateProgramAndKernels integrators... ");
+    const char* names[] = {"computeAccel", "kickBodies", "driftBodies", "selectActiveBodies", "assignLevels"};
+    cl_kernel kernels[5];
+    if (CreateProgramAndKernels(ctx, &dev, names, kernels, 5, m_bDouble)) 
+    {
+        exit(shrLogEx(LOGBOTH | CLOSELOG, -1, "CreateProgramAndKernels integrators ", STDERROR)); 
+    }
+    accelKernel  = kernels[0];
+    kickKernel   = kernels[1];
+    driftKernel  = kernels[2];
+    selectKernel = kernels[3];
+    levelsKernel = kernels[4];
+
     setSoftening(0.00125f);
     setDamping(0.995f);   
 }
@@ -119,6 +139,20 @@ void BodySystemOpenCL::_initialize(int numBodies)
     AllocateNBodyArrays(cxContext, m_dVel, m_numBodies, m_bDouble);
     shrLog("\nAllocateNBodyArrays m_dVel\n"); 
 
+    // accelerations and per body levels of the integrators other than Euler,
+    // levels start at 0: every body takes the global step
+    cl_int ciErrNum = CL_SUCCESS;
+    cl_int ciErr;
+    size_t vecSize = (m_bDouble ? sizeof(cl_double4) : sizeof(cl_float4)) * m_numBodies;
+    int* zeros = new int[m_numBodies];
+    memset(zeros, 0, m_numBodies*sizeof(int));
+    m_dAccel = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, vecSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dLevels = clCreateBuffer(cxContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, m_numBodies*sizeof(int), zeros, &ciErr); ciErrNum |= ciErr;
+    m_dActiveList = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, m_numBodies*sizeof(int), NULL, &ciErr); ciErrNum |= ciErr;
+    m_dActiveCount = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(int), NULL, &ciErr); ciErrNum |= ciErr;
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    delete [] zeros;
+
     m_bInitialized = true;
 }
 
@@ -131,6 +165,16 @@ void BodySystemOpenCL::_finalize()
 
 	clReleaseKernel(MT_kernel);
 	clReleaseKernel(noMT_kernel);
+	clReleaseKernel(accelKernel);
+	clReleaseKernel(kickKernel);
+	clReleaseKernel(driftKernel);
+	clReleaseKernel(selectKernel);
+	clReleaseKernel(levelsKernel);
+
+    clReleaseMemObject(m_dAccel);
+    clReleaseMemObject(m_dLevels);
+    clReleaseMemObject(m_dActiveList);
+    clReleaseMemObject(m_dActiveCount);
 
     DeleteNBodyArrays(m_dVel);
     if (m_bUsePBO)
@@ -155,10 +199,280 @@ void BodySystemOpenCL::setDamping(float damping)
     m_damping = damping;
 }
 
+void BodySystemOpenCL::setIntegrator(NBodyIntegrator integrator, int maxLevel, float eta)
+{
+    m_integrator = integrator;
+    m_maxLevel = (integrator == NBODY_INTEGRATOR_LEAPFROG) ? std::max(0, std::min(maxLevel, 30)) : 0;
+    m_eta = eta;
+
+    // levels of previous runs must not leak into a single level integrator
+    int* zeros = new int[m_numBodies];
+    memset(zeros, 0, m_numBodies*sizeof(int));
+    cl_int ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, m_dLevels, CL_TRUE, 0, m_numBodies*sizeof(int), zeros, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    delete [] zeros;
+    m_bAccelValid = false;
+}
+
+cl_mem BodySystemOpenCL::currentPos() const
+{
+    return m_bUsePBO ? m_pboCL[m_currentRead] : m_dPos[m_currentRead];
+}
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+void BodySystemOpenCL::computeAccel(cl_mem pos, int numActive, bool allBodies)
+{
+    if (numActive == 0)
+    {
+        return;
+    }
+
+    cl_int ciErrNum = CL_SUCCESS;
+    int iAll = allBodies ? 1 : 0;
+    size_t local = m_p;
+    size_t global = roundUp(numActive, local);
+    size_t sharedMemSize = m_p * (m_bDouble ? sizeof(cl_double4) : sizeof(cl_float4));
+
+    ciErrNum |= clSetKernelArg(accelKernel, 0, sizeof(cl_mem), (void *)&m_dAccel);
+    ciErrNum |= clSetKernelArg(accelKernel, 1, sizeof(cl_mem), (void *)&pos);
+    ciErrNum |= clSetKernelArg(accelKernel, 2, sizeof(cl_mem), (void *)&m_dActiveList);
+    ciErrNum |= clSetKernelArg(accelKernel, 3, sizeof(cl_int), (void *)&iAll);
+    ciErrNum |= clSetKernelArg(accelKernel, 4, sizeof(cl_int), (void *)&numActive);
+    ciErrNum |= SetRealKernelArg(accelKernel, 5, m_softeningSq, m_bDouble);
+    ciErrNum |= clSetKernelArg(accelKernel, 6, sizeof(cl_int), (void *)&m_numBodies);
+    ciErrNum |= clSetKernelArg(accelKernel, 7, sharedMemSize, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, accelKernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    m_forceEvaluations += numActive;
+}
+
+void BodySystemOpenCL::kick(cl_mem vel, int numActive, bool allBodies, float deltaTime, float factor, float damping)
+{
+    if (numActive == 0)
+    {
+        return;
+    }
+
+    cl_int ciErrNum = CL_SUCCESS;
+    int iAll = allBodies ? 1 : 0;
+    size_t local = m_p;
+    size_t global = roundUp(numActive, local);
+
+    ciErrNum |= clSetKernelArg(kickKernel, 0, sizeof(cl_mem), (void *)&vel);
+    ciErrNum |= clSetKernelArg(kickKernel, 1, sizeof(cl_mem), (void *)&m_dAccel);
+    ciErrNum |= clSetKernelArg(kickKernel, 2, sizeof(cl_mem), (void *)&m_dLevels);
+    ciErrNum |= clSetKernelArg(kickKernel, 3, sizeof(cl_mem), (void *)&m_dActiveList);
+    ciErrNum |= clSetKernelArg(kickKernel, 4, sizeof(cl_int), (void *)&iAll);
+    ciErrNum |= clSetKernelArg(kickKernel, 5, sizeof(cl_int), (void *)&numActive);
+    ciErrNum |= SetRealKernelArg(kickKernel, 6, deltaTime, m_bDouble);
+    ciErrNum |= SetRealKernelArg(kickKernel, 7, factor, m_bDouble);
+    ciErrNum |= SetRealKernelArg(kickKernel, 8, damping, m_bDouble);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, kickKernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+void BodySystemOpenCL::drift(cl_mem pos, cl_mem vel, float deltaTime)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    size_t local = m_p;
+    size_t global = roundUp(m_numBodies, local);
+
+    ciErrNum |= clSetKernelArg(driftKernel, 0, sizeof(cl_mem), (void *)&pos);
+    ciErrNum |= clSetKernelArg(driftKernel, 1, sizeof(cl_mem), (void *)&vel);
+    ciErrNum |= SetRealKernelArg(driftKernel, 2, deltaTime, m_bDouble);
+    ciErrNum |= clSetKernelArg(driftKernel, 3, sizeof(cl_int), (void *)&m_numBodies);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, driftKernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+// Compacts the indices of bodies with level >= minLevel into m_dActiveList,
+// returns their count (a blocking read, the count sizes the following launches)
+int BodySystemOpenCL::selectActive(int minLevel)
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    int count = 0;
+    size_t local = m_p;
+    size_t global = roundUp(m_numBodies, local);
+
+    ciErrNum |= clEnqueueWriteBuffer(cqCommandQueue, m_dActiveCount, CL_FALSE, 0, sizeof(int), &count, 0, NULL, NULL);
+    ciErrNum |= clSetKernelArg(selectKernel, 0, sizeof(cl_mem), (void *)&m_dLevels);
+    ciErrNum |= clSetKernelArg(selectKernel, 1, sizeof(cl_int), (void *)&minLevel);
+    ciErrNum |= clSetKernelArg(selectKernel, 2, sizeof(cl_int), (void *)&m_numBodies);
+    ciErrNum |= clSetKernelArg(selectKernel, 3, sizeof(cl_mem), (void *)&m_dActiveList);
+    ciErrNum |= clSetKernelArg(selectKernel, 4, sizeof(cl_mem), (void *)&m_dActiveCount);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, selectKernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    ciErrNum |= clEnqueueReadBuffer(cqCommandQueue, m_dActiveCount, CL_TRUE, 0, sizeof(int), &count, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    return count;
+}
+
+void BodySystemOpenCL::assignLevels(int numActive, bool allBodies, float deltaTime, int minLevel)
+{
+    if (numActive == 0)
+    {
+        return;
+    }
+
+    cl_int ciErrNum = CL_SUCCESS;
+    int iAll = allBodies ? 1 : 0;
+    size_t local = m_p;
+    size_t global = roundUp(numActive, local);
+
+    ciErrNum |= clSetKernelArg(levelsKernel, 0, sizeof(cl_mem), (void *)&m_dAccel);
+    ciErrNum |= clSetKernelArg(levelsKernel, 1, sizeof(cl_mem), (void *)&m_dLevels);
+    ciErrNum |= clSetKernelArg(levelsKernel, 2, sizeof(cl_mem), (void *)&m_dActiveList);
+    ciErrNum |= clSetKernelArg(levelsKernel, 3, sizeof(cl_int), (void *)&iAll);
+    ciErrNum |= clSetKernelArg(levelsKernel, 4, sizeof(cl_int), (void *)&numActive);
+    ciErrNum |= SetRealKernelArg(levelsKernel, 5, deltaTime, m_bDouble);
+    ciErrNum |= SetRealKernelArg(levelsKernel, 6, m_eta, m_bDouble);
+    ciErrNum |= SetRealKernelArg(levelsKernel, 7, sqrtf(m_softeningSq), m_bDouble);
+    ciErrNum |= clSetKernelArg(levelsKernel, 8, sizeof(cl_int), (void *)&minLevel);
+    ciErrNum |= clSetKernelArg(levelsKernel, 9, sizeof(cl_int), (void *)&m_maxLevel);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, levelsKernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+// Kick-drift-kick leapfrog. The closing kick of a step and the opening kick
+// of the next one use the same accelerations, so they are kept between steps
+// and there is one force evaluation per step.
+void BodySystemOpenCL::updateLeapfrog(float deltaTime)
+{
+    cl_mem pos = currentPos();
+    cl_mem vel = m_dVel[m_currentRead];
+
+    kick(vel, m_numBodies, true, deltaTime, 0.5f, 1.0f);
+    drift(pos, vel, deltaTime);
+    computeAccel(pos, m_numBodies, true);
+    kick(vel, m_numBodies, true, deltaTime, 0.5f, m_damping);
+}
+
+// Hierarchical block time steps: the step is split into 2^maxLevel substeps,
+// all bodies drift every substep, and only the bodies whose own step ends
+// get new accelerations, a closing and an opening kick and a new level.
+// A body of level l is due after substep s if s is a multiple of 2^(maxLevel - l).
+void BodySystemOpenCL::updateBlockSteps(float deltaTime)
+{
+    cl_mem pos = currentPos();
+    cl_mem vel = m_dVel[m_currentRead];
+    int numSubsteps = 1 << m_maxLevel;
+    float dtMin = deltaTime / (float)numSubsteps;
+
+    kick(vel, m_numBodies, true, deltaTime, 0.5f, 1.0f);
+    for (int s = 1; s <= numSubsteps; s++)
+    {
+        drift(pos, vel, dtMin);
+
+        // lowest due level: maxLevel - (# of trailing zero bits of s)
+        int minLevel = m_maxLevel;
+        for (int t = s; minLevel > 0 && !(t & 1); t >>= 1)
+        {
+            minLevel--;
+        }
+
+        int numActive = selectActive(minLevel);
+        computeAccel(pos, numActive, false);
+        kick(vel, numActive, false, deltaTime, 0.5f, 1.0f);
+        assignLevels(numActive, false, deltaTime, minLevel);
+        if (s < numSubsteps)
+        {
+            kick(vel, numActive, false, deltaTime, 0.5f, 1.0f);
+        }
+    }
+
+    if (m_damping != 1.0f)
+    {
+        kick(vel, m_numBodies, true, deltaTime, 0.0f, m_damping);
+    }
+}
+
+// Yoshida's 4th order integrator: drift-kick composition of three leapfrog
+// steps with weights w1, w0, w1
+void BodySystemOpenCL::updateYoshida(float deltaTime)
+{
+    const double cbrt2 = pow(2.0, 1.0 / 3.0);
+    const float w1 = (float)(1.0 / (2.0 - cbrt2));
+    const float w0 = (float)(-cbrt2 / (2.0 - cbrt2));
+    const float c[4] = {0.5f * w1, 0.5f * (w0 + w1), 0.5f * (w0 + w1), 0.5f * w1};
+    const float d[3] = {w1, w0, w1};
+
+    cl_mem pos = currentPos();
+    cl_mem vel = m_dVel[m_currentRead];
+
+    for (int k = 0; k < 3; k++)
+    {
+        drift(pos, vel, c[k] * deltaTime);
+        computeAccel(pos, m_numBodies, true);
+        kick(vel, m_numBodies, true, deltaTime, d[k], (k == 2) ? m_damping : 1.0f);
+    }
+    drift(pos, vel, c[3] * deltaTime);
+}
+
 void BodySystemOpenCL::update(float deltaTime)
 {
     oclCheckError(m_bInitialized, shrTRUE);
+
+    if (m_integrator != NBODY_INTEGRATOR_EULER)
+    {
+        // in place update of the current buffers
+        cl_int ciErrNum = CL_SUCCESS;
+        cl_mem pboCL = m_pboCL[m_currentRead];
+        if (m_bUsePBO)
+        {
+            ciErrNum = clEnqueueAcquireGLObjects(cqCommandQueue, 1, &pboCL, 0, NULL, NULL);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+
+        if (m_integrator == NBODY_INTEGRATOR_YOSHIDA4)
+        {
+            updateYoshida(deltaTime);
+        }
+        else
+        {
+            if (!m_bAccelValid)
+            {
+                computeAccel(currentPos(), m_numBodies, true);
+                if (m_maxLevel > 0)
+                {
+                    assignLevels(m_numBodies, true, deltaTime, 0);
+                }
+                m_bAccelValid = true;
+            }
+
+            if (m_maxLevel > 0)
+            {
+                updateBlockSteps(deltaTime);
+            }
+            else
+            {
+                updateLeapfrog(deltaTime);
+            }
+        }
+
+        if (m_bUsePBO)
+        {
+            ciErrNum = clEnqueueReleaseGLObjects(cqCommandQueue, 1, &pboCL, 0, NULL, NULL);
+            oclCheckError(ciErrNum, CL_SUCCESS);
+        }
+        return;
+    }
     
+    m_forceEvaluations += m_numBodies;
     IntegrateNbodySystem(cqCommandQueue,
                          MT_kernel, noMT_kernel,
                          m_dPos[m_currentWrite], m_dVel[m_currentWrite], 
@@ -205,6 +519,9 @@ float* BodySystemOpenCL::getArray(BodyArray array)
 void BodySystemOpenCL::setArray(BodyArray array, const float* data)
 {
     oclCheckError(m_bInitialized, shrTRUE);
+
+    // accelerations kept by the leapfrog belong to the old state
+    m_bAccelValid = false;
  
     switch (array)
     {
@@ -238,6 +555,27 @@ void BodySystemOpenCL::setArray(BodyArray array, const float* data)
     }       
 }
 
+void BodySystemOpenCL::getArrayDouble(BodyArray array, double* data)
+{
+    oclCheckError(m_bInitialized && m_bDouble && !m_bUsePBO, true);
+
+    cl_mem ddata = (array == BODYSYSTEM_VELOCITY) ? m_dVel[m_currentRead] : m_dPos[m_currentRead];
+    cl_int ciErrNum = clEnqueueReadBuffer(cqCommandQueue, ddata, CL_TRUE, 0, m_numBodies * sizeof(cl_double4), data, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+void BodySystemOpenCL::setArrayDouble(BodyArray array, const double* data)
+{
+    oclCheckError(m_bInitialized && m_bDouble && !m_bUsePBO, true);
+
+    // accelerations kept by the leapfrog belong to the old state
+    m_bAccelValid = false;
+
+    cl_mem ddata = (array == BODYSYSTEM_VELOCITY) ? m_dVel[m_currentRead] : m_dPos[m_currentRead];
+    cl_int ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, ddata, CL_TRUE, 0, m_numBodies * sizeof(cl_double4), data, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
 void BodySystemOpenCL::synchronizeThreads() const
 {
     ThreadSync(cqCommandQueue);
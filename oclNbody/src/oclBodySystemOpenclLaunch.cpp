@@ -216,9 +216,27 @@ extern "C"
         }
     }
 
+    // Sets a REAL kernel argument, float or double depending on the precision of the program
+    cl_int SetRealKernelArg(cl_kernel kernel, cl_uint index, float value, bool bDouble)
+    {
+        if (bDouble)
+        {
+            double dValue = (double)value;
+            return clSetKernelArg(kernel, index, sizeof(cl_double), (void *)&dValue);
+        }
+        return clSetKernelArg(kernel, index, sizeof(cl_float), (void *)&value);
+    }
+
     // Function to read in kernel from uncompiled source, create the OCL program and build the OCL program 
     // **************************************************************************************************
     int CreateProgramAndKernel(cl_context cxGPUContext, cl_device_id* cdDevices, const char *kernel_name, cl_kernel *kernel, bool bDouble)
+    {
+        return CreateProgramAndKernels(cxGPUContext, cdDevices, &kernel_name, kernel, 1, bDouble);
+    }
+
+    // Same as above for several kernels of one program, built only once
+    // **************************************************************************************************
+    int CreateProgramAndKernels(cl_context cxGPUContext, cl_device_id* cdDevices, const char **kernel_names, cl_kernel *kernels, int numKernels, bool bDouble)
     {
         cl_program cpProgram;
         size_t szSourceLen;
@@ -298,18 +316,21 @@ extern "C"
         }
         shrLog("clBuildProgram\n"); 
 
-        // create the kernel
-        *kernel = clCreateKernel(cpProgram, kernel_name, &ciErrNum);
-        oclCheckError(ciErrNum, CL_SUCCESS); 
-        shrLog("clCreateKernel\n"); 
-
-		size_t wgSize;
-		ciErrNum = clGetKernelWorkGroupInfo(*kernel, cdDevices[0], CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &wgSize, NULL);
-		if (wgSize == 64) {
-		  shrLog(
-			 "ERROR: Minimum work-group size 256 required by this application is not supported on this device.\n");
-		  exit(0);
-		}
+        // create the kernels
+        for (int k = 0; k < numKernels; k++)
+        {
+            kernels[k] = clCreateKernel(cpProgram, kernel_names[k], &ciErrNum);
+            oclCheckError(ciErrNum, CL_SUCCESS); 
+            shrLog("clCreateKernel %s\n", kernel_names[k]); 
+
+		    size_t wgSize;
+		    ciErrNum = clGetKernelWorkGroupInfo(kernels[k], cdDevices[0], CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &wgSize, NULL);
+		    if (wgSize == 64) {
+		      shrLog(
+			     "ERROR: Minimum work-group size 256 required by this application is not supported on this device.\n");
+		      exit(0);
+		    }
+        }
 	
 		free(pcSourceForDouble);
 
@@ -0,0 +1,400 @@
+#include "oclUtils.h"
+#include <memory.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "oclBodySystemOpenclTree.h"
+#include "oclBodySystemOpenclLaunch.h"
+
+// var to hold path to executable
+extern const char* cExecutablePath;
+
+static const char* clTreeSourcefile = "oclNbodyTreeKernel.cl";
+
+// must match oclNbodyTreeKernel.cl
+static const int RADIX_BITS  = 4;
+static const int RADIX       = 16;
+static const int RADIX_ITEMS = 16;
+static const int KEY_BITS    = 32;
+
+// upper limit of work-groups in the first bounding box pass
+static const int MAX_BOUNDS_GROUPS = 64;
+
+BodySystemOpenCLTree::BodySystemOpenCLTree(int numBodies, cl_device_id dev, cl_context ctx, cl_command_queue cmdq, float theta)
+: BodySystem(numBodies),
+  device(dev),
+  cxContext(ctx),
+  cqCommandQueue(cmdq),
+  cpProgram(0),
+  m_wgSize(256),
+  m_hPos(0),
+  m_hVel(0),
+  m_currentRead(0),
+  m_currentWrite(1)
+{
+    buildProgram();
+
+    _initialize(numBodies);
+
+    setSoftening(0.00125f);
+    setDamping(0.995f);
+    setTheta(theta);
+}
+
+BodySystemOpenCLTree::~BodySystemOpenCLTree()
+{
+    _finalize();
+    m_numBodies = 0;
+}
+
+void BodySystemOpenCLTree::buildProgram()
+{
+    size_t szSourceLen;
+    cl_int ciErrNum = CL_SUCCESS;
+
+    shrLog("\nLoading Uncompiled kernel from .cl file, using %s\n", clTreeSourcefile);
+    char* cPathAndFile = shrFindFilePath(clTreeSourcefile, cExecutablePath);
+    oclCheckError(cPathAndFile != NULL, shrTRUE);
+    char* pcSource = oclLoadProgSource(cPathAndFile, "", &szSourceLen);
+    oclCheckError(pcSource != NULL, shrTRUE);
+
+    cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&pcSource, &szSourceLen, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    free(pcSource);
+    shrLog("clCreateProgramWithSource\n");
+
+    ciErrNum = clBuildProgram(cpProgram, 0, NULL, "-cl-fast-relaxed-math", NULL, NULL);
+    if (ciErrNum != CL_SUCCESS)
+    {
+        // write out standard error and Build Log, then cleanup and exit
+        shrLogEx(LOGBOTH | ERRORMSG, ciErrNum, STDERROR);
+        oclLogBuildInfo(cpProgram, device);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+    }
+    shrLog("clBuildProgram\n");
+
+    cl_kernel* kernels[] = { &reduceBoundsKernel, &mortonKernel, &histogramKernel, &scanKernel, &scatterKernel,
+                             &gatherKernel, &buildTreeKernel, &centresOfMassKernel, &integrateKernel };
+    const char* names[] = { "reduceBounds", "computeMortonCodes", "radixHistogram", "scanExclusive", "radixScatter",
+                            "gatherSortedBodies", "buildRadixTree", "computeCentresOfMass", "integrateBodiesTree" };
+
+    // the sort and reduction kernels rely on a power of two work-group size
+    // of at least RADIX work-items, limit it by every kernel and by local memory
+    size_t maxWgSize = 0;
+    ciErrNum = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxWgSize, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    cl_ulong localMemSize = 0;
+    ciErrNum = clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemSize, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        *kernels[i] = clCreateKernel(cpProgram, names[i], &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+
+        size_t kernelWgSize = 0;
+        ciErrNum = clGetKernelWorkGroupInfo(*kernels[i], device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelWgSize, NULL);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        maxWgSize = std::min(maxWgSize, kernelWgSize);
+    }
+    shrLog("clCreateKernel\n");
+
+    while (m_wgSize > maxWgSize || m_wgSize * RADIX * sizeof(cl_uint) > localMemSize / 2)
+    {
+        m_wgSize /= 2;
+    }
+    if (m_wgSize < (size_t)RADIX)
+    {
+        exit(shrLogEx(LOGBOTH | CLOSELOG, -1, "ERROR: Work-group size %u required by the tree kernels is not supported on this device.\n", RADIX));
+    }
+    shrLog("Tree kernels work-group size = %u\n", (unsigned int)m_wgSize);
+}
+
+void BodySystemOpenCLTree::_initialize(int numBodies)
+{
+    oclCheckError(m_bInitialized, shrFALSE);
+    // the tree needs at least one internal node
+    oclCheckError(numBodies > 1, shrTRUE);
+
+    m_numBodies = numBodies;
+
+    m_hPos = new float[m_numBodies*4];
+    m_hVel = new float[m_numBodies*4];
+
+    memset(m_hPos, 0, m_numBodies*4*sizeof(float));
+    memset(m_hVel, 0, m_numBodies*4*sizeof(float));
+
+    AllocateNBodyArrays(cxContext, m_dPos, m_numBodies, false);
+    AllocateNBodyArrays(cxContext, m_dVel, m_numBodies, false);
+
+    m_boundsGroups = std::min((int)((m_numBodies + m_wgSize - 1) / m_wgSize), MAX_BOUNDS_GROUPS);
+    m_sortGroups = (int)((m_numBodies + m_wgSize * RADIX_ITEMS - 1) / (m_wgSize * RADIX_ITEMS));
+
+    int numNodes = m_numBodies - 1;
+    size_t bodyVecSize = sizeof(cl_float4) * m_numBodies;
+    size_t bodyIntSize = sizeof(cl_uint) * m_numBodies;
+    size_t nodeVecSize = sizeof(cl_float4) * numNodes;
+    size_t nodeIntSize = sizeof(cl_int) * numNodes;
+
+    cl_int ciErrNum = CL_SUCCESS;
+    cl_int ciErr;
+    m_dPartialMin = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float4) * m_boundsGroups, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dPartialMax = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float4) * m_boundsGroups, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dBoundsMin  = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float4), NULL, &ciErr); ciErrNum |= ciErr;
+    m_dBoundsMax  = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float4), NULL, &ciErr); ciErrNum |= ciErr;
+    for (int i = 0; i < 2; ++i)
+    {
+        m_dKeys[i]   = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, bodyIntSize, NULL, &ciErr); ciErrNum |= ciErr;
+        m_dValues[i] = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, bodyIntSize, NULL, &ciErr); ciErrNum |= ciErr;
+    }
+    m_dHistogram = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_uint) * RADIX * m_sortGroups, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dSortedPos = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, bodyVecSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dChildL    = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, nodeIntSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dChildR    = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, nodeIntSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dFlags     = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, nodeIntSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dParent    = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_int) * (numNodes + m_numBodies), NULL, &ciErr); ciErrNum |= ciErr;
+    m_dNodeCom   = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, nodeVecSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dNodeMin   = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, nodeVecSize, NULL, &ciErr); ciErrNum |= ciErr;
+    m_dNodeMax   = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, nodeVecSize, NULL, &ciErr); ciErrNum |= ciErr;
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    shrLog("\nAllocated tree arrays for %d bodies\n", m_numBodies);
+
+    m_bInitialized = true;
+}
+
+void BodySystemOpenCLTree::_finalize()
+{
+    oclCheckError(m_bInitialized, shrTRUE);
+
+    delete [] m_hPos;
+    delete [] m_hVel;
+
+    clReleaseKernel(reduceBoundsKernel);
+    clReleaseKernel(mortonKernel);
+    clReleaseKernel(histogramKernel);
+    clReleaseKernel(scanKernel);
+    clReleaseKernel(scatterKernel);
+    clReleaseKernel(gatherKernel);
+    clReleaseKernel(buildTreeKernel);
+    clReleaseKernel(centresOfMassKernel);
+    clReleaseKernel(integrateKernel);
+    clReleaseProgram(cpProgram);
+
+    DeleteNBodyArrays(m_dPos);
+    DeleteNBodyArrays(m_dVel);
+    DeleteNBodyArrays(m_dKeys);
+    DeleteNBodyArrays(m_dValues);
+    clReleaseMemObject(m_dPartialMin);
+    clReleaseMemObject(m_dPartialMax);
+    clReleaseMemObject(m_dBoundsMin);
+    clReleaseMemObject(m_dBoundsMax);
+    clReleaseMemObject(m_dHistogram);
+    clReleaseMemObject(m_dSortedPos);
+    clReleaseMemObject(m_dChildL);
+    clReleaseMemObject(m_dChildR);
+    clReleaseMemObject(m_dFlags);
+    clReleaseMemObject(m_dParent);
+    clReleaseMemObject(m_dNodeCom);
+    clReleaseMemObject(m_dNodeMin);
+    clReleaseMemObject(m_dNodeMax);
+}
+
+void BodySystemOpenCLTree::setSoftening(float softening)
+{
+    m_softeningSq = softening * softening;
+}
+
+void BodySystemOpenCLTree::setDamping(float damping)
+{
+    m_damping = damping;
+}
+
+void BodySystemOpenCLTree::setTheta(float theta)
+{
+    m_thetaSq = theta * theta;
+}
+
+void BodySystemOpenCLTree::enqueueKernel(cl_kernel kernel, size_t globalSize, size_t localSize)
+{
+    // round up to a multiple of the work-group size, kernels check the bounds
+    globalSize = ((globalSize + localSize - 1) / localSize) * localSize;
+    cl_int ciErrNum = clEnqueueNDRangeKernel(cqCommandQueue, kernel, 1, NULL, &globalSize, &localSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+// LSD radix sort of m_dKeys[0]/m_dValues[0], RADIX_BITS per pass.
+// The count of passes is even, so the result ends up in m_dKeys[0]/m_dValues[0] again.
+void BodySystemOpenCLTree::sortMortonCodes()
+{
+    cl_int ciErrNum = CL_SUCCESS;
+    int numHist = RADIX * m_sortGroups;
+    size_t sortGlobalSize = m_wgSize * m_sortGroups;
+
+    ciErrNum |= clSetKernelArg(scanKernel, 0, sizeof(cl_mem), (void *)&m_dHistogram);
+    ciErrNum |= clSetKernelArg(scanKernel, 1, sizeof(cl_int), (void *)&numHist);
+    ciErrNum |= clSetKernelArg(scanKernel, 2, m_wgSize * sizeof(cl_uint), NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    for (int shift = 0, src = 0; shift < KEY_BITS; shift += RADIX_BITS, src ^= 1)
+    {
+        int dst = src ^ 1;
+
+        ciErrNum |= clSetKernelArg(histogramKernel, 0, sizeof(cl_mem), (void *)&m_dKeys[src]);
+        ciErrNum |= clSetKernelArg(histogramKernel, 1, sizeof(cl_int), (void *)&m_numBodies);
+        ciErrNum |= clSetKernelArg(histogramKernel, 2, sizeof(cl_int), (void *)&shift);
+        ciErrNum |= clSetKernelArg(histogramKernel, 3, sizeof(cl_mem), (void *)&m_dHistogram);
+        ciErrNum |= clSetKernelArg(histogramKernel, 4, RADIX * sizeof(cl_uint), NULL);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        enqueueKernel(histogramKernel, sortGlobalSize, m_wgSize);
+
+        enqueueKernel(scanKernel, m_wgSize, m_wgSize);
+
+        ciErrNum |= clSetKernelArg(scatterKernel, 0, sizeof(cl_mem), (void *)&m_dKeys[src]);
+        ciErrNum |= clSetKernelArg(scatterKernel, 1, sizeof(cl_mem), (void *)&m_dValues[src]);
+        ciErrNum |= clSetKernelArg(scatterKernel, 2, sizeof(cl_mem), (void *)&m_dKeys[dst]);
+        ciErrNum |= clSetKernelArg(scatterKernel, 3, sizeof(cl_mem), (void *)&m_dValues[dst]);
+        ciErrNum |= clSetKernelArg(scatterKernel, 4, sizeof(cl_int), (void *)&m_numBodies);
+        ciErrNum |= clSetKernelArg(scatterKernel, 5, sizeof(cl_int), (void *)&shift);
+        ciErrNum |= clSetKernelArg(scatterKernel, 6, sizeof(cl_mem), (void *)&m_dHistogram);
+        ciErrNum |= clSetKernelArg(scatterKernel, 7, RADIX * m_wgSize * sizeof(cl_uint), NULL);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        enqueueKernel(scatterKernel, sortGlobalSize, m_wgSize);
+    }
+}
+
+void BodySystemOpenCLTree::update(float deltaTime)
+{
+    oclCheckError(m_bInitialized, shrTRUE);
+
+    cl_int ciErrNum = CL_SUCCESS;
+    cl_mem oldPos = m_dPos[m_currentRead];
+    cl_mem oldVel = m_dVel[m_currentRead];
+    int numPartial = m_boundsGroups;
+
+    // bounding box: partial boxes, then a single work-group over them
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 0, sizeof(cl_mem), (void *)&oldPos);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 1, sizeof(cl_mem), (void *)&oldPos);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 2, sizeof(cl_int), (void *)&m_numBodies);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 3, sizeof(cl_mem), (void *)&m_dPartialMin);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 4, sizeof(cl_mem), (void *)&m_dPartialMax);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 5, m_wgSize * sizeof(cl_float4), NULL);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 6, m_wgSize * sizeof(cl_float4), NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(reduceBoundsKernel, m_wgSize * m_boundsGroups, m_wgSize);
+
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 0, sizeof(cl_mem), (void *)&m_dPartialMin);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 1, sizeof(cl_mem), (void *)&m_dPartialMax);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 2, sizeof(cl_int), (void *)&numPartial);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 3, sizeof(cl_mem), (void *)&m_dBoundsMin);
+    ciErrNum |= clSetKernelArg(reduceBoundsKernel, 4, sizeof(cl_mem), (void *)&m_dBoundsMax);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(reduceBoundsKernel, m_wgSize, m_wgSize);
+
+    // Morton codes and their sort
+    ciErrNum |= clSetKernelArg(mortonKernel, 0, sizeof(cl_mem), (void *)&oldPos);
+    ciErrNum |= clSetKernelArg(mortonKernel, 1, sizeof(cl_mem), (void *)&m_dBoundsMin);
+    ciErrNum |= clSetKernelArg(mortonKernel, 2, sizeof(cl_mem), (void *)&m_dBoundsMax);
+    ciErrNum |= clSetKernelArg(mortonKernel, 3, sizeof(cl_int), (void *)&m_numBodies);
+    ciErrNum |= clSetKernelArg(mortonKernel, 4, sizeof(cl_mem), (void *)&m_dKeys[0]);
+    ciErrNum |= clSetKernelArg(mortonKernel, 5, sizeof(cl_mem), (void *)&m_dValues[0]);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(mortonKernel, m_numBodies, m_wgSize);
+
+    sortMortonCodes();
+
+    ciErrNum |= clSetKernelArg(gatherKernel, 0, sizeof(cl_mem), (void *)&oldPos);
+    ciErrNum |= clSetKernelArg(gatherKernel, 1, sizeof(cl_mem), (void *)&m_dValues[0]);
+    ciErrNum |= clSetKernelArg(gatherKernel, 2, sizeof(cl_mem), (void *)&m_dSortedPos);
+    ciErrNum |= clSetKernelArg(gatherKernel, 3, sizeof(cl_int), (void *)&m_numBodies);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(gatherKernel, m_numBodies, m_wgSize);
+
+    // tree topology and node data
+    ciErrNum |= clSetKernelArg(buildTreeKernel, 0, sizeof(cl_mem), (void *)&m_dKeys[0]);
+    ciErrNum |= clSetKernelArg(buildTreeKernel, 1, sizeof(cl_int), (void *)&m_numBodies);
+    ciErrNum |= clSetKernelArg(buildTreeKernel, 2, sizeof(cl_mem), (void *)&m_dChildL);
+    ciErrNum |= clSetKernelArg(buildTreeKernel, 3, sizeof(cl_mem), (void *)&m_dChildR);
+    ciErrNum |= clSetKernelArg(buildTreeKernel, 4, sizeof(cl_mem), (void *)&m_dParent);
+    ciErrNum |= clSetKernelArg(buildTreeKernel, 5, sizeof(cl_mem), (void *)&m_dFlags);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(buildTreeKernel, m_numBodies - 1, m_wgSize);
+
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 0, sizeof(cl_mem), (void *)&m_dSortedPos);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 1, sizeof(cl_int), (void *)&m_numBodies);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 2, sizeof(cl_mem), (void *)&m_dChildL);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 3, sizeof(cl_mem), (void *)&m_dChildR);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 4, sizeof(cl_mem), (void *)&m_dParent);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 5, sizeof(cl_mem), (void *)&m_dNodeCom);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 6, sizeof(cl_mem), (void *)&m_dNodeMin);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 7, sizeof(cl_mem), (void *)&m_dNodeMax);
+    ciErrNum |= clSetKernelArg(centresOfMassKernel, 8, sizeof(cl_mem), (void *)&m_dFlags);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(centresOfMassKernel, m_numBodies, m_wgSize);
+
+    // tree walk and integration
+    ciErrNum |= clSetKernelArg(integrateKernel, 0, sizeof(cl_mem), (void *)&m_dPos[m_currentWrite]);
+    ciErrNum |= clSetKernelArg(integrateKernel, 1, sizeof(cl_mem), (void *)&m_dVel[m_currentWrite]);
+    ciErrNum |= clSetKernelArg(integrateKernel, 2, sizeof(cl_mem), (void *)&oldVel);
+    ciErrNum |= clSetKernelArg(integrateKernel, 3, sizeof(cl_mem), (void *)&m_dSortedPos);
+    ciErrNum |= clSetKernelArg(integrateKernel, 4, sizeof(cl_mem), (void *)&m_dValues[0]);
+    ciErrNum |= clSetKernelArg(integrateKernel, 5, sizeof(cl_mem), (void *)&m_dChildL);
+    ciErrNum |= clSetKernelArg(integrateKernel, 6, sizeof(cl_mem), (void *)&m_dChildR);
+    ciErrNum |= clSetKernelArg(integrateKernel, 7, sizeof(cl_mem), (void *)&m_dNodeCom);
+    ciErrNum |= clSetKernelArg(integrateKernel, 8, sizeof(cl_mem), (void *)&m_dNodeMin);
+    ciErrNum |= clSetKernelArg(integrateKernel, 9, sizeof(cl_mem), (void *)&m_dNodeMax);
+    ciErrNum |= clSetKernelArg(integrateKernel, 10, sizeof(cl_float), (void *)&deltaTime);
+    ciErrNum |= clSetKernelArg(integrateKernel, 11, sizeof(cl_float), (void *)&m_damping);
+    ciErrNum |= clSetKernelArg(integrateKernel, 12, sizeof(cl_float), (void *)&m_softeningSq);
+    ciErrNum |= clSetKernelArg(integrateKernel, 13, sizeof(cl_float), (void *)&m_thetaSq);
+    ciErrNum |= clSetKernelArg(integrateKernel, 14, sizeof(cl_int), (void *)&m_numBodies);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueKernel(integrateKernel, m_numBodies, m_wgSize);
+
+    std::swap(m_currentRead, m_currentWrite);
+}
+
+float* BodySystemOpenCLTree::getArray(BodyArray array)
+{
+    oclCheckError(m_bInitialized, shrTRUE);
+
+    float *hdata = 0;
+    cl_mem ddata = 0;
+
+    switch (array)
+    {
+        default:
+        case BODYSYSTEM_POSITION:
+            hdata = m_hPos;
+            ddata = m_dPos[m_currentRead];
+            break;
+        case BODYSYSTEM_VELOCITY:
+            hdata = m_hVel;
+            ddata = m_dVel[m_currentRead];
+            break;
+    }
+
+    CopyArrayFromDevice(cqCommandQueue, hdata, ddata, 0, m_numBodies, false);
+
+    return hdata;
+}
+
+void BodySystemOpenCLTree::setArray(BodyArray array, const float* data)
+{
+    oclCheckError(m_bInitialized, shrTRUE);
+
+    switch (array)
+    {
+        default:
+        case BODYSYSTEM_POSITION:
+            CopyArrayToDevice(cqCommandQueue, m_dPos[m_currentRead], data, m_numBodies, false);
+            break;
+        case BODYSYSTEM_VELOCITY:
+            CopyArrayToDevice(cqCommandQueue, m_dVel[m_currentRead], data, m_numBodies, false);
+            break;
+    }
+}
+
+void BodySystemOpenCLTree::synchronizeThreads() const
+{
+    ThreadSync(cqCommandQueue);
+}
@@ -29,11 +29,17 @@
 // Includes
 #include <paramgl.h>
 #include <algorithm>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
 
 // Project includes
 #include "oclBodySystemOpencl.h"
+#include "oclBodySystemOpenclTree.h"
 #include "oclBodySystemCpu.h"
 #include "oclRenderParticles.h"
+#include "oclNbodyCheckpoint.h"
 
 // OpenCL and Shared QA Test Includes 
 #include <oclUtils.h>
@@ -103,6 +109,12 @@ NBodyParams demoParams[] =
 // Basic simulation parameters
 int numBodies = 7680;               // default # of bodies in sim (can be overridden by command line switch --n=<N>)
 bool bDouble = false;               //false: sp float, true: dp 
+bool bTree = false;                 //false: all-pairs O(N^2), true: Barnes-Hut tree O(N log N)
+float fTheta = 0.5f;                // Barnes-Hut opening angle (can be overridden by command line switch --theta=<theta>)
+NBodyIntegrator integrator = NBODY_INTEGRATOR_EULER;  // --integrator=euler|leapfrog|yoshida
+const char* cIntegratorArgs[NBODY_NUM_INTEGRATORS] = {"euler", "leapfrog", "yoshida"};
+int iBlockLevels = 0;               // block time step levels for the leapfrog, 0 = global step (--block-levels=<L>)
+float fEta = 0.3f;                  // block time step accuracy parameter (--eta=<eta>)
 int numDemos = sizeof(demoParams) / sizeof(NBodyParams);
 int activeDemo = 0;
 NBodyParams activeParams = demoParams[activeDemo];
@@ -139,6 +151,14 @@ shrBOOL bNoPrompt = shrFALSE;       // false = normal GL loop, true = Finite per
 shrBOOL bQATest = shrFALSE;         // false = normal GL loop, true = run No-GL test sequence (checks against host and also does a perf test)
 int iTestSets = 3;
 
+// headless batch mode vars
+shrBOOL bBatch = shrFALSE;          // true = run a sweep over n/p/q without GL and print machine-readable results
+int iBatchSteps = 100;              // # of steps in every batch run (--steps=<N>)
+int iCheckpointInterval = 0;        // write a checkpoint every K steps, 0 = only at the end (--checkpoint-interval=<K>)
+char* cCheckpointFile = NULL;       // checkpoint file (--checkpoint=<file>)
+char* cRestartFile = NULL;          // checkpoint to restart from (--restart=<file>)
+char* cCsvFile = NULL;              // file to append batch results to (--csv=<file>)
+
 // Forward Function declarations
 //*****************************************************************************
 // OpenGL (GLUT) functionality
@@ -154,9 +174,12 @@ void SpecialGL (int key, int x, int y);
 // Simulation
 void ResetSim(BodySystem *system, int numBodies, NBodyConfig config, bool useGL);
 void InitNbody(cl_device_id dev, cl_context ctx, cl_command_queue cmdq,
-               int numBodies, int p, int q, bool bUsePBO, bool bDouble);
+               int numBodies, int p, int q, bool bUsePBO, bool bDouble, bool bTree);
 void SelectDemo(int index);
 bool CompareResults(int numBodies);
+void CompareTreeWithAllPairs(int iterations, int p, int q);
+void SetClusterParams(int numBodies);
+bool RunBatch(int argc, const char** argv, int p, int q);
 void RunProfiling(int iterations, unsigned int uiWorkgroup);
 void ComputePerfStats(double &dGigaInteractionsPerSecond, double &dGigaFlops, 
                       double dSeconds, int iterations);
@@ -191,7 +214,21 @@ int main(int argc, char** argv)
     shrLog("  --n=<numbodies>\tSpecify # of bodies to simulate (default = %d)\n", numBodies);
 	shrLog("  --double\t\tUse double precision floating point values for simulation\n");
 	shrLog("  --p=<workgroup X dim>\tSpecify X dimension of workgroup (default = %d)\n", p);
-	shrLog("  --q=<workgroup Y dim>\tSpecify Y dimension of workgroup (default = %d)\n\n", q);
+	shrLog("  --q=<workgroup Y dim>\tSpecify Y dimension of workgroup (default = %d)\n", q);
+	shrLog("  --tree\t\t\tUse Barnes-Hut tree instead of all-pairs forces (single precision only)\n");
+	shrLog("  --theta=<theta>\tSpecify Barnes-Hut opening angle (default = %.2f)\n", fTheta);
+	shrLog("  --integrator=<name>\teuler (default), leapfrog or yoshida\n");
+	shrLog("  --block-levels=<L>\tLeapfrog with block time steps down to step/2^L (default = %d, global step)\n", iBlockLevels);
+	shrLog("  --eta=<eta>\t\tBlock time step criterion dt <= eta*sqrt(softening/|a|) (default = %.2f)\n", fEta);
+	shrLog("  --batch\t\tRun headless benchmark over --nlist/--plist/--qlist and print CSV results\n");
+	shrLog("  --nlist=<n1,n2,...>\tBody counts for --batch (default = --n)\n");
+	shrLog("  --plist=<p1,p2,...>\tWorkgroup X dimensions for --batch (default = --p)\n");
+	shrLog("  --qlist=<q1,q2,...>\tWorkgroup Y dimensions for --batch (default = --q)\n");
+	shrLog("  --steps=<N>\t\tSteps per batch run (default = %d)\n", iBatchSteps);
+	shrLog("  --csv=<file>\t\tAlso append batch results to file\n");
+	shrLog("  --checkpoint=<file>\tWrite binary body state to file in batch mode\n");
+	shrLog("  --checkpoint-interval=<K>\tCheckpoint every K steps (default = only at the end)\n");
+	shrLog("  --restart=<file>\tContinue a batch run from checkpoint file up to --steps\n\n");
 
 	// Get command line arguments if there are any and set vars accordingly
     if (argc > 0)
@@ -202,6 +239,42 @@ int main(int argc, char** argv)
 	    bDouble = (shrTRUE == shrCheckCmdLineFlag(argc, (const char**)argv, "double"));
         bNoPrompt = shrCheckCmdLineFlag(argc, (const char**)argv, "noprompt");
         bQATest = shrCheckCmdLineFlag(argc, (const char**)argv, "qatest");
+        bTree = (shrTRUE == shrCheckCmdLineFlag(argc, (const char**)argv, "tree"));
+        shrGetCmdLineArgumentf(argc, (const char**)argv, "theta", &fTheta);
+        char* cIntegrator = NULL;
+        if (shrGetCmdLineArgumentstr(argc, (const char**)argv, "integrator", &cIntegrator) == shrTRUE)
+        {
+            if (strcmp(cIntegrator, "leapfrog") == 0)
+            {
+                integrator = NBODY_INTEGRATOR_LEAPFROG;
+            }
+            else if (strcmp(cIntegrator, "yoshida") == 0)
+            {
+                integrator = NBODY_INTEGRATOR_YOSHIDA4;
+            }
+            else if (strcmp(cIntegrator, "euler") != 0)
+            {
+                shrLog("Unknown integrator %s, using euler\n", cIntegrator);
+            }
+            free(cIntegrator);
+        }
+        shrGetCmdLineArgumenti(argc, (const char**)argv, "block-levels", &iBlockLevels);
+        shrGetCmdLineArgumentf(argc, (const char**)argv, "eta", &fEta);
+        if (iBlockLevels > 0)
+        {
+            // block time steps are built on the leapfrog
+            integrator = NBODY_INTEGRATOR_LEAPFROG;
+        }
+        bBatch = shrCheckCmdLineFlag(argc, (const char**)argv, "batch");
+        shrGetCmdLineArgumenti(argc, (const char**)argv, "steps", &iBatchSteps);
+        shrGetCmdLineArgumenti(argc, (const char**)argv, "checkpoint-interval", &iCheckpointInterval);
+        shrGetCmdLineArgumentstr(argc, (const char**)argv, "checkpoint", &cCheckpointFile);
+        shrGetCmdLineArgumentstr(argc, (const char**)argv, "restart", &cRestartFile);
+        shrGetCmdLineArgumentstr(argc, (const char**)argv, "csv", &cCsvFile);
+        if (cRestartFile != NULL)
+        {
+            bBatch = shrTRUE;
+        }
     }
     bQATest = shrTRUE;
     //Get the NVIDIA platform
@@ -209,6 +282,25 @@ int main(int argc, char** argv)
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     shrLog("clGetPlatformID...\n\n"); 
 	
+	if (bTree)
+	{
+		if (bDouble)
+		{
+			shrLog("Barnes-Hut tree supports single precision only, --double is ignored\n");
+			bDouble = false;
+		}
+		shrLog("Barnes-Hut tree execution, theta = %.2f...\n", fTheta);
+		if (integrator != NBODY_INTEGRATOR_EULER)
+		{
+			shrLog("Barnes-Hut tree uses the Euler integrator, --integrator and --block-levels are ignored\n");
+		}
+	}
+	else if (integrator != NBODY_INTEGRATOR_EULER)
+	{
+		const char* cNames[] = {"Euler", "leapfrog", "Yoshida 4th order"};
+		shrLog("%s integrator, block time step levels = %d, eta = %.2f...\n", cNames[integrator], iBlockLevels, fEta);
+	}
+
 	if (bDouble)
 	{
 		shrLog("Double precision execution...\n\n");
@@ -252,37 +344,7 @@ int main(int argc, char** argv)
 
     // Log and config for number of bodies
     shrLog("Number of Bodies = %d\n", numBodies); 
-    switch (numBodies)
-    {
-        case 1024:
-            activeParams.m_clusterScale = 1.52f;
-            activeParams.m_velocityScale = 2.f;
-            break;
-        case 2048:
-            activeParams.m_clusterScale = 1.56f;
-            activeParams.m_velocityScale = 2.64f;
-            break;
-        case 4096:
-            activeParams.m_clusterScale = 1.68f;
-            activeParams.m_velocityScale = 2.98f;
-            break;
-        case 7680:
-        case 8192:
-            activeParams.m_clusterScale = 1.98f;
-            activeParams.m_velocityScale = 2.9f;
-            break;
-        default:
-        case 15360:
-        case 16384:
-            activeParams.m_clusterScale = 1.54f;
-            activeParams.m_velocityScale = 8.f;
-            break;
-        case 30720:
-        case 32768:
-            activeParams.m_clusterScale = 1.44f;
-            activeParams.m_velocityScale = 11.f;
-            break;
-    }
+    SetClusterParams(numBodies);
 
     if ((q * p) > 256)
     {
@@ -297,6 +359,13 @@ int main(int argc, char** argv)
     }
     shrLog("Workgroup Dims = (%d x %d)\n\n", p, q); 
 
+    // Headless benchmark, no GL and no comparison to host
+    if (bBatch == shrTRUE)
+    {
+        bool bBatchResults = RunBatch(argc, (const char**)argv, p, q);
+        Cleanup(bBatchResults ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
     // Initialize OpenGL items if using GL 
     if (bQATest == shrFALSE)
     {
@@ -310,7 +379,7 @@ int main(int argc, char** argv)
 	
     // CL/GL interop disabled
     bUsePBO = (false && (bQATest == shrFALSE));
-    InitNbody(cdDevices[uiTargetDevice], cxContext, cqCommandQueue, numBodies, p, q, bUsePBO, bDouble);
+    InitNbody(cdDevices[uiTargetDevice], cxContext, cqCommandQueue, numBodies, p, q, bUsePBO, bDouble, bTree);
     ResetSim(nbody, numBodies, NBODY_CONFIG_SHELL, bUsePBO);
 
     // init timers
@@ -336,6 +405,12 @@ int main(int argc, char** argv)
     // Compare to host, profile and write out file for regression analysis
     if (bQATest == shrTRUE) {
 	    bool bTestResults = false;
+        if (bTree)
+        {
+            shrLog("Comparing Barnes-Hut tree to all-pairs...\n\n");
+            CompareTreeWithAllPairs(10, p, q);
+        }
+
         shrLog("Running oclNbody Results Comparison...\n\n"); 
         bTestResults = CompareResults(numBodies);
 
@@ -667,6 +742,7 @@ void RunProfiling(int iterations, unsigned int uiWorkgroup)
     // once without timing to prime the GPU
     nbody->update(activeParams.m_timestep);
     nbody->synchronizeThreads();
+    unsigned long long forceEvaluations = nbodyGPU ? nbodyGPU->getForceEvaluations() : 0;
 
 	// Start timer 0 and process n loops on the GPU
     shrDeltaT(FUNCTIME);
@@ -678,9 +754,22 @@ void RunProfiling(int iterations, unsigned int uiWorkgroup)
 
     // Get elapsed time and throughput, then log to sample and master logs
     double dSeconds = shrDeltaT(FUNCTIME);
+    if (nbodyGPU && integrator != NBODY_INTEGRATOR_EULER)
+    {
+        // all-pairs interactions actually computed, not n^2 per step
+        shrLog("Force evaluations per body per step = %.3f\n", 
+               (double)(nbodyGPU->getForceEvaluations() - forceEvaluations) / ((double)numBodies * iterations));
+    }
     double dGigaInteractionsPerSecond = 0.0;
     double dGigaFlops = 0.0;
     ComputePerfStats(dGigaInteractionsPerSecond, dGigaFlops, dSeconds, iterations);
+    if (bTree)
+    {
+        // interactions are not N^2 with the tree, so throughput is given as equivalent all-pairs rate
+        shrLogEx(LOGBOTH | MASTER, 0, "oclNBody-BH, Throughput = %.4f MBodies/s (all-pairs equivalent %.4f GFLOP/s), Time = %.5f s, Size = %u bodies, NumDevsUsed = %u, Theta = %.2f\n", 
+            1.0e-6 * (double)numBodies * (double)iterations / dSeconds, dGigaFlops, dSeconds/(double)iterations, numBodies, uiNumDevsUsed, fTheta); 
+        return;
+    }
     shrLogEx(LOGBOTH | MASTER, 0, "oclNBody-%s, Throughput = %.4f GFLOP/s, Time = %.5f s, Size = %u bodies, NumDevsUsed = %u, Workgroup = %u\n", 
         (bDouble ? "DP" : "SP"), dGigaFlops, dSeconds/(double)iterations, numBodies, uiNumDevsUsed, uiWorkgroup); 
 }
@@ -821,11 +910,19 @@ void ResetSim(BodySystem *system, int numBodies, NBodyConfig config, bool useGL)
 
 //*****************************************************************************
 void InitNbody(cl_device_id dev, cl_context ctx, cl_command_queue cmdq,
-               int numBodies, int p, int q, bool bUsePBO, bool bDouble)
+               int numBodies, int p, int q, bool bUsePBO, bool bDouble, bool bTree)
 {
     // New nbody system for Device/GPU computations
-    nbodyGPU = new BodySystemOpenCL(numBodies, dev, ctx, cmdq, p, q, bUsePBO, bDouble);
-    nbody = nbodyGPU;
+    if (bTree)
+    {
+        nbody = new BodySystemOpenCLTree(numBodies, dev, ctx, cmdq, fTheta);
+    }
+    else
+    {
+        nbodyGPU = new BodySystemOpenCL(numBodies, dev, ctx, cmdq, p, q, bUsePBO, bDouble);
+        nbodyGPU->setIntegrator(integrator, iBlockLevels, fEta);
+        nbody = nbodyGPU;
+    }
 
     // allocate host memory
     hPos = new float[numBodies*4];
@@ -857,12 +954,12 @@ bool CompareResults(int numBodies)
 {
     // Run computation on the device/GPU
     shrLog("  Computing on the Device / GPU...\n");
-    nbodyGPU->update(0.001f);
-    nbodyGPU->synchronizeThreads();
+    nbody->update(0.001f);
+    nbody->synchronizeThreads();
 
     // Write out device/GPU data file for regression analysis
     shrLog("  Writing out Device/GPU data file for analysis...\n");
-    float* fGPUData = nbodyGPU->getArray(BodySystem::BODYSYSTEM_POSITION);
+    float* fGPUData = nbody->getArray(BodySystem::BODYSYSTEM_POSITION);
     shrWriteFilef( "oclNbody_Regression.dat", fGPUData, numBodies, 0.0, false);
 
     // Run computation on the host CPU
@@ -874,7 +971,7 @@ bool CompareResults(int numBodies)
 
     // Check if result matches 
     shrBOOL bMatch = shrComparefe(fGPUData, 
-                        nbodyGPU->getArray(BodySystem::BODYSYSTEM_POSITION), 
+                        nbody->getArray(BodySystem::BODYSYSTEM_POSITION), 
 						numBodies, .001f);
     shrLog("Results %s\n\n", (shrTRUE == bMatch) ? "Match" : "do not match!");
 
@@ -884,6 +981,411 @@ bool CompareResults(int numBodies)
     return (shrTRUE == bMatch);
 }
 
+// Initial cluster and velocity scale that keep the demo stable for a given # of bodies
+//*****************************************************************************
+void SetClusterParams(int numBodies)
+{
+    switch (numBodies)
+    {
+        case 1024:
+            activeParams.m_clusterScale = 1.52f;
+            activeParams.m_velocityScale = 2.f;
+            break;
+        case 2048:
+            activeParams.m_clusterScale = 1.56f;
+            activeParams.m_velocityScale = 2.64f;
+            break;
+        case 4096:
+            activeParams.m_clusterScale = 1.68f;
+            activeParams.m_velocityScale = 2.98f;
+            break;
+        case 7680:
+        case 8192:
+            activeParams.m_clusterScale = 1.98f;
+            activeParams.m_velocityScale = 2.9f;
+            break;
+        default:
+        case 15360:
+        case 16384:
+            activeParams.m_clusterScale = 1.54f;
+            activeParams.m_velocityScale = 8.f;
+            break;
+        case 30720:
+        case 32768:
+            activeParams.m_clusterScale = 1.44f;
+            activeParams.m_velocityScale = 11.f;
+            break;
+    }
+}
+
+// Splits a comma separated list of positive integers, e.g. --nlist=1024,2048
+//*****************************************************************************
+static void GetCmdLineIntList(int argc, const char** argv, const char* name, int defaultValue, std::vector<int>& values)
+{
+    char* cList = NULL;
+    values.clear();
+    if (shrGetCmdLineArgumentstr(argc, argv, name, &cList) == shrTRUE)
+    {
+        for (char* cToken = strtok(cList, ","); cToken != NULL; cToken = strtok(NULL, ","))
+        {
+            int value = atoi(cToken);
+            if (value > 0)
+            {
+                values.push_back(value);
+            }
+        }
+        free(cList);
+    }
+    if (values.empty())
+    {
+        values.push_back(defaultValue);
+    }
+}
+
+// Frees the body system and host arrays created by InitNbody
+//*****************************************************************************
+static void FreeNbody()
+{
+    delete nbody;
+    nbody = 0;
+    nbodyGPU = 0;
+    delete [] hPos;
+    delete [] hVel;
+    delete [] hColor;
+    hPos = hVel = hColor = 0;
+}
+
+// Headless benchmark: runs iBatchSteps steps for every n/p/q combination
+// and prints one CSV line per run. Time spent in checkpoints is not counted.
+// With a sweep every run gets its own checkpoint file (<file>_n<n>_p<p>_q<q>),
+// a restart continues a single run with the settings stored in the checkpoint.
+//*****************************************************************************
+bool RunBatch(int argc, const char** argv, int p, int q)
+{
+    std::vector<int> nList, pList, qList;
+    GetCmdLineIntList(argc, argv, "nlist", numBodies, nList);
+    GetCmdLineIntList(argc, argv, "plist", p, pList);
+    GetCmdLineIntList(argc, argv, "qlist", q, qList);
+
+    NBodyCheckpointHeader restart;
+    if (cRestartFile)
+    {
+        if (!ReadCheckpointHeader(cRestartFile, restart))
+        {
+            shrLogEx(LOGBOTH | ERRORMSG, -1, "Cannot read checkpoint %s\n", cRestartFile);
+            return false;
+        }
+        nList.assign(1, restart.numBodies);
+        pList.assign(1, restart.p);
+        qList.assign(1, restart.q);
+        bDouble = (restart.bDouble != 0);
+        bTree = (restart.bTree != 0);
+        fTheta = restart.theta;
+        flopsPerInteraction = bDouble ? 30 : 20;
+
+        // the integrator belongs to the run, a restart may not switch it
+        bool bIntegratorArg = (shrTRUE == shrCheckCmdLineFlag(argc, argv, "integrator"));
+        bool bLevelsArg = (shrTRUE == shrCheckCmdLineFlag(argc, argv, "block-levels"));
+        bool bEtaArg = (shrTRUE == shrCheckCmdLineFlag(argc, argv, "eta"));
+        if (((bIntegratorArg || bLevelsArg) && (int)integrator != restart.integrator) ||
+            (bLevelsArg && iBlockLevels != restart.blockLevels) ||
+            (bEtaArg && fEta != restart.eta))
+        {
+            shrLogEx(LOGBOTH | ERRORMSG, -1, "Checkpoint %s was written with --integrator=%s --block-levels=%d --eta=%g, "
+                     "the command line asks for a different integrator\n",
+                     cRestartFile, cIntegratorArgs[restart.integrator % NBODY_NUM_INTEGRATORS], restart.blockLevels, restart.eta);
+            return false;
+        }
+        integrator = (NBodyIntegrator)(restart.integrator % NBODY_NUM_INTEGRATORS);
+        iBlockLevels = restart.blockLevels;
+        fEta = restart.eta;
+        if (!cCheckpointFile)
+        {
+            cCheckpointFile = cRestartFile;
+        }
+        shrLog("Restarting from %s at step %lld of %d\n\n", cRestartFile, restart.step, iBatchSteps);
+    }
+    if (bTree)
+    {
+        // workgroup dims are not used by the tree
+        pList.resize(1);
+        qList.resize(1);
+    }
+    bool bSweep = (nList.size() * pList.size() * qList.size() > 1);
+
+    FILE* csv = cCsvFile ? fopen(cCsvFile, "a") : NULL;
+    const char* cCsvHeader = "mode,n,p,q,steps,seconds,seconds_per_step,mbodies_per_s,ginteractions_per_s,gflops,evals_per_body_step\n";
+    shrLog("%s", cCsvHeader);
+    if (csv && ftell(csv) == 0)
+    {
+        fprintf(csv, "%s", cCsvHeader);
+    }
+
+    bool bOk = true;
+    for (size_t in = 0; in < nList.size(); in++)
+    for (size_t ip = 0; ip < pList.size(); ip++)
+    for (size_t iq = 0; iq < qList.size(); iq++)
+    {
+        int n = nList[in];
+        int pp = pList[ip];
+        int qq = qList[iq];
+        if (!bTree && (pp * qq > 256 || n % pp != 0))
+        {
+            shrLog("# skipping n=%d p=%d q=%d: p*q must be <= 256 and n a multiple of p\n", n, pp, qq);
+            continue;
+        }
+
+        numBodies = n;
+        SetClusterParams(n);
+        InitNbody(cdDevices[uiTargetDevice], cxContext, cqCommandQueue, n, pp, qq, false, bDouble, bTree);
+
+        std::string checkpoint;
+        if (cCheckpointFile)
+        {
+            checkpoint = cCheckpointFile;
+            if (bSweep)
+            {
+                char cSuffix[64];
+                sprintf(cSuffix, "_n%d_p%d_q%d", n, pp, qq);
+                checkpoint += cSuffix;
+            }
+        }
+
+        // double precision state goes to and from the device without
+        // being rounded to the float host arrays
+        std::vector<double> dPos, dVel;
+        if (bDouble)
+        {
+            dPos.resize((size_t)n * 4);
+            dVel.resize((size_t)n * 4);
+        }
+
+        long long step = 0;
+        if (cRestartFile)
+        {
+            bool bRead = bDouble ? ReadCheckpoint(cRestartFile, restart, &dPos[0], &dVel[0])
+                                 : ReadCheckpoint(cRestartFile, restart, hPos, hVel);
+            if (!bRead)
+            {
+                shrLogEx(LOGBOTH | ERRORMSG, -1, "Cannot read checkpoint %s\n", cRestartFile);
+                FreeNbody();
+                bOk = false;
+                break;
+            }
+            step = restart.step;
+            activeParams.m_timestep = restart.timestep;
+            activeParams.m_softening = restart.softening;
+            activeParams.m_damping = restart.damping;
+            nbody->setSoftening(activeParams.m_softening);
+            nbody->setDamping(activeParams.m_damping);
+            if (bDouble)
+            {
+                nbodyGPU->setArrayDouble(BodySystem::BODYSYSTEM_POSITION, &dPos[0]);
+                nbodyGPU->setArrayDouble(BodySystem::BODYSYSTEM_VELOCITY, &dVel[0]);
+            }
+            else
+            {
+                nbody->setArray(BodySystem::BODYSYSTEM_POSITION, hPos);
+                nbody->setArray(BodySystem::BODYSYSTEM_VELOCITY, hVel);
+            }
+        }
+        else
+        {
+            ResetSim(nbody, n, NBODY_CONFIG_SHELL, false);
+        }
+
+        NBodyCheckpointHeader header;
+        memset(&header, 0, sizeof(header));
+        header.numBodies = n;
+        header.bDouble = bDouble ? 1 : 0;
+        header.bTree = bTree ? 1 : 0;
+        header.p = pp;
+        header.q = qq;
+        header.integrator = bTree ? NBODY_INTEGRATOR_EULER : integrator;
+        header.blockLevels = bTree ? 0 : iBlockLevels;
+        header.eta = fEta;
+        header.timestep = activeParams.m_timestep;
+        header.softening = activeParams.m_softening;
+        header.damping = activeParams.m_damping;
+        header.theta = fTheta;
+
+        // the first step is not timed, it includes kernel warm-up
+        double dSeconds = 0.0;
+        long long timedSteps = 0;
+        bool bWarm = false;
+        while (step < iBatchSteps)
+        {
+            long long chunk = bWarm ? iBatchSteps - step : 1;
+            if (iCheckpointInterval > 0)
+            {
+                chunk = min(chunk, iCheckpointInterval - step % iCheckpointInterval);
+            }
+
+            shrDeltaT(FUNCTIME);
+            for (long long i = 0; i < chunk; i++)
+            {
+                nbody->update(activeParams.m_timestep);
+            }
+            nbody->synchronizeThreads();
+            double dChunkSeconds = shrDeltaT(FUNCTIME);
+            if (bWarm)
+            {
+                dSeconds += dChunkSeconds;
+                timedSteps += chunk;
+            }
+            bWarm = true;
+            step += chunk;
+
+            bool bLast = (step >= iBatchSteps);
+            if (!checkpoint.empty() && (bLast || (iCheckpointInterval > 0 && step % iCheckpointInterval == 0)))
+            {
+                header.step = step;
+                bool bWritten;
+                if (bDouble)
+                {
+                    nbodyGPU->getArrayDouble(BodySystem::BODYSYSTEM_POSITION, &dPos[0]);
+                    nbodyGPU->getArrayDouble(BodySystem::BODYSYSTEM_VELOCITY, &dVel[0]);
+                    bWritten = WriteCheckpoint(checkpoint.c_str(), header, &dPos[0], &dVel[0]);
+                }
+                else
+                {
+                    float* fPos = nbody->getArray(BodySystem::BODYSYSTEM_POSITION);
+                    float* fVel = nbody->getArray(BodySystem::BODYSYSTEM_VELOCITY);
+                    bWritten = WriteCheckpoint(checkpoint.c_str(), header, fPos, fVel);
+                }
+                if (!bWritten)
+                {
+                    shrLogEx(LOGBOTH | ERRORMSG, -1, "Cannot write checkpoint %s\n", checkpoint.c_str());
+                    bOk = false;
+                }
+            }
+        }
+
+        // force evaluations per body per step: 1 for the Euler and the leapfrog,
+        // 3 for Yoshida, and with block time steps the mean of 2^level over the
+        // bodies, so never less than 1
+        double dEvalsPerBodyStep = 1.0;
+        if (nbodyGPU && step > 0)
+        {
+            dEvalsPerBodyStep = (double)nbodyGPU->getForceEvaluations() / ((double)n * (double)(step - (cRestartFile ? restart.step : 0)));
+        }
+
+        double dGigaInteractionsPerSecond = 0.0;
+        double dGigaFlops = 0.0;
+        double dMBodiesPerSecond = 0.0;
+        if (timedSteps > 0 && dSeconds > 0.0)
+        {
+            ComputePerfStats(dGigaInteractionsPerSecond, dGigaFlops, dSeconds, (int)timedSteps);
+            dMBodiesPerSecond = 1.0e-6 * (double)n * (double)timedSteps / dSeconds;
+        }
+
+        // mode: precision or tree, integrator and block time step levels, e.g. SP-leapfrog-L3
+        char cMode[64];
+        if (bTree)
+        {
+            sprintf(cMode, "BH-%s", cIntegratorArgs[NBODY_INTEGRATOR_EULER]);
+        }
+        else if (iBlockLevels > 0)
+        {
+            sprintf(cMode, "%s-%s-L%d", bDouble ? "DP" : "SP", cIntegratorArgs[integrator], iBlockLevels);
+        }
+        else
+        {
+            sprintf(cMode, "%s-%s", bDouble ? "DP" : "SP", cIntegratorArgs[integrator]);
+        }
+
+        char cLine[256];
+        sprintf(cLine, "%s,%d,%d,%d,%lld,%.6f,%.6e,%.4f,%.4f,%.4f,%.4f\n",
+                cMode, n, pp, qq, timedSteps, dSeconds,
+                timedSteps > 0 ? dSeconds / (double)timedSteps : 0.0,
+                dMBodiesPerSecond, dGigaInteractionsPerSecond * dEvalsPerBodyStep, dGigaFlops * dEvalsPerBodyStep,
+                dEvalsPerBodyStep);
+        shrLog("%s", cLine);
+        if (csv)
+        {
+            fprintf(csv, "%s", cLine);
+            fflush(csv);
+        }
+
+        FreeNbody();
+    }
+
+    if (csv)
+    {
+        fclose(csv);
+    }
+    return bOk;
+}
+
+// Runs the tree and the all-pairs systems from the same state:
+// force error of the tree after one step and time per step of both
+//*****************************************************************************
+void CompareTreeWithAllPairs(int iterations, int p, int q)
+{
+    const float dt = 0.001f;
+    BodySystemOpenCL* nbodyAllPairs = new BodySystemOpenCL(numBodies, cdDevices[uiTargetDevice], cxContext, cqCommandQueue, 
+                                                           p, q, false, false);
+    nbodyAllPairs->setSoftening(activeParams.m_softening);
+    nbodyAllPairs->setDamping(activeParams.m_damping);
+
+    BodySystem* systems[2] = {nbody, nbodyAllPairs};
+    float* accel[2];
+    double dSeconds[2];
+    for (int s = 0; s < 2; s++)
+    {
+        systems[s]->setArray(BodySystem::BODYSYSTEM_POSITION, hPos);
+        systems[s]->setArray(BodySystem::BODYSYSTEM_VELOCITY, hVel);
+        systems[s]->update(dt);
+
+        // recover acceleration from the velocity update v' = (v + a * dt) * damping
+        float* fVel = systems[s]->getArray(BodySystem::BODYSYSTEM_VELOCITY);
+        accel[s] = new float[numBodies*4];
+        for (int i = 0; i < numBodies*4; i++)
+        {
+            accel[s][i] = (fVel[i] / activeParams.m_damping - hVel[i]) / dt;
+        }
+
+        shrDeltaT(FUNCTIME);
+        for (int i = 0; i < iterations; ++i)
+        {
+            systems[s]->update(dt);
+        }
+        systems[s]->synchronizeThreads();
+        dSeconds[s] = shrDeltaT(FUNCTIME) / (double)iterations;
+    }
+
+    double dErrSq = 0.0, dRefSq = 0.0, dMaxRelErr = 0.0;
+    for (int i = 0; i < numBodies; i++)
+    {
+        double dErr = 0.0, dRef = 0.0;
+        for (int c = 0; c < 3; c++)
+        {
+            double d = accel[0][i*4 + c] - accel[1][i*4 + c];
+            dErr += d * d;
+            dRef += (double)accel[1][i*4 + c] * accel[1][i*4 + c];
+        }
+        dErrSq += dErr;
+        dRefSq += dRef;
+        if (dRef > 0.0)
+        {
+            dMaxRelErr = std::max(dMaxRelErr, sqrt(dErr / dRef));
+        }
+    }
+
+    shrLog("  Theta = %.2f, RMS relative force error = %.3e, max relative force error = %.3e\n", 
+           fTheta, dRefSq > 0.0 ? sqrt(dErrSq / dRefSq) : 0.0, dMaxRelErr);
+    shrLog("  Barnes-Hut %.5f s/step, all-pairs %.5f s/step, speedup %.2fx\n\n", 
+           dSeconds[0], dSeconds[1], dSeconds[1] / dSeconds[0]);
+
+    // leave the tree system in the initial state for the following tests
+    nbody->setArray(BodySystem::BODYSYSTEM_POSITION, hPos);
+    nbody->setArray(BodySystem::BODYSYSTEM_VELOCITY, hVel);
+
+    delete [] accel[0];
+    delete [] accel[1];
+    delete nbodyAllPairs;
+}
+
 //*****************************************************************************
 void ComputePerfStats(double &dGigaInteractionsPerSecond, double &dGigaFlops, double dSeconds, int iterations)
 {
@@ -899,7 +1401,7 @@ void Cleanup(int iExitCode)
 //    shrLog("\nStarting Cleanup...\n\n");
 
     // Cleanup allocated objects
-    if(nbodyGPU)delete nbodyGPU;
+    if(nbody)delete nbody;
     if(cqCommandQueue)clReleaseCommandQueue(cqCommandQueue);
     if(cxContext)clReleaseContext(cxContext);
     if(hPos)delete [] hPos;
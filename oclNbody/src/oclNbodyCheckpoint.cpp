@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "oclNbodyCheckpoint.h"
+
+bool WriteCheckpoint(const char* filename, const NBodyCheckpointHeader& header,
+                     const void* pos, const void* vel)
+{
+    std::string tmpname = std::string(filename) + ".tmp";
+
+    FILE* file = fopen(tmpname.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    NBodyCheckpointHeader h = header;
+    memcpy(h.magic, NBODY_CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.version = NBODY_CHECKPOINT_VERSION;
+
+    size_t count = (size_t)h.numBodies * 4;
+    size_t size = h.bDouble ? sizeof(double) : sizeof(float);
+    bool ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+              fwrite(pos, size, count, file) == count &&
+              fwrite(vel, size, count, file) == count;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        remove(tmpname.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename does not replace existing files on Windows
+    remove(filename);
+#endif
+    return rename(tmpname.c_str(), filename) == 0;
+}
+
+static bool ReadHeader(FILE* file, NBodyCheckpointHeader& header)
+{
+    return fread(&header, sizeof(header), 1, file) == 1 &&
+           memcmp(header.magic, NBODY_CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == NBODY_CHECKPOINT_VERSION &&
+           header.numBodies > 0;
+}
+
+bool ReadCheckpointHeader(const char* filename, NBodyCheckpointHeader& header)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    bool ok = ReadHeader(file, header);
+    fclose(file);
+    return ok;
+}
+
+bool ReadCheckpoint(const char* filename, NBodyCheckpointHeader& header,
+                    void* pos, void* vel)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    size_t count = 0;
+    bool ok = ReadHeader(file, header);
+    if (ok)
+    {
+        count = (size_t)header.numBodies * 4;
+        size_t size = header.bDouble ? sizeof(double) : sizeof(float);
+        ok = fread(pos, size, count, file) == count &&
+             fread(vel, size, count, file) == count;
+    }
+    fclose(file);
+    return ok;
+}
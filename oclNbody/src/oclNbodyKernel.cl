@@ -314,3 +314,157 @@ __kernel void integrateBodies_noMT(
     newVel[index] = vel;
 }
 
+
+// Kernels for the symplectic integrators and block time steps.
+// Unlike integrateBodies_* they update positions and velocities in place
+// and keep accelerations in a separate array between the passes.
+// The time step of body i is deltaTime / 2^levels[i]; with a single level
+// (all zeros) every body gets the global step.
+// Kernels that work on a subset of bodies take the list of their indices,
+// allBodies != 0 means the list is not used and every body is processed.
+// These kernels run with q == 1, local size p and numBodies a multiple of p.
+
+#define BODY_INDEX(gid) (allBodies ? (gid) : activeList[gid])
+
+__kernel void computeAccel(
+            __global REAL4* accelOut,
+            __global REAL4* pos,
+            __global const int* activeList,
+            int allBodies,
+            int numActive,
+            REAL softeningSquared,
+            int numBodies,
+            __local REAL4* sharedPos)
+{
+    unsigned int gid = get_global_id(0);
+    unsigned int threadIdxx = get_local_id(0);
+    unsigned int blockDimx = get_local_size(0);
+    unsigned int numTiles = numBodies / blockDimx;
+
+    // work-items past the active list still help loading the tiles
+    bool active = gid < (unsigned int)numActive;
+    int index = active ? BODY_INDEX(gid) : 0;
+    REAL4 myPos = pos[index];
+    REAL3 acc = ZERO3;
+
+    for (unsigned int tile = 0; tile < numTiles; tile++)
+    {
+        sharedPos[threadIdxx] = pos[mul24(tile, blockDimx) + threadIdxx];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        acc = gravitation(myPos, acc, softeningSquared, sharedPos);
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (active)
+    {
+        accelOut[index] = (REAL4)(acc.x, acc.y, acc.z, 0);
+    }
+}
+
+// vel = (vel + accel * factor * dt_i) * damping
+__kernel void kickBodies(
+            __global REAL4* vel,
+            __global const REAL4* accel,
+            __global const int* levels,
+            __global const int* activeList,
+            int allBodies,
+            int numActive,
+            REAL deltaTime,
+            REAL factor,
+            REAL damping)
+{
+    int gid = get_global_id(0);
+    if (gid >= numActive)
+    {
+        return;
+    }
+
+    int index = BODY_INDEX(gid);
+    REAL dt = deltaTime / (REAL)(1 << levels[index]);
+    REAL4 a = accel[index];
+    REAL4 v = vel[index];
+
+    v.x = (v.x + a.x * factor * dt) * damping;
+    v.y = (v.y + a.y * factor * dt) * damping;
+    v.z = (v.z + a.z * factor * dt) * damping;
+
+    vel[index] = v;
+}
+
+// pos = pos + vel * deltaTime, for all bodies
+__kernel void driftBodies(
+            __global REAL4* pos,
+            __global const REAL4* vel,
+            REAL deltaTime,
+            int numBodies)
+{
+    int index = get_global_id(0);
+    if (index >= numBodies)
+    {
+        return;
+    }
+
+    REAL4 p = pos[index];
+    REAL4 v = vel[index];
+
+    p.x += v.x * deltaTime;
+    p.y += v.y * deltaTime;
+    p.z += v.z * deltaTime;
+
+    pos[index] = p;
+}
+
+// Lists bodies whose level is at least minLevel, i.e. whose step ends now
+__kernel void selectActiveBodies(
+            __global const int* levels,
+            int minLevel,
+            int numBodies,
+            __global int* activeList,
+            __global int* activeCount)
+{
+    int index = get_global_id(0);
+    if (index < numBodies && levels[index] >= minLevel)
+    {
+        activeList[atomic_inc(activeCount)] = index;
+    }
+}
+
+// Picks the level of every active body from the criterion
+// dt_i <= eta * sqrt(softening / |a_i|). Levels below minLevel are not
+// allowed, as larger steps must start at a boundary of the larger step.
+__kernel void assignLevels(
+            __global const REAL4* accel,
+            __global int* levels,
+            __global const int* activeList,
+            int allBodies,
+            int numActive,
+            REAL deltaTime,
+            REAL eta,
+            REAL softening,
+            int minLevel,
+            int maxLevel)
+{
+    int gid = get_global_id(0);
+    if (gid >= numActive)
+    {
+        return;
+    }
+
+    int index = BODY_INDEX(gid);
+    REAL4 a = accel[index];
+    REAL aSqr = a.x * a.x + a.y * a.y + a.z * a.z;
+
+    int level = 0;
+    if (aSqr > 0)
+    {
+        REAL dtWanted = eta * sqrt(softening / sqrt(aSqr));
+        if (dtWanted < deltaTime)
+        {
+            level = (int)ceil(log2(deltaTime / dtWanted));
+        }
+    }
+
+    levels[index] = clamp(level, minLevel, maxLevel);
+}
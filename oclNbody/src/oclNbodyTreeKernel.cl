@@ -0,0 +1,476 @@
+// Barnes-Hut N-body kernels.
+//
+// Every time step the tree is rebuilt from scratch on the device:
+//   1. reduceBounds         - bounding box of all bodies (two passes)
+//   2. computeMortonCodes   - 30-bit Morton code of every body in that box
+//   3. radixHistogram/scanExclusive/radixScatter - LSD radix sort of the codes
+//   4. gatherSortedBodies   - bodies are copied to Morton order
+//   5. buildRadixTree       - binary radix tree over the sorted codes
+//                             (Karras, "Maximizing Parallelism in the
+//                             Construction of BVHs, Octrees, and k-d Trees")
+//   6. computeCentresOfMass - bottom-up mass, centre of mass and bounding box
+//   7. integrateBodiesTree  - tree walk with the opening angle criterion
+//                             and the same integration as integrateBodies_MT
+//
+// Every octree cell is a subtree of the radix tree (the cell of level k
+// is the set of bodies sharing the first 3*k bits of the code), so the
+// walk visits the octree cells and some intermediate binary nodes between them.
+//
+// Node numbering: internal nodes are 0..n-2 (0 is the root),
+// leaf k (k-th body in Morton order) has number n-1+k.
+
+#define RADIX_BITS  4
+#define RADIX       16
+#define RADIX_MASK  (RADIX - 1)
+#define RADIX_ITEMS 16              // keys processed by one work-item in the sort kernels
+
+#define MORTON_BITS 10              // bits per axis
+#define STACK_SIZE  64              // tree walk stack, deeper subtrees are approximated by their mass
+
+// Bounding box reduction. The first pass reads positions (minIn == maxIn == pos)
+// and writes one box per work-group, the second pass runs as a single work-group
+// over those partial boxes. Local size must be a power of two.
+__kernel void reduceBounds(__global const float4* minIn, __global const float4* maxIn, int n,
+                           __global float4* minOut, __global float4* maxOut,
+                           __local float4* sMin, __local float4* sMax)
+{
+    int lid = get_local_id(0);
+
+    float4 bmin = (float4)(FLT_MAX);
+    float4 bmax = (float4)(-FLT_MAX);
+    for (int i = get_global_id(0); i < n; i += get_global_size(0))
+    {
+        bmin = fmin(bmin, minIn[i]);
+        bmax = fmax(bmax, maxIn[i]);
+    }
+    sMin[lid] = bmin;
+    sMax[lid] = bmax;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int s = get_local_size(0) / 2; s > 0; s >>= 1)
+    {
+        if (lid < s)
+        {
+            sMin[lid] = fmin(sMin[lid], sMin[lid + s]);
+            sMax[lid] = fmax(sMax[lid], sMax[lid + s]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+    {
+        minOut[get_group_id(0)] = sMin[0];
+        maxOut[get_group_id(0)] = sMax[0];
+    }
+}
+
+// Spread 10 bits so that there are two zero bits between every two of them
+uint expandBits(uint v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Morton codes are computed in the bounding cube (not box) of the bodies,
+// so that cells of the same level have the same size along all axes
+__kernel void computeMortonCodes(__global const float4* pos, __global const float4* boundsMin,
+                                 __global const float4* boundsMax, int n,
+                                 __global uint* keys, __global uint* values)
+{
+    int i = get_global_id(0);
+    if (i >= n)
+    {
+        return;
+    }
+
+    float3 bmin = boundsMin[0].xyz;
+    float3 ext = boundsMax[0].xyz - bmin;
+    float scale = (float)(1 << MORTON_BITS) / fmax(fmax(ext.x, ext.y), fmax(ext.z, FLT_MIN));
+
+    float3 p = clamp((pos[i].xyz - bmin) * scale, 0.0f, (float)((1 << MORTON_BITS) - 1));
+    keys[i] = (expandBits((uint)p.x) << 2) | (expandBits((uint)p.y) << 1) | expandBits((uint)p.z);
+    values[i] = i;
+}
+
+// Radix sort pass, step 1: per work-group digit histograms.
+// Every work-item owns RADIX_ITEMS consecutive keys, the histogram is stored
+// digit-major (hist[digit * numGroups + group]) so that its exclusive scan
+// gives every work-group the output offset of each digit.
+__kernel void radixHistogram(__global const uint* keys, int n, int shift,
+                             __global uint* hist, __local uint* lHist)
+{
+    int lid = get_local_id(0);
+    int group = get_group_id(0);
+
+    if (lid < RADIX)
+    {
+        lHist[lid] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int base = get_global_id(0) * RADIX_ITEMS;
+    for (int k = 0; k < RADIX_ITEMS; k++)
+    {
+        int idx = base + k;
+        if (idx < n)
+        {
+            atomic_inc(&lHist[(keys[idx] >> shift) & RADIX_MASK]);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lid < RADIX)
+    {
+        hist[lid * get_num_groups(0) + group] = lHist[lid];
+    }
+}
+
+// Radix sort pass, step 2: exclusive scan of the histogram, run as a single work-group
+__kernel void scanExclusive(__global uint* data, int n, __local uint* tmp)
+{
+    int lid = get_local_id(0);
+    int lsz = get_local_size(0);
+    uint carry = 0;
+
+    for (int base = 0; base < n; base += lsz)
+    {
+        int idx = base + lid;
+        uint v = (idx < n) ? data[idx] : 0;
+        tmp[lid] = v;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int offset = 1; offset < lsz; offset <<= 1)
+        {
+            uint t = (lid >= offset) ? tmp[lid - offset] : 0;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            tmp[lid] += t;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (idx < n)
+        {
+            data[idx] = carry + tmp[lid] - v;
+        }
+        carry += tmp[lsz - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// Radix sort pass, step 3: stable scatter.
+// Work-items count their keys per digit, the counts are scanned across
+// the work-group (one work-item per digit), and then every work-item writes
+// its keys in order, so equal digits keep their relative order.
+__kernel void radixScatter(__global const uint* keysIn, __global const uint* valuesIn,
+                           __global uint* keysOut, __global uint* valuesOut,
+                           int n, int shift, __global const uint* histScanned,
+                           __local uint* lCounts)
+{
+    int lid = get_local_id(0);
+    int lsz = get_local_size(0);
+    int group = get_group_id(0);
+    int numGroups = get_num_groups(0);
+    int base = get_global_id(0) * RADIX_ITEMS;
+
+    uint counts[RADIX];
+    for (int d = 0; d < RADIX; d++)
+    {
+        counts[d] = 0;
+    }
+    for (int k = 0; k < RADIX_ITEMS; k++)
+    {
+        int idx = base + k;
+        if (idx < n)
+        {
+            counts[(keysIn[idx] >> shift) & RADIX_MASK]++;
+        }
+    }
+    for (int d = 0; d < RADIX; d++)
+    {
+        lCounts[d * lsz + lid] = counts[d];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lid < RADIX)
+    {
+        uint sum = 0;
+        for (int t = 0; t < lsz; t++)
+        {
+            uint c = lCounts[lid * lsz + t];
+            lCounts[lid * lsz + t] = sum;
+            sum += c;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int d = 0; d < RADIX; d++)
+    {
+        counts[d] = histScanned[d * numGroups + group] + lCounts[d * lsz + lid];
+    }
+    for (int k = 0; k < RADIX_ITEMS; k++)
+    {
+        int idx = base + k;
+        if (idx < n)
+        {
+            uint key = keysIn[idx];
+            uint dst = counts[(key >> shift) & RADIX_MASK]++;
+            keysOut[dst] = key;
+            valuesOut[dst] = valuesIn[idx];
+        }
+    }
+}
+
+__kernel void gatherSortedBodies(__global const float4* pos, __global const uint* sortedIndex,
+                                 __global float4* sortedPos, int n)
+{
+    int i = get_global_id(0);
+    if (i < n)
+    {
+        sortedPos[i] = pos[sortedIndex[i]];
+    }
+}
+
+// Length of the common prefix of keys i and j, -1 if j is out of range.
+// Equal keys are told apart by their indices.
+int commonPrefix(__global const uint* keys, int n, int i, int j)
+{
+    if (j < 0 || j >= n)
+    {
+        return -1;
+    }
+    uint ki = keys[i];
+    uint kj = keys[j];
+    if (ki == kj)
+    {
+        return 32 + clz((uint)(i ^ j));
+    }
+    return clz(ki ^ kj);
+}
+
+// One work-item per internal node, see Karras 2012, figure 4.
+// Also clears the flags used by computeCentresOfMass.
+__kernel void buildRadixTree(__global const uint* keys, int n,
+                             __global int* childL, __global int* childR, __global int* parent,
+                             __global int* flags)
+{
+    int i = get_global_id(0);
+    if (i >= n - 1)
+    {
+        return;
+    }
+
+    // direction of the range
+    int d = (commonPrefix(keys, n, i, i + 1) - commonPrefix(keys, n, i, i - 1)) >= 0 ? 1 : -1;
+
+    // upper bound for the length of the range
+    int deltaMin = commonPrefix(keys, n, i, i - d);
+    int lmax = 2;
+    while (commonPrefix(keys, n, i, i + lmax * d) > deltaMin)
+    {
+        lmax <<= 1;
+    }
+
+    // other end of the range by binary search
+    int l = 0;
+    for (int t = lmax >> 1; t >= 1; t >>= 1)
+    {
+        if (commonPrefix(keys, n, i, i + (l + t) * d) > deltaMin)
+        {
+            l += t;
+        }
+    }
+    int j = i + l * d;
+
+    // split position by binary search
+    int deltaNode = commonPrefix(keys, n, i, j);
+    int s = 0;
+    int t = l;
+    do
+    {
+        t = (t + 1) >> 1;
+        if (commonPrefix(keys, n, i, i + (s + t) * d) > deltaNode)
+        {
+            s += t;
+        }
+    }
+    while (t > 1);
+    int gamma = i + s * d + min(d, 0);
+
+    int left  = (min(i, j) == gamma)     ? (n - 1 + gamma)     : gamma;
+    int right = (max(i, j) == gamma + 1) ? (n - 1 + gamma + 1) : gamma + 1;
+
+    childL[i] = left;
+    childR[i] = right;
+    parent[left] = i;
+    parent[right] = i;
+    flags[i] = 0;
+    if (i == 0)
+    {
+        parent[0] = -1;
+    }
+}
+
+// A node computed by one work-group is read by another one, and mem_fence
+// only orders the accesses of a single work-item. So nodes are written and
+// read with atomics, which act on the global copy and never on a stale cache.
+void storeNode(__global float4* p, float4 v)
+{
+    volatile __global int* q = (volatile __global int*)p;
+    atomic_xchg(q + 0, as_int(v.x));
+    atomic_xchg(q + 1, as_int(v.y));
+    atomic_xchg(q + 2, as_int(v.z));
+    atomic_xchg(q + 3, as_int(v.w));
+}
+
+float4 loadNode(__global float4* p)
+{
+    volatile __global int* q = (volatile __global int*)p;
+    return (float4)(as_float(atomic_or(q + 0, 0)), as_float(atomic_or(q + 1, 0)),
+                    as_float(atomic_or(q + 2, 0)), as_float(atomic_or(q + 3, 0)));
+}
+
+// Bottom-up pass: every leaf walks to the root, at every node the first
+// arriving work-item stops and the second one (both children are done by then)
+// computes the node. w of nodeCom is the total mass.
+__kernel void computeCentresOfMass(__global const float4* sortedPos, int n,
+                                   __global const int* childL, __global const int* childR,
+                                   __global const int* parent,
+                                   __global float4* nodeCom,
+                                   __global float4* nodeMin,
+                                   __global float4* nodeMax,
+                                   __global int* flags)
+{
+    int k = get_global_id(0);
+    if (k >= n)
+    {
+        return;
+    }
+
+    int node = parent[n - 1 + k];
+    while (node >= 0)
+    {
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+        if (atomic_inc(&flags[node]) == 0)
+        {
+            return;
+        }
+
+        float4 com[2], bmin[2], bmax[2];
+        int child[2] = { childL[node], childR[node] };
+        for (int c = 0; c < 2; c++)
+        {
+            if (child[c] >= n - 1)
+            {
+                com[c] = sortedPos[child[c] - (n - 1)];
+                bmin[c] = com[c];
+                bmax[c] = com[c];
+            }
+            else
+            {
+                com[c] = loadNode(&nodeCom[child[c]]);
+                bmin[c] = loadNode(&nodeMin[child[c]]);
+                bmax[c] = loadNode(&nodeMax[child[c]]);
+            }
+        }
+
+        float mass = com[0].w + com[1].w;
+        float4 centre;
+        if (mass > 0.0f)
+        {
+            centre.xyz = (com[0].xyz * com[0].w + com[1].xyz * com[1].w) / mass;
+        }
+        else
+        {
+            centre.xyz = 0.5f * (com[0].xyz + com[1].xyz);
+        }
+        centre.w = mass;
+
+        // the stores have to be done before the flag of the parent is counted
+        storeNode(&nodeCom[node], centre);
+        storeNode(&nodeMin[node], fmin(bmin[0], bmin[1]));
+        storeNode(&nodeMax[node], fmax(bmax[0], bmax[1]));
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+
+        node = parent[node];
+    }
+}
+
+float3 pointMassAccel(float3 ai, float4 myPos, float4 other, float softeningSquared)
+{
+    float3 r = other.xyz - myPos.xyz;
+    float distSqr = dot(r, r) + softeningSquared;
+    float invDist = rsqrt(distSqr);
+    float invDistCube = invDist * invDist * invDist;
+    return ai + r * (other.w * invDistCube);
+}
+
+// Bodies are processed in Morton order, so neighbouring work-items walk
+// similar parts of the tree. A node is used as a single point mass if
+// size / distance < theta, size being the largest extent of its bounding box.
+__kernel void integrateBodiesTree(__global float4* newPos, __global float4* newVel,
+                                  __global const float4* oldVel,
+                                  __global const float4* sortedPos, __global const uint* sortedIndex,
+                                  __global const int* childL, __global const int* childR,
+                                  __global const float4* nodeCom,
+                                  __global const float4* nodeMin, __global const float4* nodeMax,
+                                  float deltaTime, float damping, float softeningSquared,
+                                  float thetaSquared, int n)
+{
+    int k = get_global_id(0);
+    if (k >= n)
+    {
+        return;
+    }
+
+    float4 pos = sortedPos[k];
+    float3 accel = (float3)(0.0f, 0.0f, 0.0f);
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = (n > 1) ? 0 : n - 1;
+
+    while (top > 0)
+    {
+        int node = stack[--top];
+        if (node >= n - 1)
+        {
+            if (node - (n - 1) != k)
+            {
+                accel = pointMassAccel(accel, pos, sortedPos[node - (n - 1)], softeningSquared);
+            }
+            continue;
+        }
+
+        float4 com = nodeCom[node];
+        float3 ext = nodeMax[node].xyz - nodeMin[node].xyz;
+        float size = fmax(ext.x, fmax(ext.y, ext.z));
+        float3 r = com.xyz - pos.xyz;
+        float distSqr = dot(r, r);
+
+        if (size * size < thetaSquared * distSqr || top + 2 > STACK_SIZE)
+        {
+            accel = pointMassAccel(accel, pos, com, softeningSquared);
+        }
+        else
+        {
+            stack[top++] = childR[node];
+            stack[top++] = childL[node];
+        }
+    }
+
+    uint index = sortedIndex[k];
+    float4 vel = oldVel[index];
+
+    // acceleration = force / mass;
+    // new velocity = old velocity + acceleration * deltaTime
+    vel.xyz += accel * deltaTime;
+    vel.xyz *= damping;
+
+    // new position = old position + velocity * deltaTime
+    pos.xyz += vel.xyz * deltaTime;
+
+    newPos[index] = pos;
+    newVel[index] = vel;
+}
@@ -30,6 +30,7 @@ public:
     {
         CONFIG_RANDOM,
         CONFIG_GRID,
+        CONFIG_DAM_BREAK,   // fluid block against the -x wall, spacing of half a smoothing length
         _NUM_CONFIGS
     };
 
@@ -39,6 +40,18 @@ public:
         VELOCITY,
     };
 
+    enum SimulationMode
+    {
+        SIM_DEM,            // spring/damper collisions between spheres
+        SIM_SPH,            // smoothed particle hydrodynamics fluid
+    };
+
+    enum GridBuilder
+    {
+        GRID_BITONIC_SORT,      // calcHash + bitonicSort + findCellBoundsAndReorder
+        GRID_COUNTING_SORT,     // countingSortGrid, no power-of-two particle count needed
+    };
+
     void update(float deltaTime);
     void reset(ParticleConfig config);
 
@@ -62,6 +75,28 @@ public:
     void setCollideAttraction(float x) { m_params.attraction = x; }
     void setColliderPos(float3 x) { m_params.colliderPos = x; }
 
+    void setGridBuilder(GridBuilder builder) { m_gridBuilder = builder; m_bListValid = false; }
+
+    // SPH uses the cell size (one particle diameter) as smoothing length
+    // and ignores the Verlet list, the grid is rebuilt every step
+    void setSimulationMode(SimulationMode mode) { m_mode = mode; m_bListValid = false; }
+    SimulationMode getSimulationMode() const { return m_mode; }
+    void setSphRestDensity(float x) { m_params.sphRestDensity = x; updateSphConstants(); }
+    void setSphGasStiffness(float x) { m_params.sphGasStiffness = x; }
+    void setSphViscosity(float x) { m_params.sphViscosity = x; }
+    float getSphRestDensity() { return m_params.sphRestDensity; }
+
+    // mean and maximum SPH density of the last step, for checking compressibility
+    void getDensityStats(float *mean, float *max);
+
+    // Verlet neighbour list: pairs closer than 2 * radius + skin are listed
+    // once and reused until a particle moved more than skin / 2, instead
+    // of scanning 27 cells every step. skin <= 0 turns the list off; it is
+    // clamped to one cell size
+    void setVerletSkin(float skin, uint maxNeighbours = 32);
+    uint getListRebuilds() const { return m_listRebuilds; }
+    uint getListOverflow() const { return m_listOverflow; }
+
     float getParticleRadius() { return m_params.particleRadius; }
     float3 getColliderPos() { return m_params.colliderPos; }
     float getColliderRadius() { return m_params.colliderRadius; }
@@ -80,6 +115,10 @@ protected: // methods
 
     void initGrid(uint *size, float spacing, float jitter, uint numParticles);
 
+    void buildGrid();
+    void updateSphConstants();
+    void freeNeighbourList();
+
 protected: // data
     bool m_bInitialized;
     uint m_numParticles;
@@ -104,6 +143,22 @@ protected: // data
     memHandle_t        m_dIndex;
     memHandle_t    m_dCellStart;
     memHandle_t      m_dCellEnd;
+    memHandle_t         m_dRank;
+    memHandle_t m_dDensityPressure;
+
+    // Verlet neighbour list, allocated by setVerletSkin
+    memHandle_t    m_dNeighbours;
+    memHandle_t m_dNeighbourCount;
+    memHandle_t       m_dListPos;
+    memHandle_t      m_dListFlag;
+
+    SimulationMode     m_mode;
+    GridBuilder m_gridBuilder;
+    float        m_verletSkin;
+    uint      m_maxNeighbours;
+    bool         m_bListValid;
+    uint       m_listRebuilds;
+    uint       m_listOverflow;
 
     uint m_gridSortBits;
     uint       m_posVbo;
@@ -45,6 +45,16 @@ typedef struct{
     float shear;
     float attraction;
     float boundaryDamping;
+
+    //SPH fluid mode, see ParticleSystem::setSimulationMode
+    float sphSmoothingLength;
+    float sphParticleMass;
+    float sphRestDensity;
+    float sphGasStiffness;
+    float sphViscosity;
+    float sphPoly6;          //kernel normalisations, derived from the smoothing length
+    float sphSpikyGrad;
+    float sphViscLaplacian;
 } simParams_t;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +62,7 @@ typedef struct{
 ////////////////////////////////////////////////////////////////////////////////
 extern "C" void startupOpenCL(int argc, const char **argv);
 extern "C" void shutdownOpenCL(void);
+extern "C" void finishOpenCL(void);
 
 extern "C" void allocateArray(memHandle_t *memObj, size_t size);
 extern "C" void freeArray(memHandle_t memObj);
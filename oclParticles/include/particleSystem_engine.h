@@ -60,6 +60,85 @@ extern "C" void collide(
     uint   numCells
 );
 
+//Grid build without sorting: atomic cell histogram, scan and scatter.
+//Produces the same cell bounds and reordered arrays as calcHash +
+//bitonicSort + findCellBoundsAndReorder, d_Hash and d_Rank are scratch
+extern "C" void countingSortGrid(
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_Index,
+    memHandle_t d_Hash,
+    memHandle_t d_Rank,
+    memHandle_t d_Pos,
+    memHandle_t d_Vel,
+    uint numParticles,
+    uint numCells
+);
+
+//Verlet neighbour list of all pairs closer than cutoff, built from the
+//current grid; returns the number of neighbours dropped for lack of room
+extern "C" uint buildNeighbourList(
+    memHandle_t d_Neighbours,
+    memHandle_t d_NeighbourCount,
+    memHandle_t d_ListPos,
+    memHandle_t d_Overflow,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    float cutoff,
+    float cellSize,
+    uint  maxNeighbours,
+    uint  numParticles
+);
+
+//Gathers pos/vel into list order, returns nonzero when a particle
+//moved more than skin / 2 since the list was built
+extern "C" int reorderAndCheckSkin(
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_Rebuild,
+    memHandle_t d_ListPos,
+    memHandle_t d_Index,
+    memHandle_t d_Pos,
+    memHandle_t d_Vel,
+    float skin,
+    uint  numParticles
+);
+
+extern "C" void collideNeighbourList(
+    memHandle_t d_Vel,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_Index,
+    memHandle_t d_Neighbours,
+    memHandle_t d_NeighbourCount,
+    uint   numParticles
+);
+
+//SPH passes over the sorted grid: density and pressure per particle,
+//then pressure + viscosity acceleration applied to d_Vel
+extern "C" void sphDensityPressure(
+    memHandle_t d_DensityPressure,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    uint   numParticles
+);
+
+extern "C" void sphForces(
+    memHandle_t d_Vel,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_DensityPressure,
+    memHandle_t d_Index,
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    float  deltaTime,
+    uint   numParticles
+);
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
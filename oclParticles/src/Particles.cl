@@ -56,6 +56,15 @@ typedef struct{
     float shear;
     float attraction;
     float boundaryDamping;
+
+    float sphSmoothingLength;
+    float sphParticleMass;
+    float sphRestDensity;
+    float sphGasStiffness;
+    float sphViscosity;
+    float sphPoly6;
+    float sphSpikyGrad;
+    float sphViscLaplacian;
 } simParams_t;
 
 
@@ -352,3 +361,403 @@ __kernel void collide(
     //Write new velocity back to original unsorted location
     d_Vel[d_Index[index]] = vel + force;
 }
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Counting sort grid build: atomic cell histogram, exclusive scan of the
+// cell counts and a scatter into cell order; O(numParticles + numCells)
+// instead of the O(n log^2 n) bitonic sort of the hashes
+////////////////////////////////////////////////////////////////////////////////
+#define SCAN_WG_SIZE 256
+#define SCAN_ITEMS   4
+#define SCAN_BLOCK   (SCAN_WG_SIZE * SCAN_ITEMS)
+
+//Count particles per cell, remembering the slot of each particle in its cell
+__kernel void countCells(
+    __global uint         *d_CellCount, //output: particles per cell, cleared beforehand
+    __global uint         *d_Hash,      //output: grid hash of each particle
+    __global uint         *d_Rank,      //output: slot of each particle inside its cell
+    __global const float4 *d_Pos,       //input: positions
+    __constant simParams_t *params,
+    uint numParticles
+){
+    const uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    uint gridHash = getGridHash(getGridPos(d_Pos[index], params), params);
+    d_Hash[index] = gridHash;
+    d_Rank[index] = atomic_inc(&d_CellCount[gridHash]);
+}
+
+//Exclusive scan of SCAN_BLOCK elements per work-group, block totals to d_BlockSums
+__kernel __attribute__((reqd_work_group_size(SCAN_WG_SIZE, 1, 1)))
+void scanCellsLocal(
+    __global uint       *d_Dst,       //output: exclusive scan inside each block
+    __global uint       *d_BlockSums, //output: total of each block
+    __global const uint *d_Src,       //input: cell counts
+    uint N
+){
+    __local uint l_Sum[SCAN_WG_SIZE];
+    const uint lid  = get_local_id(0);
+    const uint base = get_group_id(0) * SCAN_BLOCK + lid * SCAN_ITEMS;
+
+    uint data[SCAN_ITEMS];
+    uint sum = 0;
+    for(uint i = 0; i < SCAN_ITEMS; i++){
+        data[i] = (base + i < N) ? d_Src[base + i] : 0;
+        sum += data[i];
+    }
+
+    //Inclusive scan of the per work-item sums
+    l_Sum[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for(uint offset = 1; offset < SCAN_WG_SIZE; offset <<= 1){
+        uint t = (lid >= offset) ? l_Sum[lid - offset] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        l_Sum[lid] += t;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    uint prefix = l_Sum[lid] - sum;
+    for(uint i = 0; i < SCAN_ITEMS; i++){
+        if(base + i < N)
+            d_Dst[base + i] = prefix;
+        prefix += data[i];
+    }
+
+    if(lid == SCAN_WG_SIZE - 1)
+        d_BlockSums[get_group_id(0)] = l_Sum[lid];
+}
+
+//In-place exclusive scan of the block totals by a single work-group
+__kernel __attribute__((reqd_work_group_size(SCAN_WG_SIZE, 1, 1)))
+void scanBlockSums(
+    __global uint *d_BlockSums,
+    uint numBlocks
+){
+    __local uint l_Sum[SCAN_WG_SIZE];
+    const uint lid = get_local_id(0);
+    uint carry = 0;
+
+    for(uint base = 0; base < numBlocks; base += SCAN_WG_SIZE){
+        uint i = base + lid;
+        uint value = (i < numBlocks) ? d_BlockSums[i] : 0;
+
+        l_Sum[lid] = value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for(uint offset = 1; offset < SCAN_WG_SIZE; offset <<= 1){
+            uint t = (lid >= offset) ? l_Sum[lid - offset] : 0;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            l_Sum[lid] += t;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if(i < numBlocks)
+            d_BlockSums[i] = carry + l_Sum[lid] - value;
+        carry += l_Sum[SCAN_WG_SIZE - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+//Add block offsets; empty cells get start == end, so no 0xFFFFFFFF marker is needed
+__kernel void finalizeCellBounds(
+    __global uint       *d_CellStart, //input: block-local scan, output: cell start index
+    __global uint       *d_CellEnd,   //input: cell counts, output: cell end index
+    __global const uint *d_BlockSums, //input: scanned block totals
+    uint numCells
+){
+    const uint index = get_global_id(0);
+    if(index >= numCells)
+        return;
+
+    uint start = d_CellStart[index] + d_BlockSums[index / SCAN_BLOCK];
+    d_CellStart[index] = start;
+    d_CellEnd[index]   = start + d_CellEnd[index];
+}
+
+//Move every particle to its slot, producing the same layout as
+//findCellBoundsAndReorder does after the hash sort
+__kernel void scatterParticles(
+    __global float4       *d_ReorderedPos, //output: reordered by cell hash positions
+    __global float4       *d_ReorderedVel, //output: reordered by cell hash velocities
+    __global uint         *d_Index,        //output: particle indices in cell order
+    __global const uint   *d_CellStart,    //input: cell start index
+    __global const uint   *d_Hash,         //input: unsorted grid hashes
+    __global const uint   *d_Rank,         //input: slot of each particle inside its cell
+    __global const float4 *d_Pos,          //input: unsorted positions
+    __global const float4 *d_Vel,          //input: unsorted velocities
+    uint numParticles
+){
+    const uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    uint dst = d_CellStart[d_Hash[index]] + d_Rank[index];
+    d_Index[dst] = index;
+    d_ReorderedPos[dst] = d_Pos[index];
+    d_ReorderedVel[dst] = d_Vel[index];
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Verlet neighbour list: every pair closer than 2 * radius + skin, kept in
+// cell order and reused until some particle moved more than skin / 2
+////////////////////////////////////////////////////////////////////////////////
+__kernel void buildNeighbourList(
+    __global uint         *d_Neighbours,     //output: maxNeighbours x numParticles, column major
+    __global uint         *d_NeighbourCount, //output: list length of each particle
+    __global float4       *d_ListPos,        //output: positions the list was built at
+    __global uint         *d_Overflow,       //output: count of neighbours that did not fit
+    __global const float4 *d_ReorderedPos,   //input: reordered positions
+    __global const uint   *d_CellStart,      //input: cell boundaries
+    __global const uint   *d_CellEnd,
+    __constant simParams_t *params,
+    float cutoffSq,
+    int   cellRange,                         //cells to search in each direction
+    uint  maxNeighbours,
+    uint  numParticles
+){
+    const uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    float4 pos = d_ReorderedPos[index];
+    int4 gridPos = getGridPos(pos, params);
+    uint count = 0;
+
+    for(int z = -cellRange; z <= cellRange; z++)
+        for(int y = -cellRange; y <= cellRange; y++)
+            for(int x = -cellRange; x <= cellRange; x++){
+                uint   hash = getGridHash(gridPos + (int4)(x, y, z, 0), params);
+                uint startI = d_CellStart[hash];
+
+                //Skip empty cell (bitonic sort path)
+                if(startI == 0xFFFFFFFFU)
+                    continue;
+
+                uint endI = d_CellEnd[hash];
+                for(uint j = startI; j < endI; j++){
+                    if(j == index)
+                        continue;
+
+                    float4 relPos = d_ReorderedPos[j] - pos;
+                    float distSq = relPos.x * relPos.x + relPos.y * relPos.y + relPos.z * relPos.z;
+                    if(distSq < cutoffSq){
+                        if(count < maxNeighbours)
+                            d_Neighbours[count * numParticles + index] = j;
+                        count++;
+                    }
+                }
+            }
+
+    if(count > maxNeighbours){
+        atomic_add(d_Overflow, count - maxNeighbours);
+        count = maxNeighbours;
+    }
+    d_NeighbourCount[index] = count;
+    d_ListPos[index] = pos;
+}
+
+//Gather the integrated state into list order and flag a rebuild
+//as soon as one particle left its half of the skin
+__kernel void reorderAndCheckSkin(
+    __global float4       *d_ReorderedPos, //output: positions in list order
+    __global float4       *d_ReorderedVel, //output: velocities in list order
+    __global uint         *d_Rebuild,      //output: set to 1 when the list is stale
+    __global const float4 *d_ListPos,      //input: positions the list was built at
+    __global const uint   *d_Index,        //input: particle indices in list order
+    __global const float4 *d_Pos,          //input: unsorted positions
+    __global const float4 *d_Vel,          //input: unsorted velocities
+    float maxDisplacementSq,
+    uint  numParticles
+){
+    const uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    uint sortedIndex = d_Index[index];
+    float4 pos = d_Pos[sortedIndex];
+    d_ReorderedPos[index] = pos;
+    d_ReorderedVel[index] = d_Vel[sortedIndex];
+
+    float4 disp = pos - d_ListPos[index];
+    if(disp.x * disp.x + disp.y * disp.y + disp.z * disp.z > maxDisplacementSq)
+        *d_Rebuild = 1;
+}
+
+__kernel void collideNeighbourList(
+    __global float4       *d_Vel,            //output: new velocity
+    __global const float4 *d_ReorderedPos,   //input: positions in list order
+    __global const float4 *d_ReorderedVel,   //input: velocities in list order
+    __global const uint   *d_Index,          //input: particle indices in list order
+    __global const uint   *d_Neighbours,     //input: neighbour lists, column major
+    __global const uint   *d_NeighbourCount,
+    __constant simParams_t *params,
+    uint    numParticles
+){
+    uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    float4   pos = d_ReorderedPos[index];
+    float4   vel = d_ReorderedVel[index];
+    float4 force = (float4)(0, 0, 0, 0);
+
+    uint count = d_NeighbourCount[index];
+    for(uint k = 0; k < count; k++){
+        uint j = d_Neighbours[k * numParticles + index];
+        force += collideSpheres(
+            pos, d_ReorderedPos[j],
+            vel, d_ReorderedVel[j],
+            params->particleRadius, params->particleRadius,
+            params->spring, params->damping, params->shear, params->attraction
+        );
+    }
+
+    //Collide with cursor sphere
+    force += collideSpheres(
+        pos, (float4)(params->colliderPos.x, params->colliderPos.y, params->colliderPos.z, 0),
+        vel, (float4)(0, 0, 0, 0),
+        params->particleRadius, params->colliderRadius,
+        params->spring, params->damping, params->shear, params->attraction
+    );
+
+    //Write new velocity back to original unsorted location
+    d_Vel[d_Index[index]] = vel + force;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SPH fluid (Mueller et al. 2003): density/pressure and force passes over
+// the same cell structure collide uses, smoothing length == cell size
+////////////////////////////////////////////////////////////////////////////////
+__kernel void computeDensityPressure(
+    __global float2       *d_DensityPressure, //output: density and pressure in cell order
+    __global const float4 *d_ReorderedPos,    //input: reordered positions
+    __global const uint   *d_CellStart,       //input: cell boundaries
+    __global const uint   *d_CellEnd,
+    __constant simParams_t *params,
+    uint    numParticles
+){
+    uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    float4 pos = d_ReorderedPos[index];
+    float h2 = params->sphSmoothingLength * params->sphSmoothingLength;
+    float sum = 0.0f;
+
+    //Get address in grid
+    int4 gridPos = getGridPos(pos, params);
+
+    //Accumulate surrounding cells, the particle itself included
+    for(int z = -1; z <= 1; z++)
+        for(int y = -1; y <= 1; y++)
+            for(int x = -1; x <= 1; x++){
+                uint   hash = getGridHash(gridPos + (int4)(x, y, z, 0), params);
+                uint startI = d_CellStart[hash];
+
+                //Skip empty cell
+                if(startI == 0xFFFFFFFFU)
+                    continue;
+
+                uint endI = d_CellEnd[hash];
+                for(uint j = startI; j < endI; j++){
+                    float4 relPos = d_ReorderedPos[j] - pos;
+                    float r2 = relPos.x * relPos.x + relPos.y * relPos.y + relPos.z * relPos.z;
+                    if(r2 < h2){
+                        float t = h2 - r2;
+                        sum += t * t * t;
+                    }
+                }
+            }
+
+    float density  = params->sphParticleMass * params->sphPoly6 * sum;
+    //No tension: clamping keeps the free surface from clumping
+    float pressure = fmax(params->sphGasStiffness * (density - params->sphRestDensity), 0.0f);
+    d_DensityPressure[index] = (float2)(density, pressure);
+}
+
+__kernel void computeSphForces(
+    __global float4       *d_Vel,             //output: new velocity
+    __global const float4 *d_ReorderedPos,    //input: reordered positions
+    __global const float4 *d_ReorderedVel,    //input: reordered velocities
+    __global const float2 *d_DensityPressure, //input: density and pressure in cell order
+    __global const uint   *d_Index,           //input: reordered particle indices
+    __global const uint   *d_CellStart,       //input: cell boundaries
+    __global const uint   *d_CellEnd,
+    __constant simParams_t *params,
+    float   deltaTime,
+    uint    numParticles
+){
+    uint index = get_global_id(0);
+    if(index >= numParticles)
+        return;
+
+    float4   pos = d_ReorderedPos[index];
+    float4   vel = d_ReorderedVel[index];
+    float2    dp = d_DensityPressure[index];
+    float4 force = (float4)(0, 0, 0, 0);
+
+    float h  = params->sphSmoothingLength;
+    float h2 = h * h;
+    float mass = params->sphParticleMass;
+
+    //Get address in grid
+    int4 gridPos = getGridPos(pos, params);
+
+    //Accumulate surrounding cells
+    for(int z = -1; z <= 1; z++)
+        for(int y = -1; y <= 1; y++)
+            for(int x = -1; x <= 1; x++){
+                uint   hash = getGridHash(gridPos + (int4)(x, y, z, 0), params);
+                uint startI = d_CellStart[hash];
+
+                //Skip empty cell
+                if(startI == 0xFFFFFFFFU)
+                    continue;
+
+                uint endI = d_CellEnd[hash];
+                for(uint j = startI; j < endI; j++){
+                    if(j == index)
+                        continue;
+
+                    float4 relPos = pos - d_ReorderedPos[j];
+                    relPos.w = 0.0f;
+                    float r2 = relPos.x * relPos.x + relPos.y * relPos.y + relPos.z * relPos.z;
+
+                    //Coincident particles (e.g. clamped to a wall) have no direction
+                    if(r2 >= h2 || r2 < 1e-12f)
+                        continue;
+
+                    float  r = sqrt(r2);
+                    float hr = h - r;
+                    float2 dp2 = d_DensityPressure[j];
+
+                    //Symmetric pressure term with the spiky kernel gradient
+                    force -= relPos * (mass * (dp.y + dp2.y) / (2.0f * dp2.x) * params->sphSpikyGrad * hr * hr / r);
+
+                    //Viscosity term with the viscosity kernel laplacian
+                    float4 relVel = d_ReorderedVel[j] - vel;
+                    relVel.w = 0.0f;
+                    force += relVel * (params->sphViscosity * mass * params->sphViscLaplacian * hr / dp2.x);
+                }
+            }
+
+    vel += force * (deltaTime / dp.x);
+
+    //Collide with cursor sphere
+    vel += collideSpheres(
+        pos, (float4)(params->colliderPos.x, params->colliderPos.y, params->colliderPos.z, 0),
+        vel, (float4)(0, 0, 0, 0),
+        params->particleRadius, params->colliderRadius,
+        params->spring, params->damping, params->shear, params->attraction
+    );
+
+    //Write new velocity back to original unsorted location
+    d_Vel[d_Index[index]] = vel;
+}
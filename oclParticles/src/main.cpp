@@ -36,6 +36,8 @@
 #include <oclUtils.h>
 #include <shrQATest.h>
 
+#include <vector>
+
 #ifndef min
 #define min(a,b) (a < b ? a : b)
 #endif
@@ -105,12 +107,23 @@ int iTestSets = 3;                  // # of loop set retriggers before auto exit
 int iSetCount = 0;                  // Var for present set count 
 const char* cExecutableName = NULL;
 
+// grid build and neighbour search options
+shrBOOL bCountingSort = shrFALSE;   // true = countingSortGrid, false = bitonic sort of cell hashes
+float fVerletSkin = 0.0f;           // Verlet list skin in particle diameters, 0 = scan 27 cells every step
+shrBOOL bBenchmark = shrFALSE;      // true = run the steps/s comparison of grid pipelines and exit
+int iBenchmarkSteps = 50;           // timed steps per benchmark configuration
+
+// SPH fluid mode
+shrBOOL bSph = shrFALSE;            // true = smoothed particle hydrodynamics instead of sphere collisions
+float fSphTimestep = 0.2f;          // fixed SPH time step, the DEM time step is too large for the pressure waves
+
 // Forward Function declarations
 //*****************************************************************************
 // OpenCL Simulation, test and demo
 void ResetSim(int iOption);
 void initParticleSystem(int numParticles, uint3 gridSize);
 void initParams();
+void RunBenchmark(int argc, const char** argv);
 
 // OpenGL (GLUT) functionality
 void InitGL(int* argc, char** argv);
@@ -154,6 +167,12 @@ int main(int argc, char** argv)
         shrGetCmdLineArgumenti(argc, (const char**)argv, "grid", (int*)&gridDim);
         bQATest = shrCheckCmdLineFlag(argc, (const char**)argv, "qatest");
         bNoPrompt = shrCheckCmdLineFlag(argc, (const char**)argv, "noprompt");
+        bCountingSort = shrCheckCmdLineFlag(argc, (const char**)argv, "counting-sort");
+        shrGetCmdLineArgumentf(argc, (const char**)argv, "verlet-skin", &fVerletSkin);
+        bBenchmark = shrCheckCmdLineFlag(argc, (const char**)argv, "benchmark");
+        shrGetCmdLineArgumenti(argc, (const char**)argv, "steps", &iBenchmarkSteps);
+        bSph = shrCheckCmdLineFlag(argc, (const char**)argv, "sph");
+        shrGetCmdLineArgumentf(argc, (const char**)argv, "sph-dt", &fSphTimestep);
     }
     bQATest = shrTRUE;
     // Set and log grid size and particle count, after checking optional command-line inputs
@@ -170,6 +189,14 @@ int main(int argc, char** argv)
     // initialize OpenCL
     startupOpenCL(argc,(const char**)argv);
 
+    // headless pipeline comparison, builds its own particle systems
+    if (bBenchmark)
+    {
+        RunBenchmark(argc, (const char**)argv);
+        shrQAFinish2(true, argc, (const char **)argv, QA_PASSED);
+        Cleanup(EXIT_SUCCESS);
+    }
+
     // init simulation parameters and objects
     initParticleSystem(numParticles, gridSize);
     initParams();
@@ -199,7 +226,16 @@ int main(int argc, char** argv)
 void initParticleSystem(int numParticles, uint3 gridSize)
 {
     psystem = new ParticleSystem(numParticles, gridSize, fParticleRadius, fColliderRadius, bQATest); 
-    psystem->reset(ParticleSystem::CONFIG_GRID);
+    if (bSph)
+    {
+        psystem->setSimulationMode(ParticleSystem::SIM_SPH);
+        psystem->reset(ParticleSystem::CONFIG_DAM_BREAK);
+        timestep = fSphTimestep;
+    }
+    else
+    {
+        psystem->reset(ParticleSystem::CONFIG_GRID);
+    }
     psystem->setIterations(iterations);
     psystem->setDamping(damping);
     psystem->setGravity(-gravity);
@@ -207,6 +243,8 @@ void initParticleSystem(int numParticles, uint3 gridSize)
     psystem->setCollideDamping(collideDamping);
     psystem->setCollideShear(collideShear);
     psystem->setCollideAttraction(collideAttraction);
+    psystem->setGridBuilder(bCountingSort ? ParticleSystem::GRID_COUNTING_SORT : ParticleSystem::GRID_BITONIC_SORT);
+    psystem->setVerletSkin(fVerletSkin * 2.0f * fParticleRadius);
 
     if (!bQATest)
     {
@@ -813,23 +851,151 @@ void TestNoGL()
     psystem->update(timestep); 
 
 	// Start timer 0 and process n loops on the GPU
-    const int iCycles = 20;
+    // (SPH runs --steps fixed time steps of the dam break)
+    const int iCycles = bSph ? iBenchmarkSteps : 20;
+    finishOpenCL();
     shrDeltaT(0); 
     for (int i = 0; i < iCycles; i++)
     {
         psystem->update(timestep); 
     }
+    finishOpenCL();
 
     // Get elapsed time and throughput, then log to sample and master logs
     double dAvgTime = shrDeltaT(0)/(double)iCycles;
-    shrLogEx(LOGBOTH | MASTER, 0, "oclParticles, Throughput = %.4f KParticles/s, Time = %.5f s, Size = %u particles, NumDevsUsed = %u, Workgroup = %u\n", 
-           (1.0e-3 * numParticles)/dAvgTime, dAvgTime, numParticles, 1, 0); 
+    shrLogEx(LOGBOTH | MASTER, 0, "%s, Throughput = %.4f KParticles/s, Time = %.5f s, Size = %u particles, NumDevsUsed = %u, Workgroup = %u\n", 
+           bSph ? "oclParticles-SPH" : "oclParticles", (1.0e-3 * numParticles)/dAvgTime, dAvgTime, numParticles, 1, 0); 
+
+    if (bSph)
+    {
+        // a weakly compressible fluid should stay within a few percent of rest density
+        float fMeanDensity, fMaxDensity;
+        psystem->getDensityStats(&fMeanDensity, &fMaxDensity);
+        shrLog("SPH: %d steps of %.3f, %.2f steps/s, density mean %.1f max %.1f (rest %.1f)\n",
+               iCycles, timestep, 1.0 / dAvgTime, fMeanDensity, fMaxDensity, psystem->getSphRestDensity());
+    }
 
     // Cleanup and exit
     shrQAFinish2(true, *pArgc, (const char **)pArgv, QA_PASSED);
     Cleanup (EXIT_SUCCESS);
 }
 
+// Parses a comma separated list of particle counts, e.g. --nlist=262144,1048576
+//*****************************************************************************
+static void GetCmdLineUintList(int argc, const char** argv, const char* name, std::vector<uint>& values)
+{
+    char* cList = NULL;
+    if (shrGetCmdLineArgumentstr(argc, argv, name, &cList) == shrTRUE)
+    {
+        values.clear();
+        for (char* cToken = strtok(cList, ","); cToken != NULL; cToken = strtok(NULL, ","))
+        {
+            int value = atoi(cToken);
+            if (value > 0)
+            {
+                values.push_back((uint)value);
+            }
+        }
+        free(cList);
+    }
+}
+
+// Steps/s of the grid pipelines at growing particle counts: bitonic sort
+// (the original pipeline), counting sort, and counting sort with a Verlet
+// list. Particles start as a jittered cube filling the world, the radius
+// shrinks with n so the packing density and contact count stay comparable.
+//*****************************************************************************
+void RunBenchmark(int argc, const char** argv)
+{
+    std::vector<uint> nList;
+    nList.push_back(1 << 18);
+    nList.push_back(1 << 19);
+    nList.push_back(1 << 20);
+    nList.push_back(1 << 21);
+    nList.push_back(1 << 22);
+    GetCmdLineUintList(argc, argv, "nlist", nList);
+
+    // list skin in particle diameters when --verlet-skin is not given
+    float fSkin = (fVerletSkin > 0.0f) ? fVerletSkin : 0.25f;
+    const char* cPipeline[] = {"bitonic", "counting", "counting+verlet"};
+
+    shrLog("\npipeline, n, grid, steps, seconds, steps/s, MParticles/s, list rebuilds, speedup\n");
+    for (size_t i = 0; i < nList.size(); i++)
+    {
+        uint n = nList[i];
+
+        // spacing of the initial cube is one diameter
+        uint side = (uint)ceil(pow((double)n, 1.0 / 3.0));
+        float fRadius = 0.95f / side;
+        uint uiGridDim = 1;
+        while (uiGridDim * 2.0f * fRadius < 2.0f)
+        {
+            uiGridDim <<= 1;
+        }
+        uint3 benchGrid;
+        benchGrid.x = benchGrid.y = benchGrid.z = uiGridDim;
+
+        double dBaseline = 0.0;
+        for (int iPipeline = 0; iPipeline < 3; iPipeline++)
+        {
+            // bitonicSort handles power-of-two lengths only
+            if (iPipeline == 0 && (n & (n - 1)) != 0)
+            {
+                shrLog("%s, %u, skipped (n is not a power of two)\n", cPipeline[iPipeline], n);
+                continue;
+            }
+
+            ParticleSystem* bench = new ParticleSystem(n, benchGrid, fRadius, fColliderRadius, shrTRUE);
+            bench->setDamping(damping);
+            bench->setGravity(-gravity);
+            bench->setCollideSpring(collideSpring);
+            bench->setCollideDamping(collideDamping);
+            bench->setCollideShear(collideShear);
+            bench->setCollideAttraction(collideAttraction);
+            bench->setGridBuilder(iPipeline == 0 ? ParticleSystem::GRID_BITONIC_SORT : ParticleSystem::GRID_COUNTING_SORT);
+            bench->setVerletSkin(iPipeline == 2 ? fSkin * 2.0f * fRadius : 0.0f);
+            bench->reset(ParticleSystem::CONFIG_GRID);
+
+            // warmup, also builds the first neighbour list
+            bench->update(timestep);
+            finishOpenCL();
+
+            shrDeltaT(0);
+            for (int iStep = 0; iStep < iBenchmarkSteps; iStep++)
+            {
+                bench->update(timestep);
+            }
+            finishOpenCL();
+            double dSeconds = shrDeltaT(0);
+            double dStepsPerSec = iBenchmarkSteps / dSeconds;
+            if (iPipeline == 0)
+            {
+                dBaseline = dStepsPerSec;
+            }
+
+            shrLog("%s, %u, %u, %d, %.4f, %.2f, %.2f, %u, ", cPipeline[iPipeline], n, uiGridDim, iBenchmarkSteps,
+                   dSeconds, dStepsPerSec, 1.0e-6 * n * dStepsPerSec, bench->getListRebuilds());
+            if (dBaseline > 0.0)
+            {
+                shrLog("%.2fx\n", dStepsPerSec / dBaseline);
+            }
+            else
+            {
+                shrLog("-\n");
+            }
+            if (bench->getListOverflow() > 0)
+            {
+                shrLog("  warning: %u neighbours did not fit the list\n", bench->getListOverflow());
+            }
+
+            shrLogEx(LOGBOTH | MASTER, 0, "oclParticles-%s, Throughput = %.4f KParticles/s, Time = %.5f s, Size = %u particles, NumDevsUsed = %u, Workgroup = %u\n",
+                     cPipeline[iPipeline], (1.0e-3 * n) * dStepsPerSec, dSeconds / iBenchmarkSteps, n, 1, 0);
+
+            delete bench;
+        }
+    }
+}
+
 // Function to clean up and exit
 //*****************************************************************************
 void Cleanup(int iExitCode)
@@ -77,6 +77,13 @@ extern "C" void shutdownOpenCL(void){
     oclCheckError(ciErrNum, CL_SUCCESS);
 }
 
+//Wait for all queued work, for timing
+extern "C" void finishOpenCL(void){
+    cl_int ciErrNum;
+    ciErrNum = clFinish(cqCommandQueue);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
 //GPU buffer allocation
 extern "C" void allocateArray(memHandle_t *memObj, size_t size){
     cl_int ciErrNum;
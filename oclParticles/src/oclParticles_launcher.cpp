@@ -43,7 +43,17 @@ static cl_kernel
     ckCalcHash,
     ckMemset,
     ckFindCellBoundsAndReorder,
-    ckCollide;
+    ckCollide,
+    ckCountCells,
+    ckScanCellsLocal,
+    ckScanBlockSums,
+    ckFinalizeCellBounds,
+    ckScatterParticles,
+    ckBuildNeighbourList,
+    ckReorderAndCheckSkin,
+    ckCollideNeighbourList,
+    ckComputeDensityPressure,
+    ckComputeSphForces;
 
 //Default command queue for particles kernels
 static cl_command_queue cqDefaultCommandQue;
@@ -53,6 +63,14 @@ static cl_mem params;
 
 static size_t wgSize = 64;
 
+//Counting sort scan geometry, must match SCAN_WG_SIZE and SCAN_ITEMS in Particles.cl
+static const size_t scanWgSize = 256;
+static const uint   scanBlock  = 256 * 4;
+
+//Scan block totals, grown on demand by countingSortGrid()
+static cl_mem d_BlockSums = NULL;
+static uint   blockSumsCapacity = 0;
+
 extern "C" void initParticles(cl_context cxGPUContext, cl_command_queue cqParamCommandQue, const char **argv){
     cl_int ciErrNum;
     size_t kernelLength;
@@ -87,6 +105,26 @@ extern "C" void initParticles(cl_context cxGPUContext, cl_command_queue cqParamC
         oclCheckError(ciErrNum, CL_SUCCESS);
         ckCollide = clCreateKernel(cpParticles, "collide", &ciErrNum);
         oclCheckError(ciErrNum, CL_SUCCESS);
+        ckCountCells = clCreateKernel(cpParticles, "countCells", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckScanCellsLocal = clCreateKernel(cpParticles, "scanCellsLocal", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckScanBlockSums = clCreateKernel(cpParticles, "scanBlockSums", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckFinalizeCellBounds = clCreateKernel(cpParticles, "finalizeCellBounds", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckScatterParticles = clCreateKernel(cpParticles, "scatterParticles", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckBuildNeighbourList = clCreateKernel(cpParticles, "buildNeighbourList", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckReorderAndCheckSkin = clCreateKernel(cpParticles, "reorderAndCheckSkin", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckCollideNeighbourList = clCreateKernel(cpParticles, "collideNeighbourList", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckComputeDensityPressure = clCreateKernel(cpParticles, "computeDensityPressure", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        ckComputeSphForces = clCreateKernel(cpParticles, "computeSphForces", &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
 
     shrLog("Creating parameter GPU buffer...\n\n");
         allocateArray(&params, sizeof(simParams_t));
@@ -104,6 +142,18 @@ extern "C" void initParticles(cl_context cxGPUContext, cl_command_queue cqParamC
 extern "C" void closeParticles(void){
     cl_int ciErrNum;
     ciErrNum  = clReleaseMemObject(params);
+    if(d_BlockSums)
+        ciErrNum |= clReleaseMemObject(d_BlockSums);
+    ciErrNum |= clReleaseKernel(ckComputeSphForces);
+    ciErrNum |= clReleaseKernel(ckComputeDensityPressure);
+    ciErrNum |= clReleaseKernel(ckCollideNeighbourList);
+    ciErrNum |= clReleaseKernel(ckReorderAndCheckSkin);
+    ciErrNum |= clReleaseKernel(ckBuildNeighbourList);
+    ciErrNum |= clReleaseKernel(ckScatterParticles);
+    ciErrNum |= clReleaseKernel(ckFinalizeCellBounds);
+    ciErrNum |= clReleaseKernel(ckScanBlockSums);
+    ciErrNum |= clReleaseKernel(ckScanCellsLocal);
+    ciErrNum |= clReleaseKernel(ckCountCells);
     ciErrNum |= clReleaseKernel(ckCollide);
     ciErrNum |= clReleaseKernel(ckFindCellBoundsAndReorder);
     ciErrNum |= clReleaseKernel(ckMemset);
@@ -237,3 +287,241 @@ extern "C" void collide(
     ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckCollide, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
     oclCheckError(ciErrNum, CL_SUCCESS);
 }
+
+extern "C" void countingSortGrid(
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_Index,
+    memHandle_t d_Hash,
+    memHandle_t d_Rank,
+    memHandle_t d_Pos,
+    memHandle_t d_Vel,
+    uint numParticles,
+    uint numCells
+){
+    cl_int ciErrNum;
+    uint numBlocks = (numCells + scanBlock - 1) / scanBlock;
+    if(numBlocks > blockSumsCapacity){
+        if(d_BlockSums)
+            freeArray(d_BlockSums);
+        allocateArray(&d_BlockSums, numBlocks * sizeof(uint));
+        blockSumsCapacity = numBlocks;
+    }
+
+    //Histogram of particles per cell, counted into d_CellEnd
+    memsetOCL(d_CellEnd, 0, numCells);
+    size_t globalWorkSize = uSnap(numParticles, wgSize);
+
+    ciErrNum  = clSetKernelArg(ckCountCells, 0, sizeof(cl_mem), (void *)&d_CellEnd);
+    ciErrNum |= clSetKernelArg(ckCountCells, 1, sizeof(cl_mem), (void *)&d_Hash);
+    ciErrNum |= clSetKernelArg(ckCountCells, 2, sizeof(cl_mem), (void *)&d_Rank);
+    ciErrNum |= clSetKernelArg(ckCountCells, 3, sizeof(cl_mem), (void *)&d_Pos);
+    ciErrNum |= clSetKernelArg(ckCountCells, 4, sizeof(cl_mem), (void *)&params);
+    ciErrNum |= clSetKernelArg(ckCountCells, 5, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckCountCells, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    //Exclusive scan of the counts into d_CellStart
+    globalWorkSize = numBlocks * scanWgSize;
+    ciErrNum  = clSetKernelArg(ckScanCellsLocal, 0, sizeof(cl_mem), (void *)&d_CellStart);
+    ciErrNum |= clSetKernelArg(ckScanCellsLocal, 1, sizeof(cl_mem), (void *)&d_BlockSums);
+    ciErrNum |= clSetKernelArg(ckScanCellsLocal, 2, sizeof(cl_mem), (void *)&d_CellEnd);
+    ciErrNum |= clSetKernelArg(ckScanCellsLocal, 3, sizeof(uint),   (void *)&numCells);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckScanCellsLocal, 1, NULL, &globalWorkSize, &scanWgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum  = clSetKernelArg(ckScanBlockSums, 0, sizeof(cl_mem), (void *)&d_BlockSums);
+    ciErrNum |= clSetKernelArg(ckScanBlockSums, 1, sizeof(uint),   (void *)&numBlocks);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckScanBlockSums, 1, NULL, &scanWgSize, &scanWgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    globalWorkSize = uSnap(numCells, wgSize);
+    ciErrNum  = clSetKernelArg(ckFinalizeCellBounds, 0, sizeof(cl_mem), (void *)&d_CellStart);
+    ciErrNum |= clSetKernelArg(ckFinalizeCellBounds, 1, sizeof(cl_mem), (void *)&d_CellEnd);
+    ciErrNum |= clSetKernelArg(ckFinalizeCellBounds, 2, sizeof(cl_mem), (void *)&d_BlockSums);
+    ciErrNum |= clSetKernelArg(ckFinalizeCellBounds, 3, sizeof(uint),   (void *)&numCells);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckFinalizeCellBounds, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    //Scatter particles into cell order
+    globalWorkSize = uSnap(numParticles, wgSize);
+    ciErrNum  = clSetKernelArg(ckScatterParticles, 0, sizeof(cl_mem), (void *)&d_ReorderedPos);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 1, sizeof(cl_mem), (void *)&d_ReorderedVel);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 2, sizeof(cl_mem), (void *)&d_Index);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 3, sizeof(cl_mem), (void *)&d_CellStart);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 4, sizeof(cl_mem), (void *)&d_Hash);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 5, sizeof(cl_mem), (void *)&d_Rank);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 6, sizeof(cl_mem), (void *)&d_Pos);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 7, sizeof(cl_mem), (void *)&d_Vel);
+    ciErrNum |= clSetKernelArg(ckScatterParticles, 8, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckScatterParticles, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+extern "C" uint buildNeighbourList(
+    memHandle_t d_Neighbours,
+    memHandle_t d_NeighbourCount,
+    memHandle_t d_ListPos,
+    memHandle_t d_Overflow,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    float cutoff,
+    float cellSize,
+    uint  maxNeighbours,
+    uint  numParticles
+){
+    cl_int ciErrNum;
+    float cutoffSq = cutoff * cutoff;
+    int cellRange = (int)ceilf(cutoff / cellSize);
+    size_t globalWorkSize = uSnap(numParticles, wgSize);
+
+    memsetOCL(d_Overflow, 0, 1);
+
+    ciErrNum  = clSetKernelArg(ckBuildNeighbourList,  0, sizeof(cl_mem), (void *)&d_Neighbours);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  1, sizeof(cl_mem), (void *)&d_NeighbourCount);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  2, sizeof(cl_mem), (void *)&d_ListPos);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  3, sizeof(cl_mem), (void *)&d_Overflow);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  4, sizeof(cl_mem), (void *)&d_ReorderedPos);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  5, sizeof(cl_mem), (void *)&d_CellStart);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  6, sizeof(cl_mem), (void *)&d_CellEnd);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  7, sizeof(cl_mem), (void *)&params);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  8, sizeof(float),  (void *)&cutoffSq);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList,  9, sizeof(int),    (void *)&cellRange);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList, 10, sizeof(uint),   (void *)&maxNeighbours);
+    ciErrNum |= clSetKernelArg(ckBuildNeighbourList, 11, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckBuildNeighbourList, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    uint overflow = 0;
+    copyArrayFromDevice(&overflow, d_Overflow, 0, sizeof(uint));
+    return overflow;
+}
+
+extern "C" int reorderAndCheckSkin(
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_Rebuild,
+    memHandle_t d_ListPos,
+    memHandle_t d_Index,
+    memHandle_t d_Pos,
+    memHandle_t d_Vel,
+    float skin,
+    uint  numParticles
+){
+    cl_int ciErrNum;
+    float maxDisplacementSq = 0.25f * skin * skin;
+    size_t globalWorkSize = uSnap(numParticles, wgSize);
+
+    memsetOCL(d_Rebuild, 0, 1);
+
+    ciErrNum  = clSetKernelArg(ckReorderAndCheckSkin, 0, sizeof(cl_mem), (void *)&d_ReorderedPos);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 1, sizeof(cl_mem), (void *)&d_ReorderedVel);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 2, sizeof(cl_mem), (void *)&d_Rebuild);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 3, sizeof(cl_mem), (void *)&d_ListPos);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 4, sizeof(cl_mem), (void *)&d_Index);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 5, sizeof(cl_mem), (void *)&d_Pos);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 6, sizeof(cl_mem), (void *)&d_Vel);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 7, sizeof(float),  (void *)&maxDisplacementSq);
+    ciErrNum |= clSetKernelArg(ckReorderAndCheckSkin, 8, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckReorderAndCheckSkin, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    uint rebuild = 0;
+    copyArrayFromDevice(&rebuild, d_Rebuild, 0, sizeof(uint));
+    return rebuild != 0;
+}
+
+extern "C" void collideNeighbourList(
+    memHandle_t d_Vel,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_Index,
+    memHandle_t d_Neighbours,
+    memHandle_t d_NeighbourCount,
+    uint   numParticles
+){
+    cl_int ciErrNum;
+    size_t globalWorkSize = uSnap(numParticles, wgSize);
+
+    ciErrNum  = clSetKernelArg(ckCollideNeighbourList, 0, sizeof(cl_mem), (void *)&d_Vel);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 1, sizeof(cl_mem), (void *)&d_ReorderedPos);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 2, sizeof(cl_mem), (void *)&d_ReorderedVel);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 3, sizeof(cl_mem), (void *)&d_Index);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 4, sizeof(cl_mem), (void *)&d_Neighbours);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 5, sizeof(cl_mem), (void *)&d_NeighbourCount);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 6, sizeof(cl_mem), (void *)&params);
+    ciErrNum |= clSetKernelArg(ckCollideNeighbourList, 7, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckCollideNeighbourList, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+extern "C" void sphDensityPressure(
+    memHandle_t d_DensityPressure,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    uint   numParticles
+){
+    cl_int ciErrNum;
+    size_t globalWorkSize = uSnap(numParticles, wgSize);
+
+    ciErrNum  = clSetKernelArg(ckComputeDensityPressure, 0, sizeof(cl_mem), (void *)&d_DensityPressure);
+    ciErrNum |= clSetKernelArg(ckComputeDensityPressure, 1, sizeof(cl_mem), (void *)&d_ReorderedPos);
+    ciErrNum |= clSetKernelArg(ckComputeDensityPressure, 2, sizeof(cl_mem), (void *)&d_CellStart);
+    ciErrNum |= clSetKernelArg(ckComputeDensityPressure, 3, sizeof(cl_mem), (void *)&d_CellEnd);
+    ciErrNum |= clSetKernelArg(ckComputeDensityPressure, 4, sizeof(cl_mem), (void *)&params);
+    ciErrNum |= clSetKernelArg(ckComputeDensityPressure, 5, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckComputeDensityPressure, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+extern "C" void sphForces(
+    memHandle_t d_Vel,
+    memHandle_t d_ReorderedPos,
+    memHandle_t d_ReorderedVel,
+    memHandle_t d_DensityPressure,
+    memHandle_t d_Index,
+    memHandle_t d_CellStart,
+    memHandle_t d_CellEnd,
+    float  deltaTime,
+    uint   numParticles
+){
+    cl_int ciErrNum;
+    size_t globalWorkSize = uSnap(numParticles, wgSize);
+
+    ciErrNum  = clSetKernelArg(ckComputeSphForces, 0, sizeof(cl_mem), (void *)&d_Vel);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 1, sizeof(cl_mem), (void *)&d_ReorderedPos);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 2, sizeof(cl_mem), (void *)&d_ReorderedVel);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 3, sizeof(cl_mem), (void *)&d_DensityPressure);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 4, sizeof(cl_mem), (void *)&d_Index);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 5, sizeof(cl_mem), (void *)&d_CellStart);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 6, sizeof(cl_mem), (void *)&d_CellEnd);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 7, sizeof(cl_mem), (void *)&params);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 8, sizeof(float),  (void *)&deltaTime);
+    ciErrNum |= clSetKernelArg(ckComputeSphForces, 9, sizeof(uint),   (void *)&numParticles);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    ciErrNum = clEnqueueNDRangeKernel(cqDefaultCommandQue, ckComputeSphForces, 1, NULL, &globalWorkSize, &wgSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
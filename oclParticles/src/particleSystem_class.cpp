@@ -22,7 +22,18 @@ ParticleSystem::ParticleSystem(uint numParticles, uint3 gridSize, float fParticl
     m_dVel(0),
     m_gridSize(gridSize),
     m_solverIterations(1),
-    m_bQATest(bQATest)
+    m_bQATest(bQATest),
+    m_dNeighbours(0),
+    m_dNeighbourCount(0),
+    m_dListPos(0),
+    m_dListFlag(0),
+    m_mode(SIM_DEM),
+    m_gridBuilder(GRID_BITONIC_SORT),
+    m_verletSkin(0.0f),
+    m_maxNeighbours(0),
+    m_bListValid(false),
+    m_listRebuilds(0),
+    m_listOverflow(0)
 {
     m_numGridCells = m_gridSize.x * m_gridSize.y * m_gridSize.z;
     float3 worldSize = make_float3(2.0f, 2.0f, 2.0f);
@@ -51,6 +62,12 @@ ParticleSystem::ParticleSystem(uint numParticles, uint3 gridSize, float fParticl
     m_params.gravity = make_float3(0.0f, -0.0003f, 0.0f);
     m_params.globalDamping = 1.0f;
 
+    m_params.sphSmoothingLength = cellSize;
+    m_params.sphRestDensity = 1000.0f;
+    m_params.sphGasStiffness = 0.02f;
+    m_params.sphViscosity = 0.05f;
+    updateSphConstants();
+
     _initialize(numParticles);
 }
 
@@ -122,6 +139,8 @@ void ParticleSystem::_initialize(int numParticles){
     allocateArray(&m_dIndex,        m_numParticles * sizeof(uint));
     allocateArray(&m_dCellStart,    m_numGridCells * sizeof(uint));
     allocateArray(&m_dCellEnd,      m_numGridCells * sizeof(uint));
+    allocateArray(&m_dRank,         m_numParticles * sizeof(uint));
+    allocateArray(&m_dDensityPressure, m_numParticles * 2 * sizeof(float));
 
     if (!m_bQATest)
     {
@@ -173,6 +192,9 @@ void ParticleSystem::_finalize(){
     freeArray(m_dIndex);
     freeArray(m_dCellStart);
     freeArray(m_dCellEnd);
+    freeArray(m_dRank);
+    freeArray(m_dDensityPressure);
+    freeNeighbourList();
 
     if (!m_bQATest)
     {
@@ -193,33 +215,99 @@ extern"C" void bitonicSort(
     unsigned int dir
 );
 
-static int isNan(float f){
-    unsigned int u = *(unsigned int*)&f;
-    return ( (u & 0x7F800000U) == 0x7F800000U ) && ( (u & 0x007FFFFFU) != 0 );
+void ParticleSystem::freeNeighbourList(){
+    if (m_dNeighbours)
+    {
+        freeArray(m_dNeighbours);
+        freeArray(m_dNeighbourCount);
+        freeArray(m_dListPos);
+        freeArray(m_dListFlag);
+        m_dNeighbours = m_dNeighbourCount = m_dListPos = m_dListFlag = 0;
+    }
+    m_bListValid = false;
 }
 
-//Step the simulation
-void ParticleSystem::update(float deltaTime){
+void ParticleSystem::setVerletSkin(float skin, uint maxNeighbours){
     assert(m_bInitialized);
+    freeNeighbourList();
+
+    // a skin up to one cell keeps the list search within 5x5x5 cells
+    m_verletSkin = fminf(skin, m_params.cellSize.x);
+    m_maxNeighbours = maxNeighbours;
+    m_listRebuilds = 0;
+    m_listOverflow = 0;
+    if (m_verletSkin <= 0.0f)
+    {
+        m_verletSkin = 0.0f;
+        return;
+    }
 
-    setParameters(&m_params);
-    setParametersHost(&m_params);
+    allocateArray(&m_dNeighbours,     (size_t)m_numParticles * m_maxNeighbours * sizeof(uint));
+    allocateArray(&m_dNeighbourCount, m_numParticles * sizeof(uint));
+    allocateArray(&m_dListPos,        m_numParticles * 4 * sizeof(float));
+    allocateArray(&m_dListFlag,       sizeof(uint));
+}
 
-    //Download positions from VBO
-    memHandle_t pos; 
-    if (!m_bQATest)
+//Kernel normalisations for the smoothing length, and the particle mass
+//that gives rest density on a lattice of half a smoothing length spacing
+void ParticleSystem::updateSphConstants(){
+    const float pi = 3.14159265358979f;
+    float h  = m_params.sphSmoothingLength;
+    float h2 = h * h;
+    float h6 = h2 * h2 * h2;
+    m_params.sphPoly6 = 315.0f / (64.0f * pi * h6 * h2 * h);
+    m_params.sphSpikyGrad = -45.0f / (pi * h6);
+    m_params.sphViscLaplacian = 45.0f / (pi * h6);
+
+    float spacing = 0.5f * h;
+    float sum = 0.0f;
+    for(int z = -2; z <= 2; z++)
+        for(int y = -2; y <= 2; y++)
+            for(int x = -2; x <= 2; x++)
+            {
+                float r2 = spacing * spacing * (float)(x * x + y * y + z * z);
+                if (r2 < h2)
+                {
+                    sum += (h2 - r2) * (h2 - r2) * (h2 - r2);
+                }
+            }
+    m_params.sphParticleMass = m_params.sphRestDensity / (m_params.sphPoly6 * sum);
+}
+
+void ParticleSystem::getDensityStats(float *mean, float *max){
+    float *hDensity = (float *)malloc(m_numParticles * 2 * sizeof(float));
+    copyArrayFromDevice(hDensity, m_dDensityPressure, 0, m_numParticles * 2 * sizeof(float));
+
+    double sum = 0.0;
+    *max = 0.0f;
+    for(uint i = 0; i < m_numParticles; i++)
     {
-        glBindBufferARB(GL_ARRAY_BUFFER, m_posVbo);
-        pos = (memHandle_t)glMapBufferARB(GL_ARRAY_BUFFER, GL_READ_WRITE);
-        copyArrayToDevice(m_dPos, pos, 0, m_numParticles * 4 * sizeof(float));
+        sum += hDensity[2 * i];
+        *max = fmaxf(*max, hDensity[2 * i]);
     }
+    *mean = (float)(sum / m_numParticles);
+    free(hDensity);
+}
 
-    integrateSystem(
-        m_dPos,
-        m_dVel,
-        deltaTime,
-        m_numParticles
-    );
+//Rebuild the uniform grid and reorder particles into cell order
+void ParticleSystem::buildGrid(){
+    if (m_gridBuilder == GRID_COUNTING_SORT)
+    {
+        countingSortGrid(
+            m_dCellStart,
+            m_dCellEnd,
+            m_dReorderedPos,
+            m_dReorderedVel,
+            m_dIndex,
+            m_dHash,
+            m_dRank,
+            m_dPos,
+            m_dVel,
+            m_numParticles,
+            m_numGridCells
+        );
+        return;
+    }
 
     calcHash(
         m_dHash,
@@ -244,18 +332,128 @@ void ParticleSystem::update(float deltaTime){
         m_numParticles,
         m_numGridCells
     );
+}
+
+static int isNan(float f){
+    unsigned int u = *(unsigned int*)&f;
+    return ( (u & 0x7F800000U) == 0x7F800000U ) && ( (u & 0x007FFFFFU) != 0 );
+}
+
+//Step the simulation
+void ParticleSystem::update(float deltaTime){
+    assert(m_bInitialized);
+
+    setParameters(&m_params);
+    setParametersHost(&m_params);
+
+    //Download positions from VBO
+    memHandle_t pos; 
+    if (!m_bQATest)
+    {
+        glBindBufferARB(GL_ARRAY_BUFFER, m_posVbo);
+        pos = (memHandle_t)glMapBufferARB(GL_ARRAY_BUFFER, GL_READ_WRITE);
+        copyArrayToDevice(m_dPos, pos, 0, m_numParticles * 4 * sizeof(float));
+    }
 
-    collide(
+    integrateSystem(
+        m_dPos,
         m_dVel,
-        m_dReorderedPos,
-        m_dReorderedVel,
-        m_dIndex,
-        m_dCellStart,
-        m_dCellEnd,
-        m_numParticles,
-        m_numGridCells
+        deltaTime,
+        m_numParticles
     );
 
+    if (m_mode == SIM_SPH)
+    {
+        buildGrid();
+
+        sphDensityPressure(
+            m_dDensityPressure,
+            m_dReorderedPos,
+            m_dCellStart,
+            m_dCellEnd,
+            m_numParticles
+        );
+
+        sphForces(
+            m_dVel,
+            m_dReorderedPos,
+            m_dReorderedVel,
+            m_dDensityPressure,
+            m_dIndex,
+            m_dCellStart,
+            m_dCellEnd,
+            deltaTime,
+            m_numParticles
+        );
+    }
+    else if (m_verletSkin > 0.0f)
+    {
+        //Reuse the list while it still covers every contact
+        if (m_bListValid)
+        {
+            m_bListValid = !reorderAndCheckSkin(
+                m_dReorderedPos,
+                m_dReorderedVel,
+                m_dListFlag,
+                m_dListPos,
+                m_dIndex,
+                m_dPos,
+                m_dVel,
+                m_verletSkin,
+                m_numParticles
+            );
+        }
+
+        if (!m_bListValid)
+        {
+            buildGrid();
+            uint overflow = buildNeighbourList(
+                m_dNeighbours,
+                m_dNeighbourCount,
+                m_dListPos,
+                m_dListFlag,
+                m_dReorderedPos,
+                m_dCellStart,
+                m_dCellEnd,
+                2.0f * m_params.particleRadius + m_verletSkin,
+                m_params.cellSize.x,
+                m_maxNeighbours,
+                m_numParticles
+            );
+            if (overflow > m_listOverflow)
+            {
+                m_listOverflow = overflow;
+            }
+            m_listRebuilds++;
+            m_bListValid = true;
+        }
+
+        collideNeighbourList(
+            m_dVel,
+            m_dReorderedPos,
+            m_dReorderedVel,
+            m_dIndex,
+            m_dNeighbours,
+            m_dNeighbourCount,
+            m_numParticles
+        );
+    }
+    else
+    {
+        buildGrid();
+
+        collide(
+            m_dVel,
+            m_dReorderedPos,
+            m_dReorderedVel,
+            m_dIndex,
+            m_dCellStart,
+            m_dCellEnd,
+            m_numParticles,
+            m_numGridCells
+        );
+    }
+
     //Update buffers
     if (!m_bQATest)
     {
@@ -303,6 +501,7 @@ float *ParticleSystem::getArray(ParticleArray array){
 
 void ParticleSystem::setArray(ParticleArray array, const float* data, int start, int count){
     assert(m_bInitialized);
+    m_bListValid = false;
 
     switch (array){
         default:
@@ -381,6 +580,29 @@ void ParticleSystem::reset(ParticleConfig config){
             initGrid(gridSize, m_params.particleRadius * 2.0f, jitter, m_numParticles);
         }
         break;
+
+        case CONFIG_DAM_BREAK:
+        {
+            //Fill the -x half of the box from the floor up
+            float spacing = 0.5f * m_params.sphSmoothingLength;
+            float jitter = spacing * 0.01f;
+            uint gridSize[3];
+            gridSize[0] = (uint)(1.0f / spacing);
+            gridSize[2] = (uint)(2.0f / spacing) - 1;
+            gridSize[1] = (m_numParticles + gridSize[0] * gridSize[2] - 1) / (gridSize[0] * gridSize[2]);
+            for(uint i = 0; i < m_numParticles; i++)
+            {
+                uint x = i % gridSize[0];
+                uint z = (i / gridSize[0]) % gridSize[2];
+                uint y = i / (gridSize[0] * gridSize[2]);
+                m_hPos[i * 4]     = (spacing * x) + spacing - 1.0f + (frand() * 2.0f - 1.0f) * jitter;
+                m_hPos[i * 4 + 1] = (spacing * y) + spacing - 1.0f + (frand() * 2.0f - 1.0f) * jitter;
+                m_hPos[i * 4 + 2] = (spacing * z) + spacing - 1.0f + (frand() * 2.0f - 1.0f) * jitter;
+                m_hPos[i * 4 + 3] = 1.0f;
+                m_hVel[i * 4] = m_hVel[i * 4 + 1] = m_hVel[i * 4 + 2] = m_hVel[i * 4 + 3] = 0.0f;
+            }
+        }
+        break;
     }
 
     if (!m_bQATest)
@@ -388,6 +610,13 @@ void ParticleSystem::reset(ParticleConfig config){
         setArray(POSITION, m_hPos, 0, m_numParticles);
         setArray(VELOCITY, m_hVel, 0, m_numParticles);
     }
+    else
+    {
+        //No VBO without GL, upload straight to the simulation buffers
+        copyArrayToDevice(m_dPos, m_hPos, 0, m_numParticles * 4 * sizeof(float));
+        copyArrayToDevice(m_dVel, m_hVel, 0, m_numParticles * 4 * sizeof(float));
+        m_bListValid = false;
+    }
 }
 
 void ParticleSystem::addSphere(int start, float *pos, float *vel, int r, float spacing){
@@ -25,3 +25,47 @@ __kernel void reduce(__global float *d_Result, __global float *d_Input, int N){
 
     d_Result[tid] = sum;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// Streaming reduction: reduceChunk turns one chunk into one partial sum per
+// work-group, combine folds N values into one with a single work-group.
+// Both finish with a tree in local memory, the work-group size must be a
+// power of two.
+////////////////////////////////////////////////////////////////////////////////
+__kernel void reduceChunk(__global float *d_Partial, __global const float *d_Input, int N,
+                          int partialOffset, __local float *l_Sum){
+    const int lid = get_local_id(0);
+
+    float sum = 0;
+    for(int pos = get_global_id(0); pos < N; pos += get_global_size(0))
+        sum += d_Input[pos];
+    l_Sum[lid] = sum;
+
+    for(int stride = get_local_size(0) / 2; stride > 0; stride >>= 1){
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(lid < stride)
+            l_Sum[lid] += l_Sum[lid + stride];
+    }
+
+    if(lid == 0)
+        d_Partial[partialOffset + get_group_id(0)] = l_Sum[0];
+}
+
+__kernel void combine(__global float *d_Out, int outIndex, __global const float *d_In, int N,
+                      __local float *l_Sum){
+    const int lid = get_local_id(0);
+
+    float sum = 0;
+    for(int pos = lid; pos < N; pos += get_local_size(0))
+        sum += d_In[pos];
+    l_Sum[lid] = sum;
+
+    for(int stride = get_local_size(0) / 2; stride > 0; stride >>= 1){
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(lid < stride)
+            l_Sum[lid] += l_Sum[lid + stride];
+    }
+
+    if(lid == 0)
+        d_Out[outIndex] = l_Sum[0];
+}
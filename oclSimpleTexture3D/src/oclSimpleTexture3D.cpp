@@ -29,6 +29,10 @@
 // Utilities, OpenCL and system includes
 #include <oclUtils.h>
 #include <shrQATest.h>
+#include <cmath>
+#include <vector>
+
+#include "HeadlessRenderer.h"
 
 // Constants, defines, typedefs and global declarations
 //*****************************************************************************
@@ -64,6 +68,7 @@ cl_device_id cdDevice;
 cl_command_queue cqCommandQueue;
 cl_program cpProgram;
 cl_kernel ckKernel;
+cl_kernel ckKernelSlice;            // oblique slices, for the headless renderer
 cl_int ciErrNum;
 cl_mem pbo_cl;
 cl_mem d_volume;
@@ -82,6 +87,7 @@ float w = 0.5;                      // initial texture coordinate in z
 int g_Index = 0;
 shrBOOL bQATest = shrFALSE;
 shrBOOL bNoPrompt = shrFALSE;
+shrBOOL bHeadless = shrFALSE;       // true = render a batch of slice matrices to images, then exit
 bool linearFiltering = true;
 bool animate = true;
 
@@ -110,6 +116,7 @@ void initGLBuffers();
 void Cleanup(int iExitCode);
 void (*pCleanup)(int) = &Cleanup;
 void TestNoGL();
+void RunHeadless(int argc, const char** argv);
 
 // Main program
 //*****************************************************************************
@@ -133,6 +140,7 @@ int main(int argc, char** argv)
     {
         bQATest   = shrCheckCmdLineFlag(argc, (const char**)argv, "qatest");
         bNoPrompt = shrCheckCmdLineFlag(argc, (const char**)argv, "noprompt");
+        bHeadless = shrCheckCmdLineFlag(argc, (const char**)argv, "headless");
     }
     bQATest = shrTRUE;
     // Initialize OpenGL context, so we can properly set the GL for CL.
@@ -204,10 +212,17 @@ int main(int argc, char** argv)
     // create the kernel
     ckKernel = clCreateKernel(cpProgram, "render", &ciErrNum);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ckKernelSlice = clCreateKernel(cpProgram, "renderSlice", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
     // Load the data
     loadVolumeData(argv[0]);
 
+    if (bHeadless)
+    {
+        RunHeadless(argc, (const char**)argv);
+    }
+
     // Create buffers and textures, 
     // and then start main GLUT rendering loop for processing and rendering, 
 	// or otherwise run No-GL Q/A test sequence
@@ -496,6 +511,8 @@ void loadVolumeData(const char *exec_path)
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
     volumeSamplerNearest = clCreateSampler(cxGPUContext, true, CL_ADDRESS_REPEAT, CL_FILTER_NEAREST, &ciErrNum);
     ciErrNum |= clSetKernelArg(ckKernel, 1, sizeof(cl_sampler), &volumeSamplerLinear);        
+    ciErrNum |= clSetKernelArg(ckKernelSlice, 0, sizeof(cl_mem), &d_volume);
+    ciErrNum |= clSetKernelArg(ckKernelSlice, 1, sizeof(cl_sampler), &volumeSamplerLinear);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
     free(h_volume);
@@ -540,6 +557,133 @@ void TestNoGL()
     Cleanup(EXIT_SUCCESS);
 }
 
+// Slices through the center of the volume, rotated about its y axis: the
+// matrix maps (u, v, 0, 1) to texture coordinates, 3x4 row major
+//*****************************************************************************
+void orbitSlices(int n, std::vector<float>& slices)
+{
+    slices.resize(n * 12);
+    for (int i = 0; i < n; i++)
+    {
+        float angle = 3.14159265f * i / n;
+        float c = cosf(angle), s = sinf(angle);
+        float m[12] = {c, 0.0f, s, 0.5f - 0.5f * c,  0.0f, 1.0f, 0.0f, 0.0f,  -s, 0.0f, c, 0.5f + 0.5f * s};
+        memcpy(&slices[i * 12], m, sizeof(m));
+    }
+}
+
+// Per-frame callbacks of the headless renderer
+//*****************************************************************************
+struct HeadlessFrames
+{
+    uint width;
+    uint height;
+    bool bSave;
+    std::vector<unsigned char> ppm;
+};
+
+void renderHeadlessFrame(cl_mem output, const float *slice, void *userData)
+{
+    HeadlessFrames *frames = (HeadlessFrames *)userData;
+    size_t localSize[] = {localWorkSize[0], localWorkSize[1]};
+    size_t globalSize[] = {shrRoundUp((int)localSize[0], (int)frames->width), shrRoundUp((int)localSize[1], (int)frames->height)};
+
+    ciErrNum = clSetKernelArg(ckKernelSlice, 2, sizeof(cl_mem), (void *)&output);
+    ciErrNum |= clSetKernelArg(ckKernelSlice, 3, sizeof(unsigned int), &frames->width);
+    ciErrNum |= clSetKernelArg(ckKernelSlice, 4, sizeof(unsigned int), &frames->height);
+    for (int row = 0; row < 3; row++)
+    {
+        ciErrNum |= clSetKernelArg(ckKernelSlice, 5 + row, sizeof(cl_float4), slice + 4 * row);
+    }
+    ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, ckKernelSlice, 2, NULL, globalSize, localSize, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
+void encodeHeadlessFrame(int frame, const unsigned char *pixels, void *userData)
+{
+    HeadlessFrames *frames = (HeadlessFrames *)userData;
+    HeadlessRenderer::EncodePPM(pixels, frames->width, frames->height, frames->ppm);
+    if (frames->bSave)
+    {
+        char cFileName[64];
+        sprintf(cFileName, "slice_%04d.ppm", frame);
+        FILE *fp = fopen(cFileName, "wb");
+        oclCheckErrorEX(fp != NULL, true, pCleanup);
+        fwrite(&frames->ppm[0], 1, frames->ppm.size(), fp);
+        fclose(fp);
+    }
+}
+
+// Render a batch of slices (-cameras=file with 12 floats per slice matrix,
+// or -frames slices rotating about the volume's y axis) to PPM images, through
+// a pool of -pool output buffers, first one frame at a time and then
+// pipelined. -width and -height set the image size, -save writes the images.
+//*****************************************************************************
+void RunHeadless(int argc, const char** argv)
+{
+    int iFrames = 64;
+    int iPoolSize = 3;
+    int n;
+    char* cCameraFile = NULL;
+    HeadlessFrames frames;
+    frames.width = width;
+    frames.height = height;
+    frames.bSave = false;
+    if (shrGetCmdLineArgumenti(argc, argv, "frames", &n) && n > 0) {
+        iFrames = n;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "pool", &n) && n > 0) {
+        iPoolSize = n;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "width", &n) && n > 0) {
+        frames.width = n;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "height", &n) && n > 0) {
+        frames.height = n;
+    }
+
+    std::vector<float> slices;
+    if (shrGetCmdLineArgumentstr(argc, argv, "cameras", &cCameraFile))
+    {
+        bool bLoaded = HeadlessRenderer::LoadCameras(cCameraFile, 12, slices);
+        free(cCameraFile);
+        oclCheckErrorEX(bLoaded, true, pCleanup);
+        iFrames = (int)(slices.size() / 12);
+    }
+    else
+    {
+        orbitSlices(iFrames, slices);
+    }
+    bool bSave = shrCheckCmdLineFlag(argc, argv, "save") == shrTRUE;
+
+    shrLog("\nHeadless: %d frames of %u x %u pixels, pool of %d buffers\n\n", iFrames, frames.width, frames.height, iPoolSize);
+
+    double dSerialTime, dPipelinedTime;
+    {
+        HeadlessRenderer renderer(cxGPUContext, cdDevice, cqCommandQueue, frames.width, frames.height, iPoolSize);
+
+        // warmup without saving; both timed runs save the same images, so
+        // the speedup compares equal work
+        renderer.RenderBatch(&slices[0], (iFrames < iPoolSize) ? iFrames : iPoolSize, 12, renderHeadlessFrame, encodeHeadlessFrame, &frames);
+
+        frames.bSave = bSave;
+        dSerialTime = renderer.RenderBatchSerial(&slices[0], iFrames, 12, renderHeadlessFrame, encodeHeadlessFrame, &frames);
+        shrLog("serial:    %8.2f frames/s, %.3f ms/frame (encode %.3f ms, wait %.3f ms)\n",
+               iFrames / dSerialTime, 1.0e3 * dSerialTime / iFrames,
+               1.0e3 * renderer.GetEncodeTime() / iFrames, 1.0e3 * renderer.GetWaitTime() / iFrames);
+
+        dPipelinedTime = renderer.RenderBatch(&slices[0], iFrames, 12, renderHeadlessFrame, encodeHeadlessFrame, &frames);
+        shrLog("pipelined: %8.2f frames/s, %.3f ms/frame (encode %.3f ms, wait %.3f ms)\n",
+               iFrames / dPipelinedTime, 1.0e3 * dPipelinedTime / iFrames,
+               1.0e3 * renderer.GetEncodeTime() / iFrames, 1.0e3 * renderer.GetWaitTime() / iFrames);
+    }
+
+    shrLogEx(LOGBOTH | MASTER, 0, "oclSimpleTexture3D-headless, Throughput = %.2f frames/s, Speedup = %.2fx, Size = %u Pixels, Frames = %d, Pool = %d\n",
+             iFrames / dPipelinedTime, dSerialTime / dPipelinedTime, frames.width * frames.height, iFrames, iPoolSize);
+
+    Cleanup(EXIT_SUCCESS);
+}
+
 // Helper to clean up
 //*****************************************************************************
 void Cleanup(int iExitCode)
@@ -549,6 +693,7 @@ void Cleanup(int iExitCode)
     if(cPathAndName)free(cPathAndName);
     if(cSourceCL)free(cSourceCL);
 	if(ckKernel)clReleaseKernel(ckKernel); 
+    if(ckKernelSlice)clReleaseKernel(ckKernelSlice);
     if(cpProgram)clReleaseProgram(cpProgram);
     if(cqCommandQueue)clReleaseCommandQueue(cqCommandQueue);
     if(cxGPUContext)clReleaseContext(cxGPUContext);
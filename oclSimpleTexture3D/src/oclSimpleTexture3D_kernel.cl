@@ -27,3 +27,22 @@ __kernel void render(__read_only image3d_t volume, sampler_t volumeSampler,  __g
         d_output[i] = voxel.x*255;
     }
 }
+
+// Arbitrary slice through the volume: texture coordinates are the 3x4 matrix
+// (rows row0..row2) applied to the normalized pixel position (u, v, 0, 1)
+__kernel void renderSlice(__read_only image3d_t volume, sampler_t volumeSampler, __global uint *d_output, uint imageW, uint imageH,
+                          float4 row0, float4 row1, float4 row2)
+{
+    uint x = get_global_id(0);
+    uint y = get_global_id(1);
+
+    float4 p = (float4)(x / (float) imageW, y / (float) imageH, 0.0f, 1.0f);
+    float4 coord = (float4)(dot(row0, p), dot(row1, p), dot(row2, p), 1.0f);
+
+    float4 voxel = read_imagef(volume, volumeSampler, coord);
+
+    if ((x < imageW) && (y < imageH)) {
+        uint i = (y * imageW) + x;
+        d_output[i] = voxel.x*255;
+    }
+}
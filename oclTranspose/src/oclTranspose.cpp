@@ -17,6 +17,10 @@
  * transpose with fully coalesced memory access and no bank conflicts.  On 
  * a G80 GPU, the optimized transpose can be more than 10x faster for large
  * matrices.
+ *
+ * The transpose engine (transpose_engine.cpp) then covers 8, 16, 32 and
+ * 64-bit elements, in-place transposes, batches of small matrices and
+ * AoS <-> SoA conversion, on the first device.
  */
 
 // standard utility and system includes
@@ -42,6 +46,8 @@ cl_program cpProgram;
 int runTest( int argc, const char** argv);
 extern "C" void computeGold( float* reference, float* idata, 
                          const unsigned int size_x, const unsigned int size_y );
+shrBOOL runTransposeEngine(int argc, const char** argv, cl_context context, cl_command_queue queue,
+                           unsigned int size_x, unsigned int size_y);
 
 // Main Program
 // *********************************************************************
@@ -340,6 +346,13 @@ int runTest( const int argc, const char** argv)
     shrLog("\nComparing results with CPU computation... \n\n");
     shrBOOL res = shrComparef( reference, h_odata, size_x * size_y);
 
+    // other element types, in-place, batched and AoS <-> SoA
+    if (!shrCheckCmdLineFlag(argc, argv, "noengine"))
+    {
+        shrBOOL engineRes = runTransposeEngine(argc, argv, cxGPUContext, commandQueue[0], size_x, size_y);
+        res = (res == shrTRUE && engineRes == shrTRUE) ? shrTRUE : shrFALSE;
+    }
+
     // cleanup memory
     free(h_idata);
     free(h_odata);
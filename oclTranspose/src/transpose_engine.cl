@@ -0,0 +1,268 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+/* Transposes for 8, 16, 32 and 64-bit elements: out-of-place, in-place for
+* square and rectangular matrices, batched small matrices, and AoS <-> SoA
+* conversion of struct arrays. The element type only matters for its size,
+* so the kernels are instantiated for uchar, ushort, uint and ulong.
+* Device code.
+*/
+
+#define BLOCK_DIM 16
+#define PITCH (BLOCK_DIM+1)
+
+#define TRANSPOSE_KERNELS(T)                                                                        \
+                                                                                                    \
+/* Baseline for the bandwidth of the other kernels */                                               \
+__kernel void copy_##T(__global T *odata, __global const T *idata, uint n)                          \
+{                                                                                                   \
+    uint i = get_global_id(0);                                                                      \
+    if (i < n)                                                                                      \
+    {                                                                                               \
+        odata[i] = idata[i];                                                                        \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* Out-of-place, through a padded tile in local memory, as transpose in transpose.cl */             \
+__kernel void transpose_##T(__global T *odata, __global const T *idata, uint width, uint height,    \
+                            __local T *block)                                                       \
+{                                                                                                   \
+    uint xIndex = get_global_id(0);                                                                 \
+    uint yIndex = get_global_id(1);                                                                 \
+    if ((xIndex < width) && (yIndex < height))                                                      \
+    {                                                                                               \
+        block[get_local_id(1)*PITCH + get_local_id(0)] = idata[(size_t)yIndex*width + xIndex];      \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_LOCAL_MEM_FENCE);                                                                   \
+                                                                                                    \
+    xIndex = get_group_id(1)*BLOCK_DIM + get_local_id(0);                                           \
+    yIndex = get_group_id(0)*BLOCK_DIM + get_local_id(1);                                           \
+    if ((xIndex < height) && (yIndex < width))                                                      \
+    {                                                                                               \
+        odata[(size_t)yIndex*height + xIndex] = block[get_local_id(0)*PITCH + get_local_id(1)];     \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* In-place, square n x n: the work-group of tile (bx, by) below the diagonal */                    \
+/* swaps it with tile (by, bx), both transposed. Groups above the diagonal */                       \
+/* leave at once, as a whole, so the barrier is still reached by everyone. */                       \
+__kernel void transpose_square_inplace_##T(__global T *data, uint n, __local T *block)              \
+{                                                                                                   \
+    uint bx = get_group_id(0);                                                                      \
+    uint by = get_group_id(1);                                                                      \
+    if (bx > by)                                                                                    \
+    {                                                                                               \
+        return;                                                                                     \
+    }                                                                                               \
+                                                                                                    \
+    uint lx = get_local_id(0);                                                                      \
+    uint ly = get_local_id(1);                                                                      \
+    __local T *a = block;                                                                           \
+    __local T *b = block + BLOCK_DIM*PITCH;                                                         \
+                                                                                                    \
+    /* element (ly, lx) of tile A at block row by, column bx, and of its mirror B */                \
+    uint ax = bx*BLOCK_DIM + lx, ay = by*BLOCK_DIM + ly;                                            \
+    uint bxIndex = by*BLOCK_DIM + lx, byIndex = bx*BLOCK_DIM + ly;                                  \
+    bool inA = (ax < n) && (ay < n);                                                                \
+    bool inB = (bxIndex < n) && (byIndex < n);                                                      \
+    if (inA)                                                                                        \
+    {                                                                                               \
+        a[ly*PITCH + lx] = data[(size_t)ay*n + ax];                                                 \
+    }                                                                                               \
+    if (inB)                                                                                        \
+    {                                                                                               \
+        b[ly*PITCH + lx] = data[(size_t)byIndex*n + bxIndex];                                       \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_LOCAL_MEM_FENCE);                                                                   \
+                                                                                                    \
+    /* on the diagonal A and B are the same tile, both writes store the same value */               \
+    if (inB)                                                                                        \
+    {                                                                                               \
+        data[(size_t)byIndex*n + bxIndex] = a[lx*PITCH + ly];                                       \
+    }                                                                                               \
+    if (inA)                                                                                        \
+    {                                                                                               \
+        data[(size_t)ay*n + ax] = b[lx*PITCH + ly];                                                 \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* In-place, rectangular rows x cols, in three passes that each permute the elements */             \
+/* within every column or within every row (Catanzaro, Keller and Garland, "A */                    \
+/* Decomposition for In-place Matrix Transposition"): element (i, j) ends at index */               \
+/* j*rows + i. With c = gcd(rows, cols) and b = cols/c, */                                          \
+/*   1. column j is rotated down by j/b (nothing to do when c = 1) */                               \
+/*   2. in row r, column j moves to (j*rows + i) % cols, i = (r - j/b) % rows */                    \
+/*   3. in column j, row i' takes row (i + j0/b) % rows, (i, j0) being the source */                \
+/*      of index i'*cols + j */                                                                     \
+/* A group stages its row or band of columns in scratch, then all of its work-items */              \
+/* move elements at once, however long the cycles of the whole permutation are. */                  \
+                                                                                                    \
+/* Pass 1, one BLOCK_DIM x BLOCK_DIM group per band of BLOCK_DIM columns */                         \
+__kernel void transpose_rotate_##T(__global T *data, __global T *scratch, uint rows, uint cols,     \
+                                   uint b, uint firstBand)                                          \
+{                                                                                                   \
+    uint lx = get_local_id(0);                                                                      \
+    uint ly = get_local_id(1);                                                                      \
+    uint j = (firstBand + get_group_id(0))*BLOCK_DIM + lx;                                          \
+    __global T *band = scratch + (size_t)get_group_id(0)*rows*BLOCK_DIM;                            \
+    if (j < cols)                                                                                   \
+    {                                                                                               \
+        for (uint i = ly; i < rows; i += BLOCK_DIM)                                                 \
+        {                                                                                           \
+            band[(size_t)i*BLOCK_DIM + lx] = data[(size_t)i*cols + j];                              \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_GLOBAL_MEM_FENCE);                                                                  \
+                                                                                                    \
+    if (j < cols)                                                                                   \
+    {                                                                                               \
+        uint shift = j / b;                                                                         \
+        for (uint i = ly; i < rows; i += BLOCK_DIM)                                                 \
+        {                                                                                           \
+            data[(size_t)((i + shift) % rows)*cols + j] = band[(size_t)i*BLOCK_DIM + lx];           \
+        }                                                                                           \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* Pass 2, one group per row */                                                                     \
+__kernel void transpose_row_shuffle_##T(__global T *data, __global T *scratch, uint rows,           \
+                                        uint cols, uint b, uint firstRow)                           \
+{                                                                                                   \
+    uint r = firstRow + get_group_id(0);                                                            \
+    __global T *row = data + (size_t)r*cols;                                                        \
+    __global T *line = scratch + (size_t)get_group_id(0)*cols;                                      \
+    for (uint j = get_local_id(0); j < cols; j += get_local_size(0))                                \
+    {                                                                                               \
+        line[j] = row[j];                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_GLOBAL_MEM_FENCE);                                                                  \
+                                                                                                    \
+    for (uint j = get_local_id(0); j < cols; j += get_local_size(0))                                \
+    {                                                                                               \
+        uint i = (r + rows - j / b) % rows;                                                         \
+        row[((ulong)j*rows + i) % cols] = line[j];                                                  \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* Pass 3, one BLOCK_DIM x BLOCK_DIM group per band of BLOCK_DIM columns */                         \
+__kernel void transpose_col_shuffle_##T(__global T *data, __global T *scratch, uint rows,           \
+                                        uint cols, uint b, uint firstBand)                          \
+{                                                                                                   \
+    uint lx = get_local_id(0);                                                                      \
+    uint ly = get_local_id(1);                                                                      \
+    uint j = (firstBand + get_group_id(0))*BLOCK_DIM + lx;                                          \
+    __global T *band = scratch + (size_t)get_group_id(0)*rows*BLOCK_DIM;                            \
+    if (j < cols)                                                                                   \
+    {                                                                                               \
+        for (uint i = ly; i < rows; i += BLOCK_DIM)                                                 \
+        {                                                                                           \
+            band[(size_t)i*BLOCK_DIM + lx] = data[(size_t)i*cols + j];                              \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_GLOBAL_MEM_FENCE);                                                                  \
+                                                                                                    \
+    if (j < cols)                                                                                   \
+    {                                                                                               \
+        for (uint i = ly; i < rows; i += BLOCK_DIM)                                                 \
+        {                                                                                           \
+            ulong p = (ulong)i*cols + j;                                                            \
+            uint src = (uint)(p % rows) + (uint)(p / rows) / b;                                     \
+            data[(size_t)i*cols + j] = band[(size_t)(src % rows)*BLOCK_DIM + lx];                   \
+        }                                                                                           \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* Batch of small rows x cols matrices, one per work-group: the whole matrix is */                  \
+/* read into local memory before any of it is written, so odata may be idata. */                  \
+/* The tile rows are padded to an odd pitch against bank conflicts. */                              \
+__kernel void transpose_batched_##T(__global T *odata, __global const T *idata, uint rows,          \
+                                    uint cols, __local T *tile)                                     \
+{                                                                                                   \
+    uint n = rows*cols;                                                                             \
+    uint pitch = cols | 1;                                                                          \
+    size_t base = (size_t)get_group_id(0)*n;                                                        \
+                                                                                                    \
+    for (uint i = get_local_id(0); i < n; i += get_local_size(0))                                   \
+    {                                                                                               \
+        tile[(i/cols)*pitch + i%cols] = idata[base + i];                                            \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_LOCAL_MEM_FENCE);                                                                   \
+                                                                                                    \
+    /* element i of the cols x rows result is (row i%rows, column i/rows) of the input */           \
+    for (uint i = get_local_id(0); i < n; i += get_local_size(0))                                   \
+    {                                                                                               \
+        odata[base + i] = tile[(i%rows)*pitch + i/rows];                                            \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* count structs of fields members each, a count x fields transpose: every */                       \
+/* work-group stages a run of local size structs, read and written coalesced */                     \
+__kernel void aos_to_soa_##T(__global T *soa, __global const T *aos, uint count, uint fields,       \
+                             __local T *tile)                                                       \
+{                                                                                                   \
+    uint lsize = get_local_size(0);                                                                 \
+    uint first = get_group_id(0)*lsize;                                                             \
+    uint structs = min(lsize, count - first);                                                       \
+    uint pitch = fields | 1;                                                                        \
+                                                                                                    \
+    for (uint i = get_local_id(0); i < structs*fields; i += lsize)                                  \
+    {                                                                                               \
+        tile[(i/fields)*pitch + i%fields] = aos[(size_t)first*fields + i];                          \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_LOCAL_MEM_FENCE);                                                                   \
+                                                                                                    \
+    uint k = get_local_id(0);                                                                       \
+    if (k < structs)                                                                                \
+    {                                                                                               \
+        for (uint f = 0; f < fields; f++)                                                           \
+        {                                                                                           \
+            soa[(size_t)f*count + first + k] = tile[k*pitch + f];                                   \
+        }                                                                                           \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* The inverse, a fields x count transpose */                                                       \
+__kernel void soa_to_aos_##T(__global T *aos, __global const T *soa, uint count, uint fields,       \
+                             __local T *tile)                                                       \
+{                                                                                                   \
+    uint lsize = get_local_size(0);                                                                 \
+    uint first = get_group_id(0)*lsize;                                                             \
+    uint structs = min(lsize, count - first);                                                       \
+    uint pitch = fields | 1;                                                                        \
+                                                                                                    \
+    uint k = get_local_id(0);                                                                       \
+    if (k < structs)                                                                                \
+    {                                                                                               \
+        for (uint f = 0; f < fields; f++)                                                           \
+        {                                                                                           \
+            tile[k*pitch + f] = soa[(size_t)f*count + first + k];                                   \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    barrier(CLK_LOCAL_MEM_FENCE);                                                                   \
+                                                                                                    \
+    for (uint i = get_local_id(0); i < structs*fields; i += lsize)                                  \
+    {                                                                                               \
+        aos[(size_t)first*fields + i] = tile[(i/fields)*pitch + i%fields];                          \
+    }                                                                                               \
+}
+
+TRANSPOSE_KERNELS(uchar)
+TRANSPOSE_KERNELS(ushort)
+TRANSPOSE_KERNELS(uint)
+TRANSPOSE_KERNELS(ulong)
@@ -0,0 +1,568 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+/* Transpose engine: out-of-place, in-place, batched and AoS <-> SoA
+ * transposes of 8, 16, 32 and 64-bit elements (transpose_engine.cl).
+ * Host code.
+ *
+ * Every transpose is checked against the CPU and timed; its throughput
+ * (one read and one write of each element) is reported as a percentage of
+ * the copy kernel's for the same element size.
+ */
+
+#include <oclUtils.h>
+#include <cmath>
+#include <vector>
+
+#define BLOCK_DIM 16
+#define ENGINE_ITERATIONS 20
+#define INPLACE_SCRATCH (1 << 22)   // elements of scratch for the rows or column bands of one in-place launch
+#define LONG_CYCLE_ROWS 8164        // its in-place permutation is two cycles of about 50M elements
+#define LONG_CYCLE_COLS 12248
+
+extern "C" void computeGoldBytes( unsigned char* reference, const unsigned char* idata,
+                                  const unsigned int size_x, const unsigned int size_y,
+                                  const unsigned int element_size );
+
+struct ElementType
+{
+    const char* name;               // kernel suffix
+    unsigned int size;
+};
+
+static const ElementType elementTypes[] = {{"uchar", 1}, {"ushort", 2}, {"uint", 4}, {"ulong", 8}};
+
+// state shared by the tests of one run
+struct Engine
+{
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_ulong localMemSize;
+    cl_ulong globalMemSize;
+    cl_ulong maxAllocSize;
+    size_t maxWorkGroupSize;
+    double copyBandwidth[4];        // GB/s of the copy kernel, per element type
+    shrBOOL passed;
+};
+
+static cl_kernel createKernel(Engine& engine, const char* op, const ElementType& type)
+{
+    char name[64];
+    sprintf(name, "%s_%s", op, type.name);
+    cl_int ciErrNum;
+    cl_kernel kernel = clCreateKernel(engine.program, name, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    return kernel;
+}
+
+static cl_mem createBuffer(Engine& engine, size_t size, const void* host)
+{
+    cl_int ciErrNum;
+    cl_mem buffer = clCreateBuffer(engine.context, host ? CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR : CL_MEM_READ_WRITE,
+                                   size, (void*)host, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    return buffer;
+}
+
+// Runs enqueue once for warmup, then iterations times, and returns the time of one
+template <class Enqueue>
+static double timeIterations(Engine& engine, Enqueue enqueue, int iterations)
+{
+    for (int i = -1; i < iterations; ++i)
+    {
+        // Start time measurement after warmup
+        if (i == 0)
+        {
+            clFinish(engine.queue);
+            shrDeltaT(0);
+        }
+        enqueue(i);
+    }
+    oclCheckError(clFinish(engine.queue), CL_SUCCESS);
+    return shrDeltaT(0)/(double)iterations;
+}
+
+// Compares the buffer with the reference and logs the result
+static void check(Engine& engine, const char* op, const ElementType& type, cl_mem buffer, const std::vector<unsigned char>& reference)
+{
+    std::vector<unsigned char> result(reference.size());
+    cl_int ciErrNum = clEnqueueReadBuffer(engine.queue, buffer, CL_TRUE, 0, result.size(), &result[0], 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    if (memcmp(&result[0], &reference[0], result.size()) != 0)
+    {
+        shrLog("  %s %s: results differ from the CPU!\n", op, type.name);
+        engine.passed = shrFALSE;
+    }
+}
+
+static void logThroughput(const char* op, const ElementType& type, size_t elements, double time, double copyBandwidth)
+{
+    double bandwidth = 1.0e-9 * 2.0 * (double)elements * type.size / time;
+    shrLogEx(LOGBOTH | MASTER, 0, "oclTranspose-Engine-%s-%s, Throughput = %.4f GB/s, Time = %.5f s, Size = %u elements, Copy = %.1f%%\n",
+             op, type.name, bandwidth, time, (unsigned int)elements, 100.0 * bandwidth / copyBandwidth);
+}
+
+static void enqueue2D(Engine& engine, cl_kernel kernel, size_t width, size_t height)
+{
+    size_t szLocalWorkSize[2] = {BLOCK_DIM, BLOCK_DIM};
+    size_t szGlobalWorkSize[2] = {shrRoundUp(BLOCK_DIM, (int)width), shrRoundUp(BLOCK_DIM, (int)height)};
+    cl_int ciErrNum = clEnqueueNDRangeKernel(engine.queue, kernel, 2, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+// the three passes of the in-place rectangular transpose, and their scratch
+struct InPlace
+{
+    cl_kernel rotate;
+    cl_kernel rowShuffle;
+    cl_kernel colShuffle;
+    cl_mem scratch;
+    size_t scratchElements;
+};
+
+// Scratch has to hold at least one row and one band of columns of a
+// rows x cols matrix and of its transpose
+static void createInPlace(Engine& engine, InPlace& inPlace, const ElementType& type, cl_uint rows, cl_uint cols)
+{
+    inPlace.rotate = createKernel(engine, "transpose_rotate", type);
+    inPlace.rowShuffle = createKernel(engine, "transpose_row_shuffle", type);
+    inPlace.colShuffle = createKernel(engine, "transpose_col_shuffle", type);
+    size_t lineElements = (size_t)((rows > cols) ? rows : cols) * BLOCK_DIM;
+    inPlace.scratchElements = (lineElements > INPLACE_SCRATCH) ? lineElements : INPLACE_SCRATCH;
+    inPlace.scratch = createBuffer(engine, inPlace.scratchElements * type.size, NULL);
+}
+
+static void releaseInPlace(InPlace& inPlace)
+{
+    clReleaseKernel(inPlace.rotate);
+    clReleaseKernel(inPlace.rowShuffle);
+    clReleaseKernel(inPlace.colShuffle);
+    clReleaseMemObject(inPlace.scratch);
+}
+
+static cl_uint gcd(cl_uint a, cl_uint b)
+{
+    while (b != 0)
+    {
+        cl_uint t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Runs one pass over all rows (groups of rowLocal work-items) or all bands
+// of BLOCK_DIM columns (BLOCK_DIM x BLOCK_DIM groups), as many of them per
+// launch as the scratch holds
+static void enqueueInPlacePass(Engine& engine, cl_kernel kernel, const InPlace& inPlace, cl_mem d_data,
+                               cl_uint rows, cl_uint cols, cl_uint b, bool bBands)
+{
+    cl_int ciErrNum;
+    cl_uint units = bBands ? (cols + BLOCK_DIM - 1) / BLOCK_DIM : rows;
+    size_t unitElements = bBands ? (size_t)rows * BLOCK_DIM : (size_t)cols;
+    cl_uint unitsPerLaunch = (cl_uint)(inPlace.scratchElements / unitElements);
+    size_t rowLocal = (engine.maxWorkGroupSize < 256) ? engine.maxWorkGroupSize : 256;
+
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_data);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &inPlace.scratch);
+    ciErrNum |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &rows);
+    ciErrNum |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &cols);
+    ciErrNum |= clSetKernelArg(kernel, 4, sizeof(cl_uint), &b);
+    for (cl_uint first = 0; first < units; first += unitsPerLaunch)
+    {
+        cl_uint count = (units - first < unitsPerLaunch) ? units - first : unitsPerLaunch;
+        ciErrNum |= clSetKernelArg(kernel, 5, sizeof(cl_uint), &first);
+        if (bBands)
+        {
+            size_t szLocalWorkSize[2] = {BLOCK_DIM, BLOCK_DIM};
+            size_t szGlobalWorkSize[2] = {(size_t)count * BLOCK_DIM, BLOCK_DIM};
+            ciErrNum |= clEnqueueNDRangeKernel(engine.queue, kernel, 2, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+        }
+        else
+        {
+            size_t szGlobalWorkSize = (size_t)count * rowLocal;
+            ciErrNum |= clEnqueueNDRangeKernel(engine.queue, kernel, 1, NULL, &szGlobalWorkSize, &rowLocal, 0, NULL, NULL);
+        }
+    }
+    oclCheckError(ciErrNum, CL_SUCCESS);
+}
+
+// In-place transpose of a rows x cols matrix: column rotation, row shuffle
+// and column shuffle (transpose_engine.cl). Every pass reads and writes each
+// element twice, once to and once from the scratch.
+static void enqueueInPlace(Engine& engine, const InPlace& inPlace, cl_mem d_data, cl_uint rows, cl_uint cols)
+{
+    cl_uint c = gcd(rows, cols);
+    cl_uint b = cols / c;
+    if (c > 1)
+    {
+        enqueueInPlacePass(engine, inPlace.rotate, inPlace, d_data, rows, cols, b, true);
+    }
+    enqueueInPlacePass(engine, inPlace.rowShuffle, inPlace, d_data, rows, cols, b, false);
+    enqueueInPlacePass(engine, inPlace.colShuffle, inPlace, d_data, rows, cols, b, true);
+}
+
+// Structs per work-group of the AoS <-> SoA kernels, so the staged structs fit
+// in half of the local memory
+static size_t structsPerGroup(Engine& engine, const ElementType& type, cl_uint fields)
+{
+    size_t structs = (engine.maxWorkGroupSize < 256) ? engine.maxWorkGroupSize : 256;
+    while (structs > 16 && structs * (fields | 1) * type.size > engine.localMemSize / 2)
+    {
+        structs /= 2;
+    }
+    return structs;
+}
+
+// All transposes of one element type
+static void runElementType(Engine& engine, int typeIndex, unsigned int size_x, unsigned int size_y,
+                           cl_uint batchRows, cl_uint batchCols, cl_uint fields)
+{
+    const ElementType& type = elementTypes[typeIndex];
+    cl_int ciErrNum;
+    size_t elements = (size_t)size_x * size_y;
+    size_t bytes = elements * type.size;
+
+    // random input, the same for every test
+    std::vector<unsigned char> h_idata(bytes);
+    for (size_t i = 0; i < bytes; i++)
+    {
+        h_idata[i] = (unsigned char)(rand() & 0xff);
+    }
+    std::vector<unsigned char> reference(bytes);
+    cl_mem d_idata = createBuffer(engine, bytes, &h_idata[0]);
+    cl_mem d_odata = createBuffer(engine, bytes, NULL);
+    cl_mem d_data = createBuffer(engine, bytes, NULL);
+
+    shrLog("\nTransposing %u elements of type %s...\n\n", (unsigned int)elements, type.name);
+
+    // copy, the reference throughput
+    cl_kernel kernel = createKernel(engine, "copy", type);
+    cl_uint n = (cl_uint)elements;
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_odata);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &d_idata);
+    ciErrNum |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &n);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    size_t szCopyLocal = BLOCK_DIM * BLOCK_DIM;
+    size_t szCopyGlobal = shrRoundUp((int)szCopyLocal, (int)elements);
+    double copyTime = timeIterations(engine, [&](int) {
+        oclCheckError(clEnqueueNDRangeKernel(engine.queue, kernel, 1, NULL, &szCopyGlobal, &szCopyLocal, 0, NULL, NULL), CL_SUCCESS);
+    }, ENGINE_ITERATIONS);
+    double copyBandwidth = 1.0e-9 * 2.0 * bytes / copyTime;
+    engine.copyBandwidth[typeIndex] = copyBandwidth;
+    logThroughput("copy", type, elements, copyTime, copyBandwidth);
+    clReleaseKernel(kernel);
+
+    // out-of-place, size_x x size_y
+    kernel = createKernel(engine, "transpose", type);
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_odata);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &d_idata);
+    ciErrNum |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &size_x);
+    ciErrNum |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &size_y);
+    ciErrNum |= clSetKernelArg(kernel, 4, (BLOCK_DIM + 1) * BLOCK_DIM * type.size, 0);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    double time = timeIterations(engine, [&](int) {enqueue2D(engine, kernel, size_x, size_y);}, ENGINE_ITERATIONS);
+    computeGoldBytes(&reference[0], &h_idata[0], size_x, size_y, type.size);
+    check(engine, "transpose", type, d_odata, reference);
+    logThroughput("transpose", type, elements, time, copyBandwidth);
+    clReleaseKernel(kernel);
+
+    // in-place, square: the largest square that fits in the matrix, taken
+    // from the start of the input
+    cl_uint square = (size_x < size_y) ? size_x : size_y;
+    size_t squareBytes = (size_t)square * square * type.size;
+    kernel = createKernel(engine, "transpose_square_inplace", type);
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_data);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_uint), &square);
+    ciErrNum |= clSetKernelArg(kernel, 2, 2 * (BLOCK_DIM + 1) * BLOCK_DIM * type.size, 0);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    ciErrNum = clEnqueueCopyBuffer(engine.queue, d_idata, d_data, 0, 0, squareBytes, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueue2D(engine, kernel, square, square);
+    std::vector<unsigned char> squareReference(squareBytes);
+    computeGoldBytes(&squareReference[0], &h_idata[0], square, square, type.size);
+    check(engine, "transpose_square_inplace", type, d_data, squareReference);
+    time = timeIterations(engine, [&](int) {enqueue2D(engine, kernel, square, square);}, ENGINE_ITERATIONS);
+    logThroughput("square_inplace", type, (size_t)square * square, time, copyBandwidth);
+    clReleaseKernel(kernel);
+
+    // in-place, rectangular: the input as a (size_y / 2) x (2 * size_x) matrix,
+    // alternately transposed back while timing
+    cl_uint rows = size_y / 2, cols = size_x * 2;
+    size_t rectElements = (size_t)rows * cols;
+    InPlace inPlace;
+    createInPlace(engine, inPlace, type, rows, cols);
+    ciErrNum = clEnqueueCopyBuffer(engine.queue, d_idata, d_data, 0, 0, rectElements * type.size, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    enqueueInPlace(engine, inPlace, d_data, rows, cols);
+    std::vector<unsigned char> rectReference(rectElements * type.size);
+    computeGoldBytes(&rectReference[0], &h_idata[0], cols, rows, type.size);
+    check(engine, "transpose_inplace", type, d_data, rectReference);
+    time = timeIterations(engine, [&](int i) {
+        if ((i + 1) % 2 == 0) enqueueInPlace(engine, inPlace, d_data, cols, rows);
+        else enqueueInPlace(engine, inPlace, d_data, rows, cols);
+    }, ENGINE_ITERATIONS);
+    logThroughput("rect_inplace", type, rectElements, time, copyBandwidth);
+    releaseInPlace(inPlace);
+
+    // batched small matrices, out-of-place and in-place
+    cl_uint batchElements = batchRows * batchCols;
+    size_t batch = elements / batchElements;
+    size_t szBatchLocal = shrRoundUp(64, (int)batchElements);
+    szBatchLocal = (szBatchLocal > 256) ? 256 : szBatchLocal;
+    szBatchLocal = (szBatchLocal > engine.maxWorkGroupSize) ? engine.maxWorkGroupSize : szBatchLocal;
+    size_t szBatchGlobal = batch * szBatchLocal;
+    kernel = createKernel(engine, "transpose_batched", type);
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_odata);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &d_idata);
+    ciErrNum |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &batchRows);
+    ciErrNum |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &batchCols);
+    ciErrNum |= clSetKernelArg(kernel, 4, batchRows * (batchCols | 1) * type.size, 0);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    time = timeIterations(engine, [&](int) {
+        oclCheckError(clEnqueueNDRangeKernel(engine.queue, kernel, 1, NULL, &szBatchGlobal, &szBatchLocal, 0, NULL, NULL), CL_SUCCESS);
+    }, ENGINE_ITERATIONS);
+    std::vector<unsigned char> batchReference(batch * batchElements * type.size);
+    for (size_t b = 0; b < batch; b++)
+    {
+        size_t offset = b * batchElements * type.size;
+        computeGoldBytes(&batchReference[offset], &h_idata[offset], batchCols, batchRows, type.size);
+    }
+    std::vector<unsigned char> batchResult(batchReference.size());
+    ciErrNum = clEnqueueReadBuffer(engine.queue, d_odata, CL_TRUE, 0, batchResult.size(), &batchResult[0], 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    if (memcmp(&batchResult[0], &batchReference[0], batchResult.size()) != 0)
+    {
+        shrLog("  transpose_batched %s: results differ from the CPU!\n", type.name);
+        engine.passed = shrFALSE;
+    }
+    logThroughput("batched", type, batch * batchElements, time, copyBandwidth);
+
+    ciErrNum = clEnqueueCopyBuffer(engine.queue, d_idata, d_data, 0, 0, batchResult.size(), 0, NULL, NULL);
+    ciErrNum |= clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_data);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &d_data);
+    ciErrNum |= clEnqueueNDRangeKernel(engine.queue, kernel, 1, NULL, &szBatchGlobal, &szBatchLocal, 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    ciErrNum = clEnqueueReadBuffer(engine.queue, d_data, CL_TRUE, 0, batchResult.size(), &batchResult[0], 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    if (memcmp(&batchResult[0], &batchReference[0], batchResult.size()) != 0)
+    {
+        shrLog("  transpose_batched in-place %s: results differ from the CPU!\n", type.name);
+        engine.passed = shrFALSE;
+    }
+    clReleaseKernel(kernel);
+
+    // AoS -> SoA and back, count structs of fields elements
+    cl_uint count = (cl_uint)(elements / fields);
+    size_t structBytes = (size_t)count * fields * type.size;
+    size_t szStructLocal = structsPerGroup(engine, type, fields);
+    size_t szStructGlobal = shrRoundUp((int)szStructLocal, (int)count);
+    size_t tileBytes = szStructLocal * (fields | 1) * type.size;
+    std::vector<unsigned char> soaReference(structBytes);
+    computeGoldBytes(&soaReference[0], &h_idata[0], fields, count, type.size);
+
+    kernel = createKernel(engine, "aos_to_soa", type);
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_odata);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &d_idata);
+    ciErrNum |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &count);
+    ciErrNum |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &fields);
+    ciErrNum |= clSetKernelArg(kernel, 4, tileBytes, 0);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    time = timeIterations(engine, [&](int) {
+        oclCheckError(clEnqueueNDRangeKernel(engine.queue, kernel, 1, NULL, &szStructGlobal, &szStructLocal, 0, NULL, NULL), CL_SUCCESS);
+    }, ENGINE_ITERATIONS);
+    std::vector<unsigned char> structResult(structBytes);
+    ciErrNum = clEnqueueReadBuffer(engine.queue, d_odata, CL_TRUE, 0, structBytes, &structResult[0], 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    if (memcmp(&structResult[0], &soaReference[0], structBytes) != 0)
+    {
+        shrLog("  aos_to_soa %s: results differ from the CPU!\n", type.name);
+        engine.passed = shrFALSE;
+    }
+    logThroughput("aos_to_soa", type, (size_t)count * fields, time, copyBandwidth);
+    clReleaseKernel(kernel);
+
+    // back from the SoA result, which has to give the input again
+    kernel = createKernel(engine, "soa_to_aos", type);
+    ciErrNum  = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *) &d_data);
+    ciErrNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *) &d_odata);
+    ciErrNum |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &count);
+    ciErrNum |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &fields);
+    ciErrNum |= clSetKernelArg(kernel, 4, tileBytes, 0);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    time = timeIterations(engine, [&](int) {
+        oclCheckError(clEnqueueNDRangeKernel(engine.queue, kernel, 1, NULL, &szStructGlobal, &szStructLocal, 0, NULL, NULL), CL_SUCCESS);
+    }, ENGINE_ITERATIONS);
+    ciErrNum = clEnqueueReadBuffer(engine.queue, d_data, CL_TRUE, 0, structBytes, &structResult[0], 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    if (memcmp(&structResult[0], &h_idata[0], structBytes) != 0)
+    {
+        shrLog("  soa_to_aos %s: results differ from the CPU!\n", type.name);
+        engine.passed = shrFALSE;
+    }
+    logThroughput("soa_to_aos", type, (size_t)count * fields, time, copyBandwidth);
+    clReleaseKernel(kernel);
+
+    clReleaseMemObject(d_idata);
+    clReleaseMemObject(d_odata);
+    clReleaseMemObject(d_data);
+}
+
+// In-place transpose of a rows x cols uint matrix whose elements hold their
+// own index, so the result checks itself without a reference copy. There is
+// no room for a copy anyway: the percentage is of the copy bandwidth measured
+// on the smaller matrix.
+static void runIndexedInPlace(Engine& engine, const char* op, cl_uint rows, cl_uint cols)
+{
+    size_t elements = (size_t)rows * cols;
+    std::vector<cl_uint> h_data(elements);
+    for (size_t i = 0; i < elements; i++)
+    {
+        h_data[i] = (cl_uint)i;
+    }
+    const ElementType& type = elementTypes[2];
+    cl_mem d_data = createBuffer(engine, elements * sizeof(cl_uint), &h_data[0]);
+    InPlace inPlace;
+    createInPlace(engine, inPlace, type, rows, cols);
+
+    clFinish(engine.queue);
+    shrDeltaT(0);
+    enqueueInPlace(engine, inPlace, d_data, rows, cols);
+    oclCheckError(clFinish(engine.queue), CL_SUCCESS);
+    double time = shrDeltaT(0);
+
+    cl_int ciErrNum = clEnqueueReadBuffer(engine.queue, d_data, CL_TRUE, 0, elements * sizeof(cl_uint), &h_data[0], 0, NULL, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    bool bMatch = true;
+    for (cl_uint c = 0; c < cols && bMatch; c++)
+    {
+        for (cl_uint r = 0; r < rows; r++)
+        {
+            if (h_data[(size_t)c * rows + r] != (cl_uint)((size_t)r * cols + c))
+            {
+                shrLog("  %s: element (%u, %u) is wrong!\n", op, c, r);
+                engine.passed = shrFALSE;
+                bMatch = false;
+                break;
+            }
+        }
+    }
+    logThroughput(op, type, elements, time, engine.copyBandwidth[2]);
+
+    releaseInPlace(inPlace);
+    clReleaseMemObject(d_data);
+}
+
+// A shape whose permutation is two cycles of about 50 million elements each,
+// skipped on devices that can't spare a quarter of their memory for it
+static void runLongCycles(Engine& engine)
+{
+    cl_ulong bytes = (cl_ulong)LONG_CYCLE_ROWS * LONG_CYCLE_COLS * sizeof(cl_uint);
+    if (bytes > engine.maxAllocSize || bytes > engine.globalMemSize / 4)
+    {
+        shrLog("\nSkipping the %u x %u in-place transpose, too large for the device\n", LONG_CYCLE_ROWS, LONG_CYCLE_COLS);
+        return;
+    }
+    shrLog("\nIn-place transpose of a %u x %u uint matrix...\n\n", LONG_CYCLE_ROWS, LONG_CYCLE_COLS);
+    runIndexedInPlace(engine, "long_cycles", LONG_CYCLE_ROWS, LONG_CYCLE_COLS);
+}
+
+// In-place transpose of a uint matrix as large as one buffer may be, up to
+// 60% of the device memory: more than an out-of-place transpose could hold
+static void runLargeInPlace(Engine& engine)
+{
+    cl_ulong bytes = (engine.globalMemSize / 10) * 6;
+    bytes = (bytes < engine.maxAllocSize) ? bytes : engine.maxAllocSize;
+    cl_ulong elements = bytes / sizeof(cl_uint);
+    elements = (elements < 0x7fffffffUL) ? elements : 0x7fffffffUL;
+
+    // rectangular, about 2 : 3
+    cl_uint rows = (cl_uint)sqrt((double)elements * 2.0 / 3.0);
+    cl_uint cols = (cl_uint)(elements / rows);
+    elements = (cl_ulong)rows * cols;
+    shrLog("\nIn-place transpose of a %u x %u uint matrix, %.1f%% of the device memory...\n\n",
+           rows, cols, 100.0 * elements * sizeof(cl_uint) / engine.globalMemSize);
+    runIndexedInPlace(engine, "large_inplace", rows, cols);
+}
+
+// Runs the transpose engine on the device of queue: every element type on a
+// size_x x size_y matrix, an in-place transpose with long permutation cycles,
+// and with -large the in-place transpose of a matrix larger than half of the
+// device memory. -batchrows/-batchcols set the size
+// of the batched matrices (32 x 24), -fields the members per struct (3).
+shrBOOL runTransposeEngine(int argc, const char** argv, cl_context context, cl_command_queue queue,
+                           unsigned int size_x, unsigned int size_y)
+{
+    cl_int ciErrNum;
+    cl_device_id device;
+    Engine engine;
+    engine.context = context;
+    engine.queue = queue;
+    engine.passed = shrTRUE;
+
+    ciErrNum  = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+    ciErrNum |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &engine.localMemSize, NULL);
+    ciErrNum |= clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &engine.globalMemSize, NULL);
+    ciErrNum |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), &engine.maxAllocSize, NULL);
+    ciErrNum |= clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &engine.maxWorkGroupSize, NULL);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    int temp;
+    cl_uint batchRows = 32, batchCols = 24, fields = 3;
+    if (shrGetCmdLineArgumenti(argc, argv, "batchrows", &temp) && temp > 0) {
+        batchRows = temp;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "batchcols", &temp) && temp > 0) {
+        batchCols = temp;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "fields", &temp) && temp > 0) {
+        fields = temp;
+    }
+
+    // Program Setup
+    size_t program_length;
+    char* source_path = shrFindFilePath("transpose_engine.cl", argv[0]);
+    oclCheckError(source_path != NULL, shrTRUE);
+    char *source = oclLoadProgSource(source_path, "", &program_length);
+    oclCheckError(source != NULL, shrTRUE);
+
+    engine.program = clCreateProgramWithSource(context, 1, (const char **)&source, &program_length, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    ciErrNum = clBuildProgram(engine.program, 1, &device, NULL, NULL, NULL);
+    if (ciErrNum != CL_SUCCESS)
+    {
+        // write out standard error, Build Log and PTX, then return error
+        shrLogEx(LOGBOTH | ERRORMSG, ciErrNum, STDERROR);
+        oclLogBuildInfo(engine.program, device);
+        oclLogPtx(engine.program, device, "oclTransposeEngine.ptx");
+        return shrFALSE;
+    }
+
+    srand(15235911);
+    for (int t = 0; t < (int)(sizeof(elementTypes) / sizeof(elementTypes[0])); t++)
+    {
+        runElementType(engine, t, size_x, size_y, batchRows, batchCols, fields);
+    }
+
+    runLongCycles(engine);
+    if (shrCheckCmdLineFlag(argc, argv, "large"))
+    {
+        runLargeInPlace(engine);
+    }
+
+    shrLog("\nTranspose engine: %s\n", engine.passed ? "all results match the CPU" : "MISMATCHES");
+
+    clReleaseProgram(engine.program);
+    free(source);
+    free(source_path);
+    return engine.passed;
+}
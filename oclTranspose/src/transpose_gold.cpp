@@ -13,11 +13,17 @@
 * Reference solution.
 */
 
+#include <string.h>
+
 ////////////////////////////////////////////////////////////////////////////////
 // export C interface
 extern "C" 
 void computeGold( float* reference, float* idata, 
                   const unsigned int size_x, const unsigned int size_y );
+extern "C" 
+void computeGoldBytes( unsigned char* reference, const unsigned char* idata, 
+                       const unsigned int size_x, const unsigned int size_y,
+                       const unsigned int element_size );
 
 ////////////////////////////////////////////////////////////////////////////////
 //! Compute reference data set
@@ -36,3 +42,20 @@ computeGold( float* reference, float* idata,
     }  
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//! Compute reference data set for elements of element_size bytes
+////////////////////////////////////////////////////////////////////////////////
+void
+computeGoldBytes( unsigned char* reference, const unsigned char* idata, 
+                  const unsigned int size_x, const unsigned int size_y,
+                  const unsigned int element_size ) 
+{
+    for( unsigned int y = 0; y < size_y; ++y) 
+    {
+        for( unsigned int x = 0; x < size_x; ++x) 
+        {
+            memcpy( &reference[((size_t)x * size_y + y) * element_size],
+                    &idata[((size_t)y * size_x + x) * element_size], element_size);
+        }
+    }  
+}
@@ -68,4 +68,70 @@ double serial_small_systems(float *a, float *b, float *c, float *d, float *x, in
     return time_spent;
 }
 
+// Periodic system, a[0] couples x[n-1] and c[n-1] couples x[0].
+// Sherman-Morrison on top of two Thomas solves of the modified matrix.
+void serial_periodic(float *a, float *b, float *c, float *d, float *x, int num_elements)
+{
+	int n = num_elements;
+	float gamma = -b[0];
+	float *bb = (float*)malloc(sizeof(float) * n);
+	float *cc = (float*)malloc(sizeof(float) * n);
+	float *u = (float*)calloc(n, sizeof(float));
+	float *z = (float*)malloc(sizeof(float) * n);
+	float a0 = a[0], cn = c[n-1];
+
+	memcpy(bb, b, sizeof(float) * n);
+	bb[0] = b[0] - gamma;
+	bb[n-1] = b[n-1] - a0 * cn / gamma;
+	u[0] = gamma;
+	u[n-1] = cn;
+
+	a[0] = 0.0f;
+	memcpy(cc, c, sizeof(float) * n);
+	serial(a, bb, cc, d, x, n);
+	memcpy(cc, c, sizeof(float) * n);
+	serial(a, bb, cc, u, z, n);
+	a[0] = a0;
+
+	float vLast = a0 / gamma;
+	float factor = (x[0] + vLast * x[n-1]) / (1.0f + z[0] + vLast * z[n-1]);
+	for (int i = 0; i < n; i++) x[i] -= factor * z[i];
+
+	free(bb);
+	free(cc);
+	free(u);
+	free(z);
+}
+
+// one matrix, num_rhs right-hand sides stored one after the other
+double serial_large_systems(float *a, float *b, float *c, float *d, float *x, int system_size, int num_rhs, bool periodic)
+{
+	const size_t mem_size = sizeof(float) * system_size;
+
+	float *cc = (float*)malloc(mem_size);
+	float *dd = (float*)malloc(mem_size);
+
+	double time_spent = 0.0;
+	shrDeltaT(0);
+	for (int i = 0; i < num_rhs; i++)
+	{
+		memcpy(dd, &d[i*system_size], mem_size);
+		if (periodic)
+		{
+			serial_periodic(a, b, c, dd, &x[i*system_size], system_size);
+		}
+		else
+		{
+			memcpy(cc, c, mem_size);
+			serial(a, b, cc, dd, &x[i*system_size], system_size);
+		}
+	}
+	time_spent = shrDeltaT(0);
+
+	free(cc);
+	free(dd);
+
+	return time_spent;
+}
+
 #endif
@@ -0,0 +1,427 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+ /*
+ * Tridiagonal solvers.
+ * Host code for large systems: partitioned Thomas + PCR hybrid with a
+ * factor-once / solve-many interface (see partition_kernels.cl).
+ *
+ * Usage:
+ *   LargeSystem ls;
+ *   large_factor(ls, queue, argv, a, b, c, n, partition_size, periodic);
+ *   large_solve(ls, d, x, num_rhs);		// as often as needed
+ *   large_release(ls);
+ *
+ * Periodic systems (a[0] couples x[n-1], c[n-1] couples x[0]) use the
+ * Sherman-Morrison formula: the modified matrix is factored once and the
+ * correction vector z is solved at factor time, each solve then adds one
+ * small kernel pair.
+ */
+
+#ifndef _LARGE_SYSTEMS_
+#define _LARGE_SYSTEMS_
+
+#include "common.h"
+
+// partitions of at least 4 rows halve the system per level, enough for any int n
+#define LARGE_MAX_LEVELS	32
+
+struct LargeSystem
+{
+	cl_command_queue queue;
+	cl_program program;
+	cl_kernel factorKernel, reduceKernel, substituteKernel, coarseKernel;
+	cl_kernel periodicFactorKernel, periodicCorrectKernel;
+
+	int n;								// system size
+	int levels;							// partitioned levels above the PCR system
+	int size[LARGE_MAX_LEVELS + 1];		// system size per level, size[levels] is solved by PCR
+	int m[LARGE_MAX_LEVELS];			// partition size per level
+	int partitions[LARGE_MAX_LEVELS];
+
+	// matrix per level (level 0 is the input), factorization per partitioned level
+	cl_mem a[LARGE_MAX_LEVELS + 1], b[LARGE_MAX_LEVELS + 1], c[LARGE_MAX_LEVELS + 1];
+	cl_mem fa[LARGE_MAX_LEVELS], fc[LARGE_MAX_LEVELS], fr[LARGE_MAX_LEVELS], fg[LARGE_MAX_LEVELS], fcf[LARGE_MAX_LEVELS];
+
+	// per rhs work space, grown to the largest batch seen
+	int capacity;
+	cl_mem dd[LARGE_MAX_LEVELS];		// eliminated rhs
+	cl_mem rd[LARGE_MAX_LEVELS + 1];	// rhs of the level, rd[0] is the caller's d
+	cl_mem rx[LARGE_MAX_LEVELS + 1];	// solution of the level, rx[0] is the caller's x
+
+	bool periodic;
+	float vLast;						// a[0] / gamma of the Sherman-Morrison vector v
+	cl_mem z;							// modified matrix applied to u, inverted
+	cl_mem periodicFactor;
+};
+
+static void large_set_launch(size_t width, size_t height, size_t *global, size_t *local)
+{
+	local[0] = 64;
+	local[1] = 1;
+	global[0] = shrRoundUp((int)local[0], (int)width);
+	global[1] = height;
+}
+
+static void large_grow(LargeSystem &ls, int num_rhs)
+{
+	if (num_rhs <= ls.capacity) return;
+
+	cl_int errcode;
+	for (int l = 0; l < ls.levels; l++)
+	{
+		if (ls.capacity) clReleaseMemObject(ls.dd[l]);
+		ls.dd[l] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float) * ls.size[l] * num_rhs, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+	for (int l = 1; l <= ls.levels; l++)
+	{
+		if (ls.capacity) clReleaseMemObject(ls.rd[l]);
+		if (ls.capacity) clReleaseMemObject(ls.rx[l]);
+		ls.rd[l] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float) * ls.size[l] * num_rhs, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+		ls.rx[l] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float) * ls.size[l] * num_rhs, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+	if (ls.periodic)
+	{
+		if (ls.capacity) clReleaseMemObject(ls.periodicFactor);
+		ls.periodicFactor = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float) * num_rhs, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+	ls.capacity = num_rhs;
+}
+
+// solve without the periodic correction, d and x hold num_rhs systems
+static void large_solve_core(LargeSystem &ls, cl_mem d, cl_mem x, int num_rhs)
+{
+	size_t szGlobalWorkSize[2], szLocalWorkSize[2];
+	cl_int errcode;
+
+	large_grow(ls, num_rhs);
+	int coarse = ls.levels;
+	ls.rd[0] = d;
+	ls.rx[0] = x;
+
+	// eliminate the rhs level by level
+	for (int l = 0; l < ls.levels; l++)
+	{
+		errcode  = clSetKernelArg(ls.reduceKernel, 0, sizeof(cl_mem), (void *) &ls.rd[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 1, sizeof(cl_mem), (void *) &ls.dd[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 2, sizeof(cl_mem), (void *) &ls.rd[l + 1]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 3, sizeof(cl_mem), (void *) &ls.fr[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 4, sizeof(cl_mem), (void *) &ls.fg[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 5, sizeof(cl_mem), (void *) &ls.fcf[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 6, sizeof(int), &ls.size[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 7, sizeof(int), &ls.m[l]);
+		errcode |= clSetKernelArg(ls.reduceKernel, 8, sizeof(int), &ls.partitions[l]);
+		oclCheckError(errcode, CL_SUCCESS);
+
+		large_set_launch(ls.partitions[l], num_rhs, szGlobalWorkSize, szLocalWorkSize);
+		errcode = clEnqueueNDRangeKernel(ls.queue, ls.reduceKernel, 2, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+
+	// coarsest system, one work-group per rhs
+	int n = ls.size[coarse];
+	errcode  = clSetKernelArg(ls.coarseKernel, 0, sizeof(cl_mem), (void *) &ls.a[coarse]);
+	errcode |= clSetKernelArg(ls.coarseKernel, 1, sizeof(cl_mem), (void *) &ls.b[coarse]);
+	errcode |= clSetKernelArg(ls.coarseKernel, 2, sizeof(cl_mem), (void *) &ls.c[coarse]);
+	errcode |= clSetKernelArg(ls.coarseKernel, 3, sizeof(cl_mem), (void *) &ls.rd[coarse]);
+	errcode |= clSetKernelArg(ls.coarseKernel, 4, sizeof(cl_mem), (void *) &ls.rx[coarse]);
+	errcode |= clSetKernelArg(ls.coarseKernel, 5, 4 * n * sizeof(float), NULL);
+	errcode |= clSetKernelArg(ls.coarseKernel, 6, sizeof(int), &n);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	szLocalWorkSize[0] = n;
+	szGlobalWorkSize[0] = (size_t)n * num_rhs;
+	errcode = clEnqueueNDRangeKernel(ls.queue, ls.coarseKernel, 1, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	// and back up to the full system
+	for (int l = ls.levels - 1; l >= 0; l--)
+	{
+		errcode  = clSetKernelArg(ls.substituteKernel, 0, sizeof(cl_mem), (void *) &ls.rx[l]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 1, sizeof(cl_mem), (void *) &ls.dd[l]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 2, sizeof(cl_mem), (void *) &ls.rx[l + 1]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 3, sizeof(cl_mem), (void *) &ls.fa[l]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 4, sizeof(cl_mem), (void *) &ls.fc[l]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 5, sizeof(int), &ls.size[l]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 6, sizeof(int), &ls.m[l]);
+		errcode |= clSetKernelArg(ls.substituteKernel, 7, sizeof(int), &ls.partitions[l]);
+		oclCheckError(errcode, CL_SUCCESS);
+
+		large_set_launch(ls.size[l], num_rhs, szGlobalWorkSize, szLocalWorkSize);
+		errcode = clEnqueueNDRangeKernel(ls.queue, ls.substituteKernel, 2, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Solve num_rhs right-hand sides with the factored matrix, d and x are device
+// buffers of num_rhs * n floats, one system after the other. Asynchronous.
+////////////////////////////////////////////////////////////////////////////////
+void large_solve(LargeSystem &ls, cl_mem d, cl_mem x, int num_rhs)
+{
+	cl_int errcode;
+	oclCheckError(((long long)num_rhs * ls.n < INT_MAX), true);
+
+	large_solve_core(ls, d, x, num_rhs);
+	if (!ls.periodic) return;
+
+	size_t szGlobalWorkSize[2], szLocalWorkSize[2];
+	errcode  = clSetKernelArg(ls.periodicFactorKernel, 0, sizeof(cl_mem), (void *) &ls.periodicFactor);
+	errcode |= clSetKernelArg(ls.periodicFactorKernel, 1, sizeof(cl_mem), (void *) &x);
+	errcode |= clSetKernelArg(ls.periodicFactorKernel, 2, sizeof(cl_mem), (void *) &ls.z);
+	errcode |= clSetKernelArg(ls.periodicFactorKernel, 3, sizeof(float), &ls.vLast);
+	errcode |= clSetKernelArg(ls.periodicFactorKernel, 4, sizeof(int), &ls.n);
+	errcode |= clSetKernelArg(ls.periodicFactorKernel, 5, sizeof(int), &num_rhs);
+	oclCheckError(errcode, CL_SUCCESS);
+	large_set_launch(num_rhs, 1, szGlobalWorkSize, szLocalWorkSize);
+	errcode = clEnqueueNDRangeKernel(ls.queue, ls.periodicFactorKernel, 1, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	errcode  = clSetKernelArg(ls.periodicCorrectKernel, 0, sizeof(cl_mem), (void *) &x);
+	errcode |= clSetKernelArg(ls.periodicCorrectKernel, 1, sizeof(cl_mem), (void *) &ls.z);
+	errcode |= clSetKernelArg(ls.periodicCorrectKernel, 2, sizeof(cl_mem), (void *) &ls.periodicFactor);
+	errcode |= clSetKernelArg(ls.periodicCorrectKernel, 3, sizeof(int), &ls.n);
+	oclCheckError(errcode, CL_SUCCESS);
+	large_set_launch(ls.n, num_rhs, szGlobalWorkSize, szLocalWorkSize);
+	errcode = clEnqueueNDRangeKernel(ls.queue, ls.periodicCorrectKernel, 2, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+	oclCheckError(errcode, CL_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Factor the n x n matrix (a, b, c) on the device of queue. partition_size is
+// the number of rows eliminated per work-item, at least 4 (with 3 every level
+// only shrinks the system to 2/3 and deep levels add up). Blocks until done.
+////////////////////////////////////////////////////////////////////////////////
+void large_factor(LargeSystem &ls, cl_command_queue queue, const char** argv,
+				  const float *a, const float *b, const float *c, int n, int partition_size, bool periodic)
+{
+	cl_int errcode;
+	memset(&ls, 0, sizeof(ls));
+	ls.queue = queue;
+	ls.n = n;
+	ls.periodic = periodic;
+
+	size_t program_length;
+	char *source = oclLoadProgSource(shrFindFilePath("partition_kernels.cl", argv[0]), "", &program_length);
+	oclCheckError(source != NULL, shrTRUE);
+	ls.program = clCreateProgramWithSource(cxGPUContext, 1, (const char **)&source, &program_length, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	free(source);
+
+	// no relaxed math, rounding errors add up over the levels
+	errcode = clBuildProgram(ls.program, 0, NULL, "-cl-mad-enable", NULL, NULL);
+	if (errcode != CL_SUCCESS)
+	{
+		oclLogBuildInfo(ls.program, oclGetFirstDev(cxGPUContext));
+		oclLogPtx(ls.program, oclGetFirstDev(cxGPUContext), "partition_kernels.ptx");
+		shrLog("\nFAILED\n\n");
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+	ls.factorKernel = clCreateKernel(ls.program, "partition_factor_kernel", &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.reduceKernel = clCreateKernel(ls.program, "partition_reduce_kernel", &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.substituteKernel = clCreateKernel(ls.program, "partition_substitute_kernel", &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.coarseKernel = clCreateKernel(ls.program, "pcr_coarse_kernel", &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.periodicFactorKernel = clCreateKernel(ls.program, "periodic_factor_kernel", &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.periodicCorrectKernel = clCreateKernel(ls.program, "periodic_correct_kernel", &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	// the coarsest system must fit one work-group and its local memory
+	cl_device_id device;
+	size_t maxWgSize;
+	cl_ulong localMem;
+	errcode  = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+	errcode |= clGetKernelWorkGroupInfo(ls.coarseKernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxWgSize, NULL);
+	errcode |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMem, NULL);
+	oclCheckError(errcode, CL_SUCCESS);
+	int coarseLimit = (int)MIN(MIN(maxWgSize, (size_t)512), (size_t)(localMem / (4 * sizeof(float)) / 2));
+
+	// level sizes
+	ls.size[0] = n;
+	while (ls.size[ls.levels] > coarseLimit)
+	{
+		int l = ls.levels;
+		oclCheckError((l < LARGE_MAX_LEVELS), true);
+		ls.m[l] = CLAMP(partition_size, 4, ls.size[l]);
+		ls.partitions[l] = ls.size[l] / ls.m[l];
+		ls.size[l + 1] = 2 * ls.partitions[l];
+		ls.levels++;
+	}
+
+	// modified matrix of a periodic system: b[0] -= gamma, b[n-1] -= a[0]c[n-1]/gamma
+	float *bb = (float*)malloc(sizeof(float) * n);
+	memcpy(bb, b, sizeof(float) * n);
+	float gamma = 0.0f;
+	if (periodic)
+	{
+		gamma = -b[0];
+		bb[0] = b[0] - gamma;
+		bb[n - 1] = b[n - 1] - a[0] * c[n - 1] / gamma;
+		ls.vLast = a[0] / gamma;
+	}
+
+	ls.a[0] = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * n, (void *)a, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.b[0] = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * n, bb, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	ls.c[0] = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * n, (void *)c, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	free(bb);
+
+	for (int l = 0; l < ls.levels; l++)
+	{
+		size_t levelB = sizeof(float) * ls.size[l];
+		size_t nextB = sizeof(float) * ls.size[l + 1];
+		cl_mem *factor[5] = { &ls.fa[l], &ls.fc[l], &ls.fr[l], &ls.fg[l], &ls.fcf[l] };
+		for (int f = 0; f < 5; f++)
+		{
+			*factor[f] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, levelB, NULL, &errcode);
+			oclCheckError(errcode, CL_SUCCESS);
+		}
+		ls.a[l + 1] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, nextB, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+		ls.b[l + 1] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, nextB, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+		ls.c[l + 1] = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, nextB, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+
+		errcode  = clSetKernelArg(ls.factorKernel, 0, sizeof(cl_mem), (void *) &ls.a[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 1, sizeof(cl_mem), (void *) &ls.b[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 2, sizeof(cl_mem), (void *) &ls.c[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 3, sizeof(cl_mem), (void *) &ls.fa[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 4, sizeof(cl_mem), (void *) &ls.fc[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 5, sizeof(cl_mem), (void *) &ls.fr[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 6, sizeof(cl_mem), (void *) &ls.fg[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 7, sizeof(cl_mem), (void *) &ls.fcf[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 8, sizeof(cl_mem), (void *) &ls.a[l + 1]);
+		errcode |= clSetKernelArg(ls.factorKernel, 9, sizeof(cl_mem), (void *) &ls.b[l + 1]);
+		errcode |= clSetKernelArg(ls.factorKernel, 10, sizeof(cl_mem), (void *) &ls.c[l + 1]);
+		errcode |= clSetKernelArg(ls.factorKernel, 11, sizeof(int), &ls.size[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 12, sizeof(int), &ls.m[l]);
+		errcode |= clSetKernelArg(ls.factorKernel, 13, sizeof(int), &ls.partitions[l]);
+		oclCheckError(errcode, CL_SUCCESS);
+
+		size_t szGlobalWorkSize[2], szLocalWorkSize[2];
+		large_set_launch(ls.partitions[l], 1, szGlobalWorkSize, szLocalWorkSize);
+		errcode = clEnqueueNDRangeKernel(queue, ls.factorKernel, 1, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+		oclCheckError(errcode, CL_SUCCESS);
+	}
+
+	// z = A'^-1 u with u = (gamma, 0, ..., 0, c[n-1])
+	if (periodic)
+	{
+		float *u = (float*)calloc(n, sizeof(float));
+		u[0] = gamma;
+		u[n - 1] = c[n - 1];
+		cl_mem du = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * n, u, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+		ls.z = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(float) * n, NULL, &errcode);
+		oclCheckError(errcode, CL_SUCCESS);
+		large_solve_core(ls, du, ls.z, 1);
+		clFinish(queue);
+		clReleaseMemObject(du);
+		free(u);
+	}
+	clFinish(queue);
+}
+
+void large_release(LargeSystem &ls)
+{
+	for (int l = 0; l <= ls.levels; l++)
+	{
+		clReleaseMemObject(ls.a[l]);
+		clReleaseMemObject(ls.b[l]);
+		clReleaseMemObject(ls.c[l]);
+	}
+	for (int l = 0; l < ls.levels; l++)
+	{
+		clReleaseMemObject(ls.fa[l]);
+		clReleaseMemObject(ls.fc[l]);
+		clReleaseMemObject(ls.fr[l]);
+		clReleaseMemObject(ls.fg[l]);
+		clReleaseMemObject(ls.fcf[l]);
+	}
+	if (ls.capacity)
+	{
+		for (int l = 0; l < ls.levels; l++) clReleaseMemObject(ls.dd[l]);
+		for (int l = 1; l <= ls.levels; l++)
+		{
+			clReleaseMemObject(ls.rd[l]);
+			clReleaseMemObject(ls.rx[l]);
+		}
+		if (ls.periodic) clReleaseMemObject(ls.periodicFactor);
+	}
+	if (ls.periodic) clReleaseMemObject(ls.z);
+
+	clReleaseKernel(ls.factorKernel);
+	clReleaseKernel(ls.reduceKernel);
+	clReleaseKernel(ls.substituteKernel);
+	clReleaseKernel(ls.coarseKernel);
+	clReleaseKernel(ls.periodicFactorKernel);
+	clReleaseKernel(ls.periodicCorrectKernel);
+	clReleaseProgram(ls.program);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark: factor one system of system_size, solve num_rhs right-hand sides
+// in BENCH_ITERATIONS batches and compare with the serial CPU solver
+////////////////////////////////////////////////////////////////////////////////
+double large_systems(const char** argv, float *a, float *b, float *c, float *d, float *x, int system_size, int num_rhs,
+					 int partition_size, bool periodic, double *factor_time)
+{
+	cl_int errcode;
+	const size_t mem_size = sizeof(float) * system_size * num_rhs;
+
+	cl_mem device_d = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, mem_size, d, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+	cl_mem device_x = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY, mem_size, NULL, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	LargeSystem ls;
+	shrDeltaT(0);
+	large_factor(ls, cqCommandQue[0], argv, a, b, c, system_size, partition_size, periodic);
+	*factor_time = shrDeltaT(0);
+
+	shrLog("  %d partitioned level(s), coarsest system = %d\n", ls.levels, ls.size[ls.levels]);
+	shrLog("  looping %i times..\n", BENCH_ITERATIONS);
+
+	// warm up, also allocates the work space
+	large_solve(ls, device_d, device_x, num_rhs);
+	clFinish(cqCommandQue[0]);
+
+	double sum_time = 0.0;
+	for (int iCycles = 0; iCycles < BENCH_ITERATIONS; iCycles++)
+	{
+		shrDeltaT(0);
+		large_solve(ls, device_d, device_x, num_rhs);
+		clFinish(cqCommandQue[0]);
+		sum_time += shrDeltaT(0);
+	}
+
+	errcode = clEnqueueReadBuffer(cqCommandQue[0], device_x, CL_TRUE, 0, mem_size, x, 0, NULL, NULL);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	large_release(ls);
+	clReleaseMemObject(device_d);
+	clReleaseMemObject(device_x);
+
+	return sum_time / BENCH_ITERATIONS;
+}
+
+#endif
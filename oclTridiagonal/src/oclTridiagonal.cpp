@@ -18,6 +18,9 @@
  *  CR		- original cyclic reduction O(N)
  *	Sweep	- serial one-thread-per-system gauss elimination O(N)
  *
+ * and one for a single large (optionally periodic) matrix with many right-hand sides:
+ *	Partitioned - Thomas per partition, PCR on the partition ends O(N)
+ *
  * Original testrig code: UC Davis, Yao Zhang & John Owens
  * Reference paper for the cyclic reduction methods on the GPU:  
  *   Yao Zhang, Jonathan Cohen, and John D. Owens. Fast Tridiagonal Solvers on the GPU. 
@@ -36,6 +39,7 @@
 #include <string.h>
 #include <math.h>
 #include <float.h>
+#include <limits.h>
 
 #include <oclUtils.h>
 #include <shrQATest.h>
@@ -58,6 +62,7 @@ int              SWEEP_BLOCK_SIZE = 256;
 #include "pcr_small_systems.h"
 #include "cyclic_small_systems.h"
 #include "sweep_small_systems.h"
+#include "large_systems.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Solve <num_systems> of <system_size> using <devCount> devices
@@ -147,6 +152,66 @@ int run(const char** argv, int system_size, int num_systems, int devCount)
 	return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Solve <num_rhs> right-hand sides of one system of <system_size> on the first
+// device, factoring the matrix once
+////////////////////////////////////////////////////////////////////////////////
+int run_large(const char** argv, int system_size, int num_rhs, int partition_size, bool periodic)
+{
+	cl_int errcode;
+
+	shrLog("Device %d: ", selectedDevNums[0]);
+	oclPrintDevName(LOGBOTH, cdDevices[0]);
+	shrLog("\n\n");
+	cqCommandQue[0] = clCreateCommandQueue(cxGPUContext, cdDevices[0], CL_QUEUE_PROFILING_ENABLE, &errcode);
+	oclCheckError(errcode, CL_SUCCESS);
+
+	const size_t mem_size = sizeof(float) * system_size;
+
+	// one matrix, num_rhs right-hand sides
+	float *a = (float*)malloc(mem_size);
+	float *b = (float*)malloc(mem_size);
+	float *c = (float*)malloc(mem_size);
+	float *d = (float*)malloc(mem_size * num_rhs);
+	float *x1 = (float*)malloc(mem_size * num_rhs);
+	float *x2 = (float*)malloc(mem_size * num_rhs);
+
+	// the partitioned solver does not pivot, use a diagonally dominant matrix
+	test_gen_cyclic(a, b, c, d, x1, system_size, 2);
+	if (periodic)
+	{
+		a[0] = 0.25f * b[0];
+		c[system_size-1] = 0.25f * b[system_size-1];
+	}
+	for (int i = 0; i < system_size * num_rhs; i++) d[i] = rand01();
+
+	shrLog("  Large system: system_size = %d, num_rhs = %d, partition = %d%s\n",
+		   system_size, num_rhs, partition_size, periodic ? ", periodic" : "");
+
+	double time_cpu = serial_large_systems(a, b, c, d, x2, system_size, num_rhs, periodic);
+	shrLog("\n----- CPU  solvers -----\n");
+	shrLog("  CPU Time =    %.5f s\n", time_cpu);
+
+	shrLog("\n----- partitioned GPU solver -----\n\n");
+	double time_factor;
+	double time_gpu = large_systems(argv, a, b, c, d, x1, system_size, num_rhs, partition_size, periodic, &time_factor);
+	shrLog("  Factor Time = %.5f s\n", time_factor);
+	shrLogEx(LOGBOTH | MASTER, 0, "oclTridiagonal-large, Throughput = %.4f MUnknowns/s, Time = %.5f s, Size = %u Unknowns, NumDevsUsed = %u\n",
+		  (1.0e-6 * (double)system_size * num_rhs / time_gpu), time_gpu, system_size * num_rhs, 1);
+	compare_small_systems(x1, x2, system_size, num_rhs);
+
+	clReleaseCommandQueue(cqCommandQue[0]);
+
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	free(x1);
+	free(x2);
+
+	return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Main program
 ////////////////////////////////////////////////////////////////////////////////
@@ -283,6 +348,16 @@ int main(int argc, const char** argv)
 	// run the main test
     int result = run(argv, system_size, num_systems, devCount);
 
+	// large system test, only when a size is given
+	int large_size = 0, num_rhs = 16, partition_size = 32;
+	if (shrGetCmdLineArgumenti(argc, (const char**)argv, "large_size", &large_size) && large_size > 0)
+	{
+		shrGetCmdLineArgumenti(argc, (const char**)argv, "num_rhs", &num_rhs);
+		shrGetCmdLineArgumenti(argc, (const char**)argv, "partition", &partition_size);
+		bool periodic = (shrCheckCmdLineFlag(argc, (const char**)argv, "periodic") == shrTRUE);
+		result |= run_large(argv, MAX(large_size, 3), MAX(num_rhs, 1), MAX(partition_size, 4), periodic);
+	}
+
 	// free OCL context & devices
 	clReleaseContext(cxGPUContext);
 	free(cdAllDevices);
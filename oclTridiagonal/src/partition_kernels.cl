@@ -0,0 +1,232 @@
+/*
+ * Copyright 1993-2010 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+ /*
+ * Tridiagonal solvers.
+ * Device code for the partitioned solver of large systems.
+ *
+ * The system of size n is cut into P = n / m partitions of m rows, the last
+ * one takes the remainder. Every partition is eliminated by a modified Thomas
+ * sweep (one work-item per partition) until each of its rows depends only on
+ * the first and the last unknown of the partition. These 2P unknowns form a
+ * tridiagonal system of their own, which is reduced the same way until it
+ * fits one work-group and is solved by PCR. The interior unknowns follow from
+ * the partition ends in a fully parallel substitution.
+ *
+ * Elimination of the matrix (factor) and of the right-hand side (reduce) are
+ * separate kernels, so one factorization serves any number of RHS batches.
+ */
+
+// partition k covers rows [*start, *start + *len)
+void partition_range(int k, int m, int num_partitions, int n, int *start, int *len)
+{
+	*start = k * m;
+	*len = (k == num_partitions - 1) ? n - *start : m;
+}
+
+// Per partition, all arrays of size n except the reduced system (2P):
+//   fr, fg  - forward scale and coupling of the rhs sweep,
+//             fg of the first row holds the scale of its final elimination
+//   fcf     - upper coefficient after the forward sweep
+//   fa, fc  - coupling of every row to the first and the last partition unknown
+//   ra, rb, rc - reduced system, rows 2k (first) and 2k+1 (last)
+__kernel void partition_factor_kernel(__global const float *a, __global const float *b, __global const float *c,
+									  __global float *fa, __global float *fc, __global float *fr, __global float *fg, __global float *fcf,
+									  __global float *ra, __global float *rb, __global float *rc,
+									  int n, int m, int num_partitions)
+{
+	int k = get_global_id(0);
+	if (k >= num_partitions) return;
+
+	int s, len;
+	partition_range(k, m, num_partitions, n, &s, &len);
+
+	// the system ends have no outer neighbours, whatever the input holds
+	float a0 = (s == 0) ? 0.0f : a[s];
+	float cLast = (s + len == n) ? 0.0f : c[s + len - 1];
+
+	// first two rows are only normalized, partitions have at least 3 rows
+	float r = 1.0f / b[s];
+	fr[s] = r;
+	fa[s] = a0 * r;
+	fcf[s] = fc[s] = c[s] * r;
+
+	r = 1.0f / b[s + 1];
+	fr[s + 1] = r;
+	fg[s + 1] = 0.0f;
+	fa[s + 1] = a[s + 1] * r;
+	fcf[s + 1] = fc[s + 1] = c[s + 1] * r;
+
+	// forward: row i couples to the first unknown and to i+1
+	for (int i = 2; i < len; i++)
+	{
+		float ai = a[s + i];
+		float ci = (i == len - 1) ? cLast : c[s + i];
+		r = 1.0f / (b[s + i] - ai * fcf[s + i - 1]);
+		fr[s + i] = r;
+		fg[s + i] = r * ai;
+		fa[s + i] = -r * ai * fa[s + i - 1];
+		fcf[s + i] = fc[s + i] = r * ci;
+	}
+
+	// backward: row i couples to the first and the last unknown
+	for (int i = len - 3; i >= 1; i--)
+	{
+		fa[s + i] = fa[s + i] - fcf[s + i] * fa[s + i + 1];
+		fc[s + i] = -fcf[s + i] * fc[s + i + 1];
+	}
+
+	// first row: eliminate its right neighbour
+	r = 1.0f / (1.0f - fcf[s] * fa[s + 1]);
+	fg[s] = r;
+	fa[s] = r * fa[s];
+	fc[s] = -r * fcf[s] * fc[s + 1];
+
+	ra[2 * k] = fa[s];
+	rb[2 * k] = 1.0f;
+	rc[2 * k] = fc[s];
+	ra[2 * k + 1] = fa[s + len - 1];
+	rb[2 * k + 1] = 1.0f;
+	rc[2 * k + 1] = fc[s + len - 1];
+}
+
+// Applies the factorization to one partition of one rhs (dimension 1),
+// dd receives the eliminated rhs and rd the rhs of the reduced system
+__kernel void partition_reduce_kernel(__global const float *d, __global float *dd, __global float *rd,
+									  __global const float *fr, __global const float *fg, __global const float *fcf,
+									  int n, int m, int num_partitions)
+{
+	int k = get_global_id(0);
+	int rhs = get_global_id(1);
+	if (k >= num_partitions) return;
+
+	int s, len;
+	partition_range(k, m, num_partitions, n, &s, &len);
+	__global const float *D = d + rhs * n + s;
+	__global float *DD = dd + rhs * n + s;
+	fr += s;
+	fg += s;
+	fcf += s;
+
+	float prev = D[1] * fr[1];
+	DD[0] = D[0] * fr[0];
+	DD[1] = prev;
+	for (int i = 2; i < len; i++)
+	{
+		prev = fr[i] * D[i] - fg[i] * prev;
+		DD[i] = prev;
+	}
+	float last = prev;
+
+	float next = DD[len - 2];
+	for (int i = len - 3; i >= 1; i--)
+	{
+		next = DD[i] - fcf[i] * next;
+		DD[i] = next;
+	}
+	float first = fg[0] * (DD[0] - fcf[0] * DD[1]);
+	DD[0] = first;
+
+	rd[rhs * 2 * num_partitions + 2 * k] = first;
+	rd[rhs * 2 * num_partitions + 2 * k + 1] = last;
+}
+
+// Interior unknowns from the solved partition ends, one work-item per row
+// and rhs (dimension 1)
+__kernel void partition_substitute_kernel(__global float *x, __global const float *dd, __global const float *rx,
+										  __global const float *fa, __global const float *fc,
+										  int n, int m, int num_partitions)
+{
+	int i = get_global_id(0);
+	int rhs = get_global_id(1);
+	if (i >= n) return;
+
+	int k = min(i / m, num_partitions - 1);
+	int s, len;
+	partition_range(k, m, num_partitions, n, &s, &len);
+
+	float xFirst = rx[rhs * 2 * num_partitions + 2 * k];
+	float xLast  = rx[rhs * 2 * num_partitions + 2 * k + 1];
+
+	float value;
+	if (i == s) value = xFirst;
+	else if (i == s + len - 1) value = xLast;
+	else value = dd[rhs * n + i] - fa[i] * xFirst - fc[i] * xLast;
+	x[rhs * n + i] = value;
+}
+
+// PCR for one system of any size n up to the work-group size, one work-group
+// per rhs. Rows beyond the ends count as zero, after ceil(log2(n)) steps every
+// row is decoupled.
+__kernel void pcr_coarse_kernel(__global const float *a_d, __global const float *b_d, __global const float *c_d,
+								__global const float *d_d, __global float *x_d,
+								__local float *shared, int n)
+{
+	int i = get_local_id(0);
+	int rhs = get_group_id(0);
+
+	__local float* a = shared;
+	__local float* b = &a[n];
+	__local float* c = &b[n];
+	__local float* d = &c[n];
+
+	a[i] = (i == 0) ? 0.0f : a_d[i];
+	b[i] = b_d[i];
+	c[i] = (i == n - 1) ? 0.0f : c_d[i];
+	d[i] = d_d[rhs * n + i];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int delta = 1; delta < n; delta *= 2)
+	{
+		int iLeft = i - delta;
+		int iRight = i + delta;
+		float k1 = (iLeft >= 0) ? a[i] / b[iLeft] : 0.0f;
+		float k2 = (iRight < n) ? c[i] / b[iRight] : 0.0f;
+		iLeft = max(iLeft, 0);
+		iRight = min(iRight, n - 1);
+
+		float bNew = b[i] - c[iLeft] * k1 - a[iRight] * k2;
+		float dNew = d[i] - d[iLeft] * k1 - d[iRight] * k2;
+		float aNew = -a[iLeft] * k1;
+		float cNew = -c[iRight] * k2;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		a[i] = aNew;
+		b[i] = bNew;
+		c[i] = cNew;
+		d[i] = dNew;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	x_d[rhs * n + i] = d[i] / b[i];
+}
+
+// Sherman-Morrison correction of periodic systems: x = y - (v.y / (1 + v.z)) z,
+// v has its only entries at 0 and n-1. One work-item per rhs.
+__kernel void periodic_factor_kernel(__global float *factor, __global const float *y, __global const float *z,
+									 float vLast, int n, int num_rhs)
+{
+	int rhs = get_global_id(0);
+	if (rhs >= num_rhs) return;
+
+	float vy = y[rhs * n] + vLast * y[rhs * n + n - 1];
+	float vz = z[0] + vLast * z[n - 1];
+	factor[rhs] = vy / (1.0f + vz);
+}
+
+__kernel void periodic_correct_kernel(__global float *x, __global const float *z, __global const float *factor, int n)
+{
+	int i = get_global_id(0);
+	int rhs = get_global_id(1);
+	if (i >= n) return;
+
+	x[rhs * n + i] -= factor[rhs] * z[i];
+}
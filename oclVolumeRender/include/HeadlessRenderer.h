@@ -0,0 +1,98 @@
+/*
+ * Copyright 1993-2011 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _HEADLESS_RENDERER_H_
+#define _HEADLESS_RENDERER_H_
+
+#include <CL/cl.h>
+#include <vector>
+
+// Enqueues the commands that render one frame into output (width * height
+// RGBA8 pixels) on the render queue. camera points to the frame's entry of
+// the batch.
+typedef void (*HeadlessRenderFunc)(cl_mem output, const float *camera, void *userData);
+
+// Called on the host with the pixels of a finished frame, in frame order.
+// The pixels are only valid during the call.
+typedef void (*HeadlessEncodeFunc)(int frame, const unsigned char *pixels, void *userData);
+
+// Renders a batch of camera views without any window, for server-side use.
+//
+// Frames go round-robin into a pool of output buffers, each with a pinned
+// host buffer for its readback. The kernels of frame N+1 are on the render
+// queue while frame N is copied to the host on a second queue and encoded
+// by the host thread, so the device never waits for the encoder unless
+// every buffer of the pool is still being read or encoded.
+class HeadlessRenderer
+{
+public:
+    // renderQueue is the sample's queue, the readback queue is created on device
+    HeadlessRenderer(cl_context GPUContext,
+                     cl_device_id device,
+                     cl_command_queue renderQueue,
+                     unsigned int width,
+                     unsigned int height,
+                     int poolSize);
+    ~HeadlessRenderer();
+
+    // Renders numFrames frames, camera i at cameras + i * cameraFloats, and
+    // hands each to pfnEncode. Returns the elapsed time in seconds.
+    double RenderBatch(const float *cameras, int numFrames, int cameraFloats,
+                       HeadlessRenderFunc pfnRender, HeadlessEncodeFunc pfnEncode, void *userData);
+
+    // The same one frame at a time, render, blocking read, encode: the baseline
+    double RenderBatchSerial(const float *cameras, int numFrames, int cameraFloats,
+                             HeadlessRenderFunc pfnRender, HeadlessEncodeFunc pfnEncode, void *userData);
+
+    // host time of the last batch spent in pfnEncode and waiting for readbacks
+    double GetEncodeTime() {return dEncodeTime;}
+    double GetWaitTime() {return dWaitTime;}
+
+    unsigned int GetWidth() {return uiWidth;}
+    unsigned int GetHeight() {return uiHeight;}
+    int GetPoolSize() {return (int)slots.size();}
+
+    // Binary PPM (P6) of RGBA8 pixels, alpha dropped
+    static void EncodePPM(const unsigned char *pixels, unsigned int width, unsigned int height,
+                          std::vector<unsigned char> &ppm);
+
+    // Whitespace separated floats, cameraFloats per camera; false when the
+    // file can't be read or holds no complete camera
+    static bool LoadCameras(const char *fileName, int cameraFloats, std::vector<float> &cameras);
+
+private:
+    // output buffer, pinned staging buffer and readback event of one frame
+    struct Slot
+    {
+        cl_mem output;
+        cl_mem pinned;
+        unsigned char *pixels;
+        cl_event readDone;
+        int frame;
+    };
+
+    cl_context cxGPUContext;
+    cl_command_queue cqRender;
+    cl_command_queue cqRead;
+    unsigned int uiWidth;
+    unsigned int uiHeight;
+    std::vector<Slot> slots;
+    double dEncodeTime;
+    double dWaitTime;
+
+    // waits for the readback of the slot's frame and encodes it
+    void retire(Slot &slot, HeadlessEncodeFunc pfnEncode, void *userData);
+
+    HeadlessRenderer(const HeadlessRenderer &);
+    HeadlessRenderer &operator=(const HeadlessRenderer &);
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * Copyright 1993-2011 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include <oclUtils.h>
+#include <chrono>
+#include <cstdio>
+
+#include "HeadlessRenderer.h"
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+HeadlessRenderer::HeadlessRenderer(cl_context GPUContext,
+                                   cl_device_id device,
+                                   cl_command_queue renderQueue,
+                                   unsigned int width,
+                                   unsigned int height,
+                                   int poolSize)
+{
+    cl_int ciErrNum;
+    size_t szFrameBytes = width * height * 4;
+
+    cxGPUContext = GPUContext;
+    cqRender = renderQueue;
+    uiWidth = width;
+    uiHeight = height;
+    dEncodeTime = 0.0;
+    dWaitTime = 0.0;
+
+    // readbacks on their own queue, so they can run beside the next frame's kernels
+    cqRead = clCreateCommandQueue(cxGPUContext, device, 0, &ciErrNum);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+
+    slots.resize(poolSize > 0 ? poolSize : 1);
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        Slot &slot = slots[i];
+        slot.output = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY, szFrameBytes, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+
+        // pinned host memory, mapped once for the lifetime of the renderer
+        slot.pinned = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, szFrameBytes, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        slot.pixels = (unsigned char *)clEnqueueMapBuffer(cqRead, slot.pinned, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                                          0, szFrameBytes, 0, NULL, NULL, &ciErrNum);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+
+        slot.readDone = 0;
+        slot.frame = -1;
+    }
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+    clFinish(cqRender);
+    clFinish(cqRead);
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        Slot &slot = slots[i];
+        if (slot.readDone)
+        {
+            clReleaseEvent(slot.readDone);
+        }
+        clEnqueueUnmapMemObject(cqRead, slot.pinned, slot.pixels, 0, NULL, NULL);
+    }
+    clFinish(cqRead);
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        clReleaseMemObject(slots[i].pinned);
+        clReleaseMemObject(slots[i].output);
+    }
+    clReleaseCommandQueue(cqRead);
+}
+
+double HeadlessRenderer::RenderBatch(const float *cameras, int numFrames, int cameraFloats,
+                                     HeadlessRenderFunc pfnRender, HeadlessEncodeFunc pfnEncode, void *userData)
+{
+    cl_int ciErrNum;
+    size_t szFrameBytes = uiWidth * uiHeight * 4;
+    dEncodeTime = 0.0;
+    dWaitTime = 0.0;
+
+    double dStart = now();
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        // the slot of frame - poolSize has to be read and encoded before it is reused
+        Slot &slot = slots[frame % slots.size()];
+        if (slot.frame >= 0)
+        {
+            retire(slot, pfnEncode, userData);
+        }
+
+        pfnRender(slot.output, cameras + (size_t)frame * cameraFloats, userData);
+        cl_event renderDone;
+        ciErrNum = clEnqueueMarker(cqRender, &renderDone);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+
+        ciErrNum = clEnqueueReadBuffer(cqRead, slot.output, CL_FALSE, 0, szFrameBytes, slot.pixels,
+                                       1, &renderDone, &slot.readDone);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        clReleaseEvent(renderDone);
+        slot.frame = frame;
+
+        // start the device on both right away, the host goes on encoding
+        clFlush(cqRender);
+        clFlush(cqRead);
+    }
+
+    // the last frames, oldest first
+    for (int frame = (numFrames > (int)slots.size()) ? numFrames - (int)slots.size() : 0; frame < numFrames; frame++)
+    {
+        retire(slots[frame % slots.size()], pfnEncode, userData);
+    }
+    return now() - dStart;
+}
+
+double HeadlessRenderer::RenderBatchSerial(const float *cameras, int numFrames, int cameraFloats,
+                                           HeadlessRenderFunc pfnRender, HeadlessEncodeFunc pfnEncode, void *userData)
+{
+    cl_int ciErrNum;
+    size_t szFrameBytes = uiWidth * uiHeight * 4;
+    Slot &slot = slots[0];
+    dEncodeTime = 0.0;
+    dWaitTime = 0.0;
+
+    double dStart = now();
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        pfnRender(slot.output, cameras + (size_t)frame * cameraFloats, userData);
+
+        double dWaitStart = now();
+        ciErrNum = clEnqueueReadBuffer(cqRender, slot.output, CL_TRUE, 0, szFrameBytes, slot.pixels, 0, NULL, NULL);
+        oclCheckError(ciErrNum, CL_SUCCESS);
+        double dEncodeStart = now();
+        dWaitTime += dEncodeStart - dWaitStart;
+
+        pfnEncode(frame, slot.pixels, userData);
+        dEncodeTime += now() - dEncodeStart;
+    }
+    return now() - dStart;
+}
+
+void HeadlessRenderer::retire(Slot &slot, HeadlessEncodeFunc pfnEncode, void *userData)
+{
+    double dWaitStart = now();
+    cl_int ciErrNum = clWaitForEvents(1, &slot.readDone);
+    oclCheckError(ciErrNum, CL_SUCCESS);
+    clReleaseEvent(slot.readDone);
+    slot.readDone = 0;
+    double dEncodeStart = now();
+    dWaitTime += dEncodeStart - dWaitStart;
+
+    pfnEncode(slot.frame, slot.pixels, userData);
+    dEncodeTime += now() - dEncodeStart;
+    slot.frame = -1;
+}
+
+void HeadlessRenderer::EncodePPM(const unsigned char *pixels, unsigned int width, unsigned int height,
+                                 std::vector<unsigned char> &ppm)
+{
+    char header[64];
+    int iHeaderLength = sprintf(header, "P6\n%u %u\n255\n", width, height);
+    size_t szPixels = (size_t)width * height;
+
+    ppm.resize(iHeaderLength + szPixels * 3);
+    memcpy(&ppm[0], header, iHeaderLength);
+    unsigned char *dst = &ppm[iHeaderLength];
+    for (size_t i = 0; i < szPixels; i++)
+    {
+        dst[3 * i] = pixels[4 * i];
+        dst[3 * i + 1] = pixels[4 * i + 1];
+        dst[3 * i + 2] = pixels[4 * i + 2];
+    }
+}
+
+bool HeadlessRenderer::LoadCameras(const char *fileName, int cameraFloats, std::vector<float> &cameras)
+{
+    FILE *fp = fopen(fileName, "r");
+    if (!fp)
+    {
+        return false;
+    }
+
+    cameras.clear();
+    float value;
+    while (fscanf(fp, "%f", &value) == 1)
+    {
+        cameras.push_back(value);
+    }
+    fclose(fp);
+
+    // drop an incomplete last camera
+    cameras.resize(cameras.size() - cameras.size() % cameraFloats);
+    return !cameras.empty();
+}
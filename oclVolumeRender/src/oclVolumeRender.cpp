@@ -32,11 +32,15 @@
 // Includes
 #include <iostream>
 #include <string>
+#include <vector>
+#include <cmath>
 
 // Utilities, OpenCL and system includes
 #include <oclUtils.h>
 #include <shrQATest.h>
 
+#include "HeadlessRenderer.h"
+
 #if defined (__APPLE__) || defined(MACOSX)
    #define GL_SHARING_EXTENSION "cl_APPLE_gl_sharing"
 #else
@@ -72,6 +76,17 @@ float transferOffset = 0.0f;
 float transferScale = 1.0f;
 bool linearFiltering = true;
 
+// Front-to-back rendering with early ray termination and empty space skipping
+// over a coarse grid of bricks (d_renderFrontToBack), instead of d_render
+#define TRANSFER_FUNC_WIDTH 9   // texels of the transfer function
+bool frontToBack = false;
+bool skipEmpty = true;
+float opacityThreshold = 0.99f; // rays stop at this accumulated opacity
+float maxStepScale = 4.0f;      // largest step, in tsteps, in bricks of low opacity
+uint brickSize = 8;             // voxels per brick edge
+cl_uint4 brickGrid;             // bricks per axis
+uint numBricks = 0;
+
 GLuint pbo = 0;                 // OpenGL pixel buffer object
 int iGLUTWindowHandle;          // handle to the GLUT window
 
@@ -86,11 +101,16 @@ cl_device_id device;
 cl_command_queue cqCommandQueue;
 cl_program cpProgram;
 cl_kernel ckKernel;
+cl_kernel ckKernelFrontToBack;
+cl_kernel ckBuildMinMax;            // occupancy grid kernels, with image support only
+cl_kernel ckClassifyBricks;
 cl_int ciErrNum;
 cl_mem pbo_cl;
 cl_mem d_volumeArray;
 cl_mem d_transferFuncArray;
 cl_mem d_invViewMatrix;
+cl_mem d_brickMinMax;
+cl_mem d_brickOpacity;
 char* cPathAndName = NULL;          // var for full paths to data, src, etc.
 char* cSourceCL;                    // Buffer to hold source for compilation 
 const char* cExecutableName = NULL;
@@ -107,6 +127,8 @@ int iTestSets = 3;
 int g_Index = 0;
 shrBOOL bNoPrompt = shrFALSE;		// false = normal GL loop, true = Finite period of GL loop (a few seconds)
 shrBOOL bQATest = shrFALSE;			// false = normal GL loop, true = run No-GL test sequence  
+shrBOOL bBenchmark = shrFALSE;      // true = headless frame time of the render modes, then exit
+shrBOOL bHeadless = shrFALSE;       // true = render a batch of cameras to images, then exit
 bool g_bFBODisplay = false;
 int ox, oy;                         // mouse location vars
 int buttonState = 0;                
@@ -118,6 +140,10 @@ void initPixelBuffer();
 void render();
 void createCLContext(int argc, const char** argv);
 void initCLVolume(uchar *h_volume);
+void releaseCLVolume();
+void initBrickGrid();
+void setOutputArgs(cl_mem output);
+void enqueueRender(const size_t* localSize);
 
 // OpenGL functionality
 void InitGL(int* argc, char** argv);
@@ -133,6 +159,8 @@ void mouse(int button, int state, int x, int y);
 void Cleanup(int iExitCode);
 void (*pCleanup)(int) = &Cleanup;
 void TestNoGL();
+void RunBenchmark(uchar *h_volume);
+void RunHeadless(int argc, const char** argv);
 
 // Main program
 //*****************************************************************************
@@ -151,7 +179,8 @@ int main(int argc, char** argv)
 		                 "       '-' and '+' to change density (0.01 increments)\n"
                          "       ']' and '[' to change brightness\n"
                          "       ';' and ''' to modify transfer function offset\n"
-                         "       '.' and ',' to modify transfer function scale\n\n");
+                         "       '.' and ',' to modify transfer function scale\n"
+                         "       'm' to toggle front-to-back rendering, 'e' to toggle empty space skipping\n\n");
 
     // get command line arg for quick test, if provided
     // process command line arguments
@@ -159,6 +188,10 @@ int main(int argc, char** argv)
     {
         bQATest = shrCheckCmdLineFlag(argc, (const char**)argv, "qatest");
         bNoPrompt = shrCheckCmdLineFlag(argc, (const char**)argv, "noprompt");
+        bBenchmark = shrCheckCmdLineFlag(argc, (const char**)argv, "benchmark");
+        bHeadless = shrCheckCmdLineFlag(argc, (const char**)argv, "headless");
+        frontToBack = shrCheckCmdLineFlag(argc, (const char**)argv, "ftb") == shrTRUE;
+        skipEmpty = shrCheckCmdLineFlag(argc, (const char**)argv, "noskip") != shrTRUE;
     }
     bQATest = shrTRUE;
     // First initialize OpenGL context, so we can properly setup the OpenGL / OpenCL interop.
@@ -208,6 +241,15 @@ int main(int argc, char** argv)
     // create the kernel
     ckKernel = clCreateKernel(cpProgram, "d_render", &ciErrNum);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    ckKernelFrontToBack = clCreateKernel(cpProgram, "d_renderFrontToBack", &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    if (g_bImageSupport)
+    {
+        ckBuildMinMax = clCreateKernel(cpProgram, "d_buildMinMax", &ciErrNum);
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+        ckClassifyBricks = clCreateKernel(cpProgram, "d_classifyBricks", &ciErrNum);
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    }
 
     // parse arguments
     char *filename;
@@ -227,6 +269,12 @@ int main(int argc, char** argv)
     if (shrGetCmdLineArgumenti(argc, (const char**)argv, "zsize", &n)) {
          volumeSize[2] = n;
     }
+    if (shrGetCmdLineArgumenti(argc, (const char**)argv, "brick", &n) && n > 0) {
+        brickSize = n;
+    }
+    shrGetCmdLineArgumentf(argc, (const char**)argv, "threshold", &opacityThreshold);
+    shrGetCmdLineArgumentf(argc, (const char**)argv, "stepscale", &maxStepScale);
+    maxStepScale = (maxStepScale < 1.0f) ? 1.0f : maxStepScale;
 
     // load volume data
     free(cPathAndName);
@@ -239,7 +287,15 @@ int main(int argc, char** argv)
 
     // Init OpenCL
     initCLVolume(h_volume);
+    if (bBenchmark)
+    {
+        RunBenchmark(h_volume);
+    }
     free (h_volume);
+    if (bHeadless)
+    {
+        RunHeadless(argc, (const char**)argv);
+    }
 
     // init timer 1 for fps measurement 
     shrDeltaT(1);  
@@ -279,13 +335,8 @@ void render()
 
     // execute OpenCL kernel, writing results to PBO
     size_t localSize[] = {LOCAL_SIZE_X,LOCAL_SIZE_Y};
-
-    ciErrNum |= clSetKernelArg(ckKernel, 3, sizeof(float), &density);
-    ciErrNum |= clSetKernelArg(ckKernel, 4, sizeof(float), &brightness);
-    ciErrNum |= clSetKernelArg(ckKernel, 5, sizeof(float), &transferOffset);
-    ciErrNum |= clSetKernelArg(ckKernel, 6, sizeof(float), &transferScale);
-    ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 2, NULL, gridSize, localSize, 0, 0, 0);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    enqueueRender(localSize);
 
 	if( g_glInterop ) {
 		// Transfer ownership of buffer back from CL to GL    
@@ -306,6 +357,42 @@ void render()
 	}
 }
 
+// Launch the kernel of the current render mode. Front to back, the brick
+// opacities are classified first: density and the transfer function
+// parameters may have changed since the last frame.
+//*****************************************************************************
+void enqueueRender(const size_t* localSize)
+{
+    cl_kernel kernel = frontToBack ? ckKernelFrontToBack : ckKernel;
+
+    ciErrNum = clSetKernelArg(kernel, 3, sizeof(float), &density);
+    ciErrNum |= clSetKernelArg(kernel, 4, sizeof(float), &brightness);
+    ciErrNum |= clSetKernelArg(kernel, 5, sizeof(float), &transferOffset);
+    ciErrNum |= clSetKernelArg(kernel, 6, sizeof(float), &transferScale);
+
+    if (frontToBack)
+    {
+        // arguments after those of d_render
+        cl_uint uiArg = g_bImageSupport ? 12 : 8;
+        cl_uint uiSkipEmpty = skipEmpty ? 1 : 0;
+        ciErrNum |= clSetKernelArg(kernel, uiArg + 3, sizeof(float), &opacityThreshold);
+        ciErrNum |= clSetKernelArg(kernel, uiArg + 4, sizeof(float), &maxStepScale);
+        ciErrNum |= clSetKernelArg(kernel, uiArg + 5, sizeof(cl_uint), &uiSkipEmpty);
+
+        if (g_bImageSupport && skipEmpty)
+        {
+            size_t globalSize = numBricks;
+            ciErrNum |= clSetKernelArg(ckClassifyBricks, 4, sizeof(float), &density);
+            ciErrNum |= clSetKernelArg(ckClassifyBricks, 5, sizeof(float), &transferOffset);
+            ciErrNum |= clSetKernelArg(ckClassifyBricks, 6, sizeof(float), &transferScale);
+            ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, ckClassifyBricks, 1, NULL, &globalSize, NULL, 0, 0, 0);
+        }
+    }
+
+    ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, kernel, 2, NULL, gridSize, localSize, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
 // Display callback for GLUT main loop
 //*****************************************************************************
 void DisplayGL()
@@ -448,9 +535,20 @@ void KeyboardGL(unsigned char key, int /*x*/, int /*y*/)
         case 'f':
                     linearFiltering = !linearFiltering;
                     ciErrNum = clSetKernelArg(ckKernel, 10, sizeof(cl_sampler), linearFiltering ? &volumeSamplerLinear : &volumeSamplerNearest);
+                    ciErrNum |= clSetKernelArg(ckKernelFrontToBack, 10, sizeof(cl_sampler), linearFiltering ? &volumeSamplerLinear : &volumeSamplerNearest);
                     shrLog("\nLinear Filtering Toggled %s...\n", linearFiltering ? "ON" : "OFF");
                     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
                     break;
+        case 'M':
+        case 'm':
+                    frontToBack = !frontToBack;
+                    shrLog("\nFront-to-back Rendering Toggled %s...\n", frontToBack ? "ON" : "OFF");
+                    break;
+        case 'E':
+        case 'e':
+                    skipEmpty = !skipEmpty;
+                    shrLog("\nEmpty Space Skipping Toggled %s...\n", skipEmpty ? "ON" : "OFF");
+                    break;
         default:
             break;
     }
@@ -673,18 +771,106 @@ void initCLVolume(uchar *h_volume)
         volumeSamplerNearest = clCreateSampler(cxGPUContext, true, CL_ADDRESS_REPEAT, CL_FILTER_NEAREST, &ciErrNum);
         oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 
-        // set image and sampler args
-        ciErrNum = clSetKernelArg(ckKernel, 8, sizeof(cl_mem), (void *) &d_volumeArray);
-		ciErrNum |= clSetKernelArg(ckKernel, 9, sizeof(cl_mem), (void *) &d_transferFuncArray);
-        ciErrNum |= clSetKernelArg(ckKernel, 10, sizeof(cl_sampler), linearFiltering ? &volumeSamplerLinear : &volumeSamplerNearest);
-        ciErrNum |= clSetKernelArg(ckKernel, 11, sizeof(cl_sampler), &transferFuncSampler);
+        // set image and sampler args, the same on both render kernels
+        cl_kernel kernels[] = {ckKernel, ckKernelFrontToBack};
+        ciErrNum = CL_SUCCESS;
+        for (int k = 0; k < 2; k++)
+        {
+            ciErrNum |= clSetKernelArg(kernels[k], 8, sizeof(cl_mem), (void *) &d_volumeArray);
+            ciErrNum |= clSetKernelArg(kernels[k], 9, sizeof(cl_mem), (void *) &d_transferFuncArray);
+            ciErrNum |= clSetKernelArg(kernels[k], 10, sizeof(cl_sampler), linearFiltering ? &volumeSamplerLinear : &volumeSamplerNearest);
+            ciErrNum |= clSetKernelArg(kernels[k], 11, sizeof(cl_sampler), &transferFuncSampler);
+        }
 		oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 	}
 
     // init invViewMatrix
     d_invViewMatrix = clCreateBuffer(cxGPUContext, CL_MEM_READ_ONLY, 12 * sizeof(float), 0, &ciErrNum);
     ciErrNum |= clSetKernelArg(ckKernel, 7, sizeof(cl_mem), (void *) &d_invViewMatrix);
+    ciErrNum |= clSetKernelArg(ckKernelFrontToBack, 7, sizeof(cl_mem), (void *) &d_invViewMatrix);
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    initBrickGrid();
+}
+
+// Build the occupancy grid of the volume on the device: min and max density
+// of every brick. Which bricks are empty depends on the transfer function,
+// that is decided per frame by d_classifyBricks.
+//*****************************************************************************
+void initBrickGrid()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        brickGrid.s[i] = (cl_uint)((volumeSize[i] + brickSize - 1) / brickSize);
+    }
+    brickGrid.s[3] = 1;
+    numBricks = brickGrid.s[0] * brickGrid.s[1] * brickGrid.s[2];
+
+    d_brickOpacity = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, numBricks * sizeof(float), 0, &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+    if (g_bImageSupport)
+    {
+        d_brickMinMax = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, numBricks * 2 * sizeof(float), 0, &ciErrNum);
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+        size_t globalSize[] = {brickGrid.s[0], brickGrid.s[1], brickGrid.s[2]};
+        ciErrNum = clSetKernelArg(ckBuildMinMax, 0, sizeof(cl_mem), (void *) &d_brickMinMax);
+        ciErrNum |= clSetKernelArg(ckBuildMinMax, 1, sizeof(cl_uint4), &brickGrid);
+        ciErrNum |= clSetKernelArg(ckBuildMinMax, 2, sizeof(cl_uint), &brickSize);
+        ciErrNum |= clSetKernelArg(ckBuildMinMax, 3, sizeof(cl_mem), (void *) &d_volumeArray);
+        ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, ckBuildMinMax, 3, NULL, globalSize, NULL, 0, 0, 0);
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+        // density and transfer function parameters are set per frame
+        cl_uint uiTransferWidth = TRANSFER_FUNC_WIDTH;
+        ciErrNum = clSetKernelArg(ckClassifyBricks, 0, sizeof(cl_mem), (void *) &d_brickMinMax);
+        ciErrNum |= clSetKernelArg(ckClassifyBricks, 1, sizeof(cl_mem), (void *) &d_brickOpacity);
+        ciErrNum |= clSetKernelArg(ckClassifyBricks, 2, sizeof(cl_uint), &numBricks);
+        ciErrNum |= clSetKernelArg(ckClassifyBricks, 3, sizeof(cl_uint), &uiTransferWidth);
+        ciErrNum |= clSetKernelArg(ckClassifyBricks, 7, sizeof(cl_mem), (void *) &d_transferFuncArray);
+        ciErrNum |= clSetKernelArg(ckClassifyBricks, 8, sizeof(cl_sampler), &transferFuncSampler);
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    }
+    else
+    {
+        // without images every sample has the same opacity, nothing to skip
+        std::vector<float> opaque(numBricks, 1.0f);
+        ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, d_brickOpacity, CL_TRUE, 0, numBricks * sizeof(float), &opaque[0], 0, 0, 0);
+        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    }
+
+    cl_uint uiArg = g_bImageSupport ? 12 : 8;
+    ciErrNum = clSetKernelArg(ckKernelFrontToBack, uiArg, sizeof(cl_mem), (void *) &d_brickOpacity);
+    ciErrNum |= clSetKernelArg(ckKernelFrontToBack, uiArg + 1, sizeof(cl_uint4), &brickGrid);
+
+    // bricks per unit of normalized coordinates: the ray finds its brick with
+    // it, also when the volume size isn't a multiple of the brick size
+    cl_float4 brickScale;
+    for (int i = 0; i < 3; i++)
+    {
+        brickScale.s[i] = (float)volumeSize[i] / (float)brickSize;
+    }
+    brickScale.s[3] = 1.0f;
+    ciErrNum |= clSetKernelArg(ckKernelFrontToBack, uiArg + 2, sizeof(cl_float4), &brickScale);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+}
+
+// Release what initCLVolume created, so another volume can be loaded
+//*****************************************************************************
+void releaseCLVolume()
+{
+    clFinish(cqCommandQueue);
+    if(volumeSamplerLinear)clReleaseSampler(volumeSamplerLinear);
+    if(volumeSamplerNearest)clReleaseSampler(volumeSamplerNearest);
+    if(transferFuncSampler)clReleaseSampler(transferFuncSampler);
+    if(d_volumeArray)clReleaseMemObject(d_volumeArray);
+    if(d_transferFuncArray)clReleaseMemObject(d_transferFuncArray);
+    if(d_invViewMatrix)clReleaseMemObject(d_invViewMatrix);
+    if(d_brickMinMax)clReleaseMemObject(d_brickMinMax);
+    if(d_brickOpacity)clReleaseMemObject(d_brickOpacity);
+    volumeSamplerLinear = volumeSamplerNearest = transferFuncSampler = 0;
+    d_volumeArray = d_transferFuncArray = d_invViewMatrix = d_brickMinMax = d_brickOpacity = 0;
 }
 
 // Initialize GL
@@ -749,9 +935,22 @@ void initPixelBuffer()
 	gridSize[0] = shrRoundUp(LOCAL_SIZE_X,width);
 	gridSize[1] = shrRoundUp(LOCAL_SIZE_Y,height);
 
-    ciErrNum |= clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void *) &pbo_cl);
-    ciErrNum |= clSetKernelArg(ckKernel, 1, sizeof(unsigned int), &width);
-    ciErrNum |= clSetKernelArg(ckKernel, 2, sizeof(unsigned int), &height);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    setOutputArgs(pbo_cl);
+}
+
+// Output buffer and image size, on both render kernels
+//*****************************************************************************
+void setOutputArgs(cl_mem output)
+{
+    cl_kernel kernels[] = {ckKernel, ckKernelFrontToBack};
+    ciErrNum = CL_SUCCESS;
+    for (int k = 0; k < 2; k++)
+    {
+        ciErrNum |= clSetKernelArg(kernels[k], 0, sizeof(cl_mem), (void *) &output);
+        ciErrNum |= clSetKernelArg(kernels[k], 1, sizeof(unsigned int), &width);
+        ciErrNum |= clSetKernelArg(kernels[k], 2, sizeof(unsigned int), &height);
+    }
     oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
 }
 
@@ -778,21 +977,15 @@ void TestNoGL()
     gridSize[0] = width;
     gridSize[1] = height;
 
-    ciErrNum |= clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void *) &pbo_cl);
-    ciErrNum |= clSetKernelArg(ckKernel, 1, sizeof(unsigned int), &width);
-    ciErrNum |= clSetKernelArg(ckKernel, 2, sizeof(unsigned int), &height);
-    ciErrNum |= clSetKernelArg(ckKernel, 3, sizeof(float), &density);
-    ciErrNum |= clSetKernelArg(ckKernel, 4, sizeof(float), &brightness);
-    ciErrNum |= clSetKernelArg(ckKernel, 5, sizeof(float), &transferOffset);
-    ciErrNum |= clSetKernelArg(ckKernel, 6, sizeof(float), &transferScale);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    setOutputArgs(pbo_cl);
     
     // Warmup
     int iCycles = 20;
     size_t localSize[] = {LOCAL_SIZE_X,LOCAL_SIZE_Y};
     for (int i = 0; i < iCycles ; i++)
     {
-        ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 2, NULL, gridSize, localSize, 0, 0, 0);
-        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+        enqueueRender(localSize);
     }
     clFinish(cqCommandQueue);
     
@@ -800,8 +993,7 @@ void TestNoGL()
     shrDeltaT(0); 
     for (int i = 0; i < iCycles ; i++)
     {
-        ciErrNum |= clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 2, NULL, gridSize, localSize, 0, 0, 0);
-        oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+        enqueueRender(localSize);
     }
     clFinish(cqCommandQueue);
     
@@ -814,6 +1006,280 @@ void TestNoGL()
     Cleanup(EXIT_SUCCESS);
 }
 
+// Trilinear resampling of a volume of srcSize to dstSize voxels, standing in
+// for a larger data set
+//*****************************************************************************
+uchar* resampleVolume(const uchar* h_src, const size_t srcSize[3], const size_t dstSize[3])
+{
+    uchar* h_dst = (uchar*)malloc(dstSize[0] * dstSize[1] * dstSize[2]);
+    for (size_t z = 0; z < dstSize[2]; z++)
+    {
+        float fz = (float)z * (srcSize[2] - 1) / (float)(dstSize[2] - 1);
+        size_t z0 = (size_t)fz, z1 = (z0 + 1 < srcSize[2]) ? z0 + 1 : z0;
+        float wz = fz - z0;
+        for (size_t y = 0; y < dstSize[1]; y++)
+        {
+            float fy = (float)y * (srcSize[1] - 1) / (float)(dstSize[1] - 1);
+            size_t y0 = (size_t)fy, y1 = (y0 + 1 < srcSize[1]) ? y0 + 1 : y0;
+            float wy = fy - y0;
+            for (size_t x = 0; x < dstSize[0]; x++)
+            {
+                float fx = (float)x * (srcSize[0] - 1) / (float)(dstSize[0] - 1);
+                size_t x0 = (size_t)fx, x1 = (x0 + 1 < srcSize[0]) ? x0 + 1 : x0;
+                float wx = fx - x0;
+
+                #define SRC(i, j, k) (float)h_src[((k) * srcSize[1] + (j)) * srcSize[0] + (i)]
+                float c00 = SRC(x0, y0, z0) * (1.0f - wx) + SRC(x1, y0, z0) * wx;
+                float c10 = SRC(x0, y1, z0) * (1.0f - wx) + SRC(x1, y1, z0) * wx;
+                float c01 = SRC(x0, y0, z1) * (1.0f - wx) + SRC(x1, y0, z1) * wx;
+                float c11 = SRC(x0, y1, z1) * (1.0f - wx) + SRC(x1, y1, z1) * wx;
+                #undef SRC
+                float c0 = c00 * (1.0f - wy) + c10 * wy;
+                float c1 = c01 * (1.0f - wy) + c11 * wy;
+                h_dst[(z * dstSize[1] + y) * dstSize[0] + x] = (uchar)(c0 * (1.0f - wz) + c1 * wz + 0.5f);
+            }
+        }
+    }
+    return h_dst;
+}
+
+// Inverse view matrices (3x4, row major) of n cameras on a circle around the
+// y axis at distance 4, looking at the center of the volume
+//*****************************************************************************
+void orbitCameras(int n, std::vector<float>& cameras)
+{
+    cameras.resize(n * 12);
+    for (int v = 0; v < n; v++)
+    {
+        float angle = 2.0f * 3.14159265f * v / n;
+        float c = cosf(angle), s = sinf(angle);
+        float m[12] = {c, 0.0f, s, 4.0f * s,  0.0f, 1.0f, 0.0f, 0.0f,  -s, 0.0f, c, 4.0f * c};
+        memcpy(&cameras[v * 12], m, sizeof(m));
+    }
+}
+
+// Frame time of the back-to-front reference renderer against front-to-back
+// rendering with early ray termination only, and with empty space skipping
+// and adaptive steps as well, over a set of views of volumes of several
+// sizes. Errors are per color channel against the reference images.
+//*****************************************************************************
+void RunBenchmark(uchar *h_volume)
+{
+    const int iViews = 8;
+    const int iCycles = 4;
+    const char* modeNames[] = {"back-to-front", "ftb early exit", "ftb skip+adaptive"};
+    const bool modeFrontToBack[] = {false, true, true};
+    const bool modeSkipEmpty[] = {false, false, true};
+    size_t localSize[] = {LOCAL_SIZE_X,LOCAL_SIZE_Y};
+    size_t imageBytes = width * height * 4;
+
+    // kept for the whole run, the matrix writes below don't block
+    std::vector<float> views;
+    orbitCameras(iViews, views);
+
+    pbo_cl = clCreateBuffer(cxGPUContext, CL_MEM_WRITE_ONLY, imageBytes, NULL, &ciErrNum);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    gridSize[0] = shrRoundUp(LOCAL_SIZE_X,width);
+    gridSize[1] = shrRoundUp(LOCAL_SIZE_Y,height);
+    setOutputArgs(pbo_cl);
+
+    // the volume as loaded, then resampled to larger sizes; the second one is
+    // not a multiple of the brick size on any axis (unless -brick divides it),
+    // so the partial bricks at its far faces are covered too
+    const int iVolumes = 4;
+    size_t srcSize[3] = {volumeSize[0], volumeSize[1], volumeSize[2]};
+    size_t volumeDims[iVolumes][3] = {{0, 0, 0}, {100, 90, 70}, {128, 128, 128}, {256, 256, 256}};
+    bool frontToBackSaved = frontToBack, skipEmptySaved = skipEmpty;
+
+    shrLog("\nBenchmark: %u x %u pixels, %d views, brick size %u, threshold %.3f, max step scale %.1f\n\n",
+           width, height, iViews, brickSize, opacityThreshold, maxStepScale);
+    shrLog("%-14s %-20s %10s %10s %8s %9s %9s\n", "Volume", "Mode", "ms/frame", "MPixels/s", "Speedup", "MeanErr", "MaxErr");
+
+    for (int iVolume = 0; iVolume < iVolumes; iVolume++)
+    {
+        if (iVolume > 0)
+        {
+            uchar* h_resampled = resampleVolume(h_volume, srcSize, volumeDims[iVolume]);
+            releaseCLVolume();
+            for (int i = 0; i < 3; i++)
+            {
+                volumeSize[i] = volumeDims[iVolume][i];
+            }
+            initCLVolume(h_resampled);
+            free(h_resampled);
+        }
+
+        std::vector<unsigned char> reference(iViews * imageBytes);
+        std::vector<unsigned char> image(imageBytes);
+        double dReferenceTime = 0.0;
+        char cVolumeName[64];
+        sprintf(cVolumeName, "%ux%ux%u", (unsigned)volumeSize[0], (unsigned)volumeSize[1], (unsigned)volumeSize[2]);
+
+        for (int iMode = 0; iMode < 3; iMode++)
+        {
+            frontToBack = modeFrontToBack[iMode];
+            skipEmpty = modeSkipEmpty[iMode];
+
+            // one pass over the views for warmup, keeping the images
+            double dSumErr = 0.0;
+            int iMaxErr = 0;
+            for (int v = 0; v < iViews; v++)
+            {
+                ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, d_invViewMatrix, CL_FALSE, 0, 12 * sizeof(float), &views[v * 12], 0, 0, 0);
+                oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+                enqueueRender(localSize);
+                unsigned char* dst = (iMode == 0) ? &reference[v * imageBytes] : &image[0];
+                ciErrNum = clEnqueueReadBuffer(cqCommandQueue, pbo_cl, CL_TRUE, 0, imageBytes, dst, 0, 0, 0);
+                oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+
+                if (iMode > 0)
+                {
+                    const unsigned char* ref = &reference[v * imageBytes];
+                    for (size_t i = 0; i < imageBytes; i++)
+                    {
+                        int iErr = abs((int)image[i] - (int)ref[i]);
+                        dSumErr += iErr;
+                        iMaxErr = (iErr > iMaxErr) ? iErr : iMaxErr;
+                    }
+                }
+            }
+
+            shrDeltaT(0);
+            for (int i = 0; i < iCycles; i++)
+            {
+                for (int v = 0; v < iViews; v++)
+                {
+                    ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, d_invViewMatrix, CL_FALSE, 0, 12 * sizeof(float), &views[v * 12], 0, 0, 0);
+                    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+                    enqueueRender(localSize);
+                }
+            }
+            clFinish(cqCommandQueue);
+            double dAvgTime = shrDeltaT(0) / (double)(iCycles * iViews);
+            if (iMode == 0)
+            {
+                dReferenceTime = dAvgTime;
+            }
+
+            shrLog("%-14s %-20s %10.3f %10.2f %7.2fx %9.4f %9d\n", cVolumeName, modeNames[iMode],
+                   1.0e3 * dAvgTime, (1.0e-6 * width * height) / dAvgTime, dReferenceTime / dAvgTime,
+                   dSumErr / ((double)iViews * imageBytes), iMaxErr);
+        }
+    }
+
+    frontToBack = frontToBackSaved;
+    skipEmpty = skipEmptySaved;
+    shrLogEx(LOGBOTH | MASTER, 0, "oclVolumeRender, benchmark of %d volumes x %d render modes done\n", iVolumes, 3);
+
+    Cleanup(EXIT_SUCCESS);
+}
+
+// Per-frame callbacks of the headless renderer
+//*****************************************************************************
+struct HeadlessFrames
+{
+    bool bSave;
+    std::vector<unsigned char> ppm;
+};
+
+void renderHeadlessFrame(cl_mem output, const float *camera, void * /*userData*/)
+{
+    // the camera stays in the batch until the renderer is done, no need to block
+    ciErrNum = clEnqueueWriteBuffer(cqCommandQueue, d_invViewMatrix, CL_FALSE, 0, 12 * sizeof(float), camera, 0, 0, 0);
+    oclCheckErrorEX(ciErrNum, CL_SUCCESS, pCleanup);
+    setOutputArgs(output);
+    size_t localSize[] = {LOCAL_SIZE_X,LOCAL_SIZE_Y};
+    enqueueRender(localSize);
+}
+
+void encodeHeadlessFrame(int frame, const unsigned char *pixels, void *userData)
+{
+    HeadlessFrames *frames = (HeadlessFrames *)userData;
+    HeadlessRenderer::EncodePPM(pixels, width, height, frames->ppm);
+    if (frames->bSave)
+    {
+        char cFileName[64];
+        sprintf(cFileName, "volume_%04d.ppm", frame);
+        FILE *fp = fopen(cFileName, "wb");
+        oclCheckErrorEX(fp != NULL, true, pCleanup);
+        fwrite(&frames->ppm[0], 1, frames->ppm.size(), fp);
+        fclose(fp);
+    }
+}
+
+// Render a batch of cameras (-cameras=file with 12 floats per inverse view
+// matrix, or -frames views around the volume) to PPM images, through a pool
+// of -pool output buffers, first one frame at a time and then pipelined.
+// -width and -height set the image size, -save writes the images.
+//*****************************************************************************
+void RunHeadless(int argc, const char** argv)
+{
+    int iFrames = 64;
+    int iPoolSize = 3;
+    int n;
+    char* cCameraFile = NULL;
+    if (shrGetCmdLineArgumenti(argc, argv, "frames", &n) && n > 0) {
+        iFrames = n;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "pool", &n) && n > 0) {
+        iPoolSize = n;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "width", &n) && n > 0) {
+        width = n;
+    }
+    if (shrGetCmdLineArgumenti(argc, argv, "height", &n) && n > 0) {
+        height = n;
+    }
+    gridSize[0] = shrRoundUp(LOCAL_SIZE_X,width);
+    gridSize[1] = shrRoundUp(LOCAL_SIZE_Y,height);
+
+    std::vector<float> cameras;
+    if (shrGetCmdLineArgumentstr(argc, argv, "cameras", &cCameraFile))
+    {
+        bool bLoaded = HeadlessRenderer::LoadCameras(cCameraFile, 12, cameras);
+        free(cCameraFile);
+        oclCheckErrorEX(bLoaded, true, pCleanup);
+        iFrames = (int)(cameras.size() / 12);
+    }
+    else
+    {
+        orbitCameras(iFrames, cameras);
+    }
+
+    HeadlessFrames frames;
+    frames.bSave = shrCheckCmdLineFlag(argc, argv, "save") == shrTRUE;
+
+    shrLog("\nHeadless: %d frames of %u x %u pixels, %s, pool of %d buffers\n\n",
+           iFrames, width, height, frontToBack ? "front-to-back" : "back-to-front", iPoolSize);
+
+    double dSerialTime, dPipelinedTime;
+    {
+        HeadlessRenderer renderer(cxGPUContext, cdDevices[uiDeviceUsed], cqCommandQueue, width, height, iPoolSize);
+
+        // warmup without saving; both timed runs save the same images, so
+        // the speedup compares equal work
+        bool bSave = frames.bSave;
+        frames.bSave = false;
+        renderer.RenderBatch(&cameras[0], (iFrames < iPoolSize) ? iFrames : iPoolSize, 12, renderHeadlessFrame, encodeHeadlessFrame, &frames);
+        frames.bSave = bSave;
+
+        dSerialTime = renderer.RenderBatchSerial(&cameras[0], iFrames, 12, renderHeadlessFrame, encodeHeadlessFrame, &frames);
+        shrLog("serial:    %8.2f frames/s, %.3f ms/frame (encode %.3f ms, wait %.3f ms)\n",
+               iFrames / dSerialTime, 1.0e3 * dSerialTime / iFrames,
+               1.0e3 * renderer.GetEncodeTime() / iFrames, 1.0e3 * renderer.GetWaitTime() / iFrames);
+
+        dPipelinedTime = renderer.RenderBatch(&cameras[0], iFrames, 12, renderHeadlessFrame, encodeHeadlessFrame, &frames);
+        shrLog("pipelined: %8.2f frames/s, %.3f ms/frame (encode %.3f ms, wait %.3f ms)\n",
+               iFrames / dPipelinedTime, 1.0e3 * dPipelinedTime / iFrames,
+               1.0e3 * renderer.GetEncodeTime() / iFrames, 1.0e3 * renderer.GetWaitTime() / iFrames);
+    }
+
+    shrLogEx(LOGBOTH | MASTER, 0, "oclVolumeRender-headless, Throughput = %.2f frames/s, Speedup = %.2fx, Size = %u Pixels, Frames = %d, Pool = %d\n",
+             iFrames / dPipelinedTime, dSerialTime / dPipelinedTime, width * height, iFrames, iPoolSize);
+
+    Cleanup(EXIT_SUCCESS);
+}
+
 // Function to clean up and exit
 //*****************************************************************************
 void Cleanup(int iExitCode)
@@ -823,6 +1289,9 @@ void Cleanup(int iExitCode)
     if(cPathAndName)free(cPathAndName);
     if(cSourceCL)free(cSourceCL);
 	if(ckKernel)clReleaseKernel(ckKernel);  
+    if(ckKernelFrontToBack)clReleaseKernel(ckKernelFrontToBack);
+    if(ckBuildMinMax)clReleaseKernel(ckBuildMinMax);
+    if(ckClassifyBricks)clReleaseKernel(ckClassifyBricks);
     if(cpProgram)clReleaseProgram(cpProgram);
     if(volumeSamplerLinear)clReleaseSampler(volumeSamplerLinear);
     if(volumeSamplerNearest)clReleaseSampler(volumeSamplerNearest);
@@ -831,6 +1300,8 @@ void Cleanup(int iExitCode)
     if(d_transferFuncArray)clReleaseMemObject(d_transferFuncArray);
     if(pbo_cl)clReleaseMemObject(pbo_cl);    
     if(d_invViewMatrix)clReleaseMemObject(d_invViewMatrix);    
+    if(d_brickMinMax)clReleaseMemObject(d_brickMinMax);
+    if(d_brickOpacity)clReleaseMemObject(d_brickOpacity);
     if(cqCommandQueue)clReleaseCommandQueue(cqCommandQueue);
     if(cxGPUContext)clReleaseContext(cxGPUContext);
 	if(!bQATest) 
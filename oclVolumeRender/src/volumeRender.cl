@@ -12,6 +12,10 @@
 #define maxSteps 500
 #define tstep 0.01f
 
+// Front-to-back rendering: in bricks whose opacity per tstep is below
+// stepOpacity the step grows by stepOpacity / opacity, up to maxStepScale
+#define stepOpacity 0.05f
+
 // intersect ray with a box
 // http://www.siggraph.org/education/materials/HyperGraph/raytrace/rtinter3.htm
 
@@ -131,3 +135,193 @@ d_render(__global uint *d_output,
     }
 }
 
+
+
+int brickIndex(int4 brick, uint4 gridDims)
+{
+    return (brick.z * gridDims.y + brick.y) * gridDims.x + brick.x;
+}
+
+#ifdef IMAGE_SUPPORT
+// Volume sampler of the occupancy kernels: voxel coordinates, no filtering
+__constant sampler_t brickSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+// Min and max density of every brick of brickSize^3 voxels, one work-item
+// per brick. The voxels around the brick are included, because trilinear
+// filtering of a sample inside the brick reads them too.
+__kernel void
+d_buildMinMax(__global float2 *d_brickMinMax,
+              uint4 gridDims, uint brickSize,
+              __read_only image3d_t volume)
+{
+    int4 brick = (int4)(get_global_id(0), get_global_id(1), get_global_id(2), 0);
+    if (brick.x >= gridDims.x || brick.y >= gridDims.y || brick.z >= gridDims.z) return;
+
+    int4 first = brick * (int)brickSize - 1;
+    int4 last = first + (int)brickSize + 1;
+    float2 minMax = (float2)(1.0f, 0.0f);
+    for (int z = first.z; z <= last.z; z++) {
+        for (int y = first.y; y <= last.y; y++) {
+            for (int x = first.x; x <= last.x; x++) {
+                float sample = read_imagef(volume, brickSampler, (int4)(x, y, z, 0)).x;
+                minMax.x = min(minMax.x, sample);
+                minMax.y = max(minMax.y, sample);
+            }
+        }
+    }
+    d_brickMinMax[brickIndex(brick, gridDims)] = minMax;
+}
+
+// Largest opacity per tstep the transfer function gives any sample of the
+// brick, 0 for empty bricks. The transfer function is piecewise linear
+// between its texels, so the maximum over the brick's density range is at
+// an end of the range or at a texel center inside it.
+__kernel void
+d_classifyBricks(__global const float2 *d_brickMinMax,
+                 __global float *d_brickOpacity,
+                 uint numBricks, uint transferWidth,
+                 float density, float transferOffset, float transferScale,
+                 __read_only image2d_t transferFunc,
+                 sampler_t transferFuncSampler)
+{
+    uint i = get_global_id(0);
+    if (i >= numBricks) return;
+
+    float2 minMax = d_brickMinMax[i];
+    float lo = clamp((minMax.x - transferOffset) * transferScale, 0.0f, 1.0f);
+    float hi = clamp((minMax.y - transferOffset) * transferScale, 0.0f, 1.0f);
+    if (lo > hi) {
+        float swap = lo; lo = hi; hi = swap;
+    }
+
+    float alpha = max(read_imagef(transferFunc, transferFuncSampler, (float2)(lo, 0.5f)).w,
+                      read_imagef(transferFunc, transferFuncSampler, (float2)(hi, 0.5f)).w);
+    for (uint k = 0; k < transferWidth; k++) {
+        float pos = (k + 0.5f) / transferWidth;
+        if (pos > lo && pos < hi) {
+            alpha = max(alpha, read_imagef(transferFunc, transferFuncSampler, (float2)(pos, 0.5f)).w);
+        }
+    }
+    d_brickOpacity[i] = alpha * density;
+}
+#endif
+
+// Same image as d_render, marching front to back instead:
+//  - the ray stops once its accumulated opacity reaches opacityThreshold
+//  - with skipEmpty, bricks of zero opacity (see d_classifyBricks) are
+//    crossed in one step, and the step grows in bricks of low opacity, with
+//    the sample opacity corrected for the longer step
+// The arguments up to the images and samplers are those of d_render.
+__kernel void
+d_renderFrontToBack(__global uint *d_output,
+         uint imageW, uint imageH,
+         float density, float brightness,
+         float transferOffset, float transferScale,
+         __constant float* invViewMatrix,
+ #ifdef IMAGE_SUPPORT
+          __read_only image3d_t volume,
+          __read_only image2d_t transferFunc,
+          sampler_t volumeSampler,
+          sampler_t transferFuncSampler,
+ #endif
+         __global const float *d_brickOpacity,
+         uint4 gridDims,
+         float4 brickScale,     // volumeSize / brickSize: bricks per unit of [0, 1] coordinates
+         float opacityThreshold,
+         float maxStepScale,
+         uint skipEmpty
+         )
+{
+    uint x = get_global_id(0);
+    uint y = get_global_id(1);
+
+    float u = (x / (float) imageW)*2.0f-1.0f;
+    float v = (y / (float) imageH)*2.0f-1.0f;
+
+    float4 boxMin = (float4)(-1.0f, -1.0f, -1.0f,1.0f);
+    float4 boxMax = (float4)(1.0f, 1.0f, 1.0f,1.0f);
+
+    // calculate eye ray in world space
+    float4 eyeRay_o;
+    float4 eyeRay_d;
+
+    eyeRay_o = (float4)(invViewMatrix[3], invViewMatrix[7], invViewMatrix[11], 1.0f);
+
+    float4 temp = normalize(((float4)(u, v, -2.0f,0.0f)));
+    eyeRay_d.x = dot(temp, ((float4)(invViewMatrix[0],invViewMatrix[1],invViewMatrix[2],invViewMatrix[3])));
+    eyeRay_d.y = dot(temp, ((float4)(invViewMatrix[4],invViewMatrix[5],invViewMatrix[6],invViewMatrix[7])));
+    eyeRay_d.z = dot(temp, ((float4)(invViewMatrix[8],invViewMatrix[9],invViewMatrix[10],invViewMatrix[11])));
+    eyeRay_d.w = 0.0f;
+
+    // find intersection with box
+    float tnear, tfar;
+    int hit = intersectBox(eyeRay_o, eyeRay_d, boxMin, boxMax, &tnear, &tfar);
+    if (!hit) {
+        if ((x < imageW) && (y < imageH)) {
+            uint i =(y * imageW) + x;
+            d_output[i] = 0;
+        }
+        return;
+    }
+    if (tnear < 0.0f) tnear = 0.0f;     // clamp to near plane
+
+    // march along ray from front to back: the color is accumulated weighted
+    // by the transmittance of the samples in front of it
+    int4 gridMax = (int4)(gridDims.x - 1, gridDims.y - 1, gridDims.z - 1, 0);
+    float4 acc = (float4)(0.0f,0.0f,0.0f,0.0f);
+    float transmittance = 1.0f;
+    float t = tnear;
+
+    for(uint i=0; i<maxSteps && t < tfar; i++) {
+        float4 pos = eyeRay_o + eyeRay_d*t;
+        pos = pos*0.5f+0.5f;    // map position to [0, 1] coordinates
+
+        float step = tstep;
+        if (skipEmpty) {
+            // the last brick of an axis may be partial, when the volume
+            // size isn't a multiple of the brick size
+            int4 brick = clamp(convert_int4_rtn(pos * brickScale), (int4)(0), gridMax);
+            float opacity = d_brickOpacity[brickIndex(brick, gridDims)];
+            if (opacity <= 0.0f) {
+                // jump to where the ray leaves the brick
+                float4 brickMin = min(convert_float4(brick) / brickScale, 1.0f)*2.0f-1.0f;
+                float4 brickMax = min(convert_float4(brick + 1) / brickScale, 1.0f)*2.0f-1.0f;
+                brickMin.w = brickMax.w = 1.0f;
+                float bnear, bfar;
+                intersectBox(eyeRay_o, eyeRay_d, brickMin, brickMax, &bnear, &bfar);
+                t = max(bfar, t) + 0.01f * tstep;
+                continue;
+            }
+            step = tstep * clamp(stepOpacity / opacity, 1.0f, maxStepScale);
+        }
+
+        // read from 3D texture
+#ifdef IMAGE_SUPPORT
+        float4 sample = read_imagef(volume, volumeSampler, pos);
+
+        // lookup in transfer function texture
+        float2 transfer_pos = (float2)((sample.x-transferOffset)*transferScale, 0.5f);
+        float4 col = read_imagef(transferFunc, transferFuncSampler, transfer_pos);
+#else
+        float4 col = (float4)(pos.x,pos.y,pos.z,.25f);
+#endif
+
+        // accumulate result; a longer step covers more material
+        float a = clamp(col.w*density, 0.0f, 1.0f);
+        if (step > tstep) a = 1.0f - pow(1.0f - a, step / tstep);
+        acc += col * (a * transmittance);
+        transmittance *= 1.0f - a;
+
+        // early ray termination
+        if (1.0f - transmittance >= opacityThreshold) break;
+
+        t += step;
+    }
+    acc *= brightness;
+
+    if ((x < imageW) && (y < imageH)) {
+        // write output color
+        uint i =(y * imageW) + x;
+        d_output[i] = rgbaFloatToInt(acc);
+    }
+}
@@ -0,0 +1,106 @@
+// Microbenchmarks for the ceilings of the roofline model.
+// Every kernel does as little as possible besides the operation it measures;
+// results are stored so the compiler cannot remove the work.
+
+
+// Global memory: read, write and copy for each vector width of float.
+// The read kernel walks the buffer with a grid stride, so a modest number
+// of work-items covers a buffer of any size and each of them writes
+// only one result.
+#define GLOBAL_KERNELS(T)                                                   \
+__kernel void read_##T (const __global T* src, __global T* dst, uint n)     \
+{                                                                           \
+    size_t gid = get_global_id(0);                                          \
+    size_t stride = get_global_size(0);                                     \
+    T acc = 0;                                                              \
+    for(size_t i = gid; i < n; i += stride)                                 \
+    {                                                                       \
+        acc += src[i];                                                      \
+    }                                                                       \
+    dst[gid] = acc;                                                         \
+}                                                                           \
+                                                                            \
+__kernel void write_##T (__global T* dst, float value)                      \
+{                                                                           \
+    dst[get_global_id(0)] = (T)(value);                                     \
+}                                                                           \
+                                                                            \
+__kernel void copy_##T (const __global T* src, __global T* dst)             \
+{                                                                           \
+    size_t i = get_global_id(0);                                            \
+    dst[i] = src[i];                                                        \
+}
+
+GLOBAL_KERNELS(float)
+GLOBAL_KERNELS(float2)
+GLOBAL_KERNELS(float4)
+GLOBAL_KERNELS(float8)
+GLOBAL_KERNELS(float16)
+
+
+// Local memory: every work-item reads LOCAL_ITERS float4 values of the
+// work-group's tile, each time at a different position (mask is the
+// local size minus one, a power of two).
+#define LOCAL_ITERS 1024
+
+__kernel void local_read (__global float4* dst, __local float4* tile, uint mask)
+{
+    uint lid = get_local_id(0);
+    tile[lid] = (float4)((float)lid);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    float4 acc = 0;
+    for(uint i = 0; i < LOCAL_ITERS; ++i)
+    {
+        acc += tile[(lid + i) & mask];
+    }
+    dst[get_global_id(0)] = acc;
+}
+
+
+// Atomics: all work-items on one counter, and spread over mask + 1
+// counters 64 bytes apart, so no two of them share a cache line.
+__kernel void atomic_contended (__global int* counters, uint iters)
+{
+    for(uint i = 0; i < iters; ++i)
+    {
+        atomic_inc(counters);
+    }
+}
+
+__kernel void atomic_spread (__global int* counters, uint mask, uint iters)
+{
+    __global int* counter = counters + (get_global_id(0) & mask)*16;
+    for(uint i = 0; i < iters; ++i)
+    {
+        atomic_inc(counter);
+    }
+}
+
+
+// Arithmetic: eight independent fma chains per work-item, enough to hide
+// the latency of the FMA units. Each fma counts as two FLOPs.
+#define FMA_ITERS 256
+
+#define FMA_KERNEL(T)                                                       \
+__kernel void fma_##T (__global T* out, T a, T b)                           \
+{                                                                           \
+    T x0 = get_global_id(0);                                                \
+    T x1 = x0 + 1, x2 = x0 + 2, x3 = x0 + 3;                                \
+    T x4 = x0 + 4, x5 = x0 + 5, x6 = x0 + 6, x7 = x0 + 7;                   \
+    for(int i = 0; i < FMA_ITERS; ++i)                                      \
+    {                                                                       \
+        x0 = fma(x0, a, b); x1 = fma(x1, a, b);                             \
+        x2 = fma(x2, a, b); x3 = fma(x3, a, b);                             \
+        x4 = fma(x4, a, b); x5 = fma(x5, a, b);                             \
+        x6 = fma(x6, a, b); x7 = fma(x7, a, b);                             \
+    }                                                                       \
+    out[get_global_id(0)] = x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7;          \
+}
+
+FMA_KERNEL(float)
+
+#ifdef cl_khr_fp64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+FMA_KERNEL(double)
+#endif
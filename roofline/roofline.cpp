@@ -0,0 +1,683 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <CL/cl.h>
+
+#include "basic.hpp"
+#include "oclobject.hpp"
+
+
+using namespace std;
+
+
+// Kernels of the other samples are loaded from their source trees; the path
+// is relative to the build directory next to this file, like ../roofline.cl.
+const wstring SAMPLES_DIR = L"../../";
+
+const char* const VECTOR_TYPES[] = { "float", "float2", "float4", "float8", "float16" };
+const size_t NUM_VECTOR_TYPES = sizeof(VECTOR_TYPES)/sizeof(VECTOR_TYPES[0]);
+
+// Have to match the defines in roofline.cl
+const size_t LOCAL_ITERS = 1024;
+const size_t FMA_ITERS = 256;
+const cl_uint ATOMIC_ITERS = 256;
+const cl_uint ATOMIC_COUNTERS = 1024;
+
+
+struct Settings
+{
+    string platform;
+    string device_type;
+    string device;
+    size_t buffer_bytes;        // size of each buffer of the bandwidth tests
+    int runs;                   // timed runs per kernel, the best one counts
+};
+
+
+// Peak rates of the device; the roofline is min(peak FLOPS, AI * bandwidth)
+struct Ceilings
+{
+    double read_gbs[NUM_VECTOR_TYPES];
+    double write_gbs[NUM_VECTOR_TYPES];
+    double copy_gbs[NUM_VECTOR_TYPES];    // read + write
+    double bandwidth_gbs;                 // best copy, the slope of the roofline
+    double local_gbs;
+    double atomic_contended_gops;
+    double atomic_spread_gops;
+    double fp32_gflops;
+    double fp64_gflops;                   // 0 without cl_khr_fp64
+};
+
+
+// One sample kernel run. Bytes are the compulsory global memory traffic:
+// every input read and every output written once.
+struct KernelResult
+{
+    string name;
+    double flops;
+    double bytes;
+    double seconds;
+    bool fp64;
+};
+
+
+// Buffer released when it leaves the scope
+struct Buffer
+{
+    cl_mem mem;
+
+    Buffer (OpenCLBasic& oclobjects, cl_mem_flags flags, size_t size, void* host = 0)
+    {
+        cl_int err = CL_SUCCESS;
+        mem = clCreateBuffer(oclobjects.context, flags, size, host, &err);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+
+    ~Buffer ()
+    {
+        try
+        {
+            cl_int err = clReleaseMemObject(mem);
+            SAMPLE_CHECK_ERRORS(err);
+        }
+        catch(...)
+        {
+            destructorException();
+        }
+    }
+
+private:
+
+    Buffer (const Buffer&);
+    Buffer& operator= (const Buffer&);
+};
+
+
+template <typename T>
+void setArg (cl_kernel kernel, cl_uint index, const T& value)
+{
+    cl_int err = clSetKernelArg(kernel, index, sizeof(T), &value);
+    SAMPLE_CHECK_ERRORS(err);
+}
+
+void setLocalArg (cl_kernel kernel, cl_uint index, size_t size)
+{
+    cl_int err = clSetKernelArg(kernel, index, size, 0);
+    SAMPLE_CHECK_ERRORS(err);
+}
+
+
+// Best execution time of the kernel in seconds, from profiling events;
+// one untimed run goes first to warm up caches and the JIT.
+double bestKernelTime (
+    OpenCLBasic& oclobjects,
+    cl_kernel kernel,
+    cl_uint dims,
+    const size_t* global_size,
+    const size_t* local_size,
+    int runs
+)
+{
+    double best = 0;
+    for(int run = 0; run <= runs; ++run)
+    {
+        cl_event event = 0;
+        cl_int err = clEnqueueNDRangeKernel(oclobjects.queue, kernel, dims, 0, global_size, local_size, 0, 0, &event);
+        SAMPLE_CHECK_ERRORS(err);
+        err = clWaitForEvents(1, &event);
+        SAMPLE_CHECK_ERRORS(err);
+
+        double time = eventExecutionTime(event);
+        err = clReleaseEvent(event);
+        SAMPLE_CHECK_ERRORS(err);
+
+        if(run > 0 && (best == 0 || time < best))
+        {
+            best = time;
+        }
+    }
+    return best;
+}
+
+
+cl_uint computeUnits (cl_device_id device)
+{
+    cl_uint units = 0;
+    cl_int err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(units), &units, 0);
+    SAMPLE_CHECK_ERRORS(err);
+    return units;
+}
+
+bool hasExtension (cl_device_id device, const string& extension)
+{
+    size_t length = 0;
+    cl_int err = clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, 0, &length);
+    SAMPLE_CHECK_ERRORS(err);
+    vector<char> extensions(length + 1, 0);
+    err = clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, length, &extensions[0], 0);
+    SAMPLE_CHECK_ERRORS(err);
+
+    string list = " " + string(&extensions[0]) + " ";
+    return list.find(" " + extension + " ") != string::npos;
+}
+
+// Largest power of two work-group size up to limit the kernel can run with
+size_t powerOfTwoLocalSize (cl_kernel kernel, cl_device_id device, size_t limit)
+{
+    size_t max_size = min(kernelMaxWorkGroupSize(kernel, device), limit);
+    size_t size = 1;
+    while(size*2 <= max_size)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
+// Source of a kernel file of another sample, with preamble in front of it
+// for the defines the host code of that sample would pass
+string sampleSource (const wstring& file_name, const string& preamble = "")
+{
+    vector<char> text;
+    readProgramFile(SAMPLES_DIR + file_name, text);
+    return preamble + &text[0];
+}
+
+
+void measureCeilings (
+    OpenCLBasic& oclobjects,
+    OpenCLProgramMultipleKernels& program,
+    const Settings& settings,
+    Ceilings& ceilings
+)
+{
+    cl_uint units = computeUnits(oclobjects.device);
+    size_t bytes = settings.buffer_bytes;
+
+    vector<float> ones(bytes/sizeof(float), 1.0f);
+    Buffer src(oclobjects, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, &ones[0]);
+    Buffer dst(oclobjects, CL_MEM_READ_WRITE, bytes);
+
+    // Global memory, by vector width
+    ceilings.bandwidth_gbs = 0;
+    for(size_t t = 0; t < NUM_VECTOR_TYPES; ++t)
+    {
+        string type = VECTOR_TYPES[t];
+        size_t element_size = sizeof(float)*str_to<size_t>(type.size() > 5 ? type.substr(5) : "1");
+        size_t n = bytes/element_size;
+
+        cl_kernel read = program["read_" + type];
+        setArg(read, 0, src.mem);
+        setArg(read, 1, dst.mem);
+        setArg(read, 2, cl_uint(n));
+        size_t read_items = min(n, size_t(units)*4096);
+        ceilings.read_gbs[t] = bytes/bestKernelTime(oclobjects, read, 1, &read_items, 0, settings.runs)*1e-9;
+
+        cl_kernel write = program["write_" + type];
+        setArg(write, 0, dst.mem);
+        setArg(write, 1, 1.0f);
+        ceilings.write_gbs[t] = bytes/bestKernelTime(oclobjects, write, 1, &n, 0, settings.runs)*1e-9;
+
+        cl_kernel copy = program["copy_" + type];
+        setArg(copy, 0, src.mem);
+        setArg(copy, 1, dst.mem);
+        ceilings.copy_gbs[t] = 2*bytes/bestKernelTime(oclobjects, copy, 1, &n, 0, settings.runs)*1e-9;
+
+        ceilings.bandwidth_gbs = max(ceilings.bandwidth_gbs, ceilings.copy_gbs[t]);
+    }
+
+    // Local memory
+    {
+        cl_kernel kernel = program["local_read"];
+        size_t local_size = powerOfTwoLocalSize(kernel, oclobjects.device, 256);
+        size_t global_size = local_size*units*16;
+        Buffer out(oclobjects, CL_MEM_WRITE_ONLY, global_size*4*sizeof(float));
+
+        setArg(kernel, 0, out.mem);
+        setLocalArg(kernel, 1, local_size*4*sizeof(float));
+        setArg(kernel, 2, cl_uint(local_size - 1));
+        double time = bestKernelTime(oclobjects, kernel, 1, &global_size, &local_size, settings.runs);
+        ceilings.local_gbs = double(global_size)*LOCAL_ITERS*4*sizeof(float)/time*1e-9;
+    }
+
+    // Atomics
+    {
+        vector<cl_int> zeros(ATOMIC_COUNTERS*16, 0);
+        Buffer counters(oclobjects, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, zeros.size()*sizeof(cl_int), &zeros[0]);
+        size_t global_size = size_t(units)*1024;
+        double ops = double(global_size)*ATOMIC_ITERS;
+
+        cl_kernel contended = program["atomic_contended"];
+        setArg(contended, 0, counters.mem);
+        setArg(contended, 1, ATOMIC_ITERS);
+        ceilings.atomic_contended_gops = ops/bestKernelTime(oclobjects, contended, 1, &global_size, 0, settings.runs)*1e-9;
+
+        cl_kernel spread = program["atomic_spread"];
+        setArg(spread, 0, counters.mem);
+        setArg(spread, 1, cl_uint(ATOMIC_COUNTERS - 1));
+        setArg(spread, 2, ATOMIC_ITERS);
+        ceilings.atomic_spread_gops = ops/bestKernelTime(oclobjects, spread, 1, &global_size, 0, settings.runs)*1e-9;
+    }
+
+    // Arithmetic
+    {
+        size_t global_size = size_t(units)*16384;
+        double flops = double(global_size)*FMA_ITERS*8*2;
+        Buffer out(oclobjects, CL_MEM_WRITE_ONLY, global_size*sizeof(cl_double));
+
+        cl_kernel fp32 = program["fma_float"];
+        setArg(fp32, 0, out.mem);
+        setArg(fp32, 1, 0.999f);
+        setArg(fp32, 2, 0.5f);
+        ceilings.fp32_gflops = flops/bestKernelTime(oclobjects, fp32, 1, &global_size, 0, settings.runs)*1e-9;
+
+        ceilings.fp64_gflops = 0;
+        if(hasExtension(oclobjects.device, "cl_khr_fp64"))
+        {
+            cl_kernel fp64 = program["fma_double"];
+            setArg(fp64, 0, out.mem);
+            setArg(fp64, 1, 0.999);
+            setArg(fp64, 2, 0.5);
+            ceilings.fp64_gflops = flops/bestKernelTime(oclobjects, fp64, 1, &global_size, 0, settings.runs)*1e-9;
+        }
+    }
+}
+
+
+void printCeilings (const Ceilings& ceilings)
+{
+    cout << "\nGlobal memory bandwidth, GB/s:\n";
+    cout << setw(10) << "type" << setw(12) << "read" << setw(12) << "write" << setw(12) << "copy" << "\n";
+    cout << fixed << setprecision(1);
+    for(size_t t = 0; t < NUM_VECTOR_TYPES; ++t)
+    {
+        cout
+            << setw(10) << VECTOR_TYPES[t]
+            << setw(12) << ceilings.read_gbs[t]
+            << setw(12) << ceilings.write_gbs[t]
+            << setw(12) << ceilings.copy_gbs[t] << "\n";
+    }
+
+    cout
+        << "\nLocal memory read bandwidth: " << ceilings.local_gbs << " GB/s\n"
+        << "Atomic increments: " << setprecision(3)
+        << ceilings.atomic_contended_gops << " Gops/s on one counter, "
+        << ceilings.atomic_spread_gops << " Gops/s on " << ATOMIC_COUNTERS << " counters\n"
+        << setprecision(1)
+        << "FP32 FMA: " << ceilings.fp32_gflops << " GFLOPS\n"
+        << "FP64 FMA: ";
+    if(ceilings.fp64_gflops > 0)
+    {
+        cout << ceilings.fp64_gflops << " GFLOPS\n";
+    }
+    else
+    {
+        cout << "not supported\n";
+    }
+
+    cout
+        << "\nRoofline: " << ceilings.bandwidth_gbs << " GB/s, "
+        << ceilings.fp32_gflops << " GFLOPS, ridge point at "
+        << setprecision(2) << ceilings.fp32_gflops/ceilings.bandwidth_gbs << " FLOP/byte\n";
+    cout.unsetf(ios::fixed);
+}
+
+
+// ---------------------------------------------------------------------------
+// Kernels of the other samples, launched the way their host code does it
+// with inputs of about settings.buffer_bytes per array.
+
+void runVectorAdd (OpenCLBasic& oclobjects, const Settings& settings, vector<KernelResult>& results)
+{
+    OpenCLProgramMultipleKernels program(oclobjects, L"", sampleSource(L"oclVectorAdd/src/VectorAdd.cl"));
+
+    size_t n = settings.buffer_bytes/sizeof(float);
+    Buffer a(oclobjects, CL_MEM_READ_ONLY, n*sizeof(float));
+    Buffer b(oclobjects, CL_MEM_READ_ONLY, n*sizeof(float));
+    Buffer c(oclobjects, CL_MEM_WRITE_ONLY, n*sizeof(float));
+
+    cl_kernel kernel = program["VectorAdd"];
+    setArg(kernel, 0, a.mem);
+    setArg(kernel, 1, b.mem);
+    setArg(kernel, 2, c.mem);
+    setArg(kernel, 3, cl_int(n));
+
+    KernelResult result = { "oclVectorAdd VectorAdd", double(n), 12.0*n, 0, false };
+    result.seconds = bestKernelTime(oclobjects, kernel, 1, &n, 0, settings.runs);
+    results.push_back(result);
+}
+
+void runDotProduct (OpenCLBasic& oclobjects, const Settings& settings, vector<KernelResult>& results)
+{
+    OpenCLProgramMultipleKernels program(oclobjects, L"", sampleSource(L"oclDotProduct/src/DotProduct.cl"));
+
+    // Every work-item multiplies two vectors of four floats
+    size_t n = settings.buffer_bytes/(4*sizeof(float));
+    Buffer a(oclobjects, CL_MEM_READ_ONLY, 4*n*sizeof(float));
+    Buffer b(oclobjects, CL_MEM_READ_ONLY, 4*n*sizeof(float));
+    Buffer c(oclobjects, CL_MEM_WRITE_ONLY, n*sizeof(float));
+
+    cl_kernel kernel = program["DotProduct"];
+    setArg(kernel, 0, a.mem);
+    setArg(kernel, 1, b.mem);
+    setArg(kernel, 2, c.mem);
+    setArg(kernel, 3, cl_int(n));
+
+    KernelResult result = { "oclDotProduct DotProduct", 7.0*n, 36.0*n, 0, false };
+    result.seconds = bestKernelTime(oclobjects, kernel, 1, &n, 0, settings.runs);
+    results.push_back(result);
+}
+
+void runMatVecMul (OpenCLBasic& oclobjects, const Settings& settings, vector<KernelResult>& results)
+{
+    OpenCLProgramMultipleKernels program(oclobjects, L"", sampleSource(L"oclMatVecMul/src/oclMatVecMul.cl"));
+
+    size_t width = 4096;
+    size_t height = settings.buffer_bytes/(width*sizeof(float));
+    Buffer m(oclobjects, CL_MEM_READ_ONLY, width*height*sizeof(float));
+    Buffer v(oclobjects, CL_MEM_READ_ONLY, width*sizeof(float));
+    Buffer w(oclobjects, CL_MEM_WRITE_ONLY, height*sizeof(float));
+
+    const char* names[] = { "MatVecMulUncoalesced1", "MatVecMulCoalesced1", "MatVecMulCoalesced3" };
+    for(size_t i = 0; i < sizeof(names)/sizeof(names[0]); ++i)
+    {
+        cl_kernel kernel = program[names[i]];
+        size_t local_size = powerOfTwoLocalSize(kernel, oclobjects.device, 256);
+        size_t global_size = local_size*min(height, size_t(computeUnits(oclobjects.device))*8);
+
+        setArg(kernel, 0, m.mem);
+        setArg(kernel, 1, v.mem);
+        setArg(kernel, 2, cl_uint(width));
+        setArg(kernel, 3, cl_uint(height));
+        setArg(kernel, 4, w.mem);
+        if(i > 0)
+        {
+            setLocalArg(kernel, 5, local_size*sizeof(float));
+        }
+
+        KernelResult result = {
+            string("oclMatVecMul ") + names[i],
+            2.0*width*height,
+            sizeof(float)*(double(width)*height + width + height),
+            0,
+            false
+        };
+        result.seconds = bestKernelTime(oclobjects, kernel, 1, &global_size, &local_size, settings.runs);
+        results.push_back(result);
+    }
+}
+
+void runTranspose (OpenCLBasic& oclobjects, const Settings& settings, vector<KernelResult>& results)
+{
+    OpenCLProgramMultipleKernels program(oclobjects, L"", sampleSource(L"oclTranspose/src/transpose.cl"));
+
+    // Same as BLOCK_DIM in transpose.cl
+    const size_t block_dim = 16;
+    size_t side = 256;
+    while(2*side*2*side*sizeof(float) <= settings.buffer_bytes)
+    {
+        side *= 2;
+    }
+
+    Buffer in(oclobjects, CL_MEM_READ_ONLY, side*side*sizeof(float));
+    Buffer out(oclobjects, CL_MEM_WRITE_ONLY, side*side*sizeof(float));
+
+    const char* names[] = { "simple_copy", "transpose_naive", "transpose" };
+    for(size_t i = 0; i < sizeof(names)/sizeof(names[0]); ++i)
+    {
+        cl_kernel kernel = program[names[i]];
+        setArg(kernel, 0, out.mem);
+        setArg(kernel, 1, in.mem);
+        setArg(kernel, 2, cl_int(0));
+        setArg(kernel, 3, cl_int(side));
+        setArg(kernel, 4, cl_int(side));
+        if(string(names[i]) == "transpose")
+        {
+            setLocalArg(kernel, 5, (block_dim + 1)*block_dim*sizeof(float));
+        }
+
+        size_t global_size[] = { side, side };
+        size_t local_size[] = { block_dim, block_dim };
+        KernelResult result = {
+            string("oclTranspose ") + names[i],
+            0,
+            2.0*side*side*sizeof(float),
+            0,
+            false
+        };
+        result.seconds = bestKernelTime(oclobjects, kernel, 2, global_size, local_size, settings.runs);
+        results.push_back(result);
+    }
+}
+
+void runReduction (OpenCLBasic& oclobjects, const Settings& settings, vector<KernelResult>& results)
+{
+    // The sample puts the type and block size in front of the source
+    const size_t block_size = 256;
+    const size_t groups = 64;
+    OpenCLProgramMultipleKernels program(
+        oclobjects,
+        L"",
+        sampleSource(
+            L"oclReduction/src/oclReduction_kernel.cl",
+            "#define T float\n#define blockSize " + to_str(block_size) + "\n#define nIsPow2 1\n"
+        )
+    );
+
+    size_t n = settings.buffer_bytes/sizeof(float);
+    Buffer in(oclobjects, CL_MEM_READ_ONLY, n*sizeof(float));
+    Buffer out(oclobjects, CL_MEM_WRITE_ONLY, groups*sizeof(float));
+
+    cl_kernel kernel = program["reduce6"];
+    setArg(kernel, 0, in.mem);
+    setArg(kernel, 1, out.mem);
+    setArg(kernel, 2, cl_uint(n));
+    setLocalArg(kernel, 3, block_size*sizeof(float));
+
+    size_t global_size = groups*block_size;
+    KernelResult result = { "oclReduction reduce6", double(n), 4.0*n, 0, false };
+    result.seconds = bestKernelTime(oclobjects, kernel, 1, &global_size, &block_size, settings.runs);
+    results.push_back(result);
+}
+
+void runNbody (OpenCLBasic& oclobjects, const Settings& settings, vector<KernelResult>& results)
+{
+    // Single precision, as oclBodySystemOpencl builds it by default
+    OpenCLProgramMultipleKernels program(
+        oclobjects,
+        L"",
+        sampleSource(
+            L"oclNbody/src/oclNbodyKernel.cl",
+            "#define REAL float\n#define REAL4 float4\n#define REAL3 float4\n"
+            "#define ZERO3 {0.0f, 0.0f, 0.0f, 0.0f}\n"
+        ),
+        "-cl-fast-relaxed-math"
+    );
+
+    const size_t bodies = 16384;
+    const double flops_per_interaction = 20;
+    Buffer old_pos(oclobjects, CL_MEM_READ_ONLY, bodies*4*sizeof(float));
+    Buffer old_vel(oclobjects, CL_MEM_READ_ONLY, bodies*4*sizeof(float));
+    Buffer new_pos(oclobjects, CL_MEM_WRITE_ONLY, bodies*4*sizeof(float));
+    Buffer new_vel(oclobjects, CL_MEM_WRITE_ONLY, bodies*4*sizeof(float));
+
+    cl_kernel kernel = program["integrateBodies_noMT"];
+    size_t local_size[] = { powerOfTwoLocalSize(kernel, oclobjects.device, 256), 1 };
+    size_t global_size[] = { bodies, 1 };
+
+    setArg(kernel, 0, new_pos.mem);
+    setArg(kernel, 1, new_vel.mem);
+    setArg(kernel, 2, old_pos.mem);
+    setArg(kernel, 3, old_vel.mem);
+    setArg(kernel, 4, 0.016f);
+    setArg(kernel, 5, 1.0f);
+    setArg(kernel, 6, 0.01f);
+    setArg(kernel, 7, cl_int(bodies));
+    setLocalArg(kernel, 8, local_size[0]*4*sizeof(float));
+
+    KernelResult result = {
+        "oclNbody integrateBodies_noMT",
+        flops_per_interaction*bodies*bodies,
+        4.0*bodies*4*sizeof(float),
+        0,
+        false
+    };
+    result.seconds = bestKernelTime(oclobjects, kernel, 2, global_size, local_size, max(settings.runs/2, 1));
+    results.push_back(result);
+}
+
+
+// Achieved rates of the kernels against the roofline: the fraction of the
+// time the kernel would take if it ran at the ceiling that bounds it.
+void printRoofline (const Ceilings& ceilings, const vector<KernelResult>& results)
+{
+    cout
+        << "\n" << setw(36) << left << "kernel" << right
+        << setw(12) << "FLOP/byte"
+        << setw(10) << "GFLOPS"
+        << setw(10) << "GB/s"
+        << setw(10) << "bound"
+        << setw(14) << "% roofline" << "\n";
+
+    cout << fixed;
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const KernelResult& r = results[i];
+        double peak_gflops = r.fp64 ? ceilings.fp64_gflops : ceilings.fp32_gflops;
+        double intensity = r.flops/r.bytes;
+        double ridge = peak_gflops/ceilings.bandwidth_gbs;
+
+        double compute_time = r.flops/(peak_gflops*1e9);
+        double memory_time = r.bytes/(ceilings.bandwidth_gbs*1e9);
+
+        cout
+            << setw(36) << left << r.name << right
+            << setw(12) << setprecision(3) << intensity
+            << setw(10) << setprecision(1) << r.flops/r.seconds*1e-9
+            << setw(10) << r.bytes/r.seconds*1e-9
+            << setw(10) << (intensity < ridge ? "memory" : "compute")
+            << setw(14) << 100*max(compute_time, memory_time)/r.seconds << "\n";
+    }
+    cout.unsetf(ios::fixed);
+}
+
+
+void help (const char* program_name)
+{
+    cout
+        << "Usage: " << program_name << " [-p platform] [-t device type] [-d device] [-s buffer MB] [-r runs]\n"
+        << "  -p  platform name or index, 0 by default\n"
+        << "  -t  device type: cpu (default), gpu, acc or all\n"
+        << "  -d  device name or index among the devices of the type, 0 by default\n"
+        << "  -s  size of the buffers of the bandwidth tests in MB, 64 by default\n"
+        << "  -r  timed runs of every kernel, the best one counts; 5 by default\n";
+}
+
+
+int main (int argc, const char** argv)
+{
+    try
+    {
+        Settings settings = { "0", "cpu", "0", 64 << 20, 5 };
+
+        for(int i = 1; i < argc; ++i)
+        {
+            string option = argv[i];
+            if(option == "-h" || option == "--help" || i + 1 == argc)
+            {
+                help(argv[0]);
+                return option == "-h" || option == "--help" ? 0 : EXIT_FAILURE;
+            }
+
+            string value = argv[++i];
+            if(option == "-p") settings.platform = value;
+            else if(option == "-t") settings.device_type = value;
+            else if(option == "-d") settings.device = value;
+            else if(option == "-s") settings.buffer_bytes = str_to<size_t>(value) << 20;
+            else if(option == "-r") settings.runs = max(str_to<int>(value), 1);
+            else
+            {
+                help(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Create the necessary OpenCL objects up to device queue.
+        OpenCLBasic oclobjects(settings.platform, settings.device_type, settings.device, CL_QUEUE_PROFILING_ENABLE);
+
+        // Every buffer has to fit one allocation, and the largest vector
+        // type and work-group size have to divide the element counts
+        cl_ulong max_alloc = 0;
+        cl_int err = clGetDeviceInfo(oclobjects.device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, 0);
+        SAMPLE_CHECK_ERRORS(err);
+        settings.buffer_bytes = size_t(min<cl_ulong>(settings.buffer_bytes, max_alloc));
+        settings.buffer_bytes -= settings.buffer_bytes % (1 << 20);
+        if(settings.buffer_bytes == 0)
+        {
+            throw Error("The buffers of the bandwidth tests have to be at least 1 MB");
+        }
+
+        OpenCLProgramMultipleKernels program(oclobjects, L"../roofline.cl", "");
+
+        cout << "Measuring the ceilings with " << (settings.buffer_bytes >> 20) << " MB buffers..." << flush;
+        Ceilings ceilings;
+        measureCeilings(oclobjects, program, settings, ceilings);
+        cout << " DONE.\n";
+        printCeilings(ceilings);
+
+        typedef void (*SampleBenchmark)(OpenCLBasic&, const Settings&, vector<KernelResult>&);
+        struct
+        {
+            const char* sample;
+            SampleBenchmark run;
+        }
+        benchmarks[] =
+        {
+            { "oclVectorAdd", runVectorAdd },
+            { "oclDotProduct", runDotProduct },
+            { "oclMatVecMul", runMatVecMul },
+            { "oclTranspose", runTranspose },
+            { "oclReduction", runReduction },
+            { "oclNbody", runNbody }
+        };
+
+        // A sample that cannot run on the device is reported and skipped
+        vector<KernelResult> results;
+        for(size_t i = 0; i < sizeof(benchmarks)/sizeof(benchmarks[0]); ++i)
+        {
+            try
+            {
+                benchmarks[i].run(oclobjects, settings, results);
+            }
+            catch(const Error& error)
+            {
+                cerr << "[ WARNING ] " << benchmarks[i].sample << " skipped: " << error.what() << "\n";
+            }
+        }
+
+        printRoofline(ceilings, results);
+
+        // All resource deallocations happen in destructors of helper objects.
+
+        return 0;
+    }
+    catch(const Error& error)
+    {
+        cerr << "[ ERROR ] Sample application specific error: " << error.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    catch(const exception& error)
+    {
+        cerr << "[ ERROR ] " << error.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    catch(...)
+    {
+        cerr << "[ ERROR ] Unknown/internal error happened.\n";
+        return EXIT_FAILURE;
+    }
+}
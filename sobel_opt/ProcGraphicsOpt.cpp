@@ -4,6 +4,7 @@
 #include "basic.hpp"
 #include "oclobject.hpp"
 #include "utils.h"
+#include "StencilGenerator.hpp"
 
 using namespace std;
 
@@ -12,12 +13,12 @@ using namespace std;
 #define XPAD 16
 
 // generate random 8-bit value for every pixel of the given image
-void generateInput(cl_uchar* p_input, size_t width, size_t height)
+void generateInput(cl_uchar* p_input, size_t width, size_t height, size_t pad_lines = PAD_LINES)
 {
     const float rnd_byte_norm = 255.0f/(float)RAND_MAX;
     srand(12345);
 
-    for (cl_uint i = 0; i <  (width+2*XPAD) * (height+2*PAD_LINES); ++i)
+    for (cl_uint i = 0; i <  (width+2*XPAD) * (height+2*pad_lines); ++i)
     {
         p_input[i] = (cl_uchar) ((float)rand() * rnd_byte_norm);
     }
@@ -261,6 +262,63 @@ int main (int argc, const char** argv)
 
         cout << "16x16 kernel verification succeeded," << endl <<
             "run time is " << time * 1000.0 << " ms, speedup " << naive_time / time << endl;
+
+        // Generated stencil kernels
+        // The same 16x16 tile scheme is emitted by the generator for any integer stencil,
+        // vector width and tile height are picked by the device preferred vector width
+        cl_uint vector_width = pickStencilVectorWidth(oclobjects.device, "uchar");
+        cl_uint tile_height = pickStencilTileHeight(vector_width);
+        cout << "Generated kernels use " << vector_width << "x" << tile_height << " tiles" << endl;
+
+        Stencil stencils[] =
+        {
+            makeSobelStencil(),
+            makeScharrStencil(),
+            makePrewittStencil(),
+            makeLaplacianStencil(),
+            makeLaplacian5x5Stencil()
+        };
+
+        for(size_t s = 0; s < sizeof(stencils)/sizeof(stencils[0]); ++s)
+        {
+            const Stencil& stencil = stencils[s];
+            string kernel_name = "Stencil_" + stencil.name;
+            string source = generateStencilKernel(stencil, "uchar", vector_width, tile_height, XPAD, kernel_name);
+            OpenCLProgramOneKernel generated(oclobjects, L"", source, kernel_name);
+
+            // input image needs as many padding lines as the stencil radius
+            size_t stencil_pad_lines = stencil.radius();
+            size_t aligned_stencil_input_size = zeroCopySizeAlignment((width + XPAD*2) * (height + 2*stencil_pad_lines), oclobjects.device);
+            cl_uchar* p_stencil_input = (cl_uchar*)aligned_malloc(aligned_stencil_input_size, dev_alignment);
+            generateInput(p_stencil_input, width, height, stencil_pad_lines);
+            ExecuteStencilReference<cl_uchar>(stencil, p_stencil_input, p_ref, width, height, XPAD, 255.0f);
+
+            cl_mem cl_stencil_input_buffer =
+                clCreateBuffer
+                (
+                    oclobjects.context,
+                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                    aligned_stencil_input_size,
+                    p_stencil_input,
+                    &err
+                );
+            SAMPLE_CHECK_ERRORS(err);
+
+            global_work_size[0] = width/vector_width;
+            global_work_size[1] = height/tile_height;
+            time = ExecuteSobelKernel(cl_stencil_input_buffer, cl_output_buffer, p_output, outBufSize, global_work_size, NULL, oclobjects, generated.kernel);
+
+            err = clReleaseMemObject(cl_stencil_input_buffer);
+            SAMPLE_CHECK_ERRORS(err);
+            aligned_free(p_stencil_input);
+
+            if(!verify(p_output, p_ref, width, height))
+                throw Error("Generated " + stencil.name + " kernel verification failed.");
+
+            cout << "Generated " << stencil.name << " " << stencil.size << "x" << stencil.size <<
+                " kernel verification succeeded," << endl <<
+                "run time is " << time * 1000.0 << " ms, speedup " << naive_time / time << endl;
+        }
         // -------------Main part end-----------------------------------------------
 
     if(cl_input_buffer)
@@ -0,0 +1,418 @@
+#include <sstream>
+#include "basic.hpp"
+#include "StencilGenerator.hpp"
+
+using namespace std;
+
+
+Stencil::Stencil (
+    const string& name,
+    int size,
+    const cl_int* weights_x,
+    const cl_int* weights_y,
+    float scale
+) :
+    name(name),
+    size(size),
+    scale(scale)
+{
+    if(size < 1 || !(size & 1))
+    {
+        throw Error("Stencil size should be a positive odd number.");
+    }
+
+    this->weights_x.assign(weights_x, weights_x + size*size);
+    if(weights_y)
+    {
+        this->weights_y.assign(weights_y, weights_y + size*size);
+    }
+}
+
+
+Stencil makeSobelStencil ()
+{
+    const cl_int wx[] = { -1, 0, 1,   -2, 0, 2,   -1, 0, 1 };
+    const cl_int wy[] = { -1,-2,-1,    0, 0, 0,    1, 2, 1 };
+    return Stencil("Sobel", 3, wx, wy);
+}
+
+
+Stencil makeScharrStencil ()
+{
+    const cl_int wx[] = {  -3, 0,  3,  -10, 0, 10,   -3, 0, 3 };
+    const cl_int wy[] = {  -3,-10,-3,    0, 0,  0,    3,10, 3 };
+    return Stencil("Scharr", 3, wx, wy, 0.25f);
+}
+
+
+Stencil makePrewittStencil ()
+{
+    const cl_int wx[] = { -1, 0, 1,   -1, 0, 1,   -1, 0, 1 };
+    const cl_int wy[] = { -1,-1,-1,    0, 0, 0,    1, 1, 1 };
+    return Stencil("Prewitt", 3, wx, wy);
+}
+
+
+Stencil makeLaplacianStencil ()
+{
+    const cl_int w[] = { 0, 1, 0,   1,-4, 1,   0, 1, 0 };
+    return Stencil("Laplacian", 3, w);
+}
+
+
+Stencil makeLaplacian5x5Stencil ()
+{
+    const cl_int w[] =
+    {
+         0,  0, -1,  0,  0,
+         0, -1, -2, -1,  0,
+        -1, -2, 16, -2, -1,
+         0, -1, -2, -1,  0,
+         0,  0, -1,  0,  0
+    };
+    return Stencil("Laplacian5x5", 5, w);
+}
+
+
+namespace
+{
+
+bool isIntegerType (const string& data_type)
+{
+    return data_type != "float";
+}
+
+
+// OpenCL vector type name, e.g. "float16" or just "float" for width 1
+string vectorType (const string& scalar_type, cl_uint vector_width)
+{
+    return vector_width == 1 ? scalar_type : scalar_type + to_str(vector_width);
+}
+
+
+// float literal in OpenCL C syntax, e.g. "0.25f"
+string floatLiteral (float value)
+{
+    ostringstream literal;
+    literal << showpoint << setprecision(8) << value << "f";
+    return literal.str();
+}
+
+
+// name of i-th component of a vector: s0..sf
+string component (cl_uint i)
+{
+    const char* digits = "0123456789abcdef";
+    return string(".s") + digits[i];
+}
+
+
+// Every row of the aperture is held in registers as a set of
+// left scalars (l1 is the closest to the tile), a center vector (c)
+// and right scalars (r1 is the closest to the tile).
+string rowVar (int row, const string& part)
+{
+    return "row" + to_str(row) + "_" + part;
+}
+
+
+// Build an expression for the row shifted by dx pixels, for example
+// (float16)(row0_l1, row0_c.s0, ..., row0_c.se) for dx = -1.
+string shiftedRow (int row, int dx, int radius, cl_uint vector_width)
+{
+    if(dx == 0)
+    {
+        return rowVar(row, "c");
+    }
+
+    ostringstream expr;
+    if(vector_width > 1)
+    {
+        expr << "(" << vectorType("float", vector_width) << ")(";
+    }
+    for(cl_uint i = 0; i < vector_width; i++)
+    {
+        // position in the extended row [x-radius, x+vector_width+radius)
+        int e = (int)i + radius + dx;
+        if(i)
+        {
+            expr << ", ";
+        }
+        if(e < radius)
+        {
+            expr << rowVar(row, "l" + to_str(radius - e));
+        }
+        else if(e < radius + (int)vector_width)
+        {
+            expr << rowVar(row, "c") << (vector_width > 1 ? component(e - radius) : "");
+        }
+        else
+        {
+            expr << rowVar(row, "r" + to_str(e - radius - (int)vector_width + 1));
+        }
+    }
+    if(vector_width > 1)
+    {
+        expr << ")";
+    }
+    return expr.str();
+}
+
+
+// Emit accumulation of one weights matrix into the variable acc
+void emitConvolution (
+    ostringstream& src,
+    const std::vector<cl_int>& weights,
+    const string& acc,
+    int size,
+    cl_uint vector_width
+)
+{
+    int radius = size/2;
+    string float_vec = vectorType("float", vector_width);
+
+    src << "        " << float_vec << " " << acc << " = (" << float_vec << ")(0.0f);\n";
+
+    for(int dy = 0; dy < size; dy++)
+    {
+        for(int dx = -radius; dx <= radius; dx++)
+        {
+            cl_int w = weights[dy*size + dx + radius];
+            if(w == 0)
+            {
+                // zero weights are skipped, that's where most of the savings
+                // of hand-written kernels come from
+                continue;
+            }
+
+            string value = shiftedRow(dy, dx, radius, vector_width);
+            src << "        " << acc;
+            if(w == 1)
+            {
+                src << " += " << value << ";\n";
+            }
+            else if(w == -1)
+            {
+                src << " -= " << value << ";\n";
+            }
+            else
+            {
+                src << " += " << w << ".0f * " << value << ";\n";
+            }
+        }
+    }
+}
+
+
+// Emit loading of one image row at srcIndex to the row variables
+void emitRowLoad (ostringstream& src, int row, int radius, cl_uint vector_width, const string& indent)
+{
+    string float_vec = vectorType("float", vector_width);
+
+    for(int j = radius; j >= 1; j--)
+    {
+        src << indent << rowVar(row, "l" + to_str(j)) << " = convert_float(pSrc[srcIndex - " << j << "]);\n";
+    }
+    if(vector_width > 1)
+    {
+        src << indent << rowVar(row, "c") << " = convert_" << float_vec
+            << "(vload" << vector_width << "(0, pSrc + srcIndex));\n";
+    }
+    else
+    {
+        src << indent << rowVar(row, "c") << " = convert_float(pSrc[srcIndex]);\n";
+    }
+    for(int j = 1; j <= radius; j++)
+    {
+        src << indent << rowVar(row, "r" + to_str(j)) << " = convert_float(pSrc[srcIndex + "
+            << vector_width + j - 1 << "]);\n";
+    }
+    src << indent << "srcIndex += srcYStride;\n";
+}
+
+}
+
+
+string generateStencilKernel (
+    const Stencil& stencil,
+    const string& data_type,
+    cl_uint vector_width,
+    cl_uint tile_height,
+    cl_uint x_pad,
+    const string& kernel_name
+)
+{
+    if(
+        data_type != "uchar" && data_type != "char" &&
+        data_type != "ushort" && data_type != "short" &&
+        data_type != "float"
+    )
+    {
+        throw Error("Unsupported stencil data type " + inquotes(data_type) + ".");
+    }
+
+    if(
+        vector_width != 1 && vector_width != 2 && vector_width != 4 &&
+        vector_width != 8 && vector_width != 16
+    )
+    {
+        throw Error("Stencil vector width should be 1, 2, 4, 8 or 16.");
+    }
+
+    if(tile_height == 0)
+    {
+        throw Error("Stencil tile height should be positive.");
+    }
+
+    int size = stencil.size;
+    int radius = stencil.radius();
+
+    if((int)x_pad < radius)
+    {
+        throw Error("Image padding is smaller than the stencil radius.");
+    }
+
+    string float_vec = vectorType("float", vector_width);
+    string out_vec = vectorType(data_type, vector_width);
+
+    ostringstream src;
+
+    src << "// " << stencil.name << " " << size << "x" << size << " stencil, generated for "
+        << out_vec << " vectors and " << tile_height << " lines per work item\n";
+    src << "__kernel void " << kernel_name
+        << " (__global const " << data_type << "* pSrc, __global " << data_type << "* pDst)\n";
+    src << "{\n";
+    src << "    uint dstYStride = get_global_size(0) * " << vector_width << ";\n";
+    src << "    uint dstIndex   = " << tile_height << " * get_global_id(1) * dstYStride + get_global_id(0) * "
+        << vector_width << ";\n";
+    src << "    uint srcYStride = dstYStride + " << 2*x_pad << ";\n";
+    src << "    uint srcIndex   = " << tile_height << " * get_global_id(1) * srcYStride + get_global_id(0) * "
+        << vector_width << " + " << x_pad << ";\n";
+    src << "\n";
+
+    // row registers
+    for(int row = 0; row < size; row++)
+    {
+        if(radius)
+        {
+            src << "    float";
+            for(int j = radius; j >= 1; j--)
+            {
+                src << " " << rowVar(row, "l" + to_str(j)) << ",";
+            }
+            for(int j = 1; j <= radius; j++)
+            {
+                src << " " << rowVar(row, "r" + to_str(j)) << (j < radius ? "," : ";");
+            }
+            src << "\n";
+        }
+        src << "    " << float_vec << " " << rowVar(row, "c") << ";\n";
+    }
+    src << "\n";
+
+    // read data in for first size-1 lines of a tile
+    for(int row = 0; row < size - 1; row++)
+    {
+        emitRowLoad(src, row, radius, vector_width, "    ");
+    }
+    src << "\n";
+
+    src << "    for(uint k = 0; k < " << tile_height << "; k++)\n";
+    src << "    {\n";
+
+    // read the last line of the aperture
+    emitRowLoad(src, size - 1, radius, vector_width, "        ");
+    src << "\n";
+
+    emitConvolution(src, stencil.weights_x, "xVal", size, vector_width);
+    if(stencil.isGradient())
+    {
+        emitConvolution(src, stencil.weights_y, "yVal", size, vector_width);
+    }
+    src << "\n";
+
+    src << "        " << float_vec << " result = "
+        << (stencil.isGradient() ? "sqrt(xVal*xVal + yVal*yVal)" : "fabs(xVal)");
+    if(stencil.scale != 1.0f)
+    {
+        src << " * " << floatLiteral(stencil.scale);
+    }
+    src << ";\n";
+
+    // write data out
+    string converted = isIntegerType(data_type) ? "convert_" + out_vec + "_sat(result)" : "result";
+    if(vector_width > 1)
+    {
+        src << "        vstore" << vector_width << "(" << converted << ", 0, pDst + dstIndex);\n";
+    }
+    else
+    {
+        src << "        pDst[dstIndex] = " << converted << ";\n";
+    }
+    src << "\n";
+
+    // to save load operations, just shift and reuse already loaded data for next iteration
+    for(int row = 0; row < size - 1; row++)
+    {
+        src << "        ";
+        for(int j = radius; j >= 1; j--)
+        {
+            src << rowVar(row, "l" + to_str(j)) << " = " << rowVar(row + 1, "l" + to_str(j)) << "; ";
+        }
+        src << rowVar(row, "c") << " = " << rowVar(row + 1, "c") << ";";
+        for(int j = 1; j <= radius; j++)
+        {
+            src << " " << rowVar(row, "r" + to_str(j)) << " = " << rowVar(row + 1, "r" + to_str(j)) << ";";
+        }
+        src << "\n";
+    }
+    src << "        dstIndex += dstYStride;\n";
+    src << "    }\n";
+    src << "}\n";
+
+    return src.str();
+}
+
+
+cl_uint pickStencilVectorWidth (cl_device_id device, const string& data_type)
+{
+    cl_device_info param = CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR;
+    if(data_type == "ushort" || data_type == "short")
+    {
+        param = CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT;
+    }
+    else if(data_type == "float")
+    {
+        param = CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT;
+    }
+
+    cl_uint preferred = 0;
+    cl_int err = clGetDeviceInfo(device, param, sizeof(preferred), &preferred, NULL);
+    SAMPLE_CHECK_ERRORS(err);
+
+    // SIMT devices report 1 and vectorize across work items by themselves
+    if(preferred <= 1)
+    {
+        return 1;
+    }
+
+    // math is done in floats, so for narrow types use the widest vector
+    // the generated code supports to fill the float SIMD units
+    // the same way as the hand-written uchar16 kernel does
+    cl_uint width = 16;
+    if(data_type == "float")
+    {
+        width = 4;
+        while(width < preferred && width < 16)
+        {
+            width *= 2;
+        }
+    }
+    return width;
+}
+
+
+cl_uint pickStencilTileHeight (cl_uint vector_width)
+{
+    return vector_width >= 16 ? 16 : vector_width >= 4 ? 4 : 1;
+}
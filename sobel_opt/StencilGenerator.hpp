@@ -0,0 +1,135 @@
+// Generator of vectorized stencil (convolution) kernels.
+// It produces the same kind of code as the hand-written
+// Sobel_uchar16_to_float16_vload_16 kernel in ProcGraphicsOpt.cl:
+// every work item processes a tile of vector_width x tile_height pixels,
+// loads image rows by vloadN, does all the math in floats and reuses
+// already loaded rows when moving to the next line of the tile.
+// Any square integer stencil of odd size can be generated,
+// for example Sobel, Scharr, Prewitt or Laplacian.
+
+
+#ifndef _STENCIL_GENERATOR_HPP_
+#define _STENCIL_GENERATOR_HPP_
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <CL/cl.h>
+
+using std::string;
+
+
+// Description of a stencil operator.
+// If only weights_x is given, output is |conv(weights_x)| * scale.
+// If weights_y is also given, output is the gradient magnitude
+// sqrt(conv(weights_x)^2 + conv(weights_y)^2) * scale.
+// Weights are stored row by row, size*size values each.
+struct Stencil
+{
+    string name;
+    int size;   // 3, 5, ... (odd)
+    std::vector<cl_int> weights_x;
+    std::vector<cl_int> weights_y;
+    float scale;
+
+    Stencil () : size(0), scale(1.0f) {}
+
+    Stencil (
+        const string& name,
+        int size,
+        const cl_int* weights_x,
+        const cl_int* weights_y = 0,
+        float scale = 1.0f
+    );
+
+    int radius () const { return size/2; }
+    bool isGradient () const { return !weights_y.empty(); }
+};
+
+// Predefined operators
+Stencil makeSobelStencil ();
+Stencil makeScharrStencil ();
+Stencil makePrewittStencil ();
+Stencil makeLaplacianStencil ();
+Stencil makeLaplacian5x5Stencil ();
+
+// Generates OpenCL C source with a single kernel named kernel_name.
+// data_type is the pixel type of both source and destination images:
+// "uchar", "char", "ushort", "short" or "float".
+// vector_width is the count of pixels processed along a row (1, 2, 4, 8 or 16),
+// tile_height is the count of rows processed by a single work item.
+// The kernel expects the source image to have x_pad pixels of padding
+// at the left and right and stencil.radius() lines at the top and bottom,
+// and it is launched with global size {width/vector_width, height/tile_height}.
+string generateStencilKernel (
+    const Stencil& stencil,
+    const string& data_type,
+    cl_uint vector_width,
+    cl_uint tile_height,
+    cl_uint x_pad,
+    const string& kernel_name
+);
+
+// Picks vector width for a given device and pixel type
+// based on CL_DEVICE_PREFERRED_VECTOR_WIDTH_* values.
+// Devices that prefer scalar code (SIMT GPUs) get width 1,
+// vector (CPU-like) devices get the widest supported width up to 16.
+cl_uint pickStencilVectorWidth (cl_device_id device, const string& data_type);
+
+// Picks tile height to go together with the given vector width:
+// wider vectors amortize more rows per work item.
+cl_uint pickStencilTileHeight (cl_uint vector_width);
+
+
+// Reference implementation used for verification of generated kernels.
+// Image layout is the same as the generated kernels expect.
+template <typename T>
+void ExecuteStencilReference (
+    const Stencil& stencil,
+    const T* p_input,
+    T* p_output,
+    cl_int width,
+    cl_int height,
+    cl_int x_pad,
+    float max_value
+)
+{
+    int r = stencil.radius();
+    int src_stride = width + 2*x_pad;
+
+    for(int y = 0; y < height; y++)        // rows loop
+    {
+        for(int x = 0; x < width; x++)     // columns loop
+        {
+            float xVal = 0.0f;
+            float yVal = 0.0f;
+
+            // apply stencil weights within aperture
+            for(int dy = -r; dy <= r; dy++)
+            {
+                const T* p_row = p_input + (y + r + dy) * src_stride + x_pad + x;
+                for(int dx = -r; dx <= r; dx++)
+                {
+                    int w = (dy + r) * stencil.size + dx + r;
+                    xVal += stencil.weights_x[w] * (float)p_row[dx];
+                    if(stencil.isGradient())
+                    {
+                        yVal += stencil.weights_y[w] * (float)p_row[dx];
+                    }
+                }
+            }
+
+            float val = stencil.isGradient() ? std::sqrt(xVal*xVal + yVal*yVal) : std::fabs(xVal);
+            val *= stencil.scale;
+            if(max_value > 0.0f)
+            {
+                // saturate as convert_<type>_sat does
+                val = val > max_value ? max_value : val;
+            }
+            p_output[y * width + x] = (T)val;
+        }
+    }
+}
+
+
+#endif  // end of the include guard
@@ -0,0 +1,411 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cassert>
+#include <exception>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include <CL/cl.h>
+
+#include "basic.hpp"
+#include "oclobject.hpp"
+#include "svmcontainers.hpp"
+
+
+using namespace std;
+
+
+// Where the containers live during a benchmark run:
+//   - coarse: coarse-grained SVM, the host maps the heap to build and check
+//   - fine:   fine-grained SVM, no maps at all
+//   - buffer: the arrays of the containers copied into ordinary buffers,
+//             links between them are offsets and every array is an argument
+enum Layout { LAYOUT_COARSE, LAYOUT_FINE, LAYOUT_BUFFER };
+
+const char* layoutName (Layout layout)
+{
+    return layout == LAYOUT_COARSE ? "coarse-grain SVM" : layout == LAYOUT_FINE ? "fine-grain SVM" : "buffer+offset";
+}
+
+
+// Input of all runs, generated once so every layout sees the same data
+struct Workload
+{
+    cl_uint num_keys;
+    vector<cl_uint> keys;
+    vector<cl_uint> values;
+    vector<cl_uint> queries;            // half of them hit
+    vector<cl_uint> expected_lookups;
+
+    cl_uint num_vertices;
+    vector<cl_uint> from;
+    vector<cl_uint> to;
+    vector<float> weights;
+    vector<cl_uint> starts;
+    cl_uint steps;
+
+    vector<float> elements;
+    vector<cl_uint> indices;
+};
+
+
+void makeWorkload (Workload& w, cl_uint num_keys, size_t num_queries, cl_uint degree, cl_uint steps)
+{
+    w.num_keys = num_keys;
+    unordered_map<cl_uint, cl_uint> reference;
+    while(reference.size() < num_keys)
+    {
+        cl_uint key = (cl_uint(rand()) << 16) ^ cl_uint(rand());
+        if(key == SVM_HASH_EMPTY || reference.count(key))
+        {
+            continue;
+        }
+        cl_uint value = cl_uint(reference.size());
+        reference[key] = value;
+        w.keys.push_back(key);
+        w.values.push_back(value);
+    }
+
+    for(size_t i = 0; i < num_queries; ++i)
+    {
+        cl_uint key = (i % 2) ? w.keys[rand_index(num_keys)] : (cl_uint(rand()) << 16) ^ cl_uint(rand()) ^ 1u;
+        unordered_map<cl_uint, cl_uint>::const_iterator hit = reference.find(key);
+        w.queries.push_back(key);
+        w.expected_lookups.push_back(hit == reference.end() ? SVM_HASH_EMPTY : hit->second);
+    }
+
+    // Random graph with the given average degree
+    w.num_vertices = num_keys;
+    w.steps = steps;
+    for(size_t e = 0; e < size_t(num_keys)*degree; ++e)
+    {
+        w.from.push_back(cl_uint(rand_index(num_keys)));
+        w.to.push_back(cl_uint(rand_index(num_keys)));
+        w.weights.push_back(rand_uniform_01<float>());
+    }
+    for(size_t i = 0; i < num_queries; ++i)
+    {
+        w.starts.push_back(cl_uint(rand_index(num_keys)));
+    }
+
+    w.elements.resize(num_keys);
+    fill_rand_uniform_01(&w.elements[0], num_keys);
+    for(size_t i = 0; i < num_queries; ++i)
+    {
+        w.indices.push_back(cl_uint(rand_index(num_keys)));
+    }
+}
+
+
+// Average kernel time over 'iterations' launches after a warm-up launch
+double timeKernel (cl_command_queue queue, cl_kernel kernel, size_t global_size, int iterations)
+{
+    double total = 0;
+    for(int i = 0; i <= iterations; ++i)
+    {
+        cl_event event = 0;
+        cl_int err = clEnqueueNDRangeKernel(queue, kernel, 1, 0, &global_size, 0, 0, 0, &event);
+        SAMPLE_CHECK_ERRORS(err);
+        err = clWaitForEvents(1, &event);
+        SAMPLE_CHECK_ERRORS(err);
+        if(i > 0)
+        {
+            total += eventExecutionTime(event);
+        }
+        clReleaseEvent(event);
+    }
+    return total/iterations;
+}
+
+
+template <typename T>
+cl_mem bufferFrom (cl_context context, const T* data, size_t count)
+{
+    cl_int err = CL_SUCCESS;
+    cl_mem buffer = clCreateBuffer(
+        context,
+        CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+        count*sizeof(T),
+        (void*)data,
+        &err
+    );
+    SAMPLE_CHECK_ERRORS(err);
+    return buffer;
+}
+
+
+template <typename T>
+void checkResults (const char* what, const T* results, const vector<T>& expected)
+{
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        if(results[i] != expected[i])
+        {
+            cerr
+                << what << ": mismatch at position " << i
+                << ", read " << results[i]
+                << ", expected " << expected[i] << "\n";
+
+            throw Error("Validation failed");
+        }
+    }
+}
+
+
+// Builds the containers in the given layout, runs the three lookup kernels
+// and reports lookups, walk steps and gathers per second
+void runLayout (
+    Layout layout,
+    const Workload& w,
+    OpenCLBasic& oclobjects,
+    OpenCLProgramMultipleKernels& program,
+    int iterations
+)
+{
+    cl_int err = CL_SUCCESS;
+    cl_context context = oclobjects.context;
+    cl_command_queue queue = oclobjects.queue;
+    size_t num_queries = w.queries.size();
+
+    // The buffer layout is built in SVM as well and then copied out
+    SVMHeap heap(context, queue, layout == LAYOUT_FINE);
+    heap.mapForHost();
+
+    SVMHashMapU32 map(heap, 2*w.num_keys);
+    for(size_t i = 0; i < w.keys.size(); ++i)
+    {
+        map.insert(w.keys[i], w.values[i]);
+    }
+    SVMCSRGraph graph(heap, w.num_vertices, w.from, w.to, w.weights);
+    SVMVectorOf<float> elements(heap, w.elements.size());
+    for(size_t i = 0; i < w.elements.size(); ++i)
+    {
+        elements.push_back(w.elements[i]);
+    }
+
+    // Host reference of the walks, on the very structure the device sees
+    vector<float> expected_walks(num_queries);
+    vector<float> expected_gathers(num_queries);
+    for(size_t i = 0; i < num_queries; ++i)
+    {
+        expected_walks[i] = graph.walk(w.starts[i], w.steps);
+        expected_gathers[i] = w.elements[w.indices[i]];
+    }
+
+    SVMVectorOf<cl_uint> queries(heap, num_queries);
+    SVMVectorOf<cl_uint> starts(heap, num_queries);
+    SVMVectorOf<cl_uint> indices(heap, num_queries);
+    SVMVectorOf<cl_uint> lookup_results(heap, num_queries);
+    SVMVectorOf<float> float_results(heap, num_queries);
+    for(size_t i = 0; i < num_queries; ++i)
+    {
+        queries.push_back(w.queries[i]);
+        starts.push_back(w.starts[i]);
+        indices.push_back(w.indices[i]);
+    }
+    lookup_results.resize(num_queries);
+    float_results.resize(num_queries);
+
+    double t_lookup = 0, t_walk = 0, t_gather = 0;
+
+    if(layout == LAYOUT_BUFFER)
+    {
+        SVMHashMap* m = map.device();
+        SVMGraph* g = graph.device();
+        cl_uint mask = m->mask;
+        cl_mem keys = bufferFrom(context, m->keys, m->mask + 1);
+        cl_mem values = bufferFrom(context, m->values, m->mask + 1);
+        cl_mem row_offsets = bufferFrom(context, g->rowOffsets, g->numVertices + 1);
+        cl_mem columns = bufferFrom(context, g->columns, max(g->numEdges, 1u));
+        cl_mem weights = bufferFrom(context, g->weights, max(g->numEdges, 1u));
+        cl_mem data = bufferFrom(context, elements.data(), elements.size());
+        cl_mem queries_buffer = bufferFrom(context, queries.data(), num_queries);
+        cl_mem starts_buffer = bufferFrom(context, starts.data(), num_queries);
+        cl_mem indices_buffer = bufferFrom(context, indices.data(), num_queries);
+        cl_mem lookup_buffer = bufferFrom(context, lookup_results.data(), num_queries);
+        cl_mem float_buffer = bufferFrom(context, float_results.data(), num_queries);
+
+        cl_kernel kernel = program["hashLookupBuffer"];
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &keys);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &values);
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &mask);
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &queries_buffer);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &lookup_buffer);
+        SAMPLE_CHECK_ERRORS(err);
+        t_lookup = timeKernel(queue, kernel, num_queries, iterations);
+
+        kernel = program["graphWalkBuffer"];
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &row_offsets);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &columns);
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &weights);
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &starts_buffer);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_uint), &w.steps);
+        err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &float_buffer);
+        SAMPLE_CHECK_ERRORS(err);
+        t_walk = timeKernel(queue, kernel, num_queries, iterations);
+
+        err = clEnqueueReadBuffer(queue, lookup_buffer, CL_TRUE, 0, num_queries*sizeof(cl_uint), lookup_results.data(), 0, 0, 0);
+        SAMPLE_CHECK_ERRORS(err);
+        checkResults("hashLookupBuffer", lookup_results.data(), w.expected_lookups);
+        err = clEnqueueReadBuffer(queue, float_buffer, CL_TRUE, 0, num_queries*sizeof(float), float_results.data(), 0, 0, 0);
+        SAMPLE_CHECK_ERRORS(err);
+        checkResults("graphWalkBuffer", float_results.data(), expected_walks);
+
+        kernel = program["vectorGatherBuffer"];
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &indices_buffer);
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &float_buffer);
+        SAMPLE_CHECK_ERRORS(err);
+        t_gather = timeKernel(queue, kernel, num_queries, iterations);
+
+        err = clEnqueueReadBuffer(queue, float_buffer, CL_TRUE, 0, num_queries*sizeof(float), float_results.data(), 0, 0, 0);
+        SAMPLE_CHECK_ERRORS(err);
+        checkResults("vectorGatherBuffer", float_results.data(), expected_gathers);
+
+        cl_mem buffers[] = {keys, values, row_offsets, columns, weights, data,
+                            queries_buffer, starts_buffer, indices_buffer, lookup_buffer, float_buffer};
+        for(size_t i = 0; i < sizeof(buffers)/sizeof(buffers[0]); ++i)
+        {
+            clReleaseMemObject(buffers[i]);
+        }
+    }
+    else
+    {
+        // The device reaches the arrays through the headers
+        heap.unmapForDevice();
+
+        cl_kernel kernel = program["hashLookupSVM"];
+        err  = clSetKernelArgSVMPointer(kernel, 0, map.device());
+        err |= clSetKernelArgSVMPointer(kernel, 1, queries.data());
+        err |= clSetKernelArgSVMPointer(kernel, 2, lookup_results.data());
+        SAMPLE_CHECK_ERRORS(err);
+        heap.setExecInfo(kernel);
+        t_lookup = timeKernel(queue, kernel, num_queries, iterations);
+
+        kernel = program["graphWalkSVM"];
+        err  = clSetKernelArgSVMPointer(kernel, 0, graph.device());
+        err |= clSetKernelArgSVMPointer(kernel, 1, starts.data());
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &w.steps);
+        err |= clSetKernelArgSVMPointer(kernel, 3, float_results.data());
+        SAMPLE_CHECK_ERRORS(err);
+        heap.setExecInfo(kernel);
+        t_walk = timeKernel(queue, kernel, num_queries, iterations);
+
+        heap.mapForHost();
+        checkResults("hashLookupSVM", lookup_results.data(), w.expected_lookups);
+        checkResults("graphWalkSVM", float_results.data(), expected_walks);
+        heap.unmapForDevice();
+
+        kernel = program["vectorGatherSVM"];
+        err  = clSetKernelArgSVMPointer(kernel, 0, elements.device());
+        err |= clSetKernelArgSVMPointer(kernel, 1, indices.data());
+        err |= clSetKernelArgSVMPointer(kernel, 2, float_results.data());
+        SAMPLE_CHECK_ERRORS(err);
+        heap.setExecInfo(kernel);
+        t_gather = timeKernel(queue, kernel, num_queries, iterations);
+
+        heap.mapForHost();
+        checkResults("vectorGatherSVM", float_results.data(), expected_gathers);
+    }
+
+    cout
+        << setw(18) << left << layoutName(layout) << right << fixed << setprecision(1)
+        << setw(16) << num_queries/t_lookup/1e6
+        << setw(16) << double(num_queries)*w.steps/t_walk/1e6
+        << setw(16) << num_queries/t_gather/1e6 << "\n";
+}
+
+
+cl_device_svm_capabilities svmCapabilities (cl_device_id device)
+{
+    cl_device_svm_capabilities caps = 0;
+    cl_int err = clGetDeviceInfo(
+        device,
+        CL_DEVICE_SVM_CAPABILITIES,
+        sizeof(cl_device_svm_capabilities),
+        &caps,
+        0
+    );
+    return err == CL_SUCCESS ? caps : 0;
+}
+
+
+int main (int argc, const char** argv)
+{
+    try
+    {
+        // Number of keys and graph vertices, in millions, from the command line
+        cl_uint num_keys = 1 << 20;
+        if(argc > 1)
+        {
+            num_keys = cl_uint(str_to<double>(argv[1])*(1 << 20));
+        }
+        size_t num_queries = 4*size_t(num_keys);
+        int iterations = 10;
+
+        // Create the necessary OpenCL objects up to device queue.
+        OpenCLBasic oclobjects("0", "all", "0", CL_QUEUE_PROFILING_ENABLE);
+
+        cl_device_svm_capabilities caps = svmCapabilities(oclobjects.device);
+        if(!(caps & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER))
+        {
+            printf(
+                "Cannot detect buffer SVM capabilities on the device. "
+                "The device seemingly doesn't support SVM.\n"
+            );
+
+            return -1;
+        }
+
+        OpenCLProgramMultipleKernels program(
+            oclobjects,
+            L"../../common/svmcontainers.cl",
+            "",
+            "-cl-std=CL2.0 -I."    // directory to search for #include directives
+        );
+
+        cout << "Generating " << num_keys << " keys and vertices, " << num_queries << " queries..." << flush;
+        Workload workload;
+        makeWorkload(workload, num_keys, num_queries, 8, 16);
+        cout << " DONE.\n";
+
+        cout
+            << setw(18) << left << "layout" << right
+            << setw(16) << "Mlookups/s"
+            << setw(16) << "Mwalk steps/s"
+            << setw(16) << "Mgathers/s" << "\n";
+
+        runLayout(LAYOUT_BUFFER, workload, oclobjects, program, iterations);
+        runLayout(LAYOUT_COARSE, workload, oclobjects, program, iterations);
+        if(caps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER)
+        {
+            runLayout(LAYOUT_FINE, workload, oclobjects, program, iterations);
+        }
+        else
+        {
+            cout << setw(18) << left << layoutName(LAYOUT_FINE) << "not supported by the device\n";
+        }
+
+        // All resource deallocations happen in destructors of helper objects.
+
+        return 0;
+    }
+    catch(const Error& error)
+    {
+        cerr << "[ ERROR ] Sample application specific error: " << error.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    catch(const exception& error)
+    {
+        cerr << "[ ERROR ] " << error.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    catch(...)
+    {
+        cerr << "[ ERROR ] Unknown/internal error happened.\n";
+        return EXIT_FAILURE;
+    }
+}
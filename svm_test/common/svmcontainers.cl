@@ -0,0 +1,144 @@
+#include "../../include/svmcontainers.h"
+
+// Device side lookup API. The cores work on plain arrays so the same code
+// serves containers in SVM, reached through their header, and the same data
+// in ordinary buffers, where the arrays are kernel arguments and the links
+// between them are offsets.
+
+// Value of key, or notFound
+static inline uint hash_find (global const uint* keys, global const uint* values, uint mask, uint key, uint notFound)
+{
+    for(uint slot = svm_hash_u32(key) & mask; ; slot = (slot + 1) & mask)
+    {
+        uint k = keys[slot];
+        if(k == key)
+        {
+            return values[slot];
+        }
+        if(k == SVM_HASH_EMPTY)
+        {
+            return notFound;
+        }
+    }
+}
+
+static inline uint svm_hash_map_find (global const SVMHashMap* map, uint key, uint notFound)
+{
+    return hash_find(map->keys, map->values, map->mask, key, notFound);
+}
+
+static inline uint csr_degree (global const uint* rowOffsets, uint v)
+{
+    return rowOffsets[v + 1] - rowOffsets[v];
+}
+
+// Sum of the weights along a walk of 'steps' edges from v, every step
+// depends on the loads of the step before
+static inline float csr_walk (
+    global const uint* rowOffsets,
+    global const uint* columns,
+    global const float* weights,
+    uint v,
+    uint steps
+)
+{
+    float sum = 0;
+    for(uint step = 0; step < steps; ++step)
+    {
+        uint first = rowOffsets[v];
+        uint degree = rowOffsets[v + 1] - first;
+        if(degree == 0)
+        {
+            break;
+        }
+        uint e = first + svm_walk_edge(v, step, degree);
+        sum += weights[e];
+        v = columns[e];
+    }
+    return sum;
+}
+
+static inline uint svm_graph_degree (global const SVMGraph* g, uint v)
+{
+    return csr_degree(g->rowOffsets, v);
+}
+
+static inline uint svm_graph_neighbor (global const SVMGraph* g, uint v, uint i)
+{
+    return g->columns[g->rowOffsets[v] + i];
+}
+
+static inline float svm_graph_walk (global const SVMGraph* g, uint v, uint steps)
+{
+    return csr_walk(g->rowOffsets, g->columns, g->weights, v, steps);
+}
+
+
+// Benchmark kernels, one work-item per query. The SVM versions receive the
+// container header and follow its pointers, the buffer versions the arrays.
+
+kernel void hashLookupSVM (
+    global const SVMHashMap* map,
+    global const uint* queries,
+    global uint* results
+)
+{
+    size_t id = get_global_id(0);
+    results[id] = svm_hash_map_find(map, queries[id], SVM_HASH_EMPTY);
+}
+
+kernel void hashLookupBuffer (
+    global const uint* keys,
+    global const uint* values,
+    uint mask,
+    global const uint* queries,
+    global uint* results
+)
+{
+    size_t id = get_global_id(0);
+    results[id] = hash_find(keys, values, mask, queries[id], SVM_HASH_EMPTY);
+}
+
+kernel void graphWalkSVM (
+    global const SVMGraph* graph,
+    global const uint* starts,
+    uint steps,
+    global float* results
+)
+{
+    size_t id = get_global_id(0);
+    results[id] = svm_graph_walk(graph, starts[id], steps);
+}
+
+kernel void graphWalkBuffer (
+    global const uint* rowOffsets,
+    global const uint* columns,
+    global const float* weights,
+    global const uint* starts,
+    uint steps,
+    global float* results
+)
+{
+    size_t id = get_global_id(0);
+    results[id] = csr_walk(rowOffsets, columns, weights, starts[id], steps);
+}
+
+kernel void vectorGatherSVM (
+    global const SVMVector* vec,
+    global const uint* indices,
+    global float* results
+)
+{
+    size_t id = get_global_id(0);
+    results[id] = SVM_VECTOR_AT(vec, float, indices[id]);
+}
+
+kernel void vectorGatherBuffer (
+    global const float* data,
+    global const uint* indices,
+    global float* results
+)
+{
+    size_t id = get_global_id(0);
+    results[id] = data[indices[id]];
+}
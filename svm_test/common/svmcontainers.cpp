@@ -0,0 +1,327 @@
+
+#include <algorithm>
+#include <cassert>
+
+#include "svmcontainers.hpp"
+
+
+SVMHeap::SVMHeap (cl_context context, cl_command_queue queue, bool fine_grain) :
+    context(context),
+    queue(queue),
+    fine_grain(fine_grain),
+    mapped(false)
+{
+}
+
+
+SVMHeap::~SVMHeap ()
+{
+    try
+    {
+        if(mapped)
+        {
+            unmapForDevice();
+        }
+        clFinish(queue);
+        for(size_t i = 0; i < ptrs.size(); ++i)
+        {
+            clSVMFree(context, ptrs[i]);
+        }
+    }
+    catch(...)
+    {
+        destructorException();
+    }
+}
+
+
+void* SVMHeap::alloc (size_t size)
+{
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE;
+    if(fine_grain)
+    {
+        flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+    }
+
+    void* ptr = clSVMAlloc(context, flags, size, 0);
+    if(!ptr)
+    {
+        throw Error(
+            "Cannot allocate SVM memory with clSVMAlloc: "
+            "it returns null pointer. "
+            "You might be out of memory."
+        );
+    }
+
+    ptrs.push_back(ptr);
+    sizes.push_back(size);
+    if(mapped)
+    {
+        mapOne(ptr, size);
+    }
+    return ptr;
+}
+
+
+void SVMHeap::free (void* ptr)
+{
+    if(!ptr)
+    {
+        return;
+    }
+
+    std::vector<void*>::iterator i = std::find(ptrs.begin(), ptrs.end(), ptr);
+    if(i == ptrs.end())
+    {
+        throw Error("SVMHeap::free: the pointer was not allocated by this heap.");
+    }
+
+    size_t index = i - ptrs.begin();
+    if(mapped && !fine_grain)
+    {
+        cl_int err = clEnqueueSVMUnmap(queue, ptr, 0, 0, 0);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+
+    // The queue may still use the allocation
+    cl_int err = clFinish(queue);
+    SAMPLE_CHECK_ERRORS(err);
+
+    clSVMFree(context, ptr);
+    ptrs.erase(i);
+    sizes.erase(sizes.begin() + index);
+}
+
+
+void SVMHeap::mapOne (void* ptr, size_t size)
+{
+    if(fine_grain)
+    {
+        return;
+    }
+
+    cl_int err = clEnqueueSVMMap(
+        queue,
+        CL_TRUE,       // blocking map
+        CL_MAP_READ | CL_MAP_WRITE,
+        ptr,
+        size,
+        0, 0, 0
+    );
+    SAMPLE_CHECK_ERRORS(err);
+}
+
+
+void SVMHeap::mapForHost ()
+{
+    if(mapped)
+    {
+        return;
+    }
+    for(size_t i = 0; i < ptrs.size(); ++i)
+    {
+        mapOne(ptrs[i], sizes[i]);
+    }
+    mapped = true;
+}
+
+
+void SVMHeap::unmapForDevice ()
+{
+    if(!mapped)
+    {
+        return;
+    }
+    if(!fine_grain)
+    {
+        for(size_t i = 0; i < ptrs.size(); ++i)
+        {
+            cl_int err = clEnqueueSVMUnmap(queue, ptrs[i], 0, 0, 0);
+            SAMPLE_CHECK_ERRORS(err);
+        }
+    }
+    mapped = false;
+}
+
+
+void SVMHeap::setExecInfo (cl_kernel kernel)
+{
+    if(ptrs.empty())
+    {
+        return;
+    }
+
+    cl_int err = clSetKernelExecInfo(
+        kernel,
+        CL_KERNEL_EXEC_INFO_SVM_PTRS,
+        ptrs.size()*sizeof(void*),
+        &ptrs[0]
+    );
+    SAMPLE_CHECK_ERRORS(err);
+}
+
+
+SVMHashMapU32::SVMHashMapU32 (SVMHeap& heap, size_t capacity) :
+    heap(heap)
+{
+    header = (SVMHashMap*)heap.alloc(sizeof(SVMHashMap));
+    header->keys = 0;
+    header->values = 0;
+    header->mask = 0;
+    header->count = 0;
+
+    // Round up to a power of two
+    size_t c = 16;
+    while(c < capacity)
+    {
+        c *= 2;
+    }
+    rehash(c);
+}
+
+
+SVMHashMapU32::~SVMHashMapU32 ()
+{
+    heap.free(header->keys);
+    heap.free(header->values);
+    heap.free(header);
+}
+
+
+void SVMHashMapU32::rehash (size_t capacity)
+{
+    cl_uint* old_keys = header->keys;
+    cl_uint* old_values = header->values;
+    size_t old_capacity = old_keys ? header->mask + 1 : 0;
+
+    header->keys = (cl_uint*)heap.alloc(capacity*sizeof(cl_uint));
+    header->values = (cl_uint*)heap.alloc(capacity*sizeof(cl_uint));
+    header->mask = cl_uint(capacity - 1);
+    header->count = 0;
+    std::fill(header->keys, header->keys + capacity, SVM_HASH_EMPTY);
+
+    for(size_t i = 0; i < old_capacity; ++i)
+    {
+        if(old_keys[i] != SVM_HASH_EMPTY)
+        {
+            insert(old_keys[i], old_values[i]);
+        }
+    }
+
+    heap.free(old_keys);
+    heap.free(old_values);
+}
+
+
+bool SVMHashMapU32::insert (cl_uint key, cl_uint value)
+{
+    if(key == SVM_HASH_EMPTY)
+    {
+        throw Error("SVMHashMapU32::insert: SVM_HASH_EMPTY cannot be used as a key.");
+    }
+
+    if(2*(header->count + 1) > header->mask + 1)
+    {
+        rehash(2*(header->mask + 1));
+    }
+
+    for(cl_uint slot = svm_hash_u32(key) & header->mask; ; slot = (slot + 1) & header->mask)
+    {
+        if(header->keys[slot] == key)
+        {
+            header->values[slot] = value;
+            return false;
+        }
+        if(header->keys[slot] == SVM_HASH_EMPTY)
+        {
+            header->keys[slot] = key;
+            header->values[slot] = value;
+            header->count++;
+            return true;
+        }
+    }
+}
+
+
+bool SVMHashMapU32::find (cl_uint key, cl_uint* value) const
+{
+    for(cl_uint slot = svm_hash_u32(key) & header->mask; ; slot = (slot + 1) & header->mask)
+    {
+        if(header->keys[slot] == key)
+        {
+            *value = header->values[slot];
+            return true;
+        }
+        if(header->keys[slot] == SVM_HASH_EMPTY)
+        {
+            return false;
+        }
+    }
+}
+
+
+SVMCSRGraph::SVMCSRGraph (
+    SVMHeap& heap,
+    cl_uint num_vertices,
+    const std::vector<cl_uint>& from,
+    const std::vector<cl_uint>& to,
+    const std::vector<float>& weights
+) :
+    heap(heap)
+{
+    assert(from.size() == to.size() && from.size() == weights.size());
+    cl_uint num_edges = cl_uint(from.size());
+
+    header = (SVMGraph*)heap.alloc(sizeof(SVMGraph));
+    header->rowOffsets = (cl_uint*)heap.alloc((num_vertices + 1)*sizeof(cl_uint));
+    header->columns = (cl_uint*)heap.alloc(std::max(num_edges, 1u)*sizeof(cl_uint));
+    header->weights = (float*)heap.alloc(std::max(num_edges, 1u)*sizeof(float));
+    header->numVertices = num_vertices;
+    header->numEdges = num_edges;
+
+    // Count the edges per vertex, scan to offsets, then scatter
+    std::fill(header->rowOffsets, header->rowOffsets + num_vertices + 1, 0);
+    for(cl_uint e = 0; e < num_edges; ++e)
+    {
+        header->rowOffsets[from[e] + 1]++;
+    }
+    for(cl_uint v = 0; v < num_vertices; ++v)
+    {
+        header->rowOffsets[v + 1] += header->rowOffsets[v];
+    }
+
+    std::vector<cl_uint> fill(header->rowOffsets, header->rowOffsets + num_vertices);
+    for(cl_uint e = 0; e < num_edges; ++e)
+    {
+        cl_uint slot = fill[from[e]]++;
+        header->columns[slot] = to[e];
+        header->weights[slot] = weights[e];
+    }
+}
+
+
+SVMCSRGraph::~SVMCSRGraph ()
+{
+    heap.free(header->rowOffsets);
+    heap.free(header->columns);
+    heap.free(header->weights);
+    heap.free(header);
+}
+
+
+float SVMCSRGraph::walk (cl_uint v, cl_uint steps) const
+{
+    float sum = 0;
+    for(cl_uint step = 0; step < steps; ++step)
+    {
+        cl_uint d = degree(v);
+        if(d == 0)
+        {
+            break;
+        }
+        cl_uint i = svm_walk_edge(v, step, d);
+        sum += weight(v, i);
+        v = neighbor(v, i);
+    }
+    return sum;
+}
@@ -0,0 +1,58 @@
+// Headers of the SVM containers, shared by the host and the device the same
+// way as svmbasic.h: the host includes this file with 'global' defined empty.
+//
+// Every container is one header structure, allocated in SVM itself, whose
+// pointers lead to further SVM allocations. A kernel receives the address of
+// the header and follows the pointers; the allocations behind them have to be
+// announced with clSetKernelExecInfo (see SVMHeap::setExecInfo).
+
+// Growable array of elementSize-byte elements, see SVM_VECTOR_AT
+typedef struct _SVMVector
+{
+    global void* data;
+    unsigned int size;
+    unsigned int capacity;
+    unsigned int elementSize;
+} SVMVector;
+
+#define SVM_VECTOR_AT(V, T, I) (((global T*)((V)->data))[I])
+
+// Open addressing hash map of 32-bit keys to 32-bit values with linear
+// probing; capacity is a power of two and unused slots hold SVM_HASH_EMPTY
+typedef struct _SVMHashMap
+{
+    global unsigned int* keys;
+    global unsigned int* values;
+    unsigned int mask;          // capacity - 1
+    unsigned int count;
+} SVMHashMap;
+
+#define SVM_HASH_EMPTY 0xFFFFFFFFu
+
+// Directed graph in compressed sparse row form: the edges of vertex v are
+// columns[rowOffsets[v]] .. columns[rowOffsets[v + 1] - 1]
+typedef struct _SVMGraph
+{
+    global unsigned int* rowOffsets;    // numVertices + 1 entries
+    global unsigned int* columns;       // numEdges entries
+    global float* weights;              // numEdges entries
+    unsigned int numVertices;
+    unsigned int numEdges;
+} SVMGraph;
+
+// Final mix of MurmurHash3, the probe start of a key on both sides
+static inline unsigned int svm_hash_u32 (unsigned int k)
+{
+    k ^= k >> 16;
+    k *= 0x85ebca6bu;
+    k ^= k >> 13;
+    k *= 0xc2b2ae35u;
+    k ^= k >> 16;
+    return k;
+}
+
+// Edge a random walk leaves vertex v by at the given step, both sides agree on it
+static inline unsigned int svm_walk_edge (unsigned int v, unsigned int step, unsigned int degree)
+{
+    return svm_hash_u32(v ^ (step * 0x9e3779b9u)) % degree;
+}
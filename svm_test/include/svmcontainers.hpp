@@ -0,0 +1,198 @@
+
+// Host side of the SVM containers: a heap of SVM allocations and vector,
+// hash map and CSR graph containers that live in it, so the very same
+// structures are traversed by the host and by kernels without serialization.
+
+
+#ifndef _INTEL_OPENCL_SAMPLE_SVMCONTAINERS_HPP_
+#define _INTEL_OPENCL_SAMPLE_SVMCONTAINERS_HPP_
+
+#include <CL/cl.h>
+#include <vector>
+#include <cstring>
+
+#include "basic.hpp"
+
+#define global
+#include "svmcontainers.h"
+#undef global
+
+
+// Owner of all SVM allocations of a set of containers.
+//
+// Fine-grained allocations are accessible by the host at any time (outside of
+// kernels writing them). Coarse-grained ones only between mapForHost and
+// unmapForDevice; allocations made in between are mapped on creation, so
+// containers can be built and grown while the heap is mapped.
+class SVMHeap
+{
+public:
+
+    SVMHeap (cl_context context, cl_command_queue queue, bool fine_grain);
+    ~SVMHeap ();
+
+    void* alloc (size_t size);
+    void free (void* ptr);
+
+    void mapForHost ();
+    void unmapForDevice ();
+    bool isMapped () const { return mapped; }
+    bool isFineGrain () const { return fine_grain; }
+
+    // Announces every allocation to the kernel, for the pointers it follows
+    void setExecInfo (cl_kernel kernel);
+
+private:
+
+    cl_context context;
+    cl_command_queue queue;
+    bool fine_grain;
+    bool mapped;
+    std::vector<void*> ptrs;
+    std::vector<size_t> sizes;
+
+    void mapOne (void* ptr, size_t size);
+
+    // Disable copying and assignment to avoid incorrect resource deallocation.
+    SVMHeap (const SVMHeap&);
+    SVMHeap& operator= (const SVMHeap&);
+};
+
+
+// std::vector-like array in SVM. Growing reallocates the data,
+// so pointers into it taken before are invalid afterwards.
+template <typename T>
+class SVMVectorOf
+{
+public:
+
+    SVMVectorOf (SVMHeap& heap, size_t capacity = 16) :
+        heap(heap)
+    {
+        header = (SVMVector*)heap.alloc(sizeof(SVMVector));
+        header->data = 0;
+        header->size = 0;
+        header->capacity = 0;
+        header->elementSize = sizeof(T);
+        reserve(capacity);
+    }
+
+    ~SVMVectorOf ()
+    {
+        heap.free(header->data);
+        heap.free(header);
+    }
+
+    void reserve (size_t capacity)
+    {
+        if(capacity <= header->capacity)
+        {
+            return;
+        }
+        void* data = heap.alloc(capacity*sizeof(T));
+        if(header->data)
+        {
+            std::memcpy(data, header->data, header->size*sizeof(T));
+            heap.free(header->data);
+        }
+        header->data = data;
+        header->capacity = cl_uint(capacity);
+    }
+
+    void resize (size_t size)
+    {
+        reserve(size);
+        header->size = cl_uint(size);
+    }
+
+    void push_back (const T& x)
+    {
+        if(header->size == header->capacity)
+        {
+            reserve(header->capacity ? 2*header->capacity : 1);
+        }
+        data()[header->size++] = x;
+    }
+
+    T* data () { return (T*)header->data; }
+    T& operator[] (size_t i) { return data()[i]; }
+    size_t size () const { return header->size; }
+
+    // Address for clSetKernelArgSVMPointer
+    SVMVector* device () { return header; }
+
+private:
+
+    SVMHeap& heap;
+    SVMVector* header;
+
+    SVMVectorOf (const SVMVectorOf&);
+    SVMVectorOf& operator= (const SVMVectorOf&);
+};
+
+
+// Hash map of cl_uint keys to cl_uint values, open addressing with linear
+// probing; grows to keep the load factor at most 1/2.
+// SVM_HASH_EMPTY cannot be used as a key.
+class SVMHashMapU32
+{
+public:
+
+    SVMHashMapU32 (SVMHeap& heap, size_t capacity = 16);
+    ~SVMHashMapU32 ();
+
+    // Returns false when the key was already there (the value is replaced)
+    bool insert (cl_uint key, cl_uint value);
+    bool find (cl_uint key, cl_uint* value) const;
+
+    size_t size () const { return header->count; }
+    size_t capacity () const { return header->mask + 1; }
+
+    SVMHashMap* device () { return header; }
+
+private:
+
+    SVMHeap& heap;
+    SVMHashMap* header;
+
+    void rehash (size_t capacity);
+
+    SVMHashMapU32 (const SVMHashMapU32&);
+    SVMHashMapU32& operator= (const SVMHashMapU32&);
+};
+
+
+// CSR graph built from an edge list
+class SVMCSRGraph
+{
+public:
+
+    // Edges (from[i], to[i]) with weights[i]; vertices are 0..num_vertices-1
+    SVMCSRGraph (
+        SVMHeap& heap,
+        cl_uint num_vertices,
+        const std::vector<cl_uint>& from,
+        const std::vector<cl_uint>& to,
+        const std::vector<float>& weights
+    );
+    ~SVMCSRGraph ();
+
+    cl_uint degree (cl_uint v) const { return header->rowOffsets[v + 1] - header->rowOffsets[v]; }
+    cl_uint neighbor (cl_uint v, cl_uint i) const { return header->columns[header->rowOffsets[v] + i]; }
+    float weight (cl_uint v, cl_uint i) const { return header->weights[header->rowOffsets[v] + i]; }
+
+    // Sum of the weights along a walk of 'steps' edges, the reference of the graphWalk kernels
+    float walk (cl_uint start, cl_uint steps) const;
+
+    SVMGraph* device () { return header; }
+
+private:
+
+    SVMHeap& heap;
+    SVMGraph* header;
+
+    SVMCSRGraph (const SVMCSRGraph&);
+    SVMCSRGraph& operator= (const SVMCSRGraph&);
+};
+
+#endif  // end of the include guard
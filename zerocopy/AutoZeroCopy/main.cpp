@@ -0,0 +1,226 @@
+
+
+//AutoZeroCopy: the render target and scene buffers come from ZeroCopyAllocator,
+//which picks ALLOC_HOST_PTR, USE_HOST_PTR or copies for the device at hand
+
+#include <stdio.h>
+#include "host_common.h"
+#include "scene.h"					//data structs and utilities associated with the AOBench scene
+#include "zero_copy_allocator.h"
+
+#define NUM_FRAMES 4
+
+ZeroCopyAllocator *g_allocator = NULL;
+ZeroCopyBuffer *g_spheresBuffer = NULL;
+ZeroCopyBuffer *g_planesBuffer = NULL;
+int g_forcedStrategy = -1;			//from the command line, -1 to let the allocator decide
+
+int initializeDeviceData()
+{
+	//initialize host side data
+	g_h = IMAGE_HEIGHT;
+	g_w = IMAGE_WIDTH;
+	g_bAlignedAlloc = false; //the allocator aligns whatever it hands to the runtime
+
+	g_imageSize = sizeof(float) * g_w * g_h * 3;
+
+	//note unsigned char, not float, for ppm file format
+	g_img = (unsigned char *)malloc( g_w * g_h * 3);
+	if(g_img == NULL)
+	{
+		printf("Error in initializeDeviceData(), can't allocate space for resulting image\n");
+		exit(EXIT_FAILURE);
+	}
+	memset((void *)g_img, 0, g_w * g_h * 3);
+
+	initializeScene();
+
+	//g_clDevices is freed at the end of initializeCL, the allocator keeps the id
+	g_allocator = new ZeroCopyAllocator(g_clContext, g_clDevices[0], g_clCommandQueue);
+	if(g_forcedStrategy >= 0)
+	{
+		g_allocator->forceStrategy((ZeroCopyStrategy)g_forcedStrategy);
+	}
+	printf("Buffer strategy: %s, host alignment %u bytes\n", g_allocator->getStrategyName(), (unsigned int)g_allocator->getAlignment());
+
+	//scene data is written through views, no clEnqueueWriteBuffer needed
+	g_spheresBuffer = g_allocator->acquire(sizeof(g_spheres), CL_MEM_READ_ONLY);
+	{
+		ZeroCopyView<sphere> spheres(*g_allocator, g_spheresBuffer, CL_MAP_WRITE);
+		memcpy(spheres.data(), g_spheres, sizeof(g_spheres));
+	}
+	g_planesBuffer = g_allocator->acquire(sizeof(g_plane), CL_MEM_READ_ONLY);
+	{
+		ZeroCopyView<plane> planes(*g_allocator, g_planesBuffer, CL_MAP_WRITE);
+		planes[0] = g_plane;
+	}
+
+	//the render target is allocated here and goes straight back to the pool,
+	//every frame of the render loop reuses it
+	ZeroCopyBuffer *resultImage = g_allocator->acquire(g_imageSize, CL_MEM_READ_WRITE);
+	g_cl_mem_resultImage = resultImage->mem;
+	g_allocator->release(resultImage);
+
+	//cleanupCL() releases these globals, so they hold their own reference
+	g_cl_mem_spheres = g_spheresBuffer->mem;
+	g_cl_mem_planes = g_planesBuffer->mem;
+	clRetainMemObject(g_cl_mem_resultImage);
+	clRetainMemObject(g_cl_mem_spheres);
+	clRetainMemObject(g_cl_mem_planes);
+
+	return SUCCESS;
+}
+
+
+int runCLKernels(void)
+{
+	cl_int status;
+
+	status = clSetKernelArg(cl_kernel_one_pixel, 1, sizeof(cl_mem), (void*)&g_spheresBuffer->mem);
+	testStatus(status, "clSetKernelArg error");
+	status = clSetKernelArg(cl_kernel_one_pixel, 2, sizeof(cl_mem), (void*)&g_planesBuffer->mem);
+	testStatus(status, "clSetKernelArg error");
+	status = clSetKernelArg(cl_kernel_one_pixel, 3, sizeof(cl_int), (void*)&g_h);
+	testStatus(status, "clSetKernelArg error");
+	status = clSetKernelArg(cl_kernel_one_pixel, 4, sizeof(cl_int), (void*)&g_w);
+	testStatus(status, "clSetKernelArg error");
+	status = clSetKernelArg(cl_kernel_one_pixel, 5, sizeof(cl_int), (void*)&g_numSubSamples);
+	testStatus(status, "clSetKernelArg error");
+
+	//Create the NDRange
+	size_t global_dim[2];
+	global_dim[0] = g_h;
+	global_dim[1] = g_w;
+
+	//a render loop, the target is acquired and released every frame
+	for(unsigned int frame = 0; frame < NUM_FRAMES; frame++)
+	{
+		ZeroCopyBuffer *resultImage = g_allocator->acquire(g_imageSize, CL_MEM_READ_WRITE);
+
+		status = clSetKernelArg(cl_kernel_one_pixel, 0, sizeof(cl_mem), (void*)&resultImage->mem);
+		testStatus(status, "clSetKernelArg error");
+
+		//launch Kernel, letting runtime select the wg size
+		status = clEnqueueNDRangeKernel(g_clCommandQueue, cl_kernel_one_pixel, 2, NULL, global_dim, NULL, 0, NULL, NULL);
+		testStatus(status, "clEnqueueNDRangeKernel error");
+
+		clFinish(g_clCommandQueue);
+
+		auto start = chrono::system_clock::now();
+		{
+			ZeroCopyView<float> pixels(*g_allocator, resultImage, CL_MAP_READ);
+			auto end   = chrono::system_clock::now();
+			auto duration = chrono::duration_cast< chrono::microseconds >(end - start);
+			cout << "frame " << frame << ": map takes " << double( duration.count() / 1000.0 ) << " ms" << endl;
+
+			//convert fp values to integer for final image
+			for(unsigned int i = 0; i < g_w * g_h * 3; i++)
+			{
+				g_img[i] = clamp(pixels[i]);
+			}
+		}
+
+		g_allocator->release(resultImage);
+	}
+	printf("%u buffer(s) allocated, %u acquire(s) served from the pool\n", g_allocator->getAllocations(), g_allocator->getPoolHits());
+
+	return status;
+}
+
+
+int cleanupAllocator()
+{
+	g_allocator->release(g_spheresBuffer);
+	g_allocator->release(g_planesBuffer);
+	g_spheresBuffer = g_planesBuffer = NULL;
+
+	//drops the pool, the globals still hold a reference for cleanupCL
+	delete g_allocator;
+	g_allocator = NULL;
+
+	return SUCCESS;
+}
+
+int cleanupHost()
+{
+	//cleanup the mallocd buffers
+	if(g_clProgramString != NULL)
+	{
+		free(g_clProgramString);
+		g_clProgramString = NULL;
+	}
+
+	if(g_img != NULL)
+	{
+		free(g_img);
+		g_img = NULL;
+	}
+
+	return SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	//optional override of the automatic choice: alloc, use or copy
+	if(argc > 1)
+	{
+		if(!strcmp(argv[1], "alloc"))
+		{
+			g_forcedStrategy = ZC_ALLOC_HOST_PTR;
+		}
+		else if(!strcmp(argv[1], "use"))
+		{
+			g_forcedStrategy = ZC_USE_HOST_PTR;
+		}
+		else if(!strcmp(argv[1], "copy"))
+		{
+			g_forcedStrategy = ZC_COPY;
+		}
+		else
+		{
+			printf("Usage: %s [alloc|use|copy]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if(initializeHost() != SUCCESS)
+	{
+		printf("Error when initializing host\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(initializeCL() != SUCCESS)
+	{
+		printf("Error when initializing OpenCL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(runCLKernels() != SUCCESS)
+	{
+		printf("Error when running CL kernels\n");
+		exit(EXIT_FAILURE);
+	}
+
+	savePPM();
+
+	if(cleanupAllocator() != SUCCESS)
+	{
+		printf("Error when cleaning up the allocator\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(cleanupCL() != SUCCESS)
+	{
+		printf("Error when cleaning up OpenCL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(cleanupHost() != SUCCESS)
+	{
+		printf("Error when cleaning up host\n");
+		exit(EXIT_FAILURE);
+	}
+	printf("Success! Exiting now...\n");
+
+	return 0;
+}
@@ -0,0 +1,323 @@
+
+
+//ProgressiveAO: the AO scene, plus any number of small spheres, rendered over
+//a BVH in passes that accumulate across launches. The image is split into
+//tiles, every pass only visits the tiles that have not converged yet.
+
+#include <stdio.h>
+#include <vector>
+#include "host_common.h"
+#include "scene.h"					//data structs and utilities associated with the AOBench scene
+#include "zero_copy_allocator.h"
+#include "bvh.h"
+
+//scene and convergence settings, see parseArgs
+int g_numExtraSpheres = 256;		//small spheres scattered on the plane
+int g_maxPasses = 256;
+int g_minPasses = 8;				//passes before a tile may converge
+int g_aoSamples = 8;				//occlusion rays per pixel and pass
+float g_threshold = 0.01f;			//standard error of the mean that counts as converged
+unsigned int g_seed = 1234;
+
+ZeroCopyAllocator *g_allocator = NULL;
+ZeroCopyBuffer *g_accumBuffer = NULL;
+ZeroCopyBuffer *g_imageBuffer = NULL;
+ZeroCopyBuffer *g_activeBuffer = NULL;
+ZeroCopyBuffer *g_tileErrBuffer = NULL;
+ZeroCopyBuffer *g_nodesBuffer = NULL;
+ZeroCopyBuffer *g_sceneSpheresBuffer = NULL;
+ZeroCopyBuffer *g_scenePlanesBuffer = NULL;
+int g_numPlanes = 1;
+int g_tilesX, g_tilesY;
+
+void buildScene(std::vector<sphere> &spheres, std::vector<bvh_node> &nodes)
+{
+	//the three spheres of the original scene
+	spheres.assign(g_spheres, g_spheres + 3);
+
+	srand(g_seed);
+	for(int i = 0; i < g_numExtraSpheres; i++)
+	{
+		sphere s;
+		s.radius = 0.05f + 0.15f * rand() / (float)RAND_MAX;
+		s.center.x = -3.0f + 6.0f * rand() / (float)RAND_MAX;
+		s.center.y = g_plane.p.y + s.radius;
+		s.center.z = -6.0f + 4.5f * rand() / (float)RAND_MAX;
+		spheres.push_back(s);
+	}
+
+	int depth = buildSphereBVH(spheres, nodes);
+	printf("Scene: %u spheres, %d plane(s), BVH of %u nodes and depth %d\n", (unsigned int)spheres.size(), g_numPlanes, (unsigned int)nodes.size(), depth);
+	if(depth >= 32)
+	{
+		printf("BVH deeper than the traversal stack of the kernel, raise BVH_STACK_SIZE\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+int initializeDeviceData()
+{
+	//initialize host side data
+	g_h = IMAGE_HEIGHT;
+	g_w = IMAGE_WIDTH;
+	g_bAlignedAlloc = false; //the allocator aligns whatever it hands to the runtime
+
+	g_imageSize = sizeof(float) * g_w * g_h * 3;
+	g_tilesX = (g_w + TILE_SIZE - 1) / TILE_SIZE;
+	g_tilesY = (g_h + TILE_SIZE - 1) / TILE_SIZE;
+
+	//note unsigned char, not float, for ppm file format
+	g_img = (unsigned char *)malloc( g_w * g_h * 3);
+	if(g_img == NULL)
+	{
+		printf("Error in initializeDeviceData(), can't allocate space for resulting image\n");
+		exit(EXIT_FAILURE);
+	}
+	memset((void *)g_img, 0, g_w * g_h * 3);
+
+	initializeScene();
+	std::vector<sphere> spheres;
+	std::vector<bvh_node> nodes;
+	buildScene(spheres, nodes);
+
+	//g_clDevices is freed at the end of initializeCL, the allocator keeps the id
+	g_allocator = new ZeroCopyAllocator(g_clContext, g_clDevices[0], g_clCommandQueue);
+	printf("Buffer strategy: %s\n", g_allocator->getStrategyName());
+
+	unsigned int numTiles = g_tilesX * g_tilesY;
+	g_accumBuffer = g_allocator->acquire(sizeof(cl_float4) * g_w * g_h, CL_MEM_READ_WRITE);
+	g_imageBuffer = g_allocator->acquire(g_imageSize, CL_MEM_READ_WRITE);
+	g_activeBuffer = g_allocator->acquire(sizeof(cl_int) * numTiles, CL_MEM_READ_ONLY);
+	g_tileErrBuffer = g_allocator->acquire(sizeof(cl_float) * numTiles, CL_MEM_WRITE_ONLY);
+	g_nodesBuffer = g_allocator->acquire(sizeof(bvh_node) * nodes.size(), CL_MEM_READ_ONLY);
+	g_sceneSpheresBuffer = g_allocator->acquire(sizeof(sphere) * spheres.size(), CL_MEM_READ_ONLY);
+	g_scenePlanesBuffer = g_allocator->acquire(sizeof(plane) * g_numPlanes, CL_MEM_READ_ONLY);
+
+	{
+		ZeroCopyView<cl_float4> accum(*g_allocator, g_accumBuffer, CL_MAP_WRITE);
+		memset(accum.data(), 0, sizeof(cl_float4) * accum.size());
+		ZeroCopyView<float> image(*g_allocator, g_imageBuffer, CL_MAP_WRITE);
+		memset(image.data(), 0, g_imageSize);
+		ZeroCopyView<bvh_node> nodeView(*g_allocator, g_nodesBuffer, CL_MAP_WRITE);
+		memcpy(nodeView.data(), &nodes[0], sizeof(bvh_node) * nodes.size());
+		ZeroCopyView<sphere> sphereView(*g_allocator, g_sceneSpheresBuffer, CL_MAP_WRITE);
+		memcpy(sphereView.data(), &spheres[0], sizeof(sphere) * spheres.size());
+		ZeroCopyView<plane> planeView(*g_allocator, g_scenePlanesBuffer, CL_MAP_WRITE);
+		planeView[0] = g_plane;
+	}
+
+	//cleanupCL() releases these globals, so they hold their own reference
+	g_cl_mem_resultImage = g_imageBuffer->mem;
+	g_cl_mem_spheres = g_sceneSpheresBuffer->mem;
+	g_cl_mem_planes = g_scenePlanesBuffer->mem;
+	clRetainMemObject(g_cl_mem_resultImage);
+	clRetainMemObject(g_cl_mem_spheres);
+	clRetainMemObject(g_cl_mem_planes);
+
+	return SUCCESS;
+}
+
+
+int runCLKernels(void)
+{
+	cl_int status;
+
+	cl_kernel traceKernel = clCreateKernel(g_clProgram, "traceTileProgressive", &status);
+	testStatus(status, "clCreateKernel error");
+	cl_kernel errorKernel = clCreateKernel(g_clProgram, "tileError", &status);
+	testStatus(status, "clCreateKernel error");
+
+	status  = clSetKernelArg(traceKernel, 0, sizeof(cl_mem), (void*)&g_accumBuffer->mem);
+	status |= clSetKernelArg(traceKernel, 1, sizeof(cl_mem), (void*)&g_imageBuffer->mem);
+	status |= clSetKernelArg(traceKernel, 2, sizeof(cl_mem), (void*)&g_activeBuffer->mem);
+	status |= clSetKernelArg(traceKernel, 3, sizeof(cl_mem), (void*)&g_nodesBuffer->mem);
+	status |= clSetKernelArg(traceKernel, 4, sizeof(cl_mem), (void*)&g_sceneSpheresBuffer->mem);
+	status |= clSetKernelArg(traceKernel, 5, sizeof(cl_mem), (void*)&g_scenePlanesBuffer->mem);
+	status |= clSetKernelArg(traceKernel, 6, sizeof(cl_int), (void*)&g_numPlanes);
+	status |= clSetKernelArg(traceKernel, 7, sizeof(cl_int), (void*)&g_w);
+	status |= clSetKernelArg(traceKernel, 8, sizeof(cl_int), (void*)&g_h);
+	status |= clSetKernelArg(traceKernel, 10, sizeof(cl_uint), (void*)&g_seed);
+	status |= clSetKernelArg(traceKernel, 11, sizeof(cl_int), (void*)&g_aoSamples);
+	testStatus(status, "clSetKernelArg error");
+
+	status  = clSetKernelArg(errorKernel, 0, sizeof(cl_mem), (void*)&g_accumBuffer->mem);
+	status |= clSetKernelArg(errorKernel, 1, sizeof(cl_mem), (void*)&g_activeBuffer->mem);
+	status |= clSetKernelArg(errorKernel, 2, sizeof(cl_mem), (void*)&g_tileErrBuffer->mem);
+	status |= clSetKernelArg(errorKernel, 3, sizeof(cl_int), (void*)&g_w);
+	status |= clSetKernelArg(errorKernel, 4, sizeof(cl_int), (void*)&g_h);
+	testStatus(status, "clSetKernelArg error");
+
+	//every tile starts out active
+	std::vector<int> active(g_tilesX * g_tilesY);
+	for(unsigned int i = 0; i < active.size(); i++)
+	{
+		active[i] = i;
+	}
+
+	unsigned long long pixelPasses = 0;
+	unsigned int pass = 0;
+	auto start = chrono::system_clock::now();
+	while(!active.empty() && pass < (unsigned int)g_maxPasses)
+	{
+		cl_int numActive = (cl_int)active.size();
+		{
+			ZeroCopyView<int> activeView(*g_allocator, g_activeBuffer, CL_MAP_WRITE);
+			memcpy(activeView.data(), &active[0], sizeof(int) * numActive);
+		}
+
+		status = clSetKernelArg(traceKernel, 9, sizeof(cl_uint), (void*)&pass);
+		testStatus(status, "clSetKernelArg error");
+
+		size_t global_dim[2];
+		global_dim[0] = TILE_SIZE * TILE_SIZE;
+		global_dim[1] = numActive;
+		status = clEnqueueNDRangeKernel(g_clCommandQueue, traceKernel, 2, NULL, global_dim, NULL, 0, NULL, NULL);
+		testStatus(status, "clEnqueueNDRangeKernel error");
+		pixelPasses += (unsigned long long)numActive * TILE_SIZE * TILE_SIZE;
+		pass++;
+
+		if(pass < (unsigned int)g_minPasses)
+		{
+			continue;
+		}
+
+		//drop the tiles whose error fell below the threshold
+		status = clSetKernelArg(errorKernel, 5, sizeof(cl_int), (void*)&numActive);
+		testStatus(status, "clSetKernelArg error");
+		size_t errorGlobal = numActive;
+		status = clEnqueueNDRangeKernel(g_clCommandQueue, errorKernel, 1, NULL, &errorGlobal, NULL, 0, NULL, NULL);
+		testStatus(status, "clEnqueueNDRangeKernel error");
+
+		ZeroCopyView<float> tileErr(*g_allocator, g_tileErrBuffer, CL_MAP_READ);
+		std::vector<int> stillActive;
+		for(unsigned int i = 0; i < active.size(); i++)
+		{
+			if(tileErr[active[i]] > g_threshold)
+			{
+				stillActive.push_back(active[i]);
+			}
+		}
+		active.swap(stillActive);
+	}
+	clFinish(g_clCommandQueue);
+	auto end   = chrono::system_clock::now();
+	auto duration = chrono::duration_cast< chrono::microseconds >(end - start);
+
+	unsigned long long fullPasses = (unsigned long long)pass * g_tilesX * g_tilesY * TILE_SIZE * TILE_SIZE;
+	printf("%u passes, %u of %u tiles still active, %.1f%% of the pixel passes of a full render\n",
+		pass, (unsigned int)active.size(), g_tilesX * g_tilesY, 100.0 * pixelPasses / (double)fullPasses);
+	cout << "rendering takes " << double( duration.count() / 1000.0 ) << " ms" << endl;
+
+	//convert fp values to integer for final image
+	{
+		ZeroCopyView<float> pixels(*g_allocator, g_imageBuffer, CL_MAP_READ);
+		for(unsigned int i = 0; i < g_w * g_h * 3; i++)
+		{
+			g_img[i] = clamp(pixels[i]);
+		}
+	}
+
+	clReleaseKernel(traceKernel);
+	clReleaseKernel(errorKernel);
+	return status;
+}
+
+
+int cleanupAllocator()
+{
+	g_allocator->release(g_accumBuffer);
+	g_allocator->release(g_imageBuffer);
+	g_allocator->release(g_activeBuffer);
+	g_allocator->release(g_tileErrBuffer);
+	g_allocator->release(g_nodesBuffer);
+	g_allocator->release(g_sceneSpheresBuffer);
+	g_allocator->release(g_scenePlanesBuffer);
+
+	//drops the pool, the globals still hold a reference for cleanupCL
+	delete g_allocator;
+	g_allocator = NULL;
+
+	return SUCCESS;
+}
+
+int cleanupHost()
+{
+	//cleanup the mallocd buffers
+	if(g_clProgramString != NULL)
+	{
+		free(g_clProgramString);
+		g_clProgramString = NULL;
+	}
+
+	if(g_img != NULL)
+	{
+		free(g_img);
+		g_img = NULL;
+	}
+
+	return SUCCESS;
+}
+
+void parseArgs(int argc, char **argv)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		if(sscanf(argv[i], "--spheres=%d", &g_numExtraSpheres) == 1) continue;
+		if(sscanf(argv[i], "--passes=%d", &g_maxPasses) == 1) continue;
+		if(sscanf(argv[i], "--min-passes=%d", &g_minPasses) == 1) continue;
+		if(sscanf(argv[i], "--ao=%d", &g_aoSamples) == 1) continue;
+		if(sscanf(argv[i], "--threshold=%f", &g_threshold) == 1) continue;
+		if(sscanf(argv[i], "--seed=%u", &g_seed) == 1) continue;
+
+		printf("Usage: %s [--spheres=N] [--passes=N] [--min-passes=N] [--ao=N] [--threshold=F] [--seed=N]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	g_minPasses = (g_minPasses < 2) ? 2 : g_minPasses;
+	g_aoSamples = (g_aoSamples < 1) ? 1 : g_aoSamples;
+}
+
+int main(int argc, char **argv)
+{
+	parseArgs(argc, argv);
+
+	if(initializeHost() != SUCCESS)
+	{
+		printf("Error when initializing host\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(initializeCL() != SUCCESS)
+	{
+		printf("Error when initializing OpenCL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(runCLKernels() != SUCCESS)
+	{
+		printf("Error when running CL kernels\n");
+		exit(EXIT_FAILURE);
+	}
+
+	savePPM();
+
+	if(cleanupAllocator() != SUCCESS)
+	{
+		printf("Error when cleaning up the allocator\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(cleanupCL() != SUCCESS)
+	{
+		printf("Error when cleaning up OpenCL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(cleanupHost() != SUCCESS)
+	{
+		printf("Error when cleaning up host\n");
+		exit(EXIT_FAILURE);
+	}
+	printf("Success! Exiting now...\n");
+
+	return 0;
+}
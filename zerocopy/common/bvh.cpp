@@ -0,0 +1,85 @@
+
+#include "bvh.h"
+#include <algorithm>
+#include <float.h>
+
+static float axisOf(const vec3 &v, int axis)
+{
+	return (axis == 0) ? v.x : (axis == 1) ? v.y : v.z;
+}
+
+static int buildNode(std::vector<sphere> &spheres, std::vector<bvh_node> &nodes, int nodeIndex, int begin, int end)
+{
+	bvh_node node;
+	float cmin[3] = { FLT_MAX,  FLT_MAX,  FLT_MAX};
+	float cmax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	for(int a = 0; a < 3; a++)
+	{
+		node.bmin[a] = FLT_MAX;
+		node.bmax[a] = -FLT_MAX;
+	}
+
+	//bounds of the spheres and of their centers
+	for(int i = begin; i < end; i++)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			float c = axisOf(spheres[i].center, a);
+			node.bmin[a] = std::min(node.bmin[a], c - spheres[i].radius);
+			node.bmax[a] = std::max(node.bmax[a], c + spheres[i].radius);
+			cmin[a] = std::min(cmin[a], c);
+			cmax[a] = std::max(cmax[a], c);
+		}
+	}
+
+	if(end - begin <= BVH_LEAF_SIZE)
+	{
+		node.first = begin;
+		node.count = end - begin;
+		nodes[nodeIndex] = node;
+		return 1;
+	}
+
+	int axis = 0;
+	for(int a = 1; a < 3; a++)
+	{
+		if(cmax[a] - cmin[a] > cmax[axis] - cmin[axis])
+		{
+			axis = a;
+		}
+	}
+
+	int mid = (begin + end) / 2;
+	std::nth_element(spheres.begin() + begin, spheres.begin() + mid, spheres.begin() + end,
+		[axis](const sphere &s0, const sphere &s1) { return axisOf(s0.center, axis) < axisOf(s1.center, axis); });
+
+	//children are always allocated as a pair, right = left + 1
+	int left = (int)nodes.size();
+	nodes.resize(nodes.size() + 2);
+	node.first = left;
+	node.count = 0;
+	nodes[nodeIndex] = node;
+
+	int depthLeft = buildNode(spheres, nodes, left, begin, mid);
+	int depthRight = buildNode(spheres, nodes, left + 1, mid, end);
+	return 1 + std::max(depthLeft, depthRight);
+}
+
+int buildSphereBVH(std::vector<sphere> &spheres, std::vector<bvh_node> &nodes)
+{
+	nodes.clear();
+	nodes.resize(1);
+	if(spheres.empty())
+	{
+		//an empty box never passes the slab test
+		for(int a = 0; a < 3; a++)
+		{
+			nodes[0].bmin[a] = FLT_MAX;
+			nodes[0].bmax[a] = -FLT_MAX;
+		}
+		nodes[0].first = 0;
+		nodes[0].count = 0;
+		return 1;
+	}
+	return buildNode(spheres, nodes, 0, 0, (int)spheres.size());
+}
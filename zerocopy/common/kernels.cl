@@ -365,6 +365,234 @@ kernel void traceOnePixel(global float *fimg, constant sphere *spheres, constant
 }
 
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Progressive, tiled renderer over a BVH scene
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//must stay same as in scene.h
+#define TILE_SIZE 16
+#define BVH_STACK_SIZE 32
+
+typedef struct _bvh_node
+{
+	float bmin[3];
+	int first;		//first sphere of a leaf, left child of an interior node (right child is first + 1)
+	float bmax[3];
+	int count;		//spheres in a leaf, 0 for interior nodes
+} bvh_node;
+
+//Philox4x32-10 counter based generator, the counter names the draw so every
+//pixel, pass and sample has its own independent numbers with no state to keep
+uint4 philox4x32_10(uint4 ctr, uint2 key)
+{
+	for(int r = 0; r < 10; r++)
+	{
+		uint lo0 = 0xD2511F53u * ctr.x;
+		uint hi0 = mul_hi(0xD2511F53u, ctr.x);
+		uint lo1 = 0xCD9E8D57u * ctr.z;
+		uint hi1 = mul_hi(0xCD9E8D57u, ctr.z);
+		ctr = (uint4)(hi1 ^ ctr.y ^ key.x, lo1, hi0 ^ ctr.w ^ key.y, lo0);
+		key += (uint2)(0x9E3779B9u, 0xBB67AE85u);
+	}
+	return ctr;
+}
+
+//four uniforms in (0, 1)
+float4 rand4(uint pixel, uint pass, uint draw, uint seed)
+{
+	uint4 r = philox4x32_10((uint4)(pixel, pass, draw, 0), (uint2)(seed, 0x414F));
+	return convert_float4(r >> 8) * (1.0f / 16777216.0f) + (0.5f / 16777216.0f);
+}
+
+int ray_box_hit(ray *r, vec3 *invDir, global const bvh_node *node, float tmax)
+{
+	float orig[3] = {r->orig.x, r->orig.y, r->orig.z};
+	float inv[3] = {invDir->x, invDir->y, invDir->z};
+	float t0 = 0.0f;
+	float t1 = tmax;
+
+	for(int a = 0; a < 3; a++)
+	{
+		float tn = (node->bmin[a] - orig[a]) * inv[a];
+		float tf = (node->bmax[a] - orig[a]) * inv[a];
+		t0 = fmax(t0, fmin(tn, tf));
+		t1 = fmin(t1, fmax(tn, tf));
+	}
+	return t0 <= t1;
+}
+
+//closest hit, or any hit at all for occlusion rays
+void scene_intersect(intersect_pt *isect, ray *r, global const bvh_node *nodes, global const sphere *spheres,
+					 global const plane *planes, int numPlanes, int anyHit)
+{
+	for(int i = 0; i < numPlanes; i++)
+	{
+		plane pl = planes[i];
+		ray_plane_intersect(isect, r, &pl);
+		if(anyHit && isect->hit) return;
+	}
+
+	vec3 invDir;
+	invDir.x = 1.0f / r->dir.x;
+	invDir.y = 1.0f / r->dir.y;
+	invDir.z = 1.0f / r->dir.z;
+
+	int stack[BVH_STACK_SIZE];
+	int sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0)
+	{
+		global const bvh_node *node = &nodes[stack[--sp]];
+		if(!ray_box_hit(r, &invDir, node, isect->t)) continue;
+
+		if(node->count > 0)
+		{
+			for(int i = 0; i < node->count; i++)
+			{
+				sphere s = spheres[node->first + i];
+				ray_sphere_intersect(isect, r, &s);
+				if(anyHit && isect->hit) return;
+			}
+		}
+		else if(sp + 2 <= BVH_STACK_SIZE)
+		{
+			stack[sp++] = node->first + 1;
+			stack[sp++] = node->first;
+		}
+	}
+}
+
+float ambient_occlusion_bvh(intersect_pt *isect, global const bvh_node *nodes, global const sphere *spheres,
+							global const plane *planes, int numPlanes, uint pixel, uint pass, uint seed, int aoSamples)
+{
+	float eps = .0001f;
+	vec3 p;
+	vec3 basis[3];
+	int occluded = 0;
+
+	p.x = isect->p.x + eps * isect->n.x;
+	p.y = isect->p.y + eps * isect->n.y;
+	p.z = isect->p.z + eps * isect->n.z;
+
+	orthoBasis(basis, &(isect->n));
+
+	//draw 0 is the camera jitter, every further draw feeds two directions
+	for(int i = 0; i < aoSamples; i += 2)
+	{
+		float4 u = rand4(pixel, pass, 1 + i / 2, seed);
+		for(int k = 0; k < 2 && i + k < aoSamples; k++)
+		{
+			float theta = sqrt(k ? u.z : u.x);
+			float phi = 2.0f * (float)M_PI * (k ? u.w : u.y);
+
+			float x = cos(phi) * theta;
+			float y = sin(phi) * theta;
+			float z = sqrt(1.0f - theta * theta);
+
+			ray ray1;
+			intersect_pt occ_intersect;
+
+			ray1.orig = p;
+			ray1.dir.x = x * basis[0].x + y * basis[1].x + z * basis[2].x;
+			ray1.dir.y = x * basis[0].y + y * basis[1].y + z * basis[2].y;
+			ray1.dir.z = x * basis[0].z + y * basis[1].z + z * basis[2].z;
+
+			occ_intersect.t = 1.0e+17f;
+			occ_intersect.hit = 0;
+
+			scene_intersect(&occ_intersect, &ray1, nodes, spheres, planes, numPlanes, 1);
+			occluded += occ_intersect.hit;
+		}
+	}
+
+	return (aoSamples - occluded) / (float)aoSamples;
+}
+
+//One pass over the active tiles: dimension 0 is the pixel inside the tile,
+//dimension 1 the entry of the active tile list. Every pass adds one jittered
+//camera sample with aoSamples occlusion rays to the running sums of a pixel
+//(x = sum, y = sum of squares, z = samples) and writes the mean to fimg.
+kernel void traceTileProgressive(global float4 *accum, global float *fimg, global const int *activeTiles,
+								 global const bvh_node *nodes, global const sphere *spheres, global const plane *planes,
+								 int numPlanes, int w, int h, uint pass, uint seed, int aoSamples)
+{
+	int tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	int tile = activeTiles[get_global_id(1)];
+	int x = (tile % tilesX) * TILE_SIZE + get_global_id(0) % TILE_SIZE;
+	int y = (tile / tilesX) * TILE_SIZE + get_global_id(0) / TILE_SIZE;
+
+	if(x >= w || y >= h) return;
+	uint pixel = y * w + x;
+
+	float4 u = rand4(pixel, pass, 0, seed);
+	float px = (x + u.x - (w/2.0f)) / (w/2.0f);
+	float py = -(y + u.y - (h/2.0f)) / (h/2.0f);
+
+	ray ray1;
+	intersect_pt isect;
+
+	ray1.orig.x = 0.0f;
+	ray1.orig.y = 0.0f;
+	ray1.orig.z = 0.0f;
+
+	ray1.dir.x = px;
+	ray1.dir.y = py;
+	ray1.dir.z = -1.0f;
+	vnormalize(&ray1.dir);
+
+	isect.t = 1.0e+17f;
+	isect.hit = 0;
+
+	scene_intersect(&isect, &ray1, nodes, spheres, planes, numPlanes, 0);
+
+	float ao = 0.0f;
+	if(isect.hit)
+	{
+		ao = ambient_occlusion_bvh(&isect, nodes, spheres, planes, numPlanes, pixel, pass, seed, aoSamples);
+	}
+
+	float4 a = accum[pixel] + (float4)(ao, ao * ao, 1.0f, 0.0f);
+	accum[pixel] = a;
+
+	float mean = a.x / a.z;
+	fimg[3 * pixel + 0] = mean;
+	fimg[3 * pixel + 1] = mean;
+	fimg[3 * pixel + 2] = mean;
+}
+
+//Largest standard error of the mean over the pixels of every active tile,
+//a tile is converged once the host sees it below the threshold
+kernel void tileError(global const float4 *accum, global const int *activeTiles, global float *tileErr,
+					  int w, int h, int numActive)
+{
+	int i = get_global_id(0);
+	if(i >= numActive) return;
+
+	int tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	int tile = activeTiles[i];
+	int x0 = (tile % tilesX) * TILE_SIZE;
+	int y0 = (tile / tilesX) * TILE_SIZE;
+
+	float err = 0.0f;
+	for(int y = y0; y < min(y0 + TILE_SIZE, h); y++)
+	{
+		for(int x = x0; x < min(x0 + TILE_SIZE, w); x++)
+		{
+			float4 a = accum[y * w + x];
+			if(a.z < 2.0f)
+			{
+				err = MAXFLOAT;
+				continue;
+			}
+			float mean = a.x / a.z;
+			float var = fmax(a.y - a.z * mean * mean, 0.0f) / (a.z - 1.0f);
+			err = fmax(err, sqrt(var / a.z));
+		}
+	}
+	tileErr[tile] = err;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 // STUFF FOR LATER
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,264 @@
+
+#include "host_common.h"
+#include "zero_copy_allocator.h"
+
+ZeroCopyAllocator::ZeroCopyAllocator(cl_context context, cl_device_id device, cl_command_queue queue)
+	: m_context(context), m_device(device), m_queue(queue),
+	  m_bWarnedCopy(false), m_allocations(0), m_poolHits(0)
+{
+	cl_int status;
+	cl_device_type deviceType = 0;
+	cl_bool bUnified = CL_FALSE;
+	cl_uint baseAddrAlignBits = 0;
+
+	status = clGetDeviceInfo(m_device, CL_DEVICE_TYPE, sizeof(deviceType), &deviceType, NULL);
+	testStatus(status, "clGetDeviceInfo error");
+	status = clGetDeviceInfo(m_device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(baseAddrAlignBits), &baseAddrAlignBits, NULL);
+	testStatus(status, "clGetDeviceInfo error");
+
+	//deprecated by OpenCL 2.0 but still answered, a failure simply means not unified
+	if(clGetDeviceInfo(m_device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(bUnified), &bUnified, NULL) != CL_SUCCESS)
+	{
+		bUnified = CL_FALSE;
+	}
+
+	//the base address alignment is reported in bits
+	m_alignment = baseAddrAlignBits / 8;
+	if(m_alignment < ZC_PAGE_SIZE)
+	{
+		m_alignment = ZC_PAGE_SIZE;
+	}
+
+	//a CPU runtime works on the host pointer itself, an integrated GPU shares
+	//memory the driver allocates, anything else has to copy
+	if(deviceType & CL_DEVICE_TYPE_CPU)
+	{
+		m_strategy = ZC_USE_HOST_PTR;
+	}
+	else if(bUnified)
+	{
+		m_strategy = ZC_ALLOC_HOST_PTR;
+	}
+	else
+	{
+		m_strategy = ZC_COPY;
+	}
+}
+
+ZeroCopyAllocator::~ZeroCopyAllocator()
+{
+	if(!m_used.empty())
+	{
+		printf("ZeroCopyAllocator: %u buffer(s) still in use at destruction\n", (unsigned int)m_used.size());
+	}
+	for(size_t i = 0; i < m_used.size(); i++)
+	{
+		destroy(m_used[i]);
+	}
+	m_used.clear();
+	purge();
+}
+
+void ZeroCopyAllocator::forceStrategy(ZeroCopyStrategy strategy)
+{
+	purge();
+	m_strategy = strategy;
+}
+
+const char *ZeroCopyAllocator::getStrategyName() const
+{
+	switch(m_strategy)
+	{
+	case ZC_ALLOC_HOST_PTR:
+		return "CL_MEM_ALLOC_HOST_PTR";
+	case ZC_USE_HOST_PTR:
+		return "CL_MEM_USE_HOST_PTR";
+	default:
+		return "copy";
+	}
+}
+
+ZeroCopyBuffer *ZeroCopyAllocator::create(size_t capacity, cl_mem_flags flags)
+{
+	cl_int status;
+	ZeroCopyBuffer *buffer = new ZeroCopyBuffer;
+	buffer->strategy = m_strategy;
+	buffer->host = NULL;
+	buffer->capacity = capacity;
+	buffer->flags = flags;
+	buffer->mapped = NULL;
+	buffer->mapFlags = 0;
+
+	if(m_strategy == ZC_ALLOC_HOST_PTR)
+	{
+		buffer->mem = clCreateBuffer(m_context, flags | CL_MEM_ALLOC_HOST_PTR, capacity, NULL, &status);
+	}
+	else
+	{
+		buffer->host = aligned_malloc(capacity, m_alignment);
+		if(buffer->host == NULL)
+		{
+			printf("Error in ZeroCopyAllocator, can't allocate %u bytes of host memory\n", (unsigned int)capacity);
+			exit(EXIT_FAILURE);
+		}
+		memset(buffer->host, 0, capacity);
+
+		if(m_strategy == ZC_USE_HOST_PTR)
+		{
+			buffer->mem = clCreateBuffer(m_context, flags | CL_MEM_USE_HOST_PTR, capacity, buffer->host, &status);
+		}
+		else
+		{
+			buffer->mem = clCreateBuffer(m_context, flags, capacity, NULL, &status);
+		}
+	}
+	testStatus(status, "clCreateBuffer error");
+
+	m_allocations++;
+	return buffer;
+}
+
+void ZeroCopyAllocator::destroy(ZeroCopyBuffer *buffer)
+{
+	clReleaseMemObject(buffer->mem);
+	if(buffer->host != NULL)
+	{
+		aligned_free(buffer->host);
+	}
+	delete buffer;
+}
+
+ZeroCopyBuffer *ZeroCopyAllocator::acquire(size_t size, cl_mem_flags flags)
+{
+	size_t capacity = (size + ZC_SIZE_MULTIPLE - 1) / ZC_SIZE_MULTIPLE * ZC_SIZE_MULTIPLE;
+
+	//smallest pooled buffer that fits without wasting more than half of it
+	size_t best = m_free.size();
+	for(size_t i = 0; i < m_free.size(); i++)
+	{
+		ZeroCopyBuffer *candidate = m_free[i];
+		if(candidate->flags != flags || candidate->capacity < capacity || candidate->capacity > 2 * capacity)
+		{
+			continue;
+		}
+		if(best == m_free.size() || candidate->capacity < m_free[best]->capacity)
+		{
+			best = i;
+		}
+	}
+
+	ZeroCopyBuffer *buffer;
+	if(best < m_free.size())
+	{
+		buffer = m_free[best];
+		m_free.erase(m_free.begin() + best);
+		m_poolHits++;
+	}
+	else
+	{
+		buffer = create(capacity, flags);
+	}
+	buffer->size = size;
+	m_used.push_back(buffer);
+	return buffer;
+}
+
+void ZeroCopyAllocator::release(ZeroCopyBuffer *buffer)
+{
+	if(buffer == NULL)
+	{
+		return;
+	}
+	if(buffer->mapped != NULL)
+	{
+		unmap(buffer);
+	}
+	for(size_t i = 0; i < m_used.size(); i++)
+	{
+		if(m_used[i] == buffer)
+		{
+			m_used.erase(m_used.begin() + i);
+			m_free.push_back(buffer);
+			return;
+		}
+	}
+	printf("ZeroCopyAllocator: released a buffer it does not own\n");
+}
+
+void ZeroCopyAllocator::purge()
+{
+	//commands on pooled buffers may still be in flight
+	clFinish(m_queue);
+	for(size_t i = 0; i < m_free.size(); i++)
+	{
+		destroy(m_free[i]);
+	}
+	m_free.clear();
+}
+
+void *ZeroCopyAllocator::map(ZeroCopyBuffer *buffer, cl_map_flags flags)
+{
+	cl_int status;
+	if(buffer->mapped != NULL)
+	{
+		printf("ZeroCopyAllocator: buffer is already mapped\n");
+		exit(EXIT_FAILURE);
+	}
+	buffer->mapFlags = flags;
+
+	if(buffer->strategy == ZC_COPY)
+	{
+		//only a pure write-invalidate map may skip reading the current contents
+		bool bRead = true;
+#ifdef CL_MAP_WRITE_INVALIDATE_REGION
+		bRead = (flags != CL_MAP_WRITE_INVALIDATE_REGION);
+#endif
+		if(bRead)
+		{
+			status = clEnqueueReadBuffer(m_queue, buffer->mem, CL_TRUE, 0, buffer->size, buffer->host, 0, NULL, NULL);
+			testStatus(status, "clEnqueueReadBuffer error");
+		}
+		buffer->mapped = buffer->host;
+		return buffer->mapped;
+	}
+
+	buffer->mapped = clEnqueueMapBuffer(m_queue, buffer->mem, CL_TRUE, flags, 0, buffer->size, 0, NULL, NULL, &status);
+	testStatus(status, "clEnqueueMapBuffer error");
+
+	//a runtime is free to shadow a USE_HOST_PTR buffer, then every map copies
+	if(buffer->strategy == ZC_USE_HOST_PTR && buffer->mapped != buffer->host && !m_bWarnedCopy)
+	{
+		printf("ZeroCopyAllocator: map did not return the host pointer, the runtime copies\n");
+		m_bWarnedCopy = true;
+	}
+	return buffer->mapped;
+}
+
+void ZeroCopyAllocator::unmap(ZeroCopyBuffer *buffer)
+{
+	cl_int status;
+	if(buffer->mapped == NULL)
+	{
+		return;
+	}
+
+	if(buffer->strategy == ZC_COPY)
+	{
+		cl_map_flags writeFlags = CL_MAP_WRITE;
+#ifdef CL_MAP_WRITE_INVALIDATE_REGION
+		writeFlags |= CL_MAP_WRITE_INVALIDATE_REGION;
+#endif
+		//blocking, the host may touch the shadow again right away
+		if(buffer->mapFlags & writeFlags)
+		{
+			status = clEnqueueWriteBuffer(m_queue, buffer->mem, CL_TRUE, 0, buffer->size, buffer->host, 0, NULL, NULL);
+			testStatus(status, "clEnqueueWriteBuffer error");
+		}
+	}
+	else
+	{
+		status = clEnqueueUnmapMemObject(m_queue, buffer->mem, buffer->mapped, 0, NULL, NULL);
+		testStatus(status, "clEnqueueUnmapMemObject error");
+	}
+	buffer->mapped = NULL;
+}
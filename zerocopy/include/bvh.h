@@ -0,0 +1,14 @@
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include "scene.h"
+
+//Builds a BVH over the spheres by median splits along the longest axis of the
+//centroid bounds, reordering the spheres so every leaf owns a contiguous range.
+//nodes[0] is the root, an empty scene gets a root with an empty box.
+//Returns the depth of the tree.
+int buildSphereBVH(std::vector<sphere> &spheres, std::vector<bvh_node> &nodes);
+
+#endif
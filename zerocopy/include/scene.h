@@ -39,6 +39,18 @@ typedef struct _ray
 	vec3 dir;
 } ray;
 
+//BVH over the spheres of a scene, planes are unbounded and tested separately
+#define TILE_SIZE 16
+#define BVH_LEAF_SIZE 4
+
+typedef struct _bvh_node
+{
+	float bmin[3];
+	int first;		//first sphere of a leaf, left child of an interior node (right child is first + 1)
+	float bmax[3];
+	int count;		//spheres in a leaf, 0 for interior nodes
+} bvh_node;
+
 
 //THese are not used host side, placeholders for now, remove before shipping if not needed
 //NEED TO GO TO A SCENE.CPP FILE IF NEEDED
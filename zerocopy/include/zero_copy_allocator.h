@@ -0,0 +1,121 @@
+
+#ifndef ZERO_COPY_ALLOCATOR_H
+#define ZERO_COPY_ALLOCATOR_H
+
+#include <CL/cl.h>
+#include <vector>
+
+//host allocations handed to CL_MEM_USE_HOST_PTR are at least page aligned and
+//buffer sizes are a multiple of a cache line, the rules for zero copy on Intel Processor Graphics
+#define ZC_PAGE_SIZE 4096
+#define ZC_SIZE_MULTIPLE 64
+
+//how the host and the device share a buffer
+enum ZeroCopyStrategy
+{
+	ZC_ALLOC_HOST_PTR,	//runtime allocates host visible memory, map returns it (integrated GPUs)
+	ZC_USE_HOST_PTR,	//aligned host memory wrapped by the runtime (CPU devices)
+	ZC_COPY				//device memory and a host shadow, map and unmap copy (discrete GPUs)
+};
+
+struct ZeroCopyBuffer
+{
+	cl_mem mem;
+	ZeroCopyStrategy strategy;	//how the buffer was created, map and unmap follow it
+	void *host;				//USE_HOST_PTR backing store or COPY shadow, NULL for ALLOC_HOST_PTR
+	size_t size;			//bytes asked for by the last acquire
+	size_t capacity;		//bytes allocated
+	cl_mem_flags flags;		//access flags the buffer was created with
+	void *mapped;			//pointer of the live view, NULL when not mapped
+	cl_map_flags mapFlags;
+};
+
+//Hands out buffers that are zero copy wherever the device allows it. The
+//strategy is picked once per device from its type and CL_DEVICE_HOST_UNIFIED_MEMORY,
+//released buffers go back to a pool and are reused by later acquires of the
+//same access flags and a similar size.
+class ZeroCopyAllocator
+{
+public:
+	ZeroCopyAllocator(cl_context context, cl_device_id device, cl_command_queue queue);
+	~ZeroCopyAllocator();
+
+	//override the automatic choice for buffers created from now on, empties
+	//the pool; buffers in use keep the strategy they were created with
+	void forceStrategy(ZeroCopyStrategy strategy);
+	ZeroCopyStrategy getStrategy() const { return m_strategy; }
+	const char *getStrategyName() const;
+	size_t getAlignment() const { return m_alignment; }
+
+	ZeroCopyBuffer *acquire(size_t size, cl_mem_flags flags);
+	void release(ZeroCopyBuffer *buffer);
+	//free every pooled buffer that is not in use
+	void purge();
+
+	//blocking map of buffer->size bytes, use ZeroCopyView instead of calling these directly
+	void *map(ZeroCopyBuffer *buffer, cl_map_flags flags);
+	void unmap(ZeroCopyBuffer *buffer);
+
+	unsigned int getAllocations() const { return m_allocations; }
+	unsigned int getPoolHits() const { return m_poolHits; }
+
+private:
+	ZeroCopyAllocator(const ZeroCopyAllocator &) = delete;
+	ZeroCopyAllocator &operator=(const ZeroCopyAllocator &) = delete;
+
+	ZeroCopyBuffer *create(size_t capacity, cl_mem_flags flags);
+	void destroy(ZeroCopyBuffer *buffer);
+
+	cl_context m_context;
+	cl_device_id m_device;
+	cl_command_queue m_queue;
+	ZeroCopyStrategy m_strategy;
+	size_t m_alignment;
+	bool m_bWarnedCopy;
+	unsigned int m_allocations;
+	unsigned int m_poolHits;
+	std::vector<ZeroCopyBuffer *> m_free;
+	std::vector<ZeroCopyBuffer *> m_used;
+};
+
+//Maps a buffer for the lifetime of the view, the unmap (and for ZC_COPY the
+//write back) happens when the view goes out of scope.
+template <typename T>
+class ZeroCopyView
+{
+public:
+	ZeroCopyView(ZeroCopyAllocator &allocator, ZeroCopyBuffer *buffer, cl_map_flags flags)
+		: m_allocator(&allocator), m_buffer(buffer)
+	{
+		m_ptr = (T *)allocator.map(buffer, flags);
+	}
+
+	ZeroCopyView(ZeroCopyView &&other)
+		: m_allocator(other.m_allocator), m_buffer(other.m_buffer), m_ptr(other.m_ptr)
+	{
+		other.m_buffer = NULL;
+		other.m_ptr = NULL;
+	}
+
+	~ZeroCopyView()
+	{
+		if(m_buffer != NULL)
+		{
+			m_allocator->unmap(m_buffer);
+		}
+	}
+
+	T *data() { return m_ptr; }
+	size_t size() const { return m_buffer->size / sizeof(T); }
+	T &operator[](size_t i) { return m_ptr[i]; }
+
+private:
+	ZeroCopyView(const ZeroCopyView &) = delete;
+	ZeroCopyView &operator=(const ZeroCopyView &) = delete;
+
+	ZeroCopyAllocator *m_allocator;
+	ZeroCopyBuffer *m_buffer;
+	T *m_ptr;
+};
+
+#endif